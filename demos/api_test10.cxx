@@ -0,0 +1,117 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using namespace Timbl;
+
+int main(){
+  TimblAPI My_Experiment( "-a IB1 +vdb+di -k3 -mM", "test10" );
+  My_Experiment.Learn( "dimin.train" );
+  vector<string> lines;
+  std::ifstream is( "dimin.test" );
+  string line;
+  while ( std::getline( is, line ) ){
+    lines.push_back( line );
+  }
+  // the reference: classify the old-fashioned way
+  vector<string> expected;
+  for ( const auto& l : lines ){
+    string cat;
+    string dist;
+    double distance;
+    My_Experiment.Classify( l, cat, dist, distance );
+    expected.push_back( cat + " " + dist );
+  }
+  // a tiny scheduler: 4 searches, each getting 20 leaves per turn
+  vector<ClassifySearch *> searches;
+  vector<size_t> todo;
+  for ( int i=0; i < 4; ++i ){
+    searches.push_back( My_Experiment.NewClassifySearch() );
+    todo.push_back( lines.size() );
+  }
+  size_t next = 0;
+  size_t busy = 0;
+  size_t errors = 0;
+  size_t steps = 0;
+  do {
+    busy = 0;
+    for ( size_t i=0; i < searches.size(); ++i ){
+      if ( todo[i] == lines.size() ){
+	if ( next == lines.size() ){
+	  continue;
+	}
+	todo[i] = next++;
+	searches[i]->start( lines[todo[i]] );
+      }
+      ++busy;
+      ++steps;
+      if ( searches[i]->step( 20 ) ){
+	string cat;
+	string dist;
+	double distance;
+	searches[i]->result( cat, dist, distance );
+	if ( searches[i]->incomplete()
+	     || cat + " " + dist != expected[todo[i]] ){
+	  ++errors;
+	}
+	todo[i] = lines.size();
+      }
+    }
+  } while ( busy > 0 );
+  cout << "classified " << lines.size() << " instances in " << steps
+       << " steps, " << errors << " differences" << endl;
+  // a very tight budget: only 1 leaf per query
+  size_t cut = 0;
+  for ( size_t i=0; i < 10; ++i ){
+    searches[0]->start( lines[i] );
+    searches[0]->step( 1 );
+    string cat;
+    string dist;
+    double distance;
+    if ( !searches[0]->result( cat, dist, distance ) ){
+      ++errors;
+    }
+    if ( searches[0]->incomplete() ){
+      ++cut;
+    }
+  }
+  cout << "with a budget of 1 leaf, " << cut << " of 10 were incomplete"
+       << endl;
+  for ( const auto& s : searches ){
+    delete s;
+  }
+  return errors == 0 ? 0 : 1;
+}
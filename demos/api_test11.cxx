@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static bool same_file( const string& f1, const string& f2 ){
+  std::ifstream is1( f1 );
+  std::ifstream is2( f2 );
+  string l1;
+  string l2;
+  while ( std::getline( is1, l1 ) ){
+    if ( !std::getline( is2, l2 ) || l1 != l2 ){
+      return false;
+    }
+  }
+  return !std::getline( is2, l2 );
+}
+
+int main(){
+  // convert to a binary instance file and back
+  TimblAPI Converter( "", "convert" );
+  if ( !Converter.ConvertInstances( "dimin.train", "dimin.bin" )
+       || !Converter.ConvertInstances( "dimin.test", "dimin.test.bin" ) ){
+    return 1;
+  }
+  TimblAPI Back( "", "back" );
+  if ( !Back.ConvertInstances( "dimin.bin", "dimin.train.txt" ) ){
+    return 1;
+  }
+  bool round_trip = same_file( "dimin.train", "dimin.train.txt" );
+  cout << "round trip " << ( round_trip ? "OK" : "FAILED" ) << endl;
+  // learning and testing from the binary files gives the same results
+  TimblAPI Text_Experiment( "-a IB1 +vdb+di -k3 -mM", "text" );
+  Text_Experiment.Learn( "dimin.train" );
+  Text_Experiment.Test( "dimin.test", "dimin.text.out" );
+  TimblAPI Bin_Experiment( "-a IB1 +vdb+di -k3 -mM", "binary" );
+  Bin_Experiment.Learn( "dimin.bin" );
+  Bin_Experiment.Test( "dimin.test.bin", "dimin.bin.out" );
+  bool same = same_file( "dimin.text.out", "dimin.bin.out" );
+  cout << "binary results " << ( same ? "OK" : "DIFFERENT" ) << endl;
+  return round_trip && same ? 0 : 1;
+}
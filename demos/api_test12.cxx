@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+// count every heap allocation the program makes
+static std::atomic<size_t> allocations( 0 );
+
+void *operator new( size_t size ){
+  ++allocations;
+  void *p = std::malloc( size ? size : 1 );
+  if ( !p ){
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete( void *p ) noexcept {
+  std::free( p );
+}
+
+void operator delete( void *p, size_t ) noexcept {
+  std::free( p );
+}
+
+static void repeat_file( const string& in, const string& out, int times ){
+  std::ofstream os( out );
+  for ( int i=0; i < times; ++i ){
+    std::ifstream is( in );
+    string line;
+    while ( std::getline( is, line ) ){
+      os << line << "\n";
+    }
+  }
+}
+
+static size_t count_test( TimblAPI& exp, const string& file ){
+  size_t start = allocations;
+  exp.Test( file, "alloc.out" );
+  return allocations - start;
+}
+
+int main(){
+  // once the experiment has seen the test data, classifying more
+  // instances should not allocate any more memory
+  repeat_file( "dimin.test", "alloc1.test", 1 );
+  repeat_file( "dimin.test", "alloc2.test", 2 );
+  TimblAPI Exp( "-a IB1 -mO +vS", "alloc" );
+  Exp.Learn( "dimin.train" );
+  count_test( Exp, "alloc1.test" );
+  size_t once = count_test( Exp, "alloc1.test" );
+  size_t twice = count_test( Exp, "alloc2.test" );
+  cout << "allocations for 950 instances: " << once
+       << ", for 1900 instances: " << twice << endl;
+  std::remove( "alloc1.test" );
+  std::remove( "alloc2.test" );
+  std::remove( "alloc.out" );
+  if ( twice != once ){
+    cout << "extra allocations per instance: "
+	 << double( twice - once ) / 950 << endl;
+    return 1;
+  }
+  cout << "no allocations per instance" << endl;
+  return 0;
+}
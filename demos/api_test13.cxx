@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <filesystem>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static bool same_file( const string& f1, const string& f2 ){
+  std::ifstream is1( f1 );
+  std::ifstream is2( f2 );
+  string l1, l2;
+  while ( std::getline( is1, l1 ) ){
+    if ( !std::getline( is2, l2 ) || l1 != l2 ){
+      return false;
+    }
+  }
+  return !std::getline( is2, l2 );
+}
+
+static size_t delta_lines( const string& f ){
+  std::ifstream is( f );
+  string line;
+  size_t count = 0;
+  while ( std::getline( is, line ) ){
+    if ( !line.empty() && line[0] != '#' ){
+      ++count;
+    }
+  }
+  return count;
+}
+
+static bool check( const string& tree, const string& expected ){
+  // a fresh experiment, restarted from the snapshot and its delta log,
+  // should classify exactly like the one that made the changes
+  TimblAPI Exp( "-a IB1 +vS", "restart" );
+  Exp.GetInstanceBase( tree );
+  Exp.Test( "dimin.test", "delta.2.out" );
+  return same_file( expected, "delta.2.out" );
+}
+
+int main(){
+  const char *updates[] = { "=,=,=,=,+,k,e,=,-,r,@,l,T",
+			    "+,zw,A,rt,-,k,O,p,-,n,O,n,E",
+			    "=,=,=,=,=,=,=,=,+,l,a,m,P",
+			    "-,sx,I,n,-,d,@,=,+,k,E,r,K",
+			    "=,=,=,=,+,b,O,l,+,d,e,r,T" };
+  TimblAPI Exp( "-a IB1 +vS", "delta" );
+  Exp.Learn( "dimin.train" );
+  Exp.WriteSnapshot( "delta.tree" );
+  for ( const auto& u : updates ){
+    Exp.Increment( u );
+  }
+  Exp.Decrement( updates[1] );
+  Exp.Decrement( "+,r,i,=,-,j,a,=,-,b,e,lt,J" );
+  Exp.Test( "dimin.test", "delta.1.out" );
+  bool ok = check( "delta.tree", "delta.1.out" );
+  cout << "replayed " << delta_lines( "delta.tree.delta" )
+       << " changes: " << ( ok ? "same" : "DIFFERENT" ) << endl;
+  // a snapshot that can't be written leaves the old one and its log
+  std::filesystem::create_directory( "delta.tree.tmp" );
+  bool kept_ok = !Exp.WriteSnapshot( "delta.tree" )
+    && check( "delta.tree", "delta.1.out" );
+  std::filesystem::remove( "delta.tree.tmp" );
+  cout << "failed snapshot: " << ( kept_ok ? "old one kept" : "LOST" ) << endl;
+  // with a limit of 3, the 5 updates are compacted once
+  Exp.WriteSnapshot( "delta.tree", 3 );
+  for ( const auto& u : updates ){
+    Exp.Increment( u );
+  }
+  Exp.Test( "dimin.test", "delta.1.out" );
+  bool compact_ok = check( "delta.tree", "delta.1.out" )
+    && delta_lines( "delta.tree.delta" ) == 2;
+  cout << "after compaction " << delta_lines( "delta.tree.delta" )
+       << " changes left: " << ( compact_ok ? "same" : "DIFFERENT" ) << endl;
+  // another tree of the same size in the place of the snapshot must not
+  // get the log replayed: the log is tied to the contents
+  string tree;
+  {
+    std::ifstream is( "delta.tree", std::ios::binary );
+    std::getline( is, tree, '\0' );
+  }
+  tree.replace( tree.find( "# Status:" ), 9, "# STATUS:" );
+  std::ofstream( "delta.tree", std::ios::binary ) << tree;
+  TimblAPI Other( "-a IB1 +vS", "other" );
+  Other.GetInstanceBase( "delta.tree" );
+  Other.Test( "dimin.test", "delta.1.out" );
+  std::rename( "delta.tree.delta", "delta.tree.delta.kept" );
+  bool ignored_ok = check( "delta.tree", "delta.1.out" );
+  std::rename( "delta.tree.delta.kept", "delta.tree.delta" );
+  cout << "log of another snapshot: "
+       << ( ignored_ok ? "ignored" : "REPLAYED" ) << endl;
+  for ( const auto& f : { "delta.tree", "delta.tree.delta", "delta.tree.idx",
+			  "delta.1.out", "delta.2.out" } ){
+    std::remove( f );
+  }
+  return ( ok && kept_ok && compact_ok && ignored_ok ) ? 0 : 1;
+}
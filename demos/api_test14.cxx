@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <set>
+#include <cstdio>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static bool same( const string& what, const string& f1, const string& f2 ){
+  bool result = contents( f1 ) == contents( f2 );
+  cout << what << ": " << ( result ? "same" : "DIFFERENT" ) << endl;
+  return result;
+}
+
+static bool same_matrices( const string& f1, const string& f2 ){
+  // the text matrices list their pairs in memory order, so compare them
+  // as sets of unordered pairs
+  std::set<string> entries[2];
+  const string files[2] = { f1, f2 };
+  for ( int i=0; i < 2; ++i ){
+    std::ifstream is( files[i] );
+    string feature;
+    string line;
+    while ( std::getline( is, line ) ){
+      string::size_type comma = line.find( ",\t" );
+      string::size_type close = line.find( "] " );
+      if ( line.empty() || line[0] != '[' || comma == string::npos
+	   || close == string::npos ){
+	feature = line;
+	continue;
+      }
+      string v1 = line.substr( 1, comma-1 );
+      string v2 = line.substr( comma+2, close-comma-2 );
+      if ( v2 < v1 ){
+	std::swap( v1, v2 );
+      }
+      entries[i].insert( feature + " " + v1 + " " + v2 + " "
+			 + line.substr( close+2 ) );
+    }
+  }
+  bool result = entries[0] == entries[1];
+  cout << "text matrices: " << ( result ? "same" : "DIFFERENT" ) << endl;
+  return result;
+}
+
+int main(){
+  const string opts = "-a IB1 -mM -k3 +vS";
+  // the reference: text tables and the output of the trained experiment
+  TimblAPI Text( opts, "text" );
+  Text.Learn( "dimin.train" );
+  Text.SaveWeights( "tab.wgt" );
+  Text.WriteArrays( "tab.arr" );
+  Text.WriteMatrices( "tab.mat" );
+  Text.Test( "dimin.test", "tab.1.out" );
+  // the same tables in binary
+  TimblAPI Bin( opts + " --binary-tables=true", "binary" );
+  Bin.Learn( "dimin.train" );
+  Bin.SaveWeights( "tab.bwgt" );
+  Bin.WriteArrays( "tab.barr" );
+  Bin.WriteMatrices( "tab.bmat" );
+  // reading the binary tables restores the exact values, so the
+  // classifications are the same and writing them again, in text or in
+  // binary, gives the same files
+  TimblAPI Reread( opts, "reread" );
+  Reread.Learn( "dimin.train" );
+  Reread.GetWeights( "tab.bwgt", GR );
+  Reread.GetArrays( "tab.barr" );
+  Reread.GetMatrices( "tab.bmat" );
+  Reread.Test( "dimin.test", "tab.2.out" );
+  Reread.WriteArrays( "tab.arr2" );
+  Reread.WriteMatrices( "tab.mat2" );
+  TimblAPI Rebin( opts + " --binary-tables=true", "rebinary" );
+  Rebin.Learn( "dimin.train" );
+  Rebin.GetArrays( "tab.barr" );
+  Rebin.GetMatrices( "tab.bmat" );
+  Rebin.WriteArrays( "tab.barr2" );
+  Rebin.WriteMatrices( "tab.bmat2" );
+  bool ok = same( "test output", "tab.1.out", "tab.2.out" );
+  ok = same( "text arrays", "tab.arr", "tab.arr2" ) && ok;
+  ok = same_matrices( "tab.mat", "tab.mat2" ) && ok;
+  ok = same( "binary arrays", "tab.barr", "tab.barr2" ) && ok;
+  ok = same( "binary matrices", "tab.bmat", "tab.bmat2" ) && ok;
+  for ( const auto& f : { "tab.wgt", "tab.arr", "tab.mat", "tab.bwgt",
+			  "tab.barr", "tab.bmat", "tab.arr2", "tab.mat2",
+			  "tab.barr2", "tab.bmat2", "tab.1.out", "tab.2.out" } ){
+    std::remove( f );
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static bool test_tree( const string& tree,
+		       const string& opts,
+		       const string& lazy ){
+  // classify with a tree read as a whole, and with the same tree read
+  // lazily. The output must be the same
+  TimblAPI Full( opts, "full" );
+  Full.GetInstanceBase( tree );
+  Full.Test( "dimin.test", "lazy.1.out" );
+  TimblAPI Lazy( opts + " " + lazy, "lazy" );
+  Lazy.GetInstanceBase( tree );
+  Lazy.Test( "dimin.test", "lazy.2.out" );
+  bool result = Full.Valid() && Lazy.Valid()
+    && contents( "lazy.1.out" ) == contents( "lazy.2.out" );
+  cout << tree << " " << opts << " " << lazy << ": "
+       << ( result ? "same" : "DIFFERENT" ) << endl;
+  std::remove( "lazy.1.out" );
+  std::remove( "lazy.2.out" );
+  return result;
+}
+
+int main(){
+  TimblAPI Train( "-a IGTREE +D", "train" );
+  Train.Learn( "dimin.train" );
+  Train.WriteInstanceBase( "lazy.tree" );
+  TimblAPI Hashed( "-a IGTREE +D -H", "hashed" );
+  Hashed.Learn( "dimin.train" );
+  Hashed.WriteInstanceBase( "lazy.htree" );
+  TimblAPI Tribl( "-a TRIBL -q 2", "tribl" );
+  Tribl.Learn( "dimin.train" );
+  Tribl.WriteInstanceBase( "lazy.ttree" );
+  TimblAPI TriblHashed( "-a TRIBL -q 2 -H", "tribl hashed" );
+  TriblHashed.Learn( "dimin.train" );
+  TriblHashed.WriteInstanceBase( "lazy.thtree" );
+  bool ok = true;
+  for ( const auto& tree : { "lazy.tree", "lazy.htree" } ){
+    // keep every subtree, and keep only a few hundred bytes of them,
+    // so most subtrees are read again and again
+    ok = test_tree( tree, "-a IGTREE +D +vdb", "--lazy" ) && ok;
+    ok = test_tree( tree, "-a IGTREE +D +vdb", "--lazy=0.0005" ) && ok;
+  }
+  for ( const auto& tree : { "lazy.ttree", "lazy.thtree" } ){
+    // TRIBL and TRIBL2 only stay lazy without weights that need every
+    // value, the last one reads the rest of the tree before testing
+    for ( const auto& opts : { "-a TRIBL -q 2 -w 0 +vdb",
+			       "-a TRIBL -q 2 -w 0 +D +vdb",
+			       "-a TRIBL2 -w 0 +vdb",
+			       "-a TRIBL -q 2 +vdb" } ){
+      ok = test_tree( tree, opts, "--lazy" ) && ok;
+      ok = test_tree( tree, opts, "--lazy=0.0005" ) && ok;
+    }
+  }
+  for ( const auto& f : { "lazy.tree", "lazy.tree.idx", "lazy.tree.wgt",
+			  "lazy.htree", "lazy.htree.idx", "lazy.htree.wgt",
+			  "lazy.ttree", "lazy.ttree.idx", "lazy.ttree.wgt",
+			  "lazy.thtree", "lazy.thtree.idx",
+			  "lazy.thtree.wgt" } ){
+    std::remove( f );
+  }
+  return ok ? 0 : 1;
+}
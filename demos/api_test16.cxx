@@ -0,0 +1,77 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static bool test_bundle( const string& opts, const string& algo ){
+  // train with 'opts' and store a bundle. An experiment which only knows
+  // the algorithm must classify exactly the same from that bundle
+  TimblAPI Train( opts, "train" );
+  Train.Learn( "dimin.train" );
+  Train.Test( "dimin.test", "bundle.1.out" );
+  Train.WriteBundle( "dimin.bdl" );
+  TimblAPI Copy( "-a " + algo, "copy" );
+  Copy.GetInstanceBase( "dimin.bdl" );
+  Copy.Test( "dimin.test", "bundle.2.out" );
+  bool result = Train.Valid() && Copy.Valid()
+    && contents( "bundle.1.out" ) == contents( "bundle.2.out" );
+  cout << opts << ": " << ( result ? "same" : "DIFFERENT" ) << endl;
+  std::remove( "bundle.1.out" );
+  std::remove( "bundle.2.out" );
+  return result;
+}
+
+int main(){
+  bool ok = test_bundle( "-a IB1 -mM -k3 -dIL", "IB1" );
+  ok = test_bundle( "-a TRIBL -q2 -mJ", "TRIBL" ) && ok;
+  ok = test_bundle( "-a IGTREE +D", "IGTREE" ) && ok;
+  // flip one byte in the last section, it must be refused
+  string data = contents( "dimin.bdl" );
+  data[data.size()-100] ^= 1;
+  std::ofstream( "dimin.bdl", std::ios::binary ) << data;
+  TimblAPI Bad( "-a IGTREE", "bad" );
+  bool refused = !Bad.GetInstanceBase( "dimin.bdl" );
+  cout << "damaged bundle: " << ( refused ? "refused" : "ACCEPTED" ) << endl;
+  std::remove( "dimin.bdl" );
+  return ( ok && refused ) ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static bool test_compact( const string& opts ){
+  // read a tree stored with distributions and test it, before and
+  // after compacting. The output must be exactly the same
+  TimblAPI Exp( opts, "compact" );
+  Exp.GetInstanceBase( "dimin.tree" );
+  Exp.Test( "dimin.test", "compact.1.out" );
+  Exp.CompactInstanceBase();
+  Exp.Test( "dimin.test", "compact.2.out" );
+  bool result = Exp.Valid()
+    && contents( "compact.1.out" ) == contents( "compact.2.out" );
+  cout << opts << ": " << ( result ? "same" : "DIFFERENT" ) << endl;
+  std::remove( "compact.1.out" );
+  std::remove( "compact.2.out" );
+  return result;
+}
+
+static bool same_output( TimblAPI& one, TimblAPI& two ){
+  one.Test( "dimin.test", "shared.1.out" );
+  two.Test( "dimin.test", "shared.2.out" );
+  bool result = one.Valid() && two.Valid()
+    && contents( "shared.1.out" ) == contents( "shared.2.out" );
+  std::remove( "shared.1.out" );
+  std::remove( "shared.2.out" );
+  return result;
+}
+
+static bool test_shared( const string& opts, bool change ){
+  // a tree that is read shares equal leaf distributions. Testing, and
+  // changing it, must give the same as with the tree that was learned
+  TimblAPI Learned( opts, "learned" );
+  Learned.Learn( "dimin.train" );
+  Learned.WriteInstanceBase( "shared.tree" );
+  TimblAPI Read( opts, "read" );
+  Read.GetInstanceBase( "shared.tree" );
+  bool result = same_output( Learned, Read );
+  if ( change ){
+    // a leaf that shares its distribution gets its own one to change
+    for ( auto *exp : { &Learned, &Read } ){
+      exp->Decrement( "=,=,=,=,+,k,e,=,-,r,@,l,T" );
+      exp->Increment( "=,=,=,=,+,k,e,=,-,r,@,l,E" );
+      exp->Increment( "=,=,=,=,+,k,e,=,-,r,@,l,E" );
+    }
+    result = same_output( Learned, Read ) && result;
+  }
+  cout << opts << " shared: " << ( result ? "same" : "DIFFERENT" ) << endl;
+  std::remove( "shared.tree" );
+  std::remove( "shared.tree.idx" );
+  return result;
+}
+
+static bool test_ranked( const string& opts, bool change ){
+  // with --frequency-order the value lists of the tree are in another
+  // order, but testing and changing it must give the same. A tree written
+  // in that order is put back in order when it is read without the option
+  TimblAPI Plain( opts, "plain" );
+  Plain.Learn( "dimin.train" );
+  Plain.WriteInstanceBase( "plain.tree" );
+  TimblAPI Ranked( opts + " --frequency-order", "ranked" );
+  Ranked.Learn( "dimin.train" );
+  Ranked.WriteInstanceBase( "ranked.tree" );
+  TimblAPI Read( opts, "read" );
+  Read.GetInstanceBase( "ranked.tree" );
+  bool result = contents( "plain.tree" ) != contents( "ranked.tree" )
+    && same_output( Plain, Ranked )
+    && same_output( Plain, Read );
+  if ( change ){
+    for ( auto *exp : { &Plain, &Ranked, &Read } ){
+      // with a value that wasn't seen before
+      exp->Increment( "=,=,=,=,+,k,e,=,-,r,@,x,E" );
+      exp->Increment( "=,=,=,=,+,k,e,=,-,r,@,l,E" );
+    }
+    result = same_output( Plain, Ranked ) && same_output( Plain, Read )
+      && result;
+  }
+  // the tree that was read is in the order of the one learned without it
+  Plain.WriteInstanceBase( "plain.tree" );
+  Read.WriteInstanceBase( "ranked.tree" );
+  result = contents( "plain.tree" ) == contents( "ranked.tree" ) && result;
+  cout << opts << " ranked: " << ( result ? "same" : "DIFFERENT" ) << endl;
+  for ( const auto& f : { "plain.tree", "plain.tree.idx",
+			  "ranked.tree", "ranked.tree.idx" } ){
+    std::remove( f );
+  }
+  return result;
+}
+
+int main(){
+  TimblAPI Train( "-a IGTREE +D", "train" );
+  Train.Learn( "dimin.train" );
+  Train.WriteInstanceBase( "dimin.tree" );
+  bool ok = test_compact( "-a IGTREE" );
+  ok = test_compact( "-a IGTREE +D +vdb" ) && ok;
+  ok = test_shared( "-a IB1", true ) && ok;
+  ok = test_shared( "-a IB1 +D", true ) && ok;
+  ok = test_shared( "-a TRIBL -q 2", false ) && ok;
+  ok = test_ranked( "-a IB1", true ) && ok;
+  ok = test_ranked( "-a IB1 +D", true ) && ok;
+  ok = test_ranked( "-a TRIBL -q 2", false ) && ok;
+  std::remove( "dimin.tree" );
+  std::remove( "dimin.tree.idx" );
+  std::remove( "dimin.tree.wgt" );
+  return ok ? 0 : 1;
+}
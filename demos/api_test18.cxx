@@ -0,0 +1,135 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <cstdio>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static string reference( const string& opts, const string& out ){
+  // train from scratch with the same options
+  TimblAPI Exp( "-a IB1 " + opts, "reference" );
+  Exp.Learn( "dimin.train" );
+  Exp.Test( "dimin.test", out );
+  string result = contents( out );
+  std::remove( out.c_str() );
+  return result;
+}
+
+int main(){
+  TimblAPI Parent( "-a IB1", "parent" );
+  Parent.Learn( "dimin.train" );
+  Parent.Test( "dimin.test", "fork.out" );
+  string parent_out = contents( "fork.out" );
+  bool ok = true;
+  // a fork without changes should give the same results
+  std::unique_ptr<TimblAPI> Fork = Parent.Fork();
+  if ( !Fork || !Fork->Test( "dimin.test", "fork.out" )
+       || contents( "fork.out" ) != parent_out ){
+    ok = false;
+  }
+  // and is not allowed to change the shared InstanceBase
+  if ( Fork && Fork->Increment( "=,=,=,=,+,k,e,=,-,r,@,l,T" ) ){
+    ok = false;
+  }
+  // neither is the parent, while the fork exists
+  if ( Parent.Increment( "=,=,=,=,+,k,e,=,-,r,@,l,T" )
+       || Parent.SetOptions( "-k3" ) ){
+    ok = false;
+  }
+  Fork.reset();
+  cout << "plain fork: " << ( ok ? "same" : "DIFFERENT" ) << endl;
+  // a fork keeps the shared experiment alive
+  TimblAPI *Origin = new TimblAPI( "-a IB1", "origin" );
+  Origin->Learn( "dimin.train" );
+  Fork = Origin->Fork();
+  delete Origin;
+  bool alive = Fork && Fork->Test( "dimin.test", "fork.out" )
+    && contents( "fork.out" ) == parent_out;
+  Fork.reset();
+  cout << "orphaned fork: " << ( alive ? "same" : "DIFFERENT" ) << endl;
+  ok = ok && alive;
+  // forks with other settings should behave like a freshly trained
+  // experiment with those settings, also when they run together
+  const vector<string> sweep = { "-k3", "-k3 -mM", "-w IG -dIL -k5",
+				 "-w0 -mJ -k2" };
+  vector<std::unique_ptr<TimblAPI>> forks;
+  for ( const auto& opts : sweep ){
+    std::unique_ptr<TimblAPI> f = Parent.Fork();
+    if ( !f || !f->SetOptions( opts ) ){
+      return 1;
+    }
+    forks.push_back( std::move( f ) );
+  }
+  vector<std::thread> testers;
+  for ( size_t i=0; i < forks.size(); ++i ){
+    testers.push_back( std::thread( [&forks,i](){
+	  forks[i]->Test( "dimin.test", "fork." + std::to_string(i) + ".out" );
+	} ) );
+  }
+  for ( auto& t : testers ){
+    t.join();
+  }
+  for ( size_t i=0; i < forks.size(); ++i ){
+    string out = "fork." + std::to_string(i) + ".out";
+    bool same = contents( out ) == reference( sweep[i], "ref.out" );
+    cout << sweep[i] << ": " << ( same ? "same" : "DIFFERENT" ) << endl;
+    ok = ok && same;
+    std::remove( out.c_str() );
+  }
+  forks.clear();
+  // the parent is not affected by its forks
+  Parent.Test( "dimin.test", "fork.out" );
+  if ( contents( "fork.out" ) != parent_out ){
+    cout << "parent changed" << endl;
+    ok = false;
+  }
+  // and may change again once they are gone
+  if ( !Parent.Increment( "=,=,=,=,+,k,e,=,-,r,@,l,T" ) ){
+    cout << "parent still locked" << endl;
+    ok = false;
+  }
+  std::remove( "fork.out" );
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include "timbl/TimblAPI.h"
+#include "timbl/InputStream.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static bool run( const string& train, const string& test, const string& out ){
+  TimblAPI Exp( "-a IB1 +vS", "zip" );
+  return Exp.Learn( train ) && Exp.Test( test, out );
+}
+
+struct zipper {
+  Compression type;
+  string command;
+  string suffix;
+};
+
+int main(){
+  if ( !run( "dimin.train", "dimin.test", "zip.plain.out" ) ){
+    return 1;
+  }
+  string plain = contents( "zip.plain.out" );
+  std::remove( "zip.plain.out" );
+  bool ok = true;
+  const std::vector<zipper> zippers = { { GzipCompression, "gzip", ".gz" },
+					{ XzCompression, "xz", ".xz" },
+					{ ZstdCompression, "zstd -q", ".zst" } };
+  for ( const auto& z : zippers ){
+    string name = InputStream::name( z.type );
+    string train = "zip.train" + z.suffix;
+    string test = "zip.test" + z.suffix;
+    if ( !InputStream::supported( z.type )
+	 || std::system( ( z.command + " -c dimin.train > " + train ).c_str() )
+	 || std::system( ( z.command + " -c dimin.test > " + test ).c_str() ) ){
+      cout << name << ": skipped" << endl;
+    }
+    else {
+      // train and test from the compressed copies
+      bool same = run( train, test, "zip.out" )
+	&& contents( "zip.out" ) == plain;
+      cout << name << ": " << ( same ? "same" : "DIFFERENT" ) << endl;
+      ok = ok && same;
+    }
+    std::remove( train.c_str() );
+    std::remove( test.c_str() );
+    std::remove( "zip.out" );
+  }
+  if ( InputStream::supported( GzipCompression )
+       && !std::system( "head -n 1500 dimin.train | gzip -c > zip.cat.gz"
+			" && tail -n +1501 dimin.train | gzip -c >> zip.cat.gz" ) ){
+    // two concatenated gzip streams are read as one file
+    bool same = run( "zip.cat.gz", "dimin.test", "zip.out" )
+      && contents( "zip.out" ) == plain;
+    cout << "concatenated: " << ( same ? "same" : "DIFFERENT" ) << endl;
+    ok = ok && same;
+    // a truncated file is an error, not a shorter one
+    string cat = contents( "zip.cat.gz" );
+    std::ofstream( "zip.cut.gz", std::ios::binary )
+      << cat.substr( 0, cat.size()/2 );
+    TimblAPI Exp( "-a IB1 +vS", "cut" );
+    bool refused = !Exp.Learn( "zip.cut.gz" );
+    cout << "truncated: " << ( refused ? "refused" : "ACCEPTED" ) << endl;
+    ok = ok && refused;
+  }
+  std::remove( "zip.cat.gz" );
+  std::remove( "zip.cut.gz" );
+  std::remove( "zip.out" );
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <set>
+#include <cstdio>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+static string contents( const string& f ){
+  std::ifstream is( f, std::ios::binary );
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return ss.str();
+}
+
+static const size_t num_feats = 500;
+
+static unsigned int next_random( unsigned int& seed ){
+  // the same data on every platform
+  seed = seed * 1103515245 + 12345;
+  return ( seed >> 16 ) & 0x7fff;
+}
+
+static void write_data( const string& name, size_t lines,
+			unsigned int seed, bool binary ){
+  // bag of words like data: a few of the many features are active, some
+  // of them typical for the class
+  std::ofstream os( name );
+  for ( size_t l=0; l < lines; ++l ){
+    size_t cls = next_random( seed ) % 3;
+    std::set<size_t> active;
+    size_t num = 3 + next_random( seed ) % 10;
+    for ( size_t i=0; i < num; ++i ){
+      if ( next_random( seed ) % 2 ){
+	active.insert( 1 + next_random( seed ) % num_feats );
+      }
+      else {
+	active.insert( 1 + cls * 100 + next_random( seed ) % 60 );
+      }
+    }
+    for ( const auto f : active ){
+      if ( binary ){
+	os << f << ",";
+      }
+      else {
+	os << "(" << f << "," << 1 + next_random( seed ) % 4 << ")";
+      }
+    }
+    os << "c" << cls << endl;
+  }
+}
+
+static bool test_sparse( const string& format, const string& opts ){
+  // the sparse search must give the same output as the tree search,
+  // including the neighbors and their distances
+  string base = "-a IB1 -F " + format + " -N "
+    + std::to_string( num_feats ) + " " + opts;
+  string train = "sparse." + format + ".train";
+  string test = "sparse." + format + ".test";
+  TimblAPI Tree( base, "tree" );
+  TimblAPI Sparse( base + " --sparse", "sparse" );
+  bool result = Tree.Learn( train ) && Tree.Test( test, "sparse.1.out" )
+    && Sparse.Learn( train ) && Sparse.Test( test, "sparse.2.out" )
+    && contents( "sparse.1.out" ) == contents( "sparse.2.out" );
+  cout << format << " " << opts << ": "
+       << ( result ? "same" : "DIFFERENT" ) << endl;
+  std::remove( "sparse.1.out" );
+  std::remove( "sparse.2.out" );
+  return result;
+}
+
+int main(){
+  write_data( "sparse.Sparse.train", 600, 17, false );
+  write_data( "sparse.Sparse.test", 100, 4711, false );
+  write_data( "sparse.Binary.train", 600, 17, true );
+  write_data( "sparse.Binary.test", 100, 4711, true );
+  bool ok = true;
+  for ( const auto& format : { "Sparse", "Binary" } ){
+    ok = test_sparse( format, "" ) && ok;
+    ok = test_sparse( format, "-mM -k3 +vn+db" ) && ok;
+    ok = test_sparse( format, "-mJ -k5 -d IL +vdb" ) && ok;
+    ok = test_sparse( format, "-mN -w0 -k3 +vn" ) && ok;
+    ok = test_sparse( format, "-mC -k3 +vn+db" ) && ok;
+    ok = test_sparse( format, "-mD -k2 +vdb" ) && ok;
+    ok = test_sparse( format, "--clones=3 -k4 +vdb" ) && ok;
+  }
+  for ( const auto& f : { "sparse.Sparse.train", "sparse.Sparse.test",
+			  "sparse.Binary.train", "sparse.Binary.test" } ){
+    std::remove( f );
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <future>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using namespace Timbl;
+
+int main(){
+  TimblAPI My_Experiment( "-a IB1 +vdb+di -k3", "test7" );
+  My_Experiment.Learn( "dimin.train" );
+  vector<string> lines;
+  std::ifstream is( "dimin.test" );
+  string line;
+  while ( std::getline( is, line ) ){
+    lines.push_back( line );
+  }
+  // classify the old-fashioned way
+  vector<string> expected;
+  for ( const auto& l : lines ){
+    string cat;
+    My_Experiment.Classify( l, cat );
+    expected.push_back( cat );
+  }
+  // now using 4 workers and a small queue
+  My_Experiment.StartClassifyPool( 4, 16 );
+  vector<std::future<classifyResult>> futures
+    = My_Experiment.ClassifyAsync( lines );
+  size_t errors = 0;
+  for ( size_t i=0; i < futures.size(); ++i ){
+    classifyResult res = futures[i].get();
+    if ( !res.ok || res.category != expected[i] ){
+      ++errors;
+    }
+    if ( i < 3 ){
+      cout << lines[i] << " --> " << res.category << " " << res.distribution
+	   << " " << res.distance << endl;
+    }
+  }
+  // and with a callback, which is called in order of submission
+  size_t next = 0;
+  My_Experiment.ClassifyAsync( lines,
+			       [&]( size_t index, const classifyResult& res ){
+				 if ( index != next++
+				      || res.category != expected[index] ){
+				   ++errors;
+				 }
+			       } );
+  My_Experiment.StopClassifyPool();
+  if ( next != lines.size() ){
+    ++errors;
+  }
+  cout << "classified " << lines.size() << " instances twice, "
+       << errors << " differences" << endl;
+  return errors == 0 ? 0 : 1;
+}
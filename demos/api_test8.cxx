@@ -0,0 +1,74 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using namespace Timbl;
+
+size_t run( const string& opts, const string& shard_opt ){
+  // test dimin.test once with one InstanceBase and once with a sharded one
+  // and return the number of lines in which the outputs differ.
+  TimblAPI Single( opts, "single" );
+  Single.Learn( "dimin.train" );
+  Single.Test( "dimin.test", "single.out" );
+  TimblAPI Sharded( opts + " " + shard_opt, "sharded" );
+  Sharded.Learn( "dimin.train" );
+  Sharded.Test( "dimin.test", "sharded.out" );
+  std::ifstream is1( "single.out" );
+  std::ifstream is2( "sharded.out" );
+  string line1;
+  string line2;
+  size_t lines = 0;
+  size_t diffs = 0;
+  while ( std::getline( is1, line1 ) ){
+    ++lines;
+    if ( !std::getline( is2, line2 ) || line1 != line2 ){
+      ++diffs;
+    }
+  }
+  if ( std::getline( is2, line2 ) ){
+    ++diffs;
+  }
+  cout << "'" << opts << " " << shard_opt << "': " << lines << " lines, "
+       << diffs << " differences" << endl;
+  return diffs;
+}
+
+int main(){
+  size_t diffs = 0;
+  diffs += run( "-a IB1 +vdb+di", "--shards=3" );
+  diffs += run( "-a IB1 +vdb+di -k3", "--shards=3" );
+  diffs += run( "-a IB1 +vdb+di -k5 -mM -dID", "--shards=4:ff" );
+  diffs += run( "-a IB1 +vdb+di -mJ -k2 -dED:2", "--shards=2" );
+  return diffs == 0 ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include "timbl/TimblAPI.h"
+
+using std::cout;
+using std::endl;
+using namespace Timbl;
+
+int main(){
+  TimblAPI My_Experiment( "-a IB1 -k3 -mM --clones=4", "test9" );
+  My_Experiment.Learn( "dimin.train" );
+  std::atomic<bool> done( false );
+  std::thread tester( [&](){
+      My_Experiment.Test( "dimin.test", "test9.out" );
+      done = true;
+    } );
+  // watch the running test
+  unsigned int last = 0;
+  bool ok = true;
+  while ( !done ){
+    statsSnapshot snap = My_Experiment.GetLiveStatistics();
+    if ( snap.lines < last ){
+      ok = false;  // the counters should never go down
+    }
+    last = snap.lines;
+    std::this_thread::sleep_for( std::chrono::milliseconds(5) );
+  }
+  tester.join();
+  statsSnapshot snap = My_Experiment.GetLiveStatistics();
+  cout << "tested " << snap.lines << " lines, accuracy " << snap.accuracy()
+       << ", exact " << snap.exactRatio() << endl;
+  if ( snap.lines != 950
+       || snap.accuracy() != My_Experiment.GetAccuracy() ){
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/*
+  Copyright (c) 1998 - 2015
+  ILK   - Tilburg University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      http://ilk.uvt.nl/software.html
+  or send mail to:
+      timbl@uvt.nl
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "timbl/Choppers.h"
+#include "timbl/StringOps.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using icu::UnicodeString;
+using namespace Timbl;
+
+// measures the speed of the input choppers on their own, and checks them
+// against a chop done the generic (ICU) way
+
+vector<UnicodeString> reference_chop( const UnicodeString& line,
+				      InputFormatType IF ){
+  UnicodeString in = TiCC::rtrim( line );
+  if ( IF == C4_5 && in.endsWith( "." ) ){
+    in.remove( in.length()-1 );
+    in = TiCC::rtrim( in );
+  }
+  vector<UnicodeString> parts;
+  if ( IF == C4_5 ){
+    parts = TiCC::split_at( in, "," );
+  }
+  else if ( IF == Tabbed ){
+    parts = TiCC::split_at( in, "\t" );
+  }
+  else {
+    parts = TiCC::split( in );
+  }
+  for ( auto& p : parts ){
+    p = StrToCode( p, IF != Tabbed );
+  }
+  return parts;
+}
+
+bool check( Chopper *chopper,
+	    const vector<UnicodeString>& lines,
+	    InputFormatType IF,
+	    size_t num_feats ){
+  bool ok = true;
+  for ( const auto& line : lines ){
+    vector<UnicodeString> ref = reference_chop( line, IF );
+    bool chopped = chopper->chop( line, num_feats );
+    if ( chopped != ( ref.size() == num_feats+1 ) ){
+      cout << "chop result differs on: '" << line << "'" << endl;
+      ok = false;
+      continue;
+    }
+    for ( size_t i=0; chopped && i < ref.size(); ++i ){
+      if ( chopper->getField( i ) != ref[i] ){
+	cout << "field " << i << " differs on: '" << line << "': '"
+	     << chopper->getField( i ) << "' instead of '" << ref[i]
+	     << "'" << endl;
+	ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+double lines_per_second( Chopper *chopper,
+			 const vector<UnicodeString>& lines,
+			 size_t num_feats,
+			 int rounds ){
+  auto start = std::chrono::steady_clock::now();
+  size_t done = 0;
+  for ( int r=0; r < rounds; ++r ){
+    for ( const auto& line : lines ){
+      if ( chopper->chop( line, num_feats ) ){
+	++done;
+      }
+    }
+  }
+  std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+  return done / secs.count();
+}
+
+int main(){
+  std::ifstream is( "dimin.train" );
+  vector<string> raw;
+  string line;
+  while ( std::getline( is, line ) ){
+    raw.push_back( line );
+  }
+  if ( raw.empty() ){
+    cout << "unable to read dimin.train" << endl;
+    return 1;
+  }
+  const size_t num_feats = 12;
+  struct format {
+    InputFormatType IF;
+    char sep;
+    const char *name;
+  };
+  const vector<format> formats = { { C4_5, ',', "C4.5" },
+				   { Columns, ' ', "Columns" },
+				   { Tabbed, '\t', "Tabbed" } };
+  // some odd lines, with the separator written as '|'
+  const vector<string> odd = { "a| b |c\\d|e f|||g|h|i|j|k|l|m .",
+			       "a|b|c|d|e|f|g|h|i|j|k|l|m|",
+			       "a|b|c|d|e|f|g|h|i|j|k|l",
+			       "   a|b|c|d|e|f|g|h|i|j|k|l|caf\xc3\xa9",
+			       "a|b|c|d|e|f|g|h|i|j|k|\xc3\xa9t\xc3\xa9|\\|  \r" };
+  bool ok = true;
+  for ( const auto& fmt : formats ){
+    vector<UnicodeString> lines;
+    for ( const auto& l : raw ){
+      string conv = l;
+      for ( auto& c : conv ){
+	if ( c == ',' ){
+	  c = fmt.sep;
+	}
+      }
+      lines.push_back( TiCC::UnicodeFromUTF8( conv ) );
+    }
+    vector<UnicodeString> tests = lines;
+    for ( const auto& l : odd ){
+      string conv = l;
+      for ( auto& c : conv ){
+	if ( c == '|' ){
+	  c = fmt.sep;
+	}
+      }
+      tests.push_back( TiCC::UnicodeFromUTF8( conv ) );
+    }
+    Chopper *chopper = Chopper::create( fmt.IF, false, 0, false );
+    if ( !check( chopper, tests, fmt.IF, num_feats ) ){
+      ok = false;
+    }
+    double speed = lines_per_second( chopper, lines, num_feats, 100 );
+    cout << fmt.name << ": " << static_cast<long>(speed) << " lines/sec"
+	 << endl;
+    delete chopper;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_BINARYINSTANCES_H
+#define TIMBL_BINARYINSTANCES_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iosfwd>
+#include <cstdint>
+#include "unicode/unistr.h"
+#include "timbl/Types.h"
+
+namespace Timbl {
+  class Chopper;
+
+  // A binary instance file holds chopped instances, so they can be read
+  // again without parsing.
+  // Layout (all integers little endian):
+  //   header: "TiMBLbin", version, number of features, the InputFormat
+  //           of the original text, flags (1=weights, 2=occurrences)
+  //   blocks: number of rows (at most 64K, 0 ends the file), then per
+  //           column (the features in file order, then the target):
+  //             the values first used in this block (so the dictionaries
+  //             grow block by block and can be read sequentially),
+  //             a width of 1, 2 or 4 bytes, and an index per row.
+  //             When one value fills most of the column, the width has
+  //             bit 0x80 set, and is followed by that value, the number
+  //             of other rows, and a (2 byte row, index) pair for each.
+  //           Then a column of exemplar weights and/or occurrences
+
+  struct binaryRow {
+    std::vector<uint32_t> values; // the features, then the target
+    double weight;
+    int occurrences;
+  };
+
+  class BinaryInstanceWriter {
+  public:
+    BinaryInstanceWriter( std::ostream&, size_t, InputFormatType,
+			  bool, bool );
+    BinaryInstanceWriter( const BinaryInstanceWriter& ) = delete;
+    BinaryInstanceWriter& operator=( const BinaryInstanceWriter& ) = delete;
+    bool add( const Chopper& );
+    bool finish();
+    size_t size() const { return total; };
+  private:
+    bool write_block();
+    std::ostream& os;
+    size_t num_feats;
+    bool weighted;
+    bool with_occurrences;
+    size_t max_rows;
+    size_t rows;
+    size_t total;
+    std::vector<std::unordered_map<icu::UnicodeString,
+				   uint32_t,
+				   unicode_hash>> index;
+    std::vector<std::vector<icu::UnicodeString>> fresh;
+    std::vector<std::vector<uint32_t>> columns;
+    std::vector<double> weights;
+    std::vector<int> occurrences;
+  };
+
+  class BinaryInstanceReader {
+  public:
+    explicit BinaryInstanceReader( std::istream& );
+    BinaryInstanceReader( const BinaryInstanceReader& ) = delete;
+    BinaryInstanceReader& operator=( const BinaryInstanceReader& ) = delete;
+    bool good() const { return message.empty(); };
+    const std::string& error() const { return message; };
+    size_t numFeatures() const { return num_feats; };
+    InputFormatType format() const { return input_format; };
+    bool weighted() const { return has_weights; };
+    bool withOccurrences() const { return has_occurrences; };
+    bool next( binaryRow& );
+    void fill( const binaryRow&, Chopper& ) const;
+    static bool detect( const std::string& );
+  private:
+    bool read_block();
+    bool fail( const std::string& );
+    std::istream& is;
+    std::string message;
+    size_t num_feats;
+    InputFormatType input_format;
+    bool has_weights;
+    bool has_occurrences;
+    bool at_end;
+    size_t rows;
+    size_t cursor;
+    std::vector<std::vector<icu::UnicodeString>> dictionary;
+    std::vector<std::vector<uint32_t>> columns; // the dense ones
+    std::vector<uint32_t> commons;
+    std::vector<std::pair<size_t,uint32_t>> patches;
+    std::vector<uint32_t> cells;  // the rows of the current block
+    std::vector<double> weights;
+    std::vector<int> occurrences;
+    icu::UnicodeString sparse_default;
+    std::vector<uint32_t> default_index;
+  };
+
+}
+#endif // TIMBL_BINARYINSTANCES_H
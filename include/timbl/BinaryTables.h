@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#ifndef TIMBL_BINARYTABLES_H
+#define TIMBL_BINARYTABLES_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include "unicode/unistr.h"
+
+namespace Timbl {
+
+  // A binary table file holds weights, probability arrays or value
+  // difference matrices exactly as they are in memory, so reading them
+  // back needs no parsing and loses no precision.
+  // Layout (all integers little endian, doubles as IEEE 754 bits):
+  //   header:  "TiMBLtab", version, kind, payload size (8 bytes),
+  //            FNV-1a checksum of the payload (8 bytes)
+  //   payload: a sequence of u32, u64, double and string (u32 length,
+  //            then UTF-8 bytes) fields, as written by MBLClass. A section
+  //            starts with its length (u64), so a reader can skip it
+  // The reader maps the file in memory when it can.
+
+  enum BinaryTableKind { WeightsTable = 1,
+			 ArraysTable = 2,
+			 MatricesTable = 3 };
+
+  // 64 bit FNV-1a, as used for the payload checksum
+  uint64_t fnv_checksum( const unsigned char *, size_t );
+
+  class BinaryTableWriter {
+  public:
+    explicit BinaryTableWriter( BinaryTableKind k ): kind( k ) {};
+    void put_u32( uint32_t );
+    void put_u64( uint64_t );
+    void put_double( double );
+    void put_string( const icu::UnicodeString& );
+    size_t start_section();
+    void end_section( size_t );
+    bool write( std::ostream& ) const;
+  private:
+    BinaryTableKind kind;
+    std::vector<char> payload;
+  };
+
+  class BinaryTableReader {
+  public:
+    BinaryTableReader();
+    ~BinaryTableReader();
+    BinaryTableReader( const BinaryTableReader& ) = delete;
+    BinaryTableReader& operator=( const BinaryTableReader& ) = delete;
+    bool open( const std::string&, BinaryTableKind );
+    bool open( const char *, size_t, BinaryTableKind, const std::string& );
+    const std::string& error() const { return message; };
+    bool get_u32( uint32_t& );
+    bool get_u64( uint64_t& );
+    bool get_double( double& );
+    bool get_string( icu::UnicodeString& );
+    bool get_section( uint64_t& len ) { return get_u64( len ); };
+    bool skip( uint64_t );
+    bool at_end() const { return cursor == size; };
+    static bool detect( const std::string& );
+  private:
+    bool fail( const std::string& );
+    bool check( const std::string&, BinaryTableKind, size_t );
+    void close();
+    std::string message;
+    const unsigned char *data;
+    size_t size;
+    size_t cursor;
+    void *mapped;
+    size_t mapped_size;
+    std::vector<unsigned char> buffer;
+  };
+
+}
+#endif // TIMBL_BINARYTABLES_H
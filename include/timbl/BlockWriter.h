@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#ifndef TIMBL_BLOCKWRITER_H
+#define TIMBL_BLOCKWRITER_H
+
+#include <string>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Timbl {
+
+  class BlockWriter {
+    // output is appended to buffer(), and goes to the stream in large
+    // blocks. With 'background' the blocks are written by a separate
+    // thread, so formatting the next block overlaps with writing this one.
+    // The output is complete after flush() or destruction.
+  public:
+    explicit BlockWriter( std::ostream&,
+			  bool = false,
+			  size_t = 1024*1024 );
+    ~BlockWriter();
+    BlockWriter( const BlockWriter& ) = delete; // forbid copies
+    BlockWriter& operator=( const BlockWriter& ) = delete; // forbid copies
+    std::string& buffer() { return current; };
+    void check() {
+      if ( current.size() >= block_size ){
+	pass();
+      }
+    };
+    std::streamoff tell() const;
+    bool flush();
+  private:
+    void pass();
+    void run();
+    std::ostream& os;
+    size_t block_size;
+    std::string current;
+    std::string writing;
+    std::streamoff base;
+    std::streamoff passed;
+    bool background;
+    bool busy;
+    bool stopping;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable cond;
+  };
+
+}
+#endif // TIMBL_BLOCKWRITER_H
@@ -32,6 +32,7 @@
 #include <cstddef>
 
 #include <iosfwd>              // for ostream
+#include <string>              // for string
 #include <vector>              // for vector
 #include "unicode/unistr.h"
 #include "unicode/ustream.h"
@@ -44,7 +45,8 @@ namespace Timbl{
   class Chopper {
   public:
     Chopper():
-      vSize(0)
+      vSize(0),
+      shuffled(false)
     {};
     virtual ~Chopper() {};
     virtual bool chop( const icu::UnicodeString&, size_t ) = 0;
@@ -55,16 +57,29 @@ namespace Timbl{
     };
     virtual double getExW() const { return -1; };
     virtual int getOcc() const { return 1; };
+    virtual const std::vector<size_t> *activeFields() const { return 0; };
     virtual icu::UnicodeString getString() const = 0;
+    virtual void appendString( std::string& ) const;
+    void appendRaw( std::string& ) const;
+    void assignSize( size_t );
+    void assign( size_t i, const icu::UnicodeString& val ){
+      choppedInput[i] = val;
+    };
+    void assignDefaults( size_t, const icu::UnicodeString& );
+    void assignActive( size_t i, const icu::UnicodeString& val ){
+      choppedInput[i] = val;
+      active.push_back( i );
+    };
+    virtual void assignExtra( double, int ){};
     void print( std::ostream& os ){
       os << getString();
     };
     void swapTarget( size_t target_pos ){
-      icu::UnicodeString tmp = choppedInput[target_pos];
+      // move the target to the end. Swapping keeps every field's storage
       for ( size_t i = target_pos+1; i < vSize; ++i ){
-	choppedInput[i-1] = choppedInput[i];
+	choppedInput[i-1].swap( choppedInput[i] );
       }
-      choppedInput[vSize-1] = tmp;
+      shuffled = true;
     }
     static Chopper *create( InputFormatType , bool, int, bool );
     static InputFormatType getInputFormat( const icu::UnicodeString&,
@@ -75,7 +90,16 @@ namespace Timbl{
 				 bool=false );
   protected:
     virtual void init( const icu::UnicodeString&, size_t, bool );
+    virtual const char *separator() const { return ","; };
+    static bool plainInput( const icu::UnicodeString& );
+    bool splitPlain( char16_t, bool, bool );
+    void setField( size_t, const char16_t *, int32_t, bool, bool );
+    void resetFields( const icu::UnicodeString&, size_t, bool,
+		      const icu::UnicodeString& );
+    std::vector<size_t> activeOrder() const;
     size_t vSize;
+    bool shuffled;
+    std::vector<size_t> active;
     icu::UnicodeString strippedInput;
     std::vector<icu::UnicodeString> choppedInput;
   };
@@ -87,6 +111,7 @@ namespace Timbl{
       exW(-1.0)
     {};
     double getExW() const override { return exW; };
+    void assignExtra( double w, int ) override { exW = w; };
   protected:
     void init( const icu::UnicodeString&, size_t, bool ) override;
     double exW;
@@ -99,6 +124,7 @@ namespace Timbl{
       occ(-1)
     {};
     int getOcc() const override { return occ; };
+    void assignExtra( double, int o ) override { occ = o; };
   protected:
     void init( const icu::UnicodeString&, size_t, bool ) override;
     int occ;
@@ -108,6 +134,7 @@ namespace Timbl{
   public:
     bool chop( const icu::UnicodeString&, size_t ) override;
     icu::UnicodeString getString() const override;
+    void appendString( std::string& ) const override;
   };
 
   class C45_ExChopper : public C45_Chopper, public ExChopper {
@@ -131,6 +158,8 @@ namespace Timbl{
   public:
     bool chop( const icu::UnicodeString&, size_t ) override;
     icu::UnicodeString getString() const override;
+    const std::vector<size_t> *activeFields() const override {
+      return &active; };
   };
 
   class Bin_ExChopper : public Bin_Chopper, public ExChopper {
@@ -144,6 +173,9 @@ namespace Timbl{
     explicit Compact_Chopper( int L ): fLen(L){};
     bool chop( const icu::UnicodeString&, size_t ) override;
     icu::UnicodeString getString() const override;
+    void appendString( std::string& ) const override;
+  protected:
+    const char *separator() const override { return ""; };
   private:
     int fLen;
     Compact_Chopper();
@@ -167,6 +199,8 @@ namespace Timbl{
   public:
     bool chop( const icu::UnicodeString&, size_t ) override;
     icu::UnicodeString getString() const override;
+  protected:
+    const char *separator() const override { return " "; };
   };
 
   class Columns_ExChopper : public Columns_Chopper, public ExChopper {
@@ -179,6 +213,9 @@ namespace Timbl{
   public:
     bool chop( const icu::UnicodeString&, size_t ) override;
     icu::UnicodeString getString() const override;
+    void appendString( std::string& ) const override;
+  protected:
+    const char *separator() const override { return "\t"; };
   };
 
   class Tabbed_ExChopper : public Tabbed_Chopper, public ExChopper {
@@ -192,6 +229,8 @@ namespace Timbl{
   public:
     bool chop( const icu::UnicodeString&, size_t ) override;
     icu::UnicodeString getString() const override;
+    const std::vector<size_t> *activeFields() const override {
+      return &active; };
   };
 
   class Sparse_ExChopper : public Sparse_Chopper, public ExChopper {
@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_CLASSIFYPOOL_H
+#define TIMBL_CLASSIFYPOOL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+
+namespace Timbl {
+  class TimblExperiment;
+
+  class classifyResult {
+  public:
+    classifyResult(): ok(false), distance(-1.0), confidence(0.0) {};
+    bool ok;
+    std::string category;
+    std::string distribution;
+    double distance;
+    double confidence;
+  };
+
+  using classifyCallback = std::function<void( size_t,
+					       const classifyResult& )>;
+
+  class ClassifyPool {
+    // a pool of worker threads, each with it's own clone of one trained
+    // experiment, all sharing the same InstanceBase.
+    // Instances are handled in order of submission. At most max_queue
+    // instances are waiting; submitting more blocks until there is room.
+  public:
+    ClassifyPool( TimblExperiment *, int, size_t );
+    ClassifyPool( const ClassifyPool& ) = delete; // forbid copies
+    ClassifyPool& operator=( const ClassifyPool& ) = delete; // forbid copies
+    ~ClassifyPool();
+    std::vector<std::future<classifyResult>> submit( const std::vector<std::string>& );
+    bool submit( const std::vector<std::string>&, const classifyCallback& );
+    size_t pending() const;
+    size_t workers() const { return threads.size(); };
+    size_t maxQueue() const { return max_queue; };
+    void shutdown();
+  private:
+    class batch;
+    class job {
+    public:
+      job(): index(0) {};
+      std::string line;
+      size_t index;
+      std::shared_ptr<batch> owner;
+      std::promise<classifyResult> result;
+    };
+    void enqueue( job&& );
+    void run( TimblExperiment * );
+    std::vector<TimblExperiment *> exps;
+    std::vector<std::thread> threads;
+    std::deque<job> queue;
+    size_t max_queue;
+    bool stopping;
+    mutable std::mutex queue_lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+  };
+
+}
+#endif // TIMBL_CLASSIFYPOOL_H
@@ -0,0 +1,69 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_CLASSIFYSEARCH_H
+#define TIMBL_CLASSIFYSEARCH_H
+
+#include <string>
+#include "timbl/MBLClass.h"
+#include "timbl/neighborSet.h"
+
+namespace Timbl {
+  class TimblExperiment;
+
+  class ClassifySearch {
+    // A classification that can be done in small steps, so a scheduler
+    // can interleave many queries on one thread and enforce deadlines.
+    // start() a query, call step() until it returns true, or stop at any
+    // moment and take the best answer found so far from result().
+    // incomplete() then tells that the search was cut short.
+    // Every ClassifySearch has its own clone of the experiment (sharing the
+    // InstanceBase), so create a few and reuse them.
+  public:
+    explicit ClassifySearch( TimblExperiment * );
+    ClassifySearch( const ClassifySearch& ) = delete; // forbid copies
+    ClassifySearch& operator=( const ClassifySearch& ) = delete; // forbid copies
+    ~ClassifySearch();
+    bool start( const std::string& );
+    bool step( size_t );
+    bool finished() const { return done; };
+    bool incomplete() const { return cut_short; };
+    size_t leaves() const { return state.leaves; };
+    bool result( std::string&, std::string&, double& );
+    double confidence() const;
+  private:
+    TimblExperiment *exp;
+    searchState state;
+    neighborSet bands;
+    bool active;
+    bool searching;
+    bool done;
+    bool cut_short;
+  };
+
+}
+#endif // TIMBL_CLASSIFYSEARCH_H
@@ -31,8 +31,10 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include <deque>
 #include "timbl/MsgClass.h"
 #include "timbl/Matrices.h"
+#include "timbl/StringOps.h"
 #include "ticcutils/Unicode.h"
 
 namespace Hash {
@@ -45,6 +47,8 @@ namespace Timbl {
   class TargetValue;
   class Targets;
   class metricClass;
+  class BinaryTableWriter;
+  class BinaryTableReader;
 
   class SparseValueProbClass {
     friend std::ostream& operator<< ( std::ostream&, SparseValueProbClass * );
@@ -82,12 +86,51 @@ namespace Timbl {
       _frequency = TargetDist.totalSize();
     };
     bool isUnknown() const { return _index == 0; };
+    size_t Rank() const { return _rank; };
+    bool before( const FeatureValue *fv ) const {
+      // the order of the value lists in an InstanceBase: on rank, which
+      // is 0 for all values unless the Feature ranked them, then on Index
+      return _rank < fv->_rank
+	|| ( _rank == fv->_rank && _index < fv->_index );
+    };
     SparseValueProbClass *valueClassProb() const { return ValueClassProb; };
   private:
     SparseValueProbClass *ValueClassProb;
+    size_t _rank;
     ClassDistribution TargetDist;
   };
 
+  class UnknownValues {
+    // the FeatureValues for test values that weren't seen in training.
+    // Repeated unknowns share one object. When 'limit' values are kept,
+    // new ones are made per instance instead, and deleted by release()
+  public:
+    explicit UnknownValues( size_t l = 64*1024 ):
+      limit( l ), hits( 0 ), misses( 0 ) {};
+    UnknownValues( const UnknownValues& ) = delete;
+    UnknownValues& operator=( const UnknownValues& ) = delete;
+    ~UnknownValues();
+    FeatureValue *get( const icu::UnicodeString& );
+    void release();
+    void clearCounts() { hits = 0; misses = 0; };
+    void mergeCounts( const UnknownValues& in ){
+      hits += in.hits;
+      misses += in.misses;
+    };
+    size_t Hits() const { return hits; };
+    size_t Misses() const { return misses; };
+    size_t size() const { return interned.size(); };
+  private:
+    size_t limit;
+    size_t hits;
+    size_t misses;
+    std::unordered_map<icu::UnicodeString,
+		       FeatureValue *,
+		       unicode_hash> interned;
+    std::vector<FeatureValue *> scratch;
+    std::deque<icu::UnicodeString> scratch_names;
+  };
+
 
   class Feature: public MsgClass {
     friend class MBLClass;
@@ -122,11 +165,13 @@ namespace Timbl {
 		       size_t=1 ) const;
     FeatureValue *add_value( const icu::UnicodeString&, TargetValue *, int=1 );
     FeatureValue *add_value( size_t, TargetValue *, int=1 );
+    void add_uncounted( FeatureValue *, const std::vector<TargetValue *>& );
     FeatureValue *Lookup( const icu::UnicodeString& ) const;
     bool decrement_value( FeatureValue *, const TargetValue * );
     bool increment_value( FeatureValue *, const TargetValue * );
     size_t EffectiveValues() const;
     size_t TotalValues() const;
+    void rank_by_frequency();
     bool isNumerical() const;
     bool isStorableMetric() const;
     bool AllocSparseArrays( size_t );
@@ -140,6 +185,10 @@ namespace Timbl {
     void print_matrix( std::ostream&, bool = false ) const;
     void print_vc_pb_array( std::ostream& ) const;
     bool read_vc_pb_array( std::istream &  );
+    void write_matrix( BinaryTableWriter& ) const;
+    bool fill_matrix( BinaryTableReader& );
+    void write_vc_pb_array( BinaryTableWriter& ) const;
+    bool read_vc_pb_array( BinaryTableReader&, size_t );
     FeatVal_Stat prepare_numeric_stats();
     void Statistics( double, const Targets&, bool );
     void NumStatistics( double, const Targets&, int, bool );
@@ -154,6 +203,7 @@ namespace Timbl {
     bool ignore;
     bool numeric;
     bool vcpb_read;
+    bool ranked;
     enum ps_stat{ ps_undef, ps_failed, ps_ok, ps_read };
     enum ps_stat PrestoreStatus;
     MetricType Prestored_metric;
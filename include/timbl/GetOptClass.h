@@ -68,6 +68,10 @@ namespace Timbl {
     int maxbests;
     int clip_freq;
     int clones;
+    int shards;
+    int ingest_limit;
+    int flush_every;
+    double lazy_load;
     int BinSize;
     int BeamSize;
     int bootstrap_lines;
@@ -79,6 +83,7 @@ namespace Timbl {
     VerbosityFlags myVerbosity;
     bool opt_init;
     bool opt_changed;
+    bool weight_changed;
     bool do_exact;
     bool do_hashed;
     bool min_present;
@@ -92,6 +97,12 @@ namespace Timbl {
     bool do_sloppy_loo;
     bool do_silly;
     bool do_diversify;
+    bool do_numa;
+    bool do_shard_on_feature;
+    bool do_echo_input;
+    bool do_binary_tables;
+    bool do_frequency_order;
+    bool do_sparse;
     std::vector<MetricType>metricsArray;
     std::ostream *parent_socket_os;
     std::string inPath;
@@ -29,6 +29,11 @@
 #define TIMBL_IBTREE_H
 
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <string>
+#include <memory>
+#include <iosfwd>
 
 #include "ticcutils/XMLtools.h"
 #include "timbl/MsgClass.h"
@@ -53,6 +58,10 @@ namespace Timbl {
   class TargetValue;
   class ClassDistribution;
   class WClassDistribution;
+  class DistributionPool;
+  class treeFragment;
+  class lazyTree;
+  class BlockWriter;
 
   class IBtree {
     friend class InstanceBase_base;
@@ -62,7 +71,6 @@ namespace Timbl {
     friend class TRIBL2_InstanceBase;
     friend std::ostream &operator<<( std::ostream&, const IBtree& );
     friend std::ostream &operator<<( std::ostream&, const IBtree * );
-    friend xmlNode *to_xml( IBtree *pnt );
     friend int count_next( const IBtree * );
   public:
     const TargetValue* targetValue() const { return TValue; };
@@ -92,12 +100,27 @@ namespace Timbl {
     inline ClassDistribution *sum_distributions( bool );
     inline IBtree *make_unique( const TargetValue *, unsigned long& );
     void cleanDistributions();
+    IBtree *replicate( std::unordered_map<const ClassDistribution *,
+					  ClassDistribution *>& ) const;
     void re_assign_defaults( bool, bool );
     void assign_defaults( bool, bool, size_t );
-    void redo_distributions();
+    void redo_distributions( bool = true );
     void countBranches( unsigned int,
 			std::vector<unsigned int>&,
 			std::vector<unsigned int>& );
+    void countDistributions( unsigned long int&,
+			     unsigned long int&,
+			     std::unordered_set<const ClassDistribution*>& ) const;
+    void share_distributions();
+    void share_distributions( std::unordered_map<std::string,
+						 ClassDistribution *>& );
+    void unshare_distribution();
+    unsigned long int compact( bool,
+			       DistributionPool *,
+			       unsigned long int& );
+    void release_distributions();
+    IBtree *order_by_frequency();
+    IBtree *order_by_rank();
     const ClassDistribution *exact_match( const Instance&  ) const;
   protected:
     const IBtree *search_node( const FeatureValue * ) const;
@@ -120,12 +143,13 @@ namespace Timbl {
     virtual ~InstanceBase_base( void ) override;
     void AssignDefaults( void );
     void RedoDistributions();
-    bool AddInstance( const Instance&  );
+    virtual bool AddInstance( const Instance&  );
     void RemoveInstance( const Instance&  );
     void summarizeNodes( std::vector<unsigned int>&,
 			 std::vector<unsigned int>& );
+    void distributionInfo( unsigned long int&, unsigned long int& );
     virtual bool MergeSub( InstanceBase_base * );
-    const ClassDistribution *ExactMatch( const Instance& I ) const {
+    virtual const ClassDistribution *ExactMatch( const Instance& I ) const {
       return InstBase->exact_match( I ); };
     virtual const ClassDistribution *InitGraphTest( std::vector<FeatureValue *>&,
 						    const std::vector<FeatureValue *> *,
@@ -148,13 +172,16 @@ namespace Timbl {
 		    Hash::UnicodeHash& ) const;
     virtual InstanceBase_base *Copy() const = 0;
     virtual InstanceBase_base *clone() const = 0;
-    void Save( std::ostream&,
+    InstanceBase_base *Replicate() const;
+    bool Save( std::ostream&,
+	       bool=false,
 	       bool=false );
-    void Save( std::ostream&,
+    bool Save( std::ostream&,
 	       const Hash::UnicodeHash&,
 	       const Hash::UnicodeHash&,
+	       bool=false,
 	       bool=false );
-    void toXML( std::ostream& );
+    bool toXML( std::ostream& );
     void printStatsTree( std::ostream&, unsigned int startLevel );
     virtual bool ReadIB( std::istream&,
 			 Feature_List&,
@@ -167,7 +194,8 @@ namespace Timbl {
     virtual void Prune( const TargetValue *, long = 0 );
     virtual bool IsPruned() const { return false; };
     void CleanPartition(  bool );
-    unsigned long int GetSizeInfo( unsigned long int&, double & ) const;
+    virtual unsigned long int GetSizeInfo( unsigned long int&,
+					   double & ) const;
     const ClassDistribution *TopDist() const { return TopDistribution; };
     bool HasDistributions() const;
     const TargetValue *TopTarget( bool & );
@@ -175,6 +203,21 @@ namespace Timbl {
     unsigned long int nodeCount() const { return ibCount;} ;
     size_t depth() const { return Depth;} ;
     const IBtree *instBase() const { return InstBase; };
+    const std::vector<std::streamoff>& subtreeOffsets() const {
+      return subtree_offsets; };
+    void setLoadIndex( const std::vector<std::streamoff>& offsets,
+		       int threads ){
+      subtree_offsets = offsets; load_threads = threads; };
+    unsigned long int savedNodes() const { return saved_nodes; };
+    unsigned long int savedTails() const { return saved_tails; };
+    void setLazyLoad( const std::string&,
+		      unsigned long int,
+		      unsigned long int,
+		      size_t );
+    bool LoadAll();
+    void OrderByRank();
+    bool isLazy() const;
+    bool Prefetch( const FeatureValue * );
 
 #ifdef IBSTATS
     std::vector<unsigned int> mismatch;
@@ -199,24 +242,53 @@ namespace Timbl {
 
     size_t Depth;
     unsigned long int NumOfTails;
+    std::vector<std::streamoff> subtree_offsets;
+    int load_threads;
+    unsigned long int saved_nodes;
+    unsigned long int saved_tails;
+    std::shared_ptr<lazyTree> lazy;
+    std::shared_ptr<DistributionPool> pool;
     IBtree *read_list( std::istream&,
 		       Feature_List&,
 		       Targets&,
-		       int );
+		       int,
+		       treeFragment * = 0 );
     IBtree *read_local( std::istream&,
 			Feature_List&,
 			Targets&,
-			int );
+			int,
+			treeFragment * = 0,
+			bool = false );
     IBtree *read_list_hashed( std::istream&,
 			      Feature_List&,
 			      Targets&,
-			      int );
+			      int,
+			      treeFragment * = 0 );
     IBtree *read_local_hashed( std::istream&,
 			       Feature_List&,
 			       Targets&,
-			       int );
-    void write_tree( std::ostream &os, const IBtree * ) const;
-    void write_tree_hashed( std::ostream &os, const IBtree * ) const;
+			       int,
+			       treeFragment * = 0,
+			       bool = false );
+    bool read_list_indexed( std::istream&,
+			    Feature_List&,
+			    Targets&,
+			    bool,
+			    IBtree *& );
+    bool read_list_lazy( std::istream&,
+			 Feature_List&,
+			 Targets&,
+			 bool,
+			 IBtree *& );
+    bool load_subtree( size_t );
+    virtual void lazy_finish( IBtree *, bool );
+    void lazy_measure( size_t );
+    bool lazy_load( const FeatureValue * );
+    const FeatureValue *lazy_value( const FeatureValue *, size_t ) const;
+    void loadWarning( treeFragment *, const std::string& ) const;
+    void loadError( treeFragment *, const std::string& ) const;
+    void noteSubtree( std::streamoff );
+    void write_list( BlockWriter&, const IBtree *, bool );
     bool read_IB( std::istream&,
 		  Feature_List& ,
 		  Targets&,
@@ -260,6 +332,7 @@ namespace Timbl {
     IG_InstanceBase *Copy() const override;
     void Prune( const TargetValue *, long = 0 ) override;
     void specialPrune( const TargetValue * );
+    unsigned long int Compact();
     bool IsPruned() const override { return Pruned; };
     const ClassDistribution *IG_test( const Instance& ,
 				      size_t&,
@@ -275,6 +348,7 @@ namespace Timbl {
 			int ) override;
     bool MergeSub( InstanceBase_base * ) override;
   protected:
+    void lazy_finish( IBtree *, bool ) override {};
     bool Pruned;
   };
 
@@ -293,6 +367,7 @@ namespace Timbl {
   private:
     IB_InstanceBase *IBPartition( IBtree * ) const;
     void AssignDefaults( size_t );
+    void lazy_finish( IBtree *, bool ) override;
     size_t Threshold;
   };
 
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_INPUTSTREAM_H
+#define TIMBL_INPUTSTREAM_H
+
+#include <istream>
+#include <fstream>
+#include <string>
+
+namespace Timbl {
+
+  enum Compression { NoCompression, GzipCompression,
+		     XzCompression, ZstdCompression };
+
+  class zipBuffer;
+  class prefixBuffer;
+
+  class InputStream: public std::istream {
+    // Reads a plain file like an ifstream, or a gzip, xz or zstd
+    // compressed one, recognized by its magic bytes.
+    // Compressed files are decoded in a separate thread, so decompression
+    // overlaps with the parsing. They can only be read sequentially:
+    // tellg() works, but seekg() only to the current position.
+    // The name "-" means standard input. Pipes and FIFO's are always read
+    // as plain text, and can't be reopened or rewound: use unread() to
+    // put back what was looked at.
+  public:
+    InputStream();
+    explicit InputStream( const std::string& );
+    InputStream( const InputStream& ) = delete;
+    InputStream& operator=( const InputStream& ) = delete;
+    ~InputStream() override;
+    bool open( const std::string& );
+    void close();
+    bool is_open() const;
+    bool compressed() const { return type != NoCompression; };
+    Compression compression() const { return type; };
+    bool streaming() const { return pipe; };
+    std::string error() const;
+    void unread( const std::string& );
+    static Compression detect( const std::string& );
+    static bool supported( Compression );
+    static std::string name( Compression );
+  private:
+    std::filebuf plain;
+    zipBuffer *zipped;
+    prefixBuffer *prefix;
+    Compression type;
+    bool pipe;
+    std::string message;
+  };
+
+}
+#endif // TIMBL_INPUTSTREAM_H
@@ -41,6 +41,9 @@ namespace Timbl {
   class TargetValue;
   class FeatureValue;
 
+  // a (position,value) pair of a sparse Instance
+  using activeValue = std::pair<size_t,FeatureValue *>;
+
   class Instance {
     friend std::ostream& operator<<(std::ostream&, const Instance& );
     friend std::ostream& operator<<(std::ostream&, const Instance * );
@@ -58,6 +61,9 @@ namespace Timbl {
     void Occurrences( const int o ) { occ = o; };
     size_t size() const { return FV.size(); };
     std::vector<FeatureValue *> FV;
+    // for a sparse search, only the values which differ from the default,
+    // ordered on their position. FV is unused then.
+    std::vector<activeValue> Active;
     TargetValue *TV;
   private:
     double sample_weight; // relative weight
@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_INSTANCESTORE_H
+#define TIMBL_INSTANCESTORE_H
+
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+namespace Timbl {
+  class Instance;
+  class FeatureValue;
+  class TargetValue;
+
+  class InstanceStore {
+    // the training instances as they are chopped during the Prepare phase,
+    // kept column by column as pointers to the FeatureValues and
+    // TargetValues learned, so the Learn phase can build the InstanceBase
+    // without reading and chopping the datafile again.
+    // Rows that don't fit in the memory limit are spilled to a temporary
+    // file as fixed size records.
+  public:
+    InstanceStore( size_t, bool, size_t );
+    ~InstanceStore();
+    InstanceStore( const InstanceStore& ) = delete; // inhibit copies
+    InstanceStore& operator=( const InstanceStore& ) = delete; // inhibit copies
+    bool add( const Instance& );
+    bool flush();
+    size_t size() const { return rows; };
+    size_t spilledRows() const { return rows - mem_rows; };
+    FeatureValue *value( size_t, size_t );
+    bool fetch( size_t, Instance&, const std::vector<size_t>&, size_t );
+  private:
+    size_t num_feats;
+    bool weighted;
+    size_t max_mem_rows;
+    size_t rows;
+    size_t mem_rows;
+    bool with_occurrences;
+    std::vector<std::vector<FeatureValue *>> columns;
+    std::vector<TargetValue *> targets;
+    std::vector<int> occurrences;
+    std::vector<double> weights;
+    FILE *spill;
+    bool dirty;
+    size_t record_size;
+    size_t cached_row;
+    std::vector<unsigned char> record;
+    bool read_record( size_t );
+  };
+
+}
+#endif // TIMBL_INSTANCESTORE_H
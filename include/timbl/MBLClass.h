@@ -43,15 +43,38 @@ namespace Timbl {
   using namespace Common;
 
   class InstanceBase_base;
+  class Sparse_InstanceBase;
   class TesterClass;
+  class SparseTester;
   class Chopper;
   class neighborSet;
+  struct binaryRow;
+  class BinaryInstanceReader;
+  class BinaryTableWriter;
+  class BinaryTableReader;
+
+  class searchState {
+    // the state of a (resumable) nearest neighbor search in an InstanceBase
+  public:
+    searchState(): inst(0), IB(0), best_distrib(0), offset(0), CurPos(0),
+      Threshold(0.0), leaves(0) {};
+    std::vector<FeatureValue *> CurrentFV;
+    const Instance *inst;
+    InstanceBase_base *IB;
+    const ClassDistribution *best_distrib;
+    size_t offset;
+    size_t CurPos;
+    double Threshold;
+    size_t leaves;
+  };
 
   class MBLClass: public MsgClass {
   public:
     bool SetOption( const std::string& );
     xmlNode *settingsToXml() const;
     virtual nlohmann::json settings_to_JSON();
+    nlohmann::json metrics_to_JSON() const;
+    bool restore_settings( const nlohmann::json&, const nlohmann::json& );
     bool ShowWeights( std::ostream& ) const;
     bool Verbosity( VerbosityFlags v ) const {
       return verbosity & v; };
@@ -76,6 +99,7 @@ namespace Timbl {
     bool sock_is_json;
     mutable nlohmann::json last_error;
     int getOcc() const { return doOcc; };
+    void setLogStream( std::ostream& os ) { mylog = &os; };
   protected:
     explicit MBLClass( const std::string& = "" );
     void init_options_table( size_t );
@@ -90,6 +114,13 @@ namespace Timbl {
     bool readMatrices( std::istream& );
     bool writeWeights( std::ostream& ) const;
     bool readWeights( std::istream&, WeightType );
+    bool writeArrays( BinaryTableWriter& );
+    bool readArrays( BinaryTableReader& );
+    bool writeMatrices( BinaryTableWriter& ) const;
+    bool readMatrices( BinaryTableReader& );
+    bool writeWeights( BinaryTableWriter& ) const;
+    bool readWeights( BinaryTableReader&, WeightType );
+    void use_read_weights();
     bool writeNamesFile( std::ostream& ) const;
     virtual bool ShowOptions( std::ostream& );
     virtual bool ShowSettings( std::ostream& );
@@ -97,25 +128,52 @@ namespace Timbl {
     void LearningInfo( std::ostream& );
     virtual ~MBLClass() override;
     void Initialize( size_t );
-    bool PutInstanceBase( std::ostream& ) const;
+    bool PutInstanceBase( std::ostream&, bool=false ) const;
     VerbosityFlags get_verbosity() const { return verbosity; };
     void set_verbosity( VerbosityFlags v ) { verbosity = v; };
     const Instance *chopped_to_instance( PhaseValue );
     bool Chop( const icu::UnicodeString& );
+    void ChopRow( const BinaryInstanceReader&, const binaryRow& );
     bool HideInstance( const Instance& );
     bool UnHideInstance( const Instance&  );
     icu::UnicodeString formatInstance( const std::vector<FeatureValue *>&,
 				       const std::vector<FeatureValue *>&,
 				       size_t,	size_t ) const;
     bool setInputFormat( const InputFormatType );
+    Chopper *newChopper() const;
+    bool chopExamples() const {
+      return do_sample_weighting &&
+	!( runningPhase == TestWords && no_samples_test ); }
+    bool chopOcc() const {
+      switch( runningPhase ) {
+      case TrainWords:
+      case LearnWords:
+      case TrainLearnWords:
+	return doOcc == 1 || doOcc == 3;
+      case TestWords:
+	return doOcc > 1;
+      default:
+	return false;
+      }
+    };
     size_t countFeatures( const icu::UnicodeString&,
 			  const InputFormatType ) const;
     InputFormatType getInputFormat( const icu::UnicodeString& ) const;
     size_t examineData( const std::string& );
+    size_t examineData( std::istream&, const std::string&,
+			std::string * = 0 );
     void time_stamp( const char *, int =-1 ) const;
+    void write_log( std::ostream&, const std::string& ) const;
+    static std::string time_string( time_t );
     void TestInstance( const Instance& ,
 		       InstanceBase_base * = NULL,
 		       size_t = 0 );
+    bool incrementalSearch() const;
+    void startSearch( searchState&,
+		      const Instance&,
+		      InstanceBase_base *,
+		      size_t = 0 );
+    bool stepSearch( searchState&, size_t = 0 );
     icu::UnicodeString get_org_input( ) const;
     const ClassDistribution *ExactMatch( const Instance& ) const;
     void fillNeighborSet( neighborSet& ) const;
@@ -163,6 +221,7 @@ namespace Timbl {
     void default_order();
     void set_order(void);
     void calculatePermutation( const std::vector<double>& );
+    bool needsAllValues() const;
     void  calculate_fv_entropy( bool );
     bool recalculate_stats( Feature_List&,
 			    std::vector<FeatVal_Stat>&,
@@ -177,9 +236,11 @@ namespace Timbl {
     DecayType decay_flag;
     std::string exp_name;
     Instance CurrInst;
+    UnknownValues unknowns;
     BestArray bestArray;
     size_t MaxBests;
     neighborSet nSet;
+    searchState testState;
     decayStruct *decay;
     int beamSize;
     normType normalisation;
@@ -194,6 +255,9 @@ namespace Timbl {
     bool tableFilled;
     MetricType globalMetricOption;
     bool do_diversify;
+    bool sparse_search;
+    void init_sparse( Sparse_InstanceBase * );
+    void count_sparse_defaults();
     bool initProbabilityArrays( bool );
     void calculatePrestored();
     void initDecay();
@@ -223,22 +287,18 @@ namespace Timbl {
     bool keep_distributions;
     double DBEntropy;
     TesterClass *tester;
+    SparseTester *sparse_tester;
     int doOcc;
-    bool chopExamples() const {
-      return do_sample_weighting &&
-	!( runningPhase == TestWords && no_samples_test ); }
-    bool chopOcc() const {
-      switch( runningPhase ) {
-      case TrainWords:
-      case LearnWords:
-      case TrainLearnWords:
-	return doOcc == 1 || doOcc == 3;
-      case TestWords:
-	return doOcc > 1;
-      default:
-	return false;
-      }
-    };
+    std::vector<FeatureValue *> sparse_defaults;
+    std::vector<size_t> active_stamp;
+    size_t chop_count;
+    std::vector<size_t> sparse_positions;
+    std::vector<size_t> no_defaults;
+    std::vector<size_t> pending_defaults;
+    bool mark_active();
+    FeatureValue *sparse_default( size_t );
+    const Instance *sparse_to_instance( PhaseValue, int );
+    const icu::UnicodeString& sparse_string() const;
     void InvalidMessage() const ;
 
     void do_numeric_statistics( );
@@ -253,6 +313,10 @@ namespace Timbl {
     void test_instance_ex( const Instance&,
 			   InstanceBase_base * = NULL,
 			   size_t = 0 );
+    void test_instance_sparse( const Instance&,
+			       const Sparse_InstanceBase * );
+    icu::UnicodeString formatSparse( const Sparse_InstanceBase&,
+				     size_t ) const;
 
     bool allocate_arrays();
 
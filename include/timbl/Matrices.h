@@ -88,6 +88,18 @@ class SparseSymetricMatrix {
     }
     return tot;
   };
+  template <class Func> void visit( Func f ) const {
+    // calls f( i, j, d ) for every stored entry
+    typename CCDmap::const_iterator it1 = my_mat.begin();
+    while ( it1 != my_mat.end() ){
+      typename CDmap::const_iterator it2 = it1->second.begin();
+      while ( it2 != it1->second.end() ){
+	f( it1->first, it2->first, it2->second );
+	++it2;
+      }
+      ++it1;
+    }
+  }
   SparseSymetricMatrix<Class> *copy(void) const{
     SparseSymetricMatrix<Class> *res = new SparseSymetricMatrix<Class>();
     typename CCDmap::const_iterator it1 = my_mat.begin();
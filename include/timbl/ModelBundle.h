@@ -0,0 +1,109 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#ifndef TIMBL_MODELBUNDLE_H
+#define TIMBL_MODELBUNDLE_H
+
+#include <string>
+#include <vector>
+#include <streambuf>
+#include <cstdint>
+#include "ticcutils/json.hpp"
+
+namespace Timbl {
+
+  // A bundle holds a trained experiment in one file: the InstanceBase,
+  // the weights, the probability arrays and matrices when there are any,
+  // the names file and the settings.
+  // Layout (integers little endian):
+  //   prefix:   "TiMBLbdl", version (4 bytes), 4 zero bytes,
+  //             header size (8 bytes), FNV-1a checksum of the header
+  //   header:   JSON, describing the experiment and listing the sections
+  //             with their offset (from the end of the header), size
+  //             and hash
+  //   sections: the data, back to back
+  // Opening a bundle reads and checks the prefix and header only, so a
+  // damaged or truncated file is refused before anything is parsed.
+  // The section hashes are checked with verify(), on several threads.
+
+  // hash of a block of data: FNV-1a over 1 MiB blocks, and FNV-1a over
+  // those. Gives the same result with any number of threads
+  uint64_t bundle_hash( const char *, size_t, int threads );
+
+  // the bundle_hash of a whole file, as 16 hex digits. Empty when the file
+  // can't be read
+  std::string file_hash( const std::string&, int threads );
+
+  class BundleWriter {
+  public:
+    nlohmann::json& header() { return head; };
+    void add( const std::string&, std::string&& );
+    bool write( std::ostream&, int threads );
+  private:
+    nlohmann::json head;
+    std::vector<std::pair<std::string,std::string>> sections;
+  };
+
+  class BundleReader {
+  public:
+    BundleReader();
+    ~BundleReader();
+    BundleReader( const BundleReader& ) = delete;
+    BundleReader& operator=( const BundleReader& ) = delete;
+    bool open( const std::string& );
+    bool verify( int threads );
+    const nlohmann::json& header() const { return head; };
+    bool section( const std::string&, const char *&, size_t& ) const;
+    const std::string& error() const { return message; };
+    static bool detect( const std::string& );
+  private:
+    bool fail( const std::string& );
+    void close();
+    std::string name;
+    std::string message;
+    nlohmann::json head;
+    const char *data;
+    size_t size;
+    size_t start;
+    void *mapped;
+    std::vector<char> buffer;
+  };
+
+  class memorybuf: public std::streambuf {
+    // a read-only, seekable streambuf on a block of memory
+  public:
+    memorybuf( const char *, size_t );
+  protected:
+    pos_type seekoff( off_type,
+		      std::ios_base::seekdir,
+		      std::ios_base::openmode ) override;
+    pos_type seekpos( pos_type, std::ios_base::openmode ) override;
+  };
+
+}
+#endif // TIMBL_MODELBUNDLE_H
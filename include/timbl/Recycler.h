@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_RECYCLER_H
+#define TIMBL_RECYCLER_H
+
+#include <cstddef>
+#include <new>
+
+namespace Timbl {
+
+  template <std::size_t Size>
+  class recycler {
+    // keeps freed blocks of Size bytes on a list per thread, and hands
+    // them out again before asking the heap. Class distributions and
+    // their nodes are made and deleted for every test instance, so this
+    // makes the classification loop allocation free once it is warmed up.
+    // At most max_free blocks are kept, the rest goes back to the heap.
+  public:
+    static void *get(){
+      block_list& blocks = list();
+      if ( blocks.head ){
+	free_block *result = blocks.head;
+	blocks.head = result->next;
+	--blocks.count;
+	return result;
+      }
+      return ::operator new( Size );
+    }
+    static void put( void *p ) noexcept {
+      if ( !p ){
+	return;
+      }
+      block_list& blocks = list();
+      if ( blocks.closed || blocks.count >= max_free ){
+	::operator delete( p );
+	return;
+      }
+      free_block *block = static_cast<free_block *>( p );
+      block->next = blocks.head;
+      blocks.head = block;
+      ++blocks.count;
+    }
+  private:
+    static_assert( Size >= sizeof(void *), "recycled blocks are too small" );
+    static const std::size_t max_free = 4096;
+    struct free_block {
+      free_block *next;
+    };
+    struct block_list {
+      free_block *head;
+      std::size_t count;
+      bool closed;
+    };
+    struct drain {
+      // gives the blocks back when the thread ends. Blocks freed after
+      // that go straight to the heap
+      explicit drain( block_list& l ): blocks( l ) {};
+      ~drain(){
+	blocks.closed = true;
+	while ( blocks.head ){
+	  free_block *next = blocks.head->next;
+	  ::operator delete( blocks.head );
+	  blocks.head = next;
+	}
+	blocks.count = 0;
+      }
+      block_list& blocks;
+    };
+    static block_list& list(){
+      // 'blocks' has no destructor, so it outlives 'cleanup'
+      static thread_local block_list blocks = { nullptr, 0, false };
+      static thread_local drain cleanup( blocks );
+      return blocks;
+    }
+  };
+
+  template <typename T>
+  class recycling_allocator {
+    // a standard allocator that recycles single elements, for the nodes
+    // of node based containers
+  public:
+    using value_type = T;
+    recycling_allocator() noexcept {};
+    template <typename U>
+    recycling_allocator( const recycling_allocator<U>& ) noexcept {}
+    T *allocate( std::size_t n ){
+      if ( n == 1 ){
+	return static_cast<T *>( recycler<sizeof(T)>::get() );
+      }
+      return static_cast<T *>( ::operator new( n * sizeof(T) ) );
+    }
+    void deallocate( T *p, std::size_t n ) noexcept {
+      if ( n == 1 ){
+	recycler<sizeof(T)>::put( p );
+      }
+      else {
+	::operator delete( p );
+      }
+    }
+  };
+
+  template <typename T, typename U>
+  bool operator==( const recycling_allocator<T>&,
+		   const recycling_allocator<U>& ){
+    return true;
+  }
+
+  template <typename T, typename U>
+  bool operator!=( const recycling_allocator<T>&,
+		   const recycling_allocator<U>& ){
+    return false;
+  }
+
+}
+
+#endif // TIMBL_RECYCLER_H
@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_SHARDS_H
+#define TIMBL_SHARDS_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "unicode/unistr.h"
+#include "timbl/neighborSet.h"
+
+namespace Timbl {
+  class Instance;
+  class Targets;
+  class ClassDistribution;
+
+  class ShardSet {
+    // the coordinator side of an IB1 experiment that is split over a
+    // number of local processes, each holding one part of the
+    // InstanceBase. Every shard returns its exact match and its k+1 nearest
+    // bands, which are merged here into one neighborSet.
+  public:
+    ShardSet(): exact(0) {};
+    ShardSet( const ShardSet& ) = delete; // forbid copies
+    ShardSet& operator=( const ShardSet& ) = delete; // forbid copies
+    ~ShardSet();
+    void add( pid_t, int );
+    size_t size() const { return fds.size(); };
+    void release();
+    bool ready( std::vector<size_t>& );
+    bool query( const Instance&, size_t, const Targets& );
+    const ClassDistribution *exactMatch() const { return exact; };
+    const neighborSet& nearestBands() const { return nearest; };
+    // the shard side
+    static bool send_ready( int, bool, size_t );
+    static bool read_query( int, std::vector<icu::UnicodeString>& );
+    static bool send_reply( int,
+			    const ClassDistribution *,
+			    const neighborSet& );
+  private:
+    std::vector<pid_t> pids;
+    std::vector<int> fds;
+    ClassDistribution *exact;
+    neighborSet nearest;
+  };
+
+}
+#endif // TIMBL_SHARDS_H
@@ -0,0 +1,88 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#ifndef TIMBL_SPARSEBASE_H
+#define TIMBL_SPARSEBASE_H
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "timbl/Instance.h"
+#include "timbl/IBtree.h"
+
+namespace Timbl {
+
+  // an (entry,value) pair in the index of a Sparse_InstanceBase
+  using sparsePosting = std::pair<size_t,FeatureValue *>;
+
+  class Sparse_InstanceBase: public InstanceBase_base {
+    // The InstanceBase of an IB1 experiment on Sparse or SparseBin data.
+    // Instead of a tree over all the features, every distinct instance
+    // is an entry which only holds its active values, and every position
+    // has a list of the entries with an active value there.
+    // All the other values of an entry are the default of their position.
+    // Copies share the entries.
+  public:
+    Sparse_InstanceBase( size_t, unsigned long&, bool );
+    Sparse_InstanceBase *Copy() const override;
+    Sparse_InstanceBase *clone() const override;
+    bool AddInstance( const Instance& ) override;
+    const ClassDistribution *ExactMatch( const Instance& ) const override;
+    unsigned long int GetSizeInfo( unsigned long int&,
+				   double & ) const override;
+    void setDefaults( const std::vector<FeatureValue *>& );
+    const std::vector<FeatureValue *>& defaults() const {
+      return store->defaults; };
+    size_t size() const { return store->distributions.size(); };
+    const activeValue *begin( size_t e ) const {
+      return store->values.data() + store->starts[e]; };
+    const activeValue *end( size_t e ) const {
+      return store->values.data() + store->starts[e+1]; };
+    const ClassDistribution *distribution( size_t e ) const {
+      return store->distributions[e]; };
+    const std::vector<sparsePosting>& postings( size_t pos ) const {
+      return store->postings[pos]; };
+  private:
+    struct sparseStore {
+      sparseStore(): starts( 1, 0 ) {};
+      sparseStore( const sparseStore& ) = delete; // forbid copies
+      sparseStore& operator=( const sparseStore& ) = delete; // forbid copies
+      ~sparseStore();
+      std::vector<FeatureValue *> defaults;     // position -> value
+      std::vector<size_t> starts;               // entry -> first value
+      std::vector<activeValue> values;
+      std::vector<ClassDistribution *> distributions;
+      std::vector<std::vector<sparsePosting>> postings; // position -> entries
+      std::unordered_multimap<size_t,size_t> lookup;    // hash -> entry
+    };
+    std::shared_ptr<sparseStore> store;
+    size_t find( const Instance&, size_t ) const;
+  };
+
+}
+#endif // TIMBL_SPARSEBASE_H
@@ -28,6 +28,7 @@
 #ifndef TIMBL_STATISTICS_H
 #define TIMBL_STATISTICS_H
 
+#include <atomic>
 #include "timbl/MsgClass.h"
 
 namespace Timbl {
@@ -47,32 +48,65 @@ namespace Timbl {
   };
 
   class StatisticsClass {
+    // The counters are only written by the thread that owns this object,
+    // but may be read by others (e.g. a progress reporter) at any time.
+    // So relaxed atomics suffice: no locks and no read-modify-write.
   public:
-  StatisticsClass(): _data(0), _skipped(0), _correct(0),
+    StatisticsClass(): _data(0), _skipped(0), _correct(0),
       _tieOk(0), _tieFalse(0), _exact(0) {};
-    void clear() { _data =0; _skipped = 0; _correct = 0;
+    StatisticsClass( const StatisticsClass& in ) { *this = in; };
+    StatisticsClass& operator=( const StatisticsClass& );
+    void clear() { _data = 0; _skipped = 0; _correct = 0;
       _tieOk = 0; _tieFalse = 0; _exact = 0; };
-    void addLine() { ++_data; }
-    void addSkipped() { ++_skipped; }
-    void addCorrect() { ++_correct; }
-    void addTieCorrect() { ++_tieOk; }
-    void addTieFailure() { ++_tieFalse; }
-    void addExact() { ++_exact; }
-    unsigned int dataLines() const { return _data; };
-    unsigned int skippedLines() const { return _skipped; };
-    unsigned int totalLines() const { return _data + _skipped; };
-    unsigned int testedCorrect() const { return _correct; };
-    unsigned int tiedCorrect() const { return _tieOk; };
-    unsigned int tiedFailure() const { return _tieFalse; };
-    unsigned int exactMatches() const { return _exact; };
+    void addLine() { incr( _data ); }
+    void addSkipped() { incr( _skipped ); }
+    void addCorrect() { incr( _correct ); }
+    void addTieCorrect() { incr( _tieOk ); }
+    void addTieFailure() { incr( _tieFalse ); }
+    void addExact() { incr( _exact ); }
+    unsigned int dataLines() const { return get( _data ); };
+    unsigned int skippedLines() const { return get( _skipped ); };
+    unsigned int totalLines() const { return dataLines() + skippedLines(); };
+    unsigned int testedCorrect() const { return get( _correct ); };
+    unsigned int tiedCorrect() const { return get( _tieOk ); };
+    unsigned int tiedFailure() const { return get( _tieFalse ); };
+    unsigned int exactMatches() const { return get( _exact ); };
     void merge( const StatisticsClass& );
   private:
-    unsigned int _data;
-    unsigned int _skipped;
-    unsigned int _correct;
-    unsigned int _tieOk;
-    unsigned int _tieFalse;
-    unsigned int _exact;
+    using counter = std::atomic<unsigned int>;
+    static void incr( counter& c ){
+      c.store( c.load( std::memory_order_relaxed ) + 1,
+	       std::memory_order_relaxed );
+    }
+    static unsigned int get( const counter& c ){
+      return c.load( std::memory_order_relaxed );
+    }
+    counter _data;
+    counter _skipped;
+    counter _correct;
+    counter _tieOk;
+    counter _tieFalse;
+    counter _exact;
+  };
+
+  class statsSnapshot {
+    // the combined counters of one or more StatisticsClass objects,
+    // taken while a Test is running or after it is finished
+  public:
+    statsSnapshot(): lines(0), skipped(0), correct(0), exact(0),
+      seconds(0.0) {};
+    void add( const StatisticsClass& );
+    double linesPerSecond() const {
+      return seconds > 0 ? lines / seconds : 0.0; };
+    double accuracy() const {
+      return lines > 0 ? correct / (double)lines : 0.0; };
+    double exactRatio() const {
+      return lines > 0 ? exact / (double)lines : 0.0; };
+    unsigned int lines;
+    unsigned int skipped;
+    unsigned int correct;
+    unsigned int exact;
+    double seconds;
   };
 
 }
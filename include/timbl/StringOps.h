@@ -44,9 +44,23 @@ namespace Timbl {
   icu::UnicodeString StrToCode( const icu::UnicodeString&, bool=true );
   icu::UnicodeString CodeToStr( const icu::UnicodeString& );
 
+  std::istream& read_line( std::istream&,
+			   std::string&,
+			   icu::UnicodeString& );
+
+  void append_string( std::string&, const icu::UnicodeString& );
+  void append_code( std::string&, const icu::UnicodeString& );
+  void append_double( std::string&, double, int, bool );
+
   std::string correct_path( const std::string&,
 			    const std::string&,
 			    bool = true );
+
+  struct unicode_hash {
+    size_t operator()( const icu::UnicodeString& us ) const {
+      return us.hashCode();
+    }
+  };
 }
 
 #endif
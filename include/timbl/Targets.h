@@ -33,6 +33,7 @@
 #include <unordered_map>
 #include "unicode/unistr.h"
 #include "timbl/MsgClass.h"
+#include "timbl/Recycler.h"
 #include "ticcutils/Unicode.h"
 
 namespace Hash {
@@ -67,6 +68,8 @@ namespace Timbl {
     size_t _frequency;
   };
 
+  void append_value( std::string&, const ValueClass * );
+
   class TargetValue: public ValueClass {
   public:
     TargetValue( const icu::UnicodeString&, size_t );
@@ -114,6 +117,12 @@ namespace Timbl {
       value(in.value), frequency(in.frequency), weight(in.weight) {};
     Vfield& operator=( const Vfield& ) = delete; // forbid copies
     ~Vfield(){};
+    static void *operator new( size_t ){
+      return recycler<sizeof(Vfield)>::get();
+    }
+    static void operator delete( void *p ){
+      recycler<sizeof(Vfield)>::put( p );
+    }
     std::ostream& put( std::ostream& ) const;
     const TargetValue *Value() const { return value; };
     void Value( const TargetValue *t ){  value = t; };
@@ -138,11 +147,28 @@ namespace Timbl {
     friend std::ostream& operator<<( std::ostream&, const ClassDistribution * );
     friend class WClassDistribution;
   public:
-    using VDlist = std::map<size_t, Vfield *>;
+    using VDlist = std::map<size_t, Vfield *, std::less<size_t>,
+			    recycling_allocator<std::pair<const size_t,
+							  Vfield *>>>;
     using dist_iterator = VDlist::const_iterator;
-    ClassDistribution( ): total_items(0) {};
+    ClassDistribution( ): total_items(0), users(1) {};
     ClassDistribution( const ClassDistribution& );
     virtual ~ClassDistribution(){ clear(); };
+    static void *operator new( size_t sz ){
+      // a WClassDistribution has the same size
+      if ( sz == sizeof(ClassDistribution) ){
+	return recycler<sizeof(ClassDistribution)>::get();
+      }
+      return ::operator new( sz );
+    }
+    static void operator delete( void *p, size_t sz ){
+      if ( sz == sizeof(ClassDistribution) ){
+	recycler<sizeof(ClassDistribution)>::put( p );
+      }
+      else {
+	::operator delete( p );
+      }
+    }
     size_t totalSize() const{ return total_items; };
     size_t size() const{ return distribution.size(); };
     bool empty() const{ return distribution.empty(); };
@@ -162,13 +188,23 @@ namespace Timbl {
 							bool );
     const std::string DistToString() const;
     const std::string DistToStringW( int ) const;
+    void DistToStringW( std::string& s, int beam ) const {
+      DistToStringWW( s, beam ); };
     double Confidence( const TargetValue * ) const;
-    virtual const std::string SaveHashed() const;
-    virtual const std::string Save() const;
+    const std::string SaveHashed() const;
+    const std::string Save() const;
+    virtual void SaveHashedTo( std::string& ) const;
+    virtual void SaveTo( std::string& ) const;
     bool ZeroDist() const { return total_items == 0; };
     double Entropy() const;
     ClassDistribution *to_VD_Copy( ) const;
     virtual WClassDistribution *to_WVD_Copy() const;
+    ClassDistribution *Replicate() const;
+    // the leaves of a tree may share a distribution. The last one
+    // deletes it, and one which changes it makes its own copy first
+    ClassDistribution *share() { ++users; return this; };
+    bool isShared() const { return users > 1; };
+    static void release( ClassDistribution * );
   protected:
     virtual void DistToString( std::string&, double=0 ) const;
     virtual void DistToStringWW( std::string&, int ) const;
@@ -178,6 +214,8 @@ namespace Timbl {
       return new ClassDistribution(); };
     size_t total_items;
     VDlist distribution;
+  private:
+    unsigned int users;
   };
 
   class WClassDistribution: public ClassDistribution {
@@ -187,8 +225,8 @@ namespace Timbl {
     void SetFreq( const TargetValue *, int, double ) override;
     bool IncFreq( const TargetValue *, size_t, double ) override;
     WClassDistribution *to_WVD_Copy( ) const override;
-    const std::string SaveHashed() const override;
-    const std::string Save() const override;
+    void SaveHashedTo( std::string& ) const override;
+    void SaveTo( std::string& ) const override;
     void Normalize();
     void Normalize_1( double, const Targets& );
     void Normalize_2();
@@ -200,5 +238,24 @@ namespace Timbl {
       return new WClassDistribution; };
   };
 
+  class DistributionPool {
+    // owns one copy of every distinct distribution given to intern(),
+    // to be shared by the nodes of a tree which doesn't change anymore
+  public:
+    DistributionPool(): num_entries(0) {};
+    DistributionPool( const DistributionPool& ) = delete; // forbid copies
+    DistributionPool& operator=( const DistributionPool& ) = delete; // forbid copies
+    ~DistributionPool();
+    ClassDistribution *intern( ClassDistribution * );
+    void freeze();
+    static std::string key( const ClassDistribution * );
+    size_t size() const { return dists.size(); };
+    size_t entries() const { return num_entries; };
+  private:
+    std::vector<ClassDistribution *> dists;
+    std::unordered_map<std::string, ClassDistribution *> index;
+    size_t num_entries;
+  };
+
 }
 #endif // TINBL_TARGETS_H
@@ -58,6 +58,16 @@ namespace Timbl{
     int threshold;
   };
 
+  class realValues {
+    // the numeric values of the FeatureValues, each one converted only
+    // once, instead of once per feature per leaf
+  public:
+    bool get( const FeatureValue *, double& );
+  private:
+    std::vector<double> values;
+    std::vector<char> status;
+  };
+
   class TesterClass {
   public:
     TesterClass( const Feature_List& );
@@ -103,7 +113,9 @@ namespace Timbl{
 			 size_t,
 			 double ) override = 0;
   protected:
+    double innerProduct( const FeatureValue *, const FeatureValue * );
   private:
+    realValues reals;
   };
 
   class CosineTester: public SimilarityTester {
@@ -132,6 +144,52 @@ namespace Timbl{
 			  const Feature_List&,
 			  int );
 
+  class Sparse_InstanceBase;
+
+  class SparseTester {
+    // the counterpart of a TesterClass for a Sparse_InstanceBase.
+    // It only visits the active values of the instances: on every other
+    // position both have the default value, which adds nothing.
+    // The distances are the same as the TesterClasses calculate, and so
+    // is the order of the nearest neighbors, for the Sparse format
+    // the similarity metrics take the default as 0 though.
+  public:
+    SparseTester( MetricType, const Feature_List&, int );
+    SparseTester( const SparseTester& ) = delete; // inhibit copies
+    SparseTester& operator=( const SparseTester& ) = delete; // inhibit copies
+    ~SparseTester();
+    void init( const Sparse_InstanceBase&, const std::vector<activeValue>& );
+    void search( size_t, std::vector<std::pair<double,size_t>>& );
+  private:
+    MetricType metric;
+    const std::vector<size_t>& permutation;
+    std::vector<Feature *> permFeatures;
+    std::vector<metricTestFunction*> metricTest;
+    realValues reals;
+    const Sparse_InstanceBase *base;
+    size_t prepared;
+    std::vector<double> entry_values;
+    std::vector<size_t> order;
+    std::vector<size_t> seen;
+    std::vector<double> sums;
+    size_t generation;
+    const std::vector<activeValue> *inst;
+    double inst_value;
+    bool isSimilarity() const {
+      return metric == Cosine || metric == DotProduct; };
+    void prepare();
+    double term( size_t, const FeatureValue *, const FeatureValue * ) const;
+    double product( size_t, const FeatureValue *, const FeatureValue * );
+    double distance( size_t, double ) const;
+    double similarity( double, size_t ) const;
+    const FeatureValue *value( size_t ) const;
+    bool treeOrder( size_t, size_t ) const;
+    void nearest( std::vector<double>&,
+		  std::vector<std::pair<double,size_t>>& );
+    void similar( std::vector<double>&,
+		  std::vector<std::pair<double,size_t>>& );
+  };
+
 }
 
 #endif // TIMBL_TESTERS_H
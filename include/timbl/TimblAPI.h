@@ -31,12 +31,15 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include "ticcutils/CommandLine.h"
 #include "timbl/Common.h"
 #include "timbl/Types.h"
 #include "timbl/Instance.h"
 #include "timbl/neighborSet.h"
 #include "timbl/TimblExperiment.h"
+#include "timbl/ClassifyPool.h"
+#include "timbl/ClassifySearch.h"
 
 namespace Timbl{
 
@@ -56,16 +59,10 @@ namespace Timbl{
     TimblAPI( const std::string&,  const std::string& = "" );
     TimblAPI( const TimblAPI& );
     ~TimblAPI();
+    std::unique_ptr<TimblAPI> Fork();
     bool isValid() const;
     bool Valid() const;
-    TimblExperiment *grabAndDisconnectExp(){
-      TimblExperiment *res = 0;
-      if ( Valid() ){
-	res = pimpl;
-	pimpl = 0;
-      }
-      return res;
-    }
+    TimblExperiment *grabAndDisconnectExp();
     bool Prepare( const std::string& = "" );
     bool CVprepare( const std::string& = "",
 		    Weighting = GR,
@@ -118,6 +115,12 @@ namespace Timbl{
 		   double& );
     bool Classify( const icu::UnicodeString&,
 		   icu::UnicodeString& );
+    bool StartClassifyPool( int, size_t = 1000 );
+    void StopClassifyPool();
+    std::vector<std::future<classifyResult>> ClassifyAsync( const std::vector<std::string>& );
+    bool ClassifyAsync( const std::vector<std::string>&,
+			const classifyCallback& );
+    ClassifySearch *NewClassifySearch();
     bool ShowBestNeighbors( std::ostream& ) const;
     size_t matchDepth() const;
     double confidence() const;
@@ -130,6 +133,9 @@ namespace Timbl{
     Weighting CurrentWeighting() const;
     Weighting GetCurrentWeights( std::vector<double>& ) const;
     bool WriteInstanceBase( const std::string& = "" );
+    bool WriteSnapshot( const std::string&, size_t = 0 );
+    bool WriteBundle( const std::string& );
+    bool CompactInstanceBase();
     bool WriteInstanceBaseXml( const std::string& = "" );
     bool WriteInstanceBaseLevels( const std::string& = "", unsigned int=0 );
     bool GetInstanceBase( const std::string& = "" );
@@ -143,6 +149,9 @@ namespace Timbl{
     bool ShowSettings( std::ostream& ) const;
     bool ShowIBInfo( std::ostream& ) const;
     bool ShowStatistics( std::ostream& ) const;
+    statsSnapshot GetLiveStatistics() const;
+    bool SetLogStream( std::ostream& );
+    bool ConvertInstances( const std::string&, const std::string& );
     bool SetOptions( const std::string& );
     bool SetIndirectOptions( const TiCC::CL_Options&  );
     bool SetThreads( int c );
@@ -155,14 +164,21 @@ namespace Timbl{
   private:
     TimblAPI();
     TimblAPI& operator=( const TimblAPI& ); // forbid copies
+    bool notForked( const std::string& ) const;
+    bool hasForks() const;
     TimblExperiment *pimpl;
+    ClassifyPool *pool;
     bool i_am_fine;
+    // the experiment that owns the InstanceBase shared with forks.
+    // Forks keep it alive, so it may outlive its own TimblAPI
+    std::shared_ptr<TimblExperiment> fork_origin;
   };
 
   const std::string to_string( const Algorithm );
   const std::string to_string( const Weighting );
   bool string_to( const std::string&, Algorithm& );
   bool string_to( const std::string&, Weighting& );
+  bool bundle_algorithm( const std::string&, Algorithm& );
 
   using ValueDistribution = ClassDistribution; // for backward compatability
   using WValueDistribution = WClassDistribution; // for backward compatability
@@ -33,10 +33,14 @@
 #include <iosfwd>
 #include <fstream>
 #include <set>
+#include <mutex>
+#include <chrono>
 #include "ticcutils/XMLtools.h"
 #include "timbl/Statistics.h"
 #include "timbl/MsgClass.h"
 #include "timbl/MBLClass.h"
+#include "timbl/InputStream.h"
+#include "timbl/BinaryInstances.h"
 
 namespace TiCC {
   class CL_Options;
@@ -77,7 +81,7 @@ namespace Timbl {
     void addTop( const ClassDistribution *, const TargetValue * );
     void addDisposable( ClassDistribution *, const TargetValue * );
     const WClassDistribution *getResultDist();
-    std::string getResult();
+    const std::string& getResult();
     void prepare();
     void normalize();
     double confidence() const {
@@ -113,21 +117,29 @@ namespace Timbl {
   class fCmp {
   public:
     bool operator()( const FeatureValue* F, const FeatureValue* G ) const{
-      return F->Index() > G->Index();
+      // descending, learnFromFileIndex() puts each part in front
+      return G->before( F );
     }
   };
 
-  using fileIndex = std::map<FeatureValue*,std::set<std::streamsize>, fCmp>;
+  using fileIndex = std::map<FeatureValue*,std::vector<std::streamsize>, fCmp>;
   using fileDoubleIndex = std::map<FeatureValue*, fileIndex, fCmp >;
   std::ostream& operator<< ( std::ostream&, const fileIndex& );
   std::ostream& operator<< ( std::ostream&, const fileDoubleIndex& );
 
   class threadData;
+  class progressReporter;
+  class ClassifySearch;
+  class ShardSet;
+  class InstanceStore;
+  class learnChunk;
 
   class TimblExperiment: public MBLClass {
     friend class TimblAPI;
     friend class threadData;
     friend class threadBlock;
+    friend class progressReporter;
+    friend class ClassifySearch;
   public:
     virtual ~TimblExperiment() override;
     virtual TimblExperiment *clone() const = 0;
@@ -150,7 +162,12 @@ namespace Timbl {
     virtual void InitInstanceBase() = 0;
     virtual bool ReadInstanceBase( const std::string& );
     virtual bool WriteInstanceBase( const std::string& );
+    bool WriteSnapshot( const std::string&, size_t = 0 );
+    bool WriteBundle( const std::string& );
+    bool CompactInstanceBase();
     bool chopLine( const icu::UnicodeString& );
+    bool chopRow( const BinaryInstanceReader&, const binaryRow& );
+    bool ConvertInstances( const std::string&, const std::string& );
     bool WriteInstanceBaseXml( const std::string& );
     bool WriteInstanceBaseLevels( const std::string&, unsigned int );
     bool WriteNamesFile( const std::string& ) const;
@@ -159,9 +176,31 @@ namespace Timbl {
     void Estimate( int e ){ estimate = e; };
     int Clones() const { return numOfThreads; };
     void Clones( int cl ) { numOfThreads = cl; };
+    bool NumaReplicas() const { return numaReplicas; };
+    void NumaReplicas( bool b ) { numaReplicas = b; };
+    int Shards() const { return numOfShards; };
+    void Shards( int n, bool on_feature ) {
+      numOfShards = n; shardByFeature = on_feature; };
+    bool Sharded() const { return shards != 0; };
+    long IngestLimit() const { return ingestLimit; };
+    void IngestLimit( long mb ) { ingestLimit = mb; };
+    int FlushEvery() const { return flushEvery; };
+    void FlushEvery( int n ) { flushEvery = n; };
+    bool EchoInput() const { return echoInput; };
+    void EchoInput( bool b ) { echoInput = b; };
+    bool BinaryTables() const { return binaryTables; };
+    void BinaryTables( bool b ) { binaryTables = b; };
+    bool FrequencyOrder() const { return frequencyOrder; };
+    void FrequencyOrder( bool b ) { frequencyOrder = b; };
+    bool SparseSearch() const { return sparseSearch; };
+    void SparseSearch( bool b ) { sparseSearch = b; };
+    long LazyLoad() const { return lazyLoad; };
+    void LazyLoad( long bytes ) { lazyLoad = bytes; };
     void setOutPath( const std::string& s ){ outPath = s; };
     TimblExperiment *CreateClient( int  ) const;
     TimblExperiment *splitChild() const;
+    TimblExperiment *Fork();
+    bool IsFork() const { return forked; };
     bool SetOptions( int, const char *[] );
     bool SetOptions( const std::string& );
     bool SetOptions( const TiCC::CL_Options&  );
@@ -186,6 +225,7 @@ namespace Timbl {
     xmlNode *bestNeighborsToXML() const;
     nlohmann::json best_neighbors_to_JSON() const;
     bool showStatistics( std::ostream& ) const;
+    statsSnapshot liveStatistics() const;
     void showInputFormat( std::ostream& ) const;
     const std::string& ExpName() const { return exp_name; };
     void setExpName( const std::string& s ) { exp_name = s; };
@@ -249,7 +289,36 @@ namespace Timbl {
     virtual void showTestingInfo( std::ostream& );
     virtual bool checkTestFile();
     bool learnFromFileIndex( const fileIndex&, std::istream& );
+    bool indexedInstance( std::streamsize,
+			  std::istream&,
+			  icu::UnicodeString& );
+    void releaseStore();
+    bool readFailed( const InputStream&, const std::string&,
+		     const BinaryInstanceReader * = 0 );
+    bool storeFailed( const std::string& );
+    bool learnLines( InputStream&, const std::string& );
+    bool learnBinary( InputStream&, BinaryInstanceReader&,
+		      const std::string& );
+    bool useSparseSearch( size_t );
+    bool learnSparse();
+    BinaryInstanceReader *openBinary( std::istream&, const std::string& );
+    bool rejectBinary( const std::string&, const std::string& );
+    bool nextTestLine( icu::UnicodeString& );
+    bool chopTestLine( const icu::UnicodeString& );
+    bool learnChunked( const std::string&,
+		       const std::vector<std::streamsize>& );
+    void chopChunk( const std::string&, learnChunk& ) const;
+    bool ShardedLearn( const std::string&, bool );
     bool initTestFiles( const std::string&, const std::string& );
+    void writeTreeIndex( const std::string&, std::streamoff ) const;
+    void readTreeIndex( const std::string&, std::istream& );
+    void setLazyLoad();
+    void rankValues();
+    void orderInstanceBase();
+    bool ReadBundle( const std::string& );
+    void logDelta( char, const icu::UnicodeString& );
+    bool syncDelta();
+    bool replayDelta( const std::string& );
     void show_results( std::ostream&,
 		       const double,
 		       const std::string&,
@@ -260,6 +329,7 @@ namespace Timbl {
 		       size_t = 0 );
     void normalizeResult();
     const neighborSet *LocalClassify( const Instance& );
+    void resultsWritten( int = 1 );
     bool nextLine( std::istream &, icu::UnicodeString&, int& );
     bool nextLine( std::istream &, icu::UnicodeString& );
     bool skipARFFHeader( std::istream & );
@@ -286,7 +356,15 @@ namespace Timbl {
     std::string outPath;
     std::string testStreamName;
     std::string outStreamName;
-    std::ifstream testStream;
+    InputStream testStream;
+    std::vector<std::streamoff> treeIndex;
+    std::string treeFile;
+    unsigned long int treeNodes;
+    unsigned long int treeTails;
+    std::string lineBuffer;
+    BinaryInstanceReader *binaryTest;
+    binaryRow testRow;
+    std::vector<char> outBuffer;
     std::ofstream outStream;
     unsigned long ibCount;
     ConfusionMatrix *confusionInfo;
@@ -300,6 +378,39 @@ namespace Timbl {
     TimblExperiment( const TimblExperiment& );
     int estimate;
     int numOfThreads;
+    bool numaReplicas;
+    std::vector<unsigned int> nodeLines;
+    ShardSet *shards;
+    int numOfShards;
+    bool shardByFeature;
+    int shardIndex;
+    size_t shardSeen;
+    size_t shardLearned;
+    mutable std::mutex live_lock;
+    std::vector<const StatisticsClass *> live_stats;
+    std::chrono::steady_clock::time_point live_start;
+    statsSnapshot live_last;
+    const neighborSet *known_bands;
+    InstanceStore *ingest;
+    long ingestLimit;
+    int flushEvery;
+    int unflushed;
+    bool echoInput;
+    bool binaryTables;
+    bool frequencyOrder;
+    bool sparseSearch;
+    long lazyLoad;
+    std::string resultLine;
+    std::ofstream deltaLog;
+    std::string snapshotName;
+    size_t deltaLimit;
+    size_t deltaCount;
+    bool forked;
+    std::ostream *forkLog;
+    void startLiveStatistics( const std::vector<const StatisticsClass *>& );
+    void stopLiveStatistics();
+    bool ownedByShard( const Instance& );
+    void runShard( int, int, const std::string&, bool );
     const TargetValue *classifyString( const icu::UnicodeString&,
 				       double& );
   };
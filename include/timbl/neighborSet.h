@@ -82,6 +82,7 @@ namespace Timbl {
     friend std::ostream& operator<<( std::ostream&, const neighborSet& );
     friend std::ostream& operator<<( std::ostream&, const neighborSet * );
     friend class BestArray;
+    friend class ShardSet;
   public:
     neighborSet();
     ~neighborSet();
@@ -92,6 +93,7 @@ namespace Timbl {
     void clear();
     void truncate( size_t );
     void merge( const neighborSet& );
+    void append( const neighborSet&, size_t );
     double getDistance( size_t ) const;
     double bestDistance() const { return getDistance(0); };
     const ClassDistribution *getDistribution( size_t ) const;
@@ -90,11 +90,10 @@ namespace Timbl {
     // Also check if verbosity has changed and a BestInstances array
     // is required.
     //
-    size_t S = size;
     size = numN;
-    if ( S < size ){
+    if ( bestArray.size() < size ){
       bestArray.reserve( size );
-      for ( size_t k=S; k < size; ++k ) {
+      for ( size_t k=bestArray.size(); k < size; ++k ) {
 	bestArray.push_back( new BestRec() );
       }
     }
@@ -0,0 +1,472 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "ticcutils/Unicode.h"
+#include "timbl/Choppers.h"
+#include "timbl/InputStream.h"
+#include "timbl/BinaryInstances.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Timbl {
+
+  static const char magic[] = "TiMBLbin";
+  static const size_t magic_len = 8;
+  static const uint32_t file_version = 1;
+  static const uint32_t weights_flag = 1;
+  static const uint32_t occurrences_flag = 2;
+  static const size_t block_rows = 64*1024; // so a row fits in 2 bytes
+  static const size_t block_cells = 4*1024*1024;
+  static const int sparse_flag = 0x80;
+
+  static void put_u32( vector<char>& buf, uint32_t val, size_t width = 4 ){
+    for ( size_t i=0; i < width; ++i ){
+      buf.push_back( static_cast<char>( val & 0xff ) );
+      val >>= 8;
+    }
+  }
+
+  static uint32_t get_u32( const unsigned char *pnt, size_t width = 4 ){
+    uint32_t result = 0;
+    for ( size_t i=width; i > 0; --i ){
+      result = ( result << 8 ) | pnt[i-1];
+    }
+    return result;
+  }
+
+  static bool read_u32( istream& is, uint32_t& val ){
+    unsigned char buf[4];
+    if ( !is.read( reinterpret_cast<char*>(buf), 4 ) ){
+      return false;
+    }
+    val = get_u32( buf );
+    return true;
+  }
+
+  static void put_double( vector<char>& buf, double d ){
+    uint64_t val;
+    memcpy( &val, &d, sizeof(val) );
+    put_u32( buf, static_cast<uint32_t>( val & 0xffffffff ) );
+    put_u32( buf, static_cast<uint32_t>( val >> 32 ) );
+  }
+
+  static double get_double( const unsigned char *pnt ){
+    uint64_t val = get_u32( pnt + 4 );
+    val = ( val << 32 ) | get_u32( pnt );
+    double result;
+    memcpy( &result, &val, sizeof(result) );
+    return result;
+  }
+
+  static size_t index_width( size_t values ){
+    // the number of bytes needed for an index in 0 .. values-1
+    if ( values <= 0x100 ){
+      return 1;
+    }
+    else if ( values <= 0x10000 ){
+      return 2;
+    }
+    return 4;
+  }
+
+  BinaryInstanceWriter::BinaryInstanceWriter( ostream& out,
+					      size_t nf,
+					      InputFormatType IF,
+					      bool w,
+					      bool occ ):
+    os( out ),
+    num_feats( nf ),
+    weighted( w ),
+    with_occurrences( occ ),
+    rows( 0 ),
+    total( 0 )
+  {
+    // keep a block in a few Mb, also with thousands of (sparse) features
+    max_rows = min( block_rows, max<size_t>( 1024, block_cells / (nf+1) ) );
+    index.resize( num_feats + 1 );
+    fresh.resize( num_feats + 1 );
+    columns.resize( num_feats + 1 );
+    vector<char> header( magic, magic + magic_len );
+    put_u32( header, file_version );
+    put_u32( header, num_feats );
+    put_u32( header, IF );
+    put_u32( header, ( weighted ? weights_flag : 0 )
+	     | ( with_occurrences ? occurrences_flag : 0 ) );
+    os.write( header.data(), header.size() );
+  }
+
+  bool BinaryInstanceWriter::add( const Chopper& chopped ){
+    // store the fields of chopped, the target being the last one
+    for ( size_t col=0; col <= num_feats; ++col ){
+      const UnicodeString& val = chopped.getField( col );
+      auto it = index[col].find( val );
+      if ( it == index[col].end() ){
+	it = index[col].emplace( val, index[col].size() ).first;
+	fresh[col].push_back( val );
+      }
+      columns[col].push_back( it->second );
+    }
+    if ( weighted ){
+      weights.push_back( chopped.getExW() );
+    }
+    if ( with_occurrences ){
+      occurrences.push_back( chopped.getOcc() );
+    }
+    ++total;
+    if ( ++rows == max_rows ){
+      return write_block();
+    }
+    return true;
+  }
+
+  bool BinaryInstanceWriter::write_block(){
+    vector<char> buf;
+    put_u32( buf, rows );
+    for ( size_t col=0; col <= num_feats; ++col ){
+      put_u32( buf, fresh[col].size() );
+      for ( const auto& val : fresh[col] ){
+	string utf8 = TiCC::UnicodeToUTF8( val );
+	put_u32( buf, utf8.size() );
+	buf.insert( buf.end(), utf8.begin(), utf8.end() );
+      }
+      fresh[col].clear();
+      size_t width = index_width( index[col].size() );
+      const vector<uint32_t>& column = columns[col];
+      // find the most frequent value, when it fills most of the column
+      uint32_t common = column[0];
+      size_t votes = 0;
+      for ( const auto idx : column ){
+	if ( votes == 0 ){
+	  common = idx;
+	}
+	if ( idx == common ){
+	  ++votes;
+	}
+	else {
+	  --votes;
+	}
+      }
+      size_t others = 0;
+      for ( const auto idx : column ){
+	others += ( idx != common );
+      }
+      if ( 4 + width + others * ( 2 + width ) < rows * width ){
+	// typical for Sparse data: store the exceptions only
+	buf.push_back( static_cast<char>( width | sparse_flag ) );
+	put_u32( buf, common, width );
+	put_u32( buf, others );
+	for ( size_t row=0; row < rows; ++row ){
+	  if ( column[row] != common ){
+	    put_u32( buf, row, 2 );
+	    put_u32( buf, column[row], width );
+	  }
+	}
+      }
+      else {
+	buf.push_back( static_cast<char>( width ) );
+	for ( const auto idx : column ){
+	  put_u32( buf, idx, width );
+	}
+      }
+      columns[col].clear();
+    }
+    for ( const auto w : weights ){
+      put_double( buf, w );
+    }
+    weights.clear();
+    for ( const auto occ : occurrences ){
+      put_u32( buf, occ );
+    }
+    occurrences.clear();
+    os.write( buf.data(), buf.size() );
+    rows = 0;
+    return os.good();
+  }
+
+  bool BinaryInstanceWriter::finish(){
+    // write the last rows and the end marker
+    if ( rows > 0 && !write_block() ){
+      return false;
+    }
+    vector<char> buf;
+    put_u32( buf, 0 );
+    os.write( buf.data(), buf.size() );
+    os.flush();
+    return os.good();
+  }
+
+  BinaryInstanceReader::BinaryInstanceReader( istream& in ):
+    is( in ),
+    num_feats( 0 ),
+    input_format( UnknownInputFormat ),
+    has_weights( false ),
+    has_occurrences( false ),
+    at_end( false ),
+    rows( 0 ),
+    cursor( 0 )
+  {
+    char buf[magic_len];
+    uint32_t version = 0;
+    uint32_t nf = 0;
+    uint32_t form = 0;
+    uint32_t flags = 0;
+    if ( !is.read( buf, magic_len )
+	 || memcmp( buf, magic, magic_len ) != 0 ){
+      fail( "not a binary instance file" );
+    }
+    else if ( !read_u32( is, version )
+	      || !read_u32( is, nf )
+	      || !read_u32( is, form )
+	      || !read_u32( is, flags ) ){
+      fail( "truncated header" );
+    }
+    else if ( version != file_version ){
+      fail( "unsupported version " + to_string( version ) );
+    }
+    else if ( nf == 0
+	      || form <= UnknownInputFormat
+	      || form >= MaxInputFormat ){
+      fail( "corrupt header" );
+    }
+    else {
+      num_feats = nf;
+      input_format = static_cast<InputFormatType>( form );
+      has_weights = flags & weights_flag;
+      has_occurrences = flags & occurrences_flag;
+      dictionary.resize( num_feats + 1 );
+      columns.resize( num_feats + 1 );
+      commons.resize( num_feats + 1 );
+      if ( input_format == Sparse ){
+	sparse_default = DefaultSparseString;
+      }
+      else if ( input_format == SparseBin ){
+	sparse_default = "0";
+      }
+      // no index yet: the default value isn't in the dictionary
+      default_index.assign( num_feats, UINT32_MAX );
+    }
+  }
+
+  bool BinaryInstanceReader::fail( const string& what ){
+    message = what;
+    return false;
+  }
+
+  bool BinaryInstanceReader::read_block(){
+    uint32_t num = 0;
+    if ( !read_u32( is, num ) ){
+      return fail( "truncated file: the end marker is missing" );
+    }
+    if ( num == 0 ){
+      at_end = true;
+      return false;
+    }
+    if ( num > block_rows ){
+      return fail( "corrupt block" );
+    }
+    vector<unsigned char> buf;
+    const size_t stride = num_feats + 1;
+    for ( size_t col=0; col < stride; ++col ){
+      uint32_t new_vals = 0;
+      if ( !read_u32( is, new_vals ) ){
+	return fail( "truncated block" );
+      }
+      for ( size_t i=0; i < new_vals; ++i ){
+	uint32_t len = 0;
+	if ( !read_u32( is, len ) ){
+	  return fail( "truncated block" );
+	}
+	string utf8( len, '\0' );
+	if ( len > 0 && !is.read( &utf8[0], len ) ){
+	  return fail( "truncated block" );
+	}
+	dictionary[col].push_back( TiCC::UnicodeFromUTF8( utf8 ) );
+	if ( col < num_feats
+	     && !sparse_default.isEmpty()
+	     && dictionary[col].back() == sparse_default ){
+	  default_index[col] = dictionary[col].size() - 1;
+	}
+      }
+      int width = is.get();
+      bool sparse = ( width != EOF ) && ( width & sparse_flag );
+      if ( sparse ){
+	width &= ~sparse_flag;
+      }
+      if ( width != 1 && width != 2 && width != 4 ){
+	return fail( "corrupt block" );
+      }
+      size_t known = dictionary[col].size();
+      if ( sparse ){
+	buf.resize( width + 4 );
+	if ( !is.read( reinterpret_cast<char*>(buf.data()), buf.size() ) ){
+	  return fail( "truncated block" );
+	}
+	uint32_t common = get_u32( &buf[0], width );
+	uint32_t others = get_u32( &buf[width] );
+	if ( common >= known || others > num ){
+	  return fail( "corrupt block" );
+	}
+	commons[col] = common;
+	columns[col].clear();
+	size_t entry = 2 + width;
+	buf.resize( others * entry );
+	if ( !is.read( reinterpret_cast<char*>(buf.data()), buf.size() ) ){
+	  return fail( "truncated block" );
+	}
+	for ( size_t i=0; i < others; ++i ){
+	  uint32_t row = get_u32( &buf[i*entry], 2 );
+	  uint32_t idx = get_u32( &buf[i*entry+2], width );
+	  if ( row >= num || idx >= known ){
+	    return fail( "corrupt block: unknown value" );
+	  }
+	  patches.push_back( { row * stride + col, idx } );
+	}
+      }
+      else {
+	buf.resize( num * width );
+	if ( !is.read( reinterpret_cast<char*>(buf.data()), buf.size() ) ){
+	  return fail( "truncated block" );
+	}
+	commons[col] = 0;
+	columns[col].resize( num );
+	for ( size_t row=0; row < num; ++row ){
+	  uint32_t idx = get_u32( &buf[row*width], width );
+	  if ( idx >= known ){
+	    return fail( "corrupt block: unknown value" );
+	  }
+	  columns[col][row] = idx;
+	}
+      }
+    }
+    // now turn the columns into rows, so next() reads them in one go
+    cells.resize( num * stride );
+    for ( size_t row=0; row < num; ++row ){
+      copy( commons.begin(), commons.end(), cells.begin() + row * stride );
+    }
+    for ( size_t col=0; col < stride; ++col ){
+      if ( !columns[col].empty() ){
+	for ( size_t row=0; row < num; ++row ){
+	  cells[row * stride + col] = columns[col][row];
+	}
+      }
+    }
+    for ( const auto& [pos,idx] : patches ){
+      cells[pos] = idx;
+    }
+    patches.clear();
+    if ( has_weights ){
+      buf.resize( num * 8 );
+      if ( !is.read( reinterpret_cast<char*>(buf.data()), buf.size() ) ){
+	return fail( "truncated block" );
+      }
+      weights.resize( num );
+      for ( size_t row=0; row < num; ++row ){
+	weights[row] = get_double( &buf[row*8] );
+      }
+    }
+    if ( has_occurrences ){
+      buf.resize( num * 4 );
+      if ( !is.read( reinterpret_cast<char*>(buf.data()), buf.size() ) ){
+	return fail( "truncated block" );
+      }
+      occurrences.resize( num );
+      for ( size_t row=0; row < num; ++row ){
+	occurrences[row] = static_cast<int>( get_u32( &buf[row*4] ) );
+      }
+    }
+    rows = num;
+    cursor = 0;
+    return true;
+  }
+
+  bool BinaryInstanceReader::next( binaryRow& row ){
+    // get the next instance, false at the end or on an error
+    if ( !good() ){
+      return false;
+    }
+    if ( cursor == rows
+	 && ( at_end || !read_block() ) ){
+      return false;
+    }
+    auto first = cells.begin() + cursor * ( num_feats + 1 );
+    row.values.assign( first, first + num_feats + 1 );
+    row.weight = has_weights ? weights[cursor] : -1;
+    row.occurrences = has_occurrences ? occurrences[cursor] : 1;
+    ++cursor;
+    return true;
+  }
+
+  void BinaryInstanceReader::fill( const binaryRow& row,
+				   Chopper& chopper ) const {
+    // give chopper the fields of row, as if it chopped them from a line.
+    // only reads the dictionaries, so threads may fill their own choppers
+    // while no new rows are read
+    if ( sparse_default.isEmpty() ){
+      chopper.assignSize( num_feats );
+      for ( size_t col=0; col <= num_feats; ++col ){
+	chopper.assign( col, dictionary[col][row.values[col]] );
+      }
+    }
+    else {
+      // only the values that differ from the default are active, like
+      // the Sparse choppers do
+      chopper.assignDefaults( num_feats, sparse_default );
+      for ( size_t col=0; col < num_feats; ++col ){
+	if ( row.values[col] != default_index[col] ){
+	  chopper.assignActive( col, dictionary[col][row.values[col]] );
+	}
+      }
+      chopper.assign( num_feats,
+		      dictionary[num_feats][row.values[num_feats]] );
+    }
+    chopper.assignExtra( row.weight, row.occurrences );
+  }
+
+  bool BinaryInstanceReader::detect( const string& name ){
+    // does name start with our magic? Only regular files are checked,
+    // we can't look into a pipe without consuming it
+    struct stat st;
+    if ( stat( name.c_str(), &st ) != 0
+	 || !S_ISREG( st.st_mode ) ){
+      return false;
+    }
+    InputStream in( name );
+    char buf[magic_len];
+    return in.read( buf, magic_len )
+      && memcmp( buf, magic, magic_len ) == 0;
+  }
+
+}
@@ -0,0 +1,310 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "timbl/BinaryTables.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Timbl {
+
+  static const char magic[] = "TiMBLtab";
+  static const size_t magic_len = 8;
+  static const uint32_t table_version = 1;
+  static const size_t header_len = magic_len + 4 + 4 + 8 + 8;
+
+  static const string kind_name( uint32_t kind ){
+    switch ( kind ){
+    case WeightsTable:
+      return "weights";
+    case ArraysTable:
+      return "probability arrays";
+    case MatricesTable:
+      return "matrices";
+    default:
+      return "unknown data";
+    }
+  }
+
+  uint64_t fnv_checksum( const unsigned char *pnt, size_t len ){
+    // 64 bit FNV-1a
+    uint64_t result = 0xcbf29ce484222325ULL;
+    for ( size_t i=0; i < len; ++i ){
+      result ^= pnt[i];
+      result *= 0x100000001b3ULL;
+    }
+    return result;
+  }
+
+  static void append_le( vector<char>& buf, uint64_t val, size_t width ){
+    for ( size_t i=0; i < width; ++i ){
+      buf.push_back( static_cast<char>( val & 0xff ) );
+      val >>= 8;
+    }
+  }
+
+  static uint64_t extract_le( const unsigned char *pnt, size_t width ){
+    uint64_t result = 0;
+    for ( size_t i=width; i > 0; --i ){
+      result = ( result << 8 ) | pnt[i-1];
+    }
+    return result;
+  }
+
+  void BinaryTableWriter::put_u32( uint32_t val ){
+    append_le( payload, val, 4 );
+  }
+
+  void BinaryTableWriter::put_u64( uint64_t val ){
+    append_le( payload, val, 8 );
+  }
+
+  void BinaryTableWriter::put_double( double d ){
+    uint64_t val;
+    memcpy( &val, &d, sizeof(val) );
+    append_le( payload, val, 8 );
+  }
+
+  void BinaryTableWriter::put_string( const UnicodeString& us ){
+    string s = TiCC::UnicodeToUTF8( us );
+    put_u32( s.size() );
+    payload.insert( payload.end(), s.begin(), s.end() );
+  }
+
+  size_t BinaryTableWriter::start_section(){
+    // reserve room for the length, filled in by end_section()
+    size_t pos = payload.size();
+    put_u64( 0 );
+    return pos;
+  }
+
+  void BinaryTableWriter::end_section( size_t pos ){
+    uint64_t len = payload.size() - pos - 8;
+    for ( size_t i=0; i < 8; ++i ){
+      payload[pos+i] = static_cast<char>( len & 0xff );
+      len >>= 8;
+    }
+  }
+
+  bool BinaryTableWriter::write( ostream& os ) const {
+    vector<char> header( magic, magic + magic_len );
+    append_le( header, table_version, 4 );
+    append_le( header, kind, 4 );
+    append_le( header, payload.size(), 8 );
+    append_le( header,
+	       fnv_checksum( reinterpret_cast<const unsigned char*>(payload.data()),
+			     payload.size() ),
+	       8 );
+    os.write( header.data(), header.size() );
+    os.write( payload.data(), payload.size() );
+    return os.good();
+  }
+
+  BinaryTableReader::BinaryTableReader():
+    data( 0 ),
+    size( 0 ),
+    cursor( 0 ),
+    mapped( 0 ),
+    mapped_size( 0 )
+  {}
+
+  BinaryTableReader::~BinaryTableReader(){
+    close();
+  }
+
+  void BinaryTableReader::close(){
+    if ( mapped ){
+      munmap( mapped, mapped_size );
+      mapped = 0;
+      mapped_size = 0;
+    }
+    buffer.clear();
+    data = 0;
+    size = 0;
+    cursor = 0;
+  }
+
+  bool BinaryTableReader::fail( const string& what ){
+    if ( message.empty() ){
+      message = what;
+    }
+    return false;
+  }
+
+  bool BinaryTableReader::open( const string& name, BinaryTableKind kind ){
+    close();
+    message.clear();
+    int fd = ::open( name.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      return fail( "can't open " + name );
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) ){
+      ::close( fd );
+      return fail( name + " is not a regular file" );
+    }
+    size_t file_size = st.st_size;
+    if ( file_size < header_len ){
+      ::close( fd );
+      return fail( name + " is too short for a binary table" );
+    }
+    void *pnt = mmap( 0, file_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( pnt != MAP_FAILED ){
+      mapped = pnt;
+      mapped_size = file_size;
+      data = static_cast<const unsigned char*>( pnt );
+    }
+    else {
+      // no mmap here, read it the old way
+      ifstream is( name, ios::binary );
+      buffer.resize( file_size );
+      if ( !is.read( reinterpret_cast<char*>(buffer.data()), file_size ) ){
+	return fail( "can't read " + name );
+      }
+      data = buffer.data();
+    }
+    return check( name, kind, file_size );
+  }
+
+  bool BinaryTableReader::open( const char *buf, size_t len,
+				BinaryTableKind kind,
+				const string& name ){
+    // use a table which is already in memory, like a section of a
+    // bundle. 'buf' is borrowed, and must outlive this reader
+    close();
+    message.clear();
+    if ( len < header_len ){
+      return fail( name + " is too short for a binary table" );
+    }
+    data = reinterpret_cast<const unsigned char*>( buf );
+    return check( name, kind, len );
+  }
+
+  bool BinaryTableReader::check( const string& name,
+				 BinaryTableKind kind,
+				 size_t file_size ){
+    // validate the header at 'data', and position us on the payload
+    if ( memcmp( data, magic, magic_len ) != 0 ){
+      return fail( name + " is not a TiMBL binary table" );
+    }
+    uint32_t version = extract_le( data + magic_len, 4 );
+    if ( version > table_version ){
+      return fail( name + " has binary table version "
+		   + TiCC::toString( version ) + ", we can only read up to "
+		   + TiCC::toString( table_version ) );
+    }
+    uint32_t file_kind = extract_le( data + magic_len + 4, 4 );
+    if ( file_kind != uint32_t(kind) ){
+      return fail( name + " holds " + kind_name( file_kind )
+		   + ", not " + kind_name( kind ) );
+    }
+    uint64_t len = extract_le( data + magic_len + 8, 8 );
+    if ( len != file_size - header_len ){
+      return fail( name + " is truncated" );
+    }
+    uint64_t sum = extract_le( data + magic_len + 16, 8 );
+    data += header_len;
+    if ( fnv_checksum( data, len ) != sum ){
+      return fail( name + " is corrupted, the checksum doesn't match" );
+    }
+    size = len;
+    cursor = 0;
+    return true;
+  }
+
+  bool BinaryTableReader::get_u32( uint32_t& val ){
+    if ( size - cursor < 4 ){
+      return fail( "unexpected end of the binary table" );
+    }
+    val = extract_le( data + cursor, 4 );
+    cursor += 4;
+    return true;
+  }
+
+  bool BinaryTableReader::get_u64( uint64_t& val ){
+    if ( size - cursor < 8 ){
+      return fail( "unexpected end of the binary table" );
+    }
+    val = extract_le( data + cursor, 8 );
+    cursor += 8;
+    return true;
+  }
+
+  bool BinaryTableReader::get_double( double& d ){
+    uint64_t val;
+    if ( !get_u64( val ) ){
+      return false;
+    }
+    memcpy( &d, &val, sizeof(d) );
+    return true;
+  }
+
+  bool BinaryTableReader::get_string( UnicodeString& us ){
+    uint32_t len;
+    if ( !get_u32( len ) ){
+      return false;
+    }
+    if ( size - cursor < len ){
+      return fail( "unexpected end of the binary table" );
+    }
+    const char *pnt = reinterpret_cast<const char*>( data + cursor );
+    us = UnicodeString::fromUTF8( StringPiece( pnt, len ) );
+    cursor += len;
+    return true;
+  }
+
+  bool BinaryTableReader::skip( uint64_t len ){
+    if ( size - cursor < len ){
+      return fail( "unexpected end of the binary table" );
+    }
+    cursor += len;
+    return true;
+  }
+
+  bool BinaryTableReader::detect( const string& name ){
+    // does name start with our magic?
+    ifstream is( name, ios::binary );
+    char buf[magic_len];
+    return is.read( buf, magic_len )
+      && memcmp( buf, magic, magic_len ) == 0;
+  }
+
+}
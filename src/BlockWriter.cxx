@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include "timbl/BlockWriter.h"
+
+using namespace std;
+
+namespace Timbl {
+
+  BlockWriter::BlockWriter( ostream& out,
+			    bool in_background,
+			    size_t size ):
+    os( out ),
+    block_size( size ),
+    passed( 0 ),
+    background( in_background ),
+    busy( false ),
+    stopping( false )
+  {
+    base = os.tellp();
+    current.reserve( block_size + block_size/4 );
+    if ( background ){
+      writing.reserve( block_size + block_size/4 );
+      worker = thread( &BlockWriter::run, this );
+    }
+  }
+
+  BlockWriter::~BlockWriter(){
+    flush();
+    if ( background ){
+      {
+	lock_guard<mutex> guard( lock );
+	stopping = true;
+      }
+      cond.notify_all();
+      worker.join();
+    }
+  }
+
+  streamoff BlockWriter::tell() const {
+    // the position in the stream where the next character will go,
+    // -1 when the stream can't tell
+    if ( base < 0 ){
+      return -1;
+    }
+    return base + passed + current.size();
+  }
+
+  void BlockWriter::pass(){
+    // hand the buffer to the stream
+    if ( current.empty() ){
+      return;
+    }
+    passed += current.size();
+    if ( !background ){
+      os.write( current.data(), current.size() );
+      current.clear();
+      return;
+    }
+    unique_lock<mutex> guard( lock );
+    cond.wait( guard, [this]{ return !busy; } );
+    writing.swap( current );
+    current.clear();
+    busy = true;
+    guard.unlock();
+    cond.notify_all();
+  }
+
+  void BlockWriter::run(){
+    unique_lock<mutex> guard( lock );
+    while ( true ){
+      cond.wait( guard, [this]{ return busy || stopping; } );
+      if ( busy ){
+	guard.unlock();
+	os.write( writing.data(), writing.size() );
+	guard.lock();
+	busy = false;
+	cond.notify_all();
+      }
+      else {
+	return;
+      }
+    }
+  }
+
+  bool BlockWriter::flush(){
+    // write out everything, and report the state of the stream
+    pass();
+    if ( background ){
+      unique_lock<mutex> guard( lock );
+      cond.wait( guard, [this]{ return !busy; } );
+    }
+    os.flush();
+    return os.good();
+  }
+
+}
@@ -74,7 +74,7 @@ namespace Timbl {
   bool CV_Experiment::get_file_names( const string& FileName ){
     if ( !ExpInvalid() ){
       size_t size = 0;
-      ifstream file_names( FileName, ios::in );
+      InputStream file_names( FileName );
       if ( !file_names ){
 	Error( "Unable to read CV filenames from " + FileName );
 	return false;
@@ -28,6 +28,8 @@
 
 #include <cctype>        // for isspace
 #include <stdexcept>
+#include <algorithm>
+#include <numeric>
 #include <vector>
 #include <string>
 #include <cassert>
@@ -35,6 +37,7 @@
 #include "ticcutils/Unicode.h"
 #include "ticcutils/PrettyPrint.h"
 #include "timbl/Types.h"
+#include "timbl/StringOps.h"
 
 
 using namespace std;
@@ -129,9 +132,122 @@ namespace Timbl{
     return result;
   }
 
+  static inline bool is_blank( char16_t c ){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  bool Chopper::plainInput( const UnicodeString& s ){
+    // true when s is printable ASCII, tabs and line ends only.
+    // For those lines we can do all the chopping in place, without the
+    // help of ICU
+    const char16_t *buf = s.getBuffer();
+    for ( int32_t i=0; i < s.length(); ++i ){
+      char16_t c = buf[i];
+      if ( c >= 0x7F
+	   || ( c < 0x20 && !is_blank( c ) ) ){
+	return false;
+      }
+    }
+    return true;
+  }
+
+  void Chopper::setField( size_t i,
+			  const char16_t *buf,
+			  int32_t len,
+			  bool trim,
+			  bool code ){
+    // store the field in choppedInput[i], re-using its storage
+    // does the same as StrToCode() for plain input
+    if ( trim ){
+      while ( len > 0 && is_blank( buf[0] ) ){
+	++buf;
+	--len;
+      }
+      while ( len > 0 && is_blank( buf[len-1] ) ){
+	--len;
+      }
+    }
+    UnicodeString& field = choppedInput[i];
+    int32_t j = 0;
+    if ( code ){
+      while ( j < len
+	      && buf[j] != ' '
+	      && buf[j] != '\t'
+	      && buf[j] != '\\' ){
+	++j;
+      }
+    }
+    else {
+      j = len;
+    }
+    field.setTo( buf, j );
+    for ( ; j < len; ++j ){
+      switch ( buf[j] ){
+      case ' ':
+	field.append( u"\\_", 2 );
+	break;
+      case '\t':
+	field.append( u"\\t", 2 );
+	break;
+      case '\\':
+	field.append( u"\\\\", 2 );
+	break;
+      default:
+	field.append( buf[j] );
+      }
+    }
+  }
+
+  bool Chopper::splitPlain( char16_t sep, bool trim, bool code ){
+    // split strippedInput in place into choppedInput, skipping empty
+    // fields like TiCC::split_at() does.
+    // with sep == ' ', split on any white space like TiCC::split()
+    const char16_t *buf = strippedInput.getBuffer();
+    int32_t len = strippedInput.length();
+    size_t num = 0;
+    int32_t pos = 0;
+    while ( pos < len ){
+      int32_t end = pos;
+      if ( sep == ' ' ){
+	while ( end < len && !is_blank( buf[end] ) ){
+	  ++end;
+	}
+      }
+      else {
+	while ( end < len && buf[end] != sep ){
+	  ++end;
+	}
+      }
+      if ( end > pos ){
+	if ( num == vSize ){
+	  return false;
+	}
+	setField( num++, buf + pos, end - pos, trim, code );
+      }
+      pos = end + 1;
+    }
+    return num == vSize;
+  }
+
   void Chopper::init( const UnicodeString& s, size_t len, bool stripDot ) {
     vSize = len+1;
     choppedInput.resize(vSize);
+    if ( plainInput( s ) ){
+      // just find the end, and copy into our own buffer
+      const char16_t *buf = s.getBuffer();
+      int32_t end = s.length();
+      while ( end > 0 && is_blank( buf[end-1] ) ){
+	--end;
+      }
+      if ( stripDot && end > 0 && buf[end-1] == '.' ){
+	--end;
+	while ( end > 0 && is_blank( buf[end-1] ) ){
+	  --end;
+	}
+      }
+      strippedInput.setTo( buf, end );
+      return;
+    }
     UnicodeString split = s;
     //    cerr << "    strip input:" << split << endl;
     // trim spaces at end
@@ -147,6 +263,90 @@ namespace Timbl{
     //    cerr << "stripped input:" << strippedInput << endl;
   }
 
+  void Chopper::appendString( string& out ) const {
+    // append getString() as UTF-8. The plain formats override this to
+    // skip building the intermediate UnicodeString
+    append_string( out, getString() );
+  }
+
+  void Chopper::appendRaw( string& out ) const {
+    // append the input line as it was read, minus the stripped trailing
+    // dot and whitespace, followed by the separator of the format, so
+    // the predicted class lines up like after appendString().
+    // Lines that were not chopped from text have nothing to echo
+    if ( strippedInput.isEmpty() ){
+      appendString( out );
+      return;
+    }
+    append_string( out, strippedInput );
+    out += separator();
+  }
+
+  void Chopper::assignSize( size_t len ){
+    // prepare for assign()ing the fields directly, without chopping.
+    // All fields count as active, so the sparse formats work too
+    strippedInput.remove();
+    vSize = len+1;
+    choppedInput.resize( vSize );
+    active.resize( len );
+    for ( size_t i=0; i < len; ++i ){
+      active[i] = i;
+    }
+    shuffled = true;
+  }
+
+  void Chopper::assignDefaults( size_t len, const UnicodeString& def ){
+    // all feature fields get the default value of a sparse format.
+    // Only the fields that were active in the previous line need
+    // resetting, unless the size changed or swapTarget() moved them around
+    bool all = shuffled || choppedInput.size() != len+1;
+    strippedInput.remove();
+    vSize = len+1;
+    choppedInput.resize( vSize );
+    if ( all ){
+      for ( size_t m = 0; m < vSize-1; ++m ){
+	choppedInput[m] = def;
+      }
+    }
+    else {
+      for ( const auto m : active ){
+	choppedInput[m] = def;
+      }
+    }
+    active.clear();
+    shuffled = false;
+  }
+
+  void Chopper::resetFields( const UnicodeString& s,
+			     size_t len,
+			     bool stripDot,
+			     const UnicodeString& def ){
+    // init() for the sparse formats
+    assignDefaults( len, def );
+    init( s, len, stripDot );
+  }
+
+  vector<size_t> Chopper::activeOrder() const {
+    // the fields which may differ from the default value of a sparse
+    // format, in ascending order. So the sparse formats can be printed
+    // without visiting every field
+    vector<size_t> result;
+    if ( shuffled ){
+      result.resize( vSize-1 );
+      iota( result.begin(), result.end(), 0 );
+    }
+    else {
+      for ( const auto i : active ){
+	if ( i < vSize-1 ){
+	  result.push_back( i );
+	}
+      }
+      sort( result.begin(), result.end() );
+      result.erase( unique( result.begin(), result.end() ), result.end() );
+    }
+    return result;
+  }
+
   static UnicodeString extractWeight( const UnicodeString& buffer,
 				      UnicodeString& wght ) {
     //    cerr << "extract weight from '" << buffer << "'" << endl;
@@ -331,6 +531,9 @@ namespace Timbl{
     // Function that takes a line, and chops it up into substrings,
     // which represent the feature-values and the target-value.
     init( InBuf, len, true );
+    if ( plainInput( strippedInput ) ){
+      return splitPlain( ',', true, true );
+    }
     vector<UnicodeString> splits = TiCC::split_at( strippedInput, "," );
     size_t res = splits.size();
     if ( res != vSize ){
@@ -351,6 +554,13 @@ namespace Timbl{
     return res;
   }
 
+  void C45_Chopper::appendString( string& out ) const {
+    for ( const auto& part : choppedInput ) {
+      append_code( out, part );
+      out += ',';
+    }
+  }
+
   bool ARFF_Chopper::chop( const UnicodeString& InBuf, size_t len ){
     // Lines look like this:
     // one, two,   three , bla.
@@ -363,10 +573,8 @@ namespace Timbl{
     // Lines look like this:
     // 12, 25, 333, bla.
     // the termination dot is optional
-    init( InBuf, len, true );
-    for ( size_t m = 0; m < vSize-1; ++m ){
-      choppedInput[m] = "0";
-    }
+    static const UnicodeString zero = "0";
+    resetFields( InBuf, len, true, zero );
     vector<UnicodeString> parts = TiCC::split_exact_at( strippedInput, "," );
     for ( auto const& p : parts ){
       if ( &p == &parts.back() ){
@@ -381,6 +589,7 @@ namespace Timbl{
 	return false;
       }
       else {
+	active.push_back( k-1 );
 	choppedInput[k-1] = "1";
       }
     }
@@ -389,15 +598,10 @@ namespace Timbl{
 
   UnicodeString Bin_Chopper::getString() const {
     UnicodeString res;
-    int i = 1;
-    for ( const auto& part : choppedInput ){
-      if ( &part == &choppedInput.back() ){
-	break;
-      }
-      if ( part[0] == '1' ){
-	res += TiCC::toUnicodeString(i) + ",";
+    for ( const auto i : activeOrder() ){
+      if ( choppedInput[i][0] == '1' ){
+	res += TiCC::toUnicodeString(i+1) + ",";
       }
-      ++i;
     }
     res += choppedInput.back() + ",";
     return res;
@@ -436,10 +640,19 @@ namespace Timbl{
     return res;
   }
 
+  void Compact_Chopper::appendString( string& out ) const {
+    for ( const auto& part : choppedInput ){
+      append_code( out, part );
+    }
+  }
+
   bool Columns_Chopper::chop( const UnicodeString& InBuf, size_t len ){
     // Lines look like this:
     // one  two three bla
     init( InBuf, len, false );
+    if ( plainInput( strippedInput ) ){
+      return splitPlain( ' ', true, true );
+    }
     vector<UnicodeString> splits = TiCC::split( strippedInput );
     size_t res = splits.size();
     if ( res != vSize ){
@@ -462,6 +675,9 @@ namespace Timbl{
     // Lines look like this:
     // oneTABtwoTAB TABthreeTABbla
     init( InBuf, len, false );
+    if ( plainInput( strippedInput ) ){
+      return splitPlain( '\t', false, true );
+    }
     vector<UnicodeString> splits = TiCC::split_at( strippedInput, "\t" );
     size_t res = splits.size();
     if ( res != vSize ){
@@ -481,14 +697,18 @@ namespace Timbl{
     return res;
   }
 
+  void Tabbed_Chopper::appendString( string& out ) const {
+    for ( const auto& part : choppedInput ){
+      append_code( out, part );
+      out += '\t';
+    }
+  }
+
   bool Sparse_Chopper::chop( const UnicodeString& InBuf, size_t len ){
     // Lines look like this:
     // (12,value1) (25,value2) (333,value3) bla.
     // the termination dot is optional
-    init( InBuf, len, true );
-    for ( size_t m = 0; m < vSize-1; ++m ){
-      choppedInput[m] = DefaultSparseString;
-    }
+    resetFields( InBuf, len, true, DefaultSparseString );
     choppedInput[vSize-1] = "";
     vector<UnicodeString> entries = TiCC::split_at_first_of( strippedInput,
 							     "()" );
@@ -520,6 +740,7 @@ namespace Timbl{
       if ( index < 1 || index >= vSize ){
 	return false;
       }
+      active.push_back( index-1 );
       choppedInput[index-1] = StrToCode( parts[1] );
     }
     return true;
@@ -527,17 +748,13 @@ namespace Timbl{
 
   UnicodeString Sparse_Chopper::getString() const {
     UnicodeString res;
-    int i = 1;
-    for ( const auto& part : choppedInput ){
-      if ( &part == &choppedInput.back() ){
-	break;
-      }
+    for ( const auto i : activeOrder() ){
+      const UnicodeString& part = choppedInput[i];
       if ( part != DefaultSparseString ){
-	res += "(" + TiCC::toUnicodeString( i ) + ",";
+	res += "(" + TiCC::toUnicodeString( i+1 ) + ",";
 	res += CodeToStr(part);
 	res += ")";
       }
-      ++i;
     }
     res += choppedInput.back() + ",";
     return res;
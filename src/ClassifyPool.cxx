@@ -0,0 +1,203 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <string>
+#include <vector>
+#include <exception>
+
+#include "ticcutils/Unicode.h"
+#include "timbl/TimblAPI.h"
+#include "timbl/GetOptClass.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Timbl {
+
+  class ClassifyPool::batch {
+    // the shared state of a batch submitted with a callback.
+    // results are passed to the callback in the order of submission.
+  public:
+    batch( size_t size, const classifyCallback& cb ):
+      results(size), done(size,false), next(0), callback(cb) {};
+    void deliver( size_t, const classifyResult& );
+  private:
+    vector<classifyResult> results;
+    vector<bool> done;
+    size_t next;
+    classifyCallback callback;
+    mutex lock;
+  };
+
+  void ClassifyPool::batch::deliver( size_t index,
+				     const classifyResult& res ){
+    lock_guard<mutex> guard( lock );
+    results[index] = res;
+    done[index] = true;
+    while ( next < done.size() && done[next] ){
+      callback( next, results[next] );
+      ++next;
+    }
+  }
+
+  ClassifyPool::ClassifyPool( TimblExperiment *parent,
+			      int num_workers,
+			      size_t queue_size ):
+    max_queue( queue_size ),
+    stopping( false )
+  {
+    if ( num_workers <= 0 ){
+      throw range_error( "ClassifyPool size cannot be <=0" );
+    }
+    if ( max_queue == 0 ){
+      max_queue = 1;
+    }
+    parent->initExperiment();
+    for ( int i=0; i < num_workers; ++i ){
+      TimblExperiment *exp = parent->clone();
+      *exp = *parent;
+      if ( parent->getOptParams() ){
+	exp->setOptParams( parent->getOptParams()->Clone( 0 ) );
+      }
+      exp->initExperiment();
+      exps.push_back( exp );
+    }
+    for ( const auto& exp : exps ){
+      threads.push_back( thread( &ClassifyPool::run, this, exp ) );
+    }
+  }
+
+  ClassifyPool::~ClassifyPool(){
+    shutdown();
+    for ( const auto& exp : exps ){
+      delete exp;
+    }
+  }
+
+  void ClassifyPool::shutdown(){
+    // finish all pending work, then stop the workers
+    {
+      lock_guard<mutex> guard( queue_lock );
+      if ( stopping ){
+	return;
+      }
+      stopping = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+    for ( auto& t : threads ){
+      t.join();
+    }
+  }
+
+  size_t ClassifyPool::pending() const {
+    lock_guard<mutex> guard( queue_lock );
+    return queue.size();
+  }
+
+  void ClassifyPool::enqueue( job&& j ){
+    unique_lock<mutex> guard( queue_lock );
+    not_full.wait( guard,
+		   [this]{ return stopping || queue.size() < max_queue; } );
+    if ( stopping ){
+      throw runtime_error( "ClassifyPool: submit after shutdown" );
+    }
+    queue.push_back( std::move(j) );
+    guard.unlock();
+    not_empty.notify_one();
+  }
+
+  vector<future<classifyResult>> ClassifyPool::submit( const vector<string>& lines ){
+    vector<future<classifyResult>> result;
+    result.reserve( lines.size() );
+    for ( size_t i=0; i < lines.size(); ++i ){
+      job j;
+      j.line = lines[i];
+      j.index = i;
+      result.push_back( j.result.get_future() );
+      enqueue( std::move(j) );
+    }
+    return result;
+  }
+
+  bool ClassifyPool::submit( const vector<string>& lines,
+			     const classifyCallback& cb ){
+    if ( !cb ){
+      return false;
+    }
+    auto owner = make_shared<batch>( lines.size(), cb );
+    for ( size_t i=0; i < lines.size(); ++i ){
+      job j;
+      j.line = lines[i];
+      j.index = i;
+      j.owner = owner;
+      enqueue( std::move(j) );
+    }
+    return true;
+  }
+
+  void ClassifyPool::run( TimblExperiment *exp ){
+    while ( true ){
+      job j;
+      {
+	unique_lock<mutex> guard( queue_lock );
+	not_empty.wait( guard, [this]{ return stopping || !queue.empty(); } );
+	if ( queue.empty() ){
+	  // stopping, and nothing left to do
+	  return;
+	}
+	j = std::move( queue.front() );
+	queue.pop_front();
+      }
+      not_full.notify_one();
+      classifyResult res;
+      try {
+	UnicodeString category;
+	UnicodeString distribution;
+	double distance = -1.0;
+	if ( exp->Classify( TiCC::UnicodeFromUTF8( j.line ),
+			    category, distribution, distance ) ){
+	  res.ok = true;
+	  res.category = TiCC::UnicodeToUTF8( category );
+	  res.distribution = TiCC::UnicodeToUTF8( distribution );
+	  res.distance = distance;
+	  res.confidence = exp->confidence();
+	}
+      }
+      catch ( const exception& ){
+	res.ok = false;
+      }
+      if ( j.owner ){
+	j.owner->deliver( j.index, res );
+      }
+      else {
+	j.result.set_value( res );
+      }
+    }
+  }
+
+}
@@ -0,0 +1,166 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#include <string>
+
+#include "ticcutils/Unicode.h"
+#include "timbl/TimblAPI.h"
+#include "timbl/GetOptClass.h"
+#include "timbl/ClassifySearch.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Timbl {
+
+  ClassifySearch::ClassifySearch( TimblExperiment *parent ):
+    exp( 0 ),
+    active( false ),
+    searching( false ),
+    done( false ),
+    cut_short( false )
+  {
+    parent->initExperiment();
+    exp = parent->clone();
+    *exp = *parent;
+    if ( parent->getOptParams() ){
+      exp->setOptParams( parent->getOptParams()->Clone( 0 ) );
+    }
+    exp->initExperiment();
+  }
+
+  ClassifySearch::~ClassifySearch(){
+    delete exp;
+  }
+
+  bool ClassifySearch::start( const string& line ){
+    // prepare the classification of a new line.
+    // returns false when the line is not usable.
+    active = false;
+    searching = false;
+    done = false;
+    cut_short = false;
+    exp->known_bands = 0;
+    UnicodeString uline = TiCC::UnicodeFromUTF8( line );
+    if ( !exp->checkLine( uline )
+	 || !exp->chopLine( uline ) ){
+      return false;
+    }
+    exp->chopped_to_instance( TimblExperiment::TestWords );
+    active = true;
+    const ClassDistribution *ExResultDist = exp->ExactMatch( exp->CurrInst );
+    if ( ExResultDist ){
+      // LocalClassify will only need a search to resolve a tie
+      // (we can only check for that when the outcome isn't random)
+      bool tie = false;
+      if ( exp->Do_Exact() ){
+	done = true;
+      }
+      else if ( exp->RandomSeed() < 0 ){
+	ExResultDist->BestTarget( tie, false );
+	done = !tie;
+      }
+      if ( done ){
+	return true;
+      }
+    }
+    if ( ( exp->Algorithm() == IB1_a || exp->Algorithm() == IB2_a )
+	 && !exp->Sharded()
+	 && exp->incrementalSearch() ){
+      // search for k+1 bands right away. The first k are the same as for
+      // a k search, and the extra one is what LocalClassify needs on a tie
+      ++exp->num_of_neighbors;
+      exp->bestArray.init( exp->num_of_neighbors, exp->MaxBests,
+			   exp->Verbosity(NEAR_N), exp->Verbosity(DISTANCE),
+			   exp->Verbosity(DISTRIB) );
+      --exp->num_of_neighbors;
+      exp->startSearch( state, exp->CurrInst, exp->InstanceBase );
+      searching = true;
+    }
+    // otherwise there is nothing to do in steps, and result() does all
+    // the work
+    return true;
+  }
+
+  bool ClassifySearch::step( size_t max_leaves ){
+    // visit at most max_leaves leaves of the InstanceBase, that is: reach
+    // at most max_leaves leaf distributions.
+    // returns true when the search is finished
+    if ( active && !done ){
+      if ( searching ){
+	done = exp->stepSearch( state, max_leaves );
+      }
+      else {
+	done = true;
+      }
+    }
+    return done || !active;
+  }
+
+  bool ClassifySearch::result( string& category,
+			       string& distribution,
+			       double& distance ){
+    // classify using the neighbors found so far. When the search isn't
+    // finished, the result is flagged as incomplete.
+    category.clear();
+    distribution.clear();
+    distance = -1.0;
+    if ( !active ){
+      return false;
+    }
+    if ( searching ){
+      if ( !done ){
+	cut_short = true;
+	if ( state.leaves == 0 ){
+	  // we need at least one neighbor
+	  exp->stepSearch( state, 1 );
+	}
+      }
+      exp->bestArray.initNeighborSet( bands );
+      exp->known_bands = &bands;
+    }
+    bool exact = false;
+    const TargetValue *targ = exp->LocalClassify( exp->CurrInst,
+						  distance,
+						  exact );
+    exp->known_bands = 0;
+    active = false;
+    if ( !targ ){
+      return false;
+    }
+    category = targ->name_string();
+    exp->normalizeResult();
+    distribution = exp->bestResult.getResult();
+    return true;
+  }
+
+  double ClassifySearch::confidence() const {
+    return exp->confidence();
+  }
+
+}
@@ -31,11 +31,14 @@
 #include <algorithm> // for sort()
 #include <numeric> // for accumulate()
 #include <cmath> // for fabs()
+#include <unordered_map>
+#include <tuple>
 #include "timbl/Common.h"
 #include "timbl/Types.h"
 #include "timbl/Metrics.h"
 #include "timbl/Matrices.h"
 #include "timbl/Instance.h"
+#include "timbl/BinaryTables.h"
 #include "ticcutils/Unicode.h"
 #include "ticcutils/UniHash.h"
 
@@ -48,13 +51,15 @@ namespace Timbl {
   FeatureValue::FeatureValue( const UnicodeString& value,
 			      size_t hash_val ):
     ValueClass( value, hash_val ),
-    ValueClassProb( 0 )
+    ValueClassProb( 0 ),
+    _rank( 0 )
   {
   }
 
   FeatureValue::FeatureValue( const UnicodeString& s ):
     ValueClass( s, 0 ),
-    ValueClassProb(0){
+    ValueClassProb(0),
+    _rank( 0 ){
     _frequency = 0;
   }
 
@@ -62,6 +67,43 @@ namespace Timbl {
     delete ValueClassProb;
   }
 
+  UnknownValues::~UnknownValues(){
+    release();
+    for ( const auto& it : interned ){
+      delete it.second;
+    }
+  }
+
+  FeatureValue *UnknownValues::get( const UnicodeString& value ){
+    // a FeatureValue only refers to its name, so the name must live as
+    // long as the value does: we keep our own copy
+    auto it = interned.find( value );
+    if ( it != interned.end() ){
+      ++hits;
+      return it->second;
+    }
+    ++misses;
+    if ( interned.size() < limit ){
+      it = interned.emplace( value, nullptr ).first;
+      it->second = new FeatureValue( it->first );
+      return it->second;
+    }
+    scratch_names.push_back( value );
+    FeatureValue *result = new FeatureValue( scratch_names.back() );
+    scratch.push_back( result );
+    return result;
+  }
+
+  void UnknownValues::release(){
+    // delete the values that didn't fit in the table. Only safe when no
+    // Instance uses them anymore
+    for ( const auto fv : scratch ){
+      delete fv;
+    }
+    scratch.clear();
+    scratch_names.clear();
+  }
+
   Feature::Feature( Hash::UnicodeHash *T ):
     metric_matrix( 0 ),
     TokenTree(T),
@@ -69,6 +111,7 @@ namespace Timbl {
     ignore( false ),
     numeric( false ),
     vcpb_read( false ),
+    ranked( false ),
     PrestoreStatus(ps_undef),
     Prestored_metric( UnknownMetric ),
     entropy( 0.0 ),
@@ -93,12 +136,14 @@ namespace Timbl {
   Feature& Feature::operator=( const Feature& in ){
     if ( this != &in ){
       metric_matrix = in.metric_matrix;
-      metric = in.metric;
+      // the metric is our own, so it can be changed independently
+      metric = in.metric ? getMetricClass( in.metric->type() ) : 0;
       PrestoreStatus = in.PrestoreStatus;
       Prestored_metric = in.Prestored_metric;
       ignore = in.ignore;
       numeric = in.numeric;
       vcpb_read = in.vcpb_read;
+      ranked = in.ranked;
       entropy = in.entropy;
       info_gain = in.info_gain;
       split_info = in.split_info;
@@ -151,6 +196,27 @@ namespace Timbl {
 			 return r + v->ValFreq(); } );
   }
 
+  void Feature::rank_by_frequency(){
+    // give the values a rank, 0 for the most frequent one. An InstanceBase
+    // keeps its value lists ordered on it, so the frequent values are
+    // found first. Only once: the lists of a tree depend on the ranks.
+    // Values added later are ranked after these
+    if ( ranked ){
+      return;
+    }
+    vector<FeatureValue *> order = values_array;
+    stable_sort( order.begin(), order.end(),
+		 []( const FeatureValue *a, const FeatureValue *b ){
+		   if ( a->ValFreq() != b->ValFreq() ){
+		     return a->ValFreq() > b->ValFreq();
+		   }
+		   return a->Index() < b->Index(); } );
+    for ( size_t i=0; i < order.size(); ++i ){
+      order[i]->_rank = i;
+    }
+    ranked = true;
+  }
+
   FeatureValue *Feature::Lookup( const UnicodeString& str ) const {
     FeatureValue *result = NULL;
     unsigned int hash_val = TokenTree->lookup( str );
@@ -182,6 +248,10 @@ namespace Timbl {
       // so we MUST reverse lookup the index
       FeatureValue *fv = new FeatureValue( value, hash_val );
       fv->ValFreq( freq );
+      if ( ranked ){
+	// after all values that were ranked
+	fv->_rank = values_array.size();
+      }
       reverse_values[hash_val] = fv;
       values_array.push_back( fv );
     }
@@ -195,6 +265,24 @@ namespace Timbl {
     return result;
   }
 
+  void Feature::add_uncounted( FeatureValue *FV,
+			       const vector<TargetValue *>& targets ){
+    // count FV for all the instances which have no value counted yet:
+    // per target its frequency, minus that of all our values
+    unordered_map<size_t,size_t> counted;
+    for ( const auto *fv : values_array ){
+      for ( const auto& [index,vf] : fv->TargetDist ){
+	counted[vf->Value()->Index()] += vf->Freq();
+      }
+    }
+    for ( const auto& tv : targets ){
+      size_t known = counted[tv->Index()];
+      if ( tv->ValFreq() > known ){
+	add_value( FV->Index(), tv, (int)(tv->ValFreq() - known) );
+      }
+    }
+  }
+
   bool Feature::increment_value( FeatureValue *FV,
 				 const TargetValue *tv ){
     bool result = false;
@@ -652,16 +740,10 @@ namespace Timbl {
       exit(1);
     }
     else {
-      for ( size_t k=0; k < _num_of_feats; ++k ){
-	size_t Max = 0;
-	for ( size_t m=1; m < _num_of_feats; ++m ){
-	  if ( WR[m] > WR[Max] ){
-	    Max = m;
-	  }
-	}
-	WR[Max] = -1;
-	permutation[k] = Max;
-      }
+      // highest first, the lowest index first on a tie. A stable sort,
+      // as we can't afford a quadratic search for 100.000's of features
+      stable_sort( permutation.begin(), permutation.end(),
+		   [&WR]( size_t a, size_t b ){ return WR[a] > WR[b]; } );
     }
     for ( size_t j=0; j < _num_of_feats; ++j ){
       if ( j < _eff_feats ){
@@ -673,9 +755,9 @@ namespace Timbl {
     }
   }
   Feature::~Feature(){
+    delete metric;
     if ( !is_reference ){
       delete_matrix();
-      delete metric;
       for ( const auto* it : values_array ){
 	delete it;
       }
@@ -793,6 +875,12 @@ namespace Timbl {
     if ( !metric || M != metric->type() ){
       delete metric;
       metric = getMetricClass(M);
+      if ( is_reference && metric_matrix ){
+	// the matrix is shared with the original, and made for another
+	// metric. Forget it, without touching it
+	metric_matrix = 0;
+	PrestoreStatus = ps_undef;
+      }
       return true;
     }
     else {
@@ -1006,4 +1094,154 @@ namespace Timbl {
     os.flags( old_flags );
   }
 
+  void Feature::write_vc_pb_array( BinaryTableWriter& os ) const {
+    // the binary counterpart of print_vc_pb_array(): the arrays are
+    // stored as they are, so reading them back restores them exactly
+    uint32_t count = 0;
+    for ( const auto* FV : values_array ){
+      if ( FV->ValueClassProb ){
+	++count;
+      }
+    }
+    os.put_u32( count );
+    for ( const auto* FV : values_array ){
+      if ( FV->ValueClassProb ){
+	os.put_string( FV->name() );
+	const auto *vcp = FV->ValueClassProb;
+	os.put_u32( std::distance( vcp->begin(), vcp->end() ) );
+	for ( const auto& it : *vcp ){
+	  os.put_u32( it.first );
+	  os.put_double( it.second );
+	}
+      }
+    }
+  }
+
+  bool Feature::read_vc_pb_array( BinaryTableReader& is, size_t dim ){
+    for ( auto* FV : values_array ){
+      delete FV->ValueClassProb;
+      FV->ValueClassProb = NULL;
+    }
+    uint32_t count;
+    if ( !is.get_u32( count ) ){
+      return false;
+    }
+    for ( size_t i=0; i < count; ++i ){
+      UnicodeString name;
+      uint32_t entries;
+      if ( !is.get_string( name ) || !is.get_u32( entries ) ){
+	return false;
+      }
+      FeatureValue *FV = Lookup( name );
+      if ( !FV ){
+	Warning( "Unknown FeatureValue '" + TiCC::UnicodeToUTF8(name)
+		 + "' in file, (skipped) " );
+      }
+      else if ( !FV->ValueClassProb ){
+	FV->ValueClassProb = new SparseValueProbClass( dim );
+      }
+      for ( size_t j=0; j < entries; ++j ){
+	uint32_t index;
+	double value;
+	if ( !is.get_u32( index ) || !is.get_double( value ) ){
+	  return false;
+	}
+	if ( FV ){
+	  FV->ValueClassProb->Assign( index, value );
+	}
+      }
+    }
+    // check if we've got all the values, assign a default if not so
+    for ( auto* FV : values_array ){
+      if ( FV->ValueClassProb == NULL ){
+	FV->ValueClassProb = new SparseValueProbClass( dim );
+      }
+    }
+    vcpb_read = true;
+    return true;
+  }
+
+  void Feature::write_matrix( BinaryTableWriter& os ) const {
+    // the binary counterpart of print_matrix(): the values involved,
+    // then the entries as (value, value, distance) using their positions.
+    // The matrix is ordered on addresses, so sort the entries to get the
+    // same file for the same matrix
+    unordered_map<const ValueClass *, uint32_t> positions;
+    metric_matrix->visit( [&]( const ValueClass *v1,
+			       const ValueClass *v2,
+			       double ){
+			    positions[v1] = 0;
+			    positions[v2] = 0;
+			  } );
+    vector<const ValueClass *> values;
+    for ( const auto *FV : values_array ){
+      auto it = positions.find( FV );
+      if ( it != positions.end() ){
+	it->second = values.size();
+	values.push_back( FV );
+      }
+    }
+    vector<tuple<uint32_t,uint32_t,double>> entries;
+    metric_matrix->visit( [&]( const ValueClass *v1,
+			       const ValueClass *v2,
+			       double d ){
+			    uint32_t p1 = positions[v1];
+			    uint32_t p2 = positions[v2];
+			    if ( p2 < p1 ){
+			      swap( p1, p2 );
+			    }
+			    entries.push_back( make_tuple( p1, p2, d ) );
+			  } );
+    sort( entries.begin(), entries.end() );
+    os.put_u32( values.size() );
+    for ( const auto *v : values ){
+      os.put_string( v->name() );
+    }
+    os.put_u64( entries.size() );
+    for ( const auto& e : entries ){
+      os.put_u32( get<0>( e ) );
+      os.put_u32( get<1>( e ) );
+      os.put_double( get<2>( e ) );
+    }
+  }
+
+  bool Feature::fill_matrix( BinaryTableReader& is ) {
+    if ( !metric_matrix ){
+      metric_matrix = new SparseSymetricMatrix<const ValueClass*>();
+    }
+    else {
+      metric_matrix->Clear();
+    }
+    uint32_t count;
+    if ( !is.get_u32( count ) ){
+      return false;
+    }
+    vector<FeatureValue *> values( count );
+    for ( auto& fv : values ){
+      UnicodeString name;
+      if ( !is.get_string( name ) ){
+	return false;
+      }
+      fv = Lookup( name );
+    }
+    uint64_t entries;
+    if ( !is.get_u64( entries ) ){
+      return false;
+    }
+    for ( uint64_t i=0; i < entries; ++i ){
+      uint32_t i1, i2;
+      double d;
+      if ( !is.get_u32( i1 ) || !is.get_u32( i2 ) || !is.get_double( d ) ){
+	return false;
+      }
+      if ( i1 >= count || i2 >= count ){
+	Error( "wrong entry in matrix file" );
+	return false;
+      }
+      metric_matrix->Assign( values[i1], values[i2], d );
+    }
+    PrestoreStatus = ps_read;
+    return true;
+  }
+
 } // namespace Timbl
@@ -61,6 +61,10 @@ namespace Timbl {
     BeamSize = 0;
     clip_freq = 10;
     clones = 1;
+    shards = 1;
+    ingest_limit = -1;
+    flush_every = 0;
+    lazy_load = -1;
     bootstrap_lines = -1;
     local_progress = 100000;
     seed = -1;
@@ -76,6 +80,12 @@ namespace Timbl {
     do_sloppy_loo = false;
     do_silly = false;
     do_diversify = false;
+    do_numa = false;
+    do_shard_on_feature = false;
+    do_echo_input = false;
+    do_binary_tables = false;
+    do_frequency_order = false;
+    do_sparse = false;
     if ( MaxFeats == -1 ){
       MaxFeats = Max;
       LocalInputFormat = UnknownInputFormat; // InputFormat and verbosity
@@ -97,6 +107,7 @@ namespace Timbl {
     myVerbosity( NO_VERB ),
     opt_init( false ),
     opt_changed( false ),
+    weight_changed( false ),
     N_present( false ),
     parent_socket_os( 0 ) {
     int MaxF = DEFAULT_MAX_FEATS;
@@ -131,6 +142,10 @@ namespace Timbl {
     maxbests( in.maxbests ),
     clip_freq( in.clip_freq ),
     clones( in.clones ),
+    shards( in.shards ),
+    ingest_limit( in.ingest_limit ),
+    flush_every( in.flush_every ),
+    lazy_load( in.lazy_load ),
     BinSize( in.BinSize ),
     BeamSize( in.BeamSize ),
     bootstrap_lines( in.bootstrap_lines ),
@@ -142,6 +157,7 @@ namespace Timbl {
     myVerbosity( in.myVerbosity ),
     opt_init( in.opt_init ),
     opt_changed( in.opt_changed ),
+    weight_changed( false ),
     do_exact( in.do_exact ),
     do_hashed( in.do_hashed ),
     min_present( in.min_present ),
@@ -155,6 +171,12 @@ namespace Timbl {
     do_sloppy_loo( false ),
     do_silly( in.do_silly ),
     do_diversify( in.do_diversify ),
+    do_numa( in.do_numa ),
+    do_shard_on_feature( in.do_shard_on_feature ),
+    do_echo_input( in.do_echo_input ),
+    do_binary_tables( in.do_binary_tables ),
+    do_frequency_order( in.do_frequency_order ),
+    do_sparse( in.do_sparse ),
     metricsArray( in.metricsArray ),
     parent_socket_os( in.parent_socket_os ),
     outPath( in.outPath ),
@@ -292,9 +314,31 @@ namespace Timbl {
 	  Exp->setOutPath( outPath );
 	}
       } //first
+      else if ( weight_changed
+		&& Exp->IsFork()
+		&& local_weight != Unknown_w ){
+	// a fork may test with other weights than its parent
+	optline = "WEIGHTING: " + TiCC::toString(local_weight);
+	Exp->SetOption( optline );
+      }
+      weight_changed = false;
       if ( clones > 0 ){
 	Exp->Clones( clones );
       }
+      Exp->NumaReplicas( do_numa );
+      Exp->Shards( shards, do_shard_on_feature );
+      Exp->IngestLimit( ingest_limit );
+      Exp->FlushEvery( flush_every );
+      if ( lazy_load < 0 ){
+	Exp->LazyLoad( -1 );
+      }
+      else {
+	Exp->LazyLoad( long( lazy_load * 1024 * 1024 ) );
+      }
+      Exp->EchoInput( do_echo_input );
+      Exp->BinaryTables( do_binary_tables );
+      Exp->FrequencyOrder( do_frequency_order );
+      Exp->SparseSearch( do_sparse );
       if ( estimate < 10 ){
 	Exp->Estimate( 0 );
       }
@@ -702,10 +746,23 @@ namespace Timbl {
 	  break;
 
 	case 'b':
-	  bootstrap_lines = TiCC::stringTo<int>( value );
-	  if ( bootstrap_lines < 1 ){
-	    Error( "illegal value for -b option: " + value );
-	    return false;
+	  if ( longOpt ){
+	    if ( option == "binary-tables" ){
+	      bool val;
+	      if ( !isBoolOrEmpty(value,val) ){
+		Error( "invalid value for binary-tables: '"
+		       + value + "'" );
+		return false;
+	      }
+	      do_binary_tables = val;
+	    }
+	  }
+	  else {
+	    bootstrap_lines = TiCC::stringTo<int>( value );
+	    if ( bootstrap_lines < 1 ){
+	      Error( "illegal value for -b option: " + value );
+	      return false;
+	    }
 	  }
 	  break;
 
@@ -819,13 +876,43 @@ namespace Timbl {
 	  break;
 
 	case 'e':
-	  if ( !TiCC::stringTo<int>( value, estimate )
-	       || estimate < 0 ){
+	  if ( longOpt ){
+	    if ( option == "echo-input" ){
+	      bool val;
+	      if ( !isBoolOrEmpty(value,val) ){
+		Error( "invalid value for echo-input: '"
+		       + value + "'" );
+		return false;
+	      }
+	      do_echo_input = val;
+	    }
+	  }
+	  else if ( !TiCC::stringTo<int>( value, estimate )
+		    || estimate < 0 ){
 	    Error( "illegal value for -e option: " + value );
 	    return false;
 	  }
 	  break;
 
+	case 'f':
+	  if ( longOpt ){
+	    if ( option == "flush" ){
+	      if ( !TiCC::stringTo<int>( value, flush_every )
+		   || flush_every < 0 ){
+		Error( "invalid value for --flush option: '"
+		       + value + "'" );
+		return false;
+	      }
+	    }
+	    else if ( option == "frequency-order" ){
+	      do_frequency_order = true;
+	    }
+	  }
+	  else {
+	    Warning( string("unhandled option: ") + opt_char + " " + value );
+	  }
+	  break;
+
 	case 'F':
 	  if ( !TiCC::stringTo<InputFormatType>( value, LocalInputFormat ) ){
 	    Error( "illegal value for -F option: " + value );
@@ -863,6 +950,22 @@ namespace Timbl {
 	  do_hashed = mood;
 	  break;
 
+	case 'i':
+	  if ( longOpt ){
+	    if ( option == "ingest-limit" ){
+	      if ( !TiCC::stringTo<int>( value, ingest_limit )
+		   || ingest_limit < 0 ){
+		Error( "invalid value for --ingest-limit option: '"
+		       + value + "'" );
+		return false;
+	      }
+	    }
+	  }
+	  else {
+	    Warning( string("unhandled option: ") + opt_char + " " + value );
+	  }
+	  break;
+
 	case 'k':
 	  if ( !TiCC::stringTo<int>( value, no_neigh )
 	       || no_neigh <= 0 ){
@@ -872,8 +975,20 @@ namespace Timbl {
 	  break;
 
 	case 'l':
-	  if ( !TiCC::stringTo<int>( value, f_length )
-	       || f_length <= 0 ){
+	  if ( longOpt ){
+	    if ( option == "lazy" ){
+	      if ( value.empty() ){
+		lazy_load = 0;
+	      }
+	      else if ( !TiCC::stringTo<double>( value, lazy_load )
+			|| lazy_load < 0 ){
+		Error( "illegal value for --lazy option: " + value );
+		return false;
+	      }
+	    }
+	  }
+	  else if ( !TiCC::stringTo<int>( value, f_length )
+		    || f_length <= 0 ){
 	    Error( "illegal value for -l option: " + value );
 	    return false;
 	  }
@@ -914,6 +1029,23 @@ namespace Timbl {
 	  }
 	  break;
 
+	case 'n':
+	  if ( longOpt ){
+	    if ( option == "numa" ){
+	      bool val;
+	      if ( !isBoolOrEmpty(value,val) ){
+		Error( "invalid value for numa: '"
+		       + value + "'" );
+		return false;
+	      }
+	      do_numa = val;
+	    }
+	  }
+	  else {
+	    Warning( string("unhandled option: ") + opt_char + " " + value );
+	  }
+	  break;
+
 	case 'N':
 	  // skip previously parsed NumOfFeatures info.
 	  break;
@@ -981,6 +1113,25 @@ namespace Timbl {
 	      }
 	      do_silly = val;
 	    }
+	    else if ( option == "shards" ){
+	      // --shards=<n>[:rr|:ff]
+	      string::size_type pos = value.find( ":" );
+	      string mode = "rr";
+	      if ( pos != string::npos ){
+		mode = value.substr( pos+1 );
+	      }
+	      if ( !TiCC::stringTo<int>( value.substr( 0, pos ), shards )
+		   || shards <= 0
+		   || ( mode != "rr" && mode != "ff" ) ){
+		Error( "invalid value for --shards option: '"
+		       + value + "' (expected <n>[:rr|:ff])" );
+		return false;
+	      }
+	      do_shard_on_feature = ( mode == "ff" );
+	    }
+	    else if ( option == "sparse" ){
+	      do_sparse = true;
+	    }
 	  }
 	  else { //short opt, so -s
 	    if ( value.empty() ){
@@ -1083,6 +1234,7 @@ namespace Timbl {
 	case 'w': {
 	  if ( !TiCC::stringTo<WeightType>( value, local_weight ) )
 	    return false;
+	  weight_changed = true;
 	};
 	  break;
 
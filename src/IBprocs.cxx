@@ -416,7 +416,7 @@ namespace Timbl {
     os << features.permutation[NumOfFeatures()-1]+1 << " >" << endl;
   }
 
-  bool MBLClass::PutInstanceBase( ostream& os ) const {
+  bool MBLClass::PutInstanceBase( ostream& os, bool background ) const {
     bool result = true;
     if ( ExpInvalid() ){
       result = false;
@@ -464,13 +464,14 @@ namespace Timbl {
       }
       os << "# Bin_Size: " << Bin_Size << endl;
       if ( hashed_trees ){
-	InstanceBase->Save( os,
-			    *targets.hash(),
-			    *features.hash(),
-			    keep_distributions );
+	result = InstanceBase->Save( os,
+				     *targets.hash(),
+				     *features.hash(),
+				     keep_distributions,
+				     background );
       }
       else {
-	InstanceBase->Save( os, keep_distributions );
+	result = InstanceBase->Save( os, keep_distributions, background );
       }
     }
     return result;
@@ -26,17 +26,24 @@
 */
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <streambuf>
+#include <cctype>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "ticcutils/StringOps.h"
 #include "ticcutils/UniHash.h"
-#include "ticcutils/XMLtools.h"
 #include "timbl/Common.h"
 #include "timbl/MsgClass.h"
 #include "timbl/Types.h"
 #include "timbl/Instance.h"
 #include "timbl/IBtree.h"
+#include "timbl/BlockWriter.h"
 
 using namespace std;
 using namespace icu;
@@ -55,7 +62,7 @@ namespace Timbl {
   { }
 
   IBtree::~IBtree(){
-    delete TDistribution;
+    ClassDistribution::release( TDistribution );
     delete link;
     delete next;
   }
@@ -77,7 +84,7 @@ namespace Timbl {
 	// already there, so bail out.
 	return *pnt;
       }
-      else if ( (*pnt)->FValue->Index() < FV->Index() ){
+      else if ( (*pnt)->FValue->before( FV ) ){
 #ifdef IBSTATS
 	++mm;
 #endif
@@ -181,64 +188,90 @@ namespace Timbl {
     return CurSize * sizeof(IBtree);
   }
 
-  void InstanceBase_base::write_tree( ostream &os, const IBtree *pnt ) const {
-    // part of saving a tree in a recoverable manner
-    os << " (" << pnt->TValue << " ";
-    if ( pnt->link ){
-      if ( PersistentDistributions && pnt->TDistribution ){
-	os << pnt->TDistribution->Save();
+  static void append_dist( string& out,
+			   const ClassDistribution *dist,
+			   bool hashed ){
+    if ( hashed ){
+      dist->SaveHashedTo( out );
+    }
+    else {
+      dist->SaveTo( out );
+    }
+  }
+
+  void InstanceBase_base::write_list( BlockWriter& writer,
+				      const IBtree *pnt,
+				      bool hashed ){
+    // part of saving a tree in a recoverable manner.
+    // Writes the list starting at pnt and everything below it, walking
+    // the tree with an explicit path instead of recursion
+    string& out = writer.buffer();
+    out += '[';
+    vector<const IBtree*> path;
+    path.push_back( pnt );
+    while ( !path.empty() ){
+      pnt = path.back();
+      if ( path.size() == 1 ){
+	noteSubtree( writer.tell() );
+      }
+      if ( hashed ){
+	out += to_string( pnt->FValue->Index() );
+	out += '(';
+	out += to_string( pnt->TValue->Index() );
       }
-      pnt = pnt->link;
-      if ( pnt->FValue ){
-	os << "[";
-	while ( pnt ){
-	  os << pnt->FValue << " ";
-	  write_tree( os, pnt );
-	  pnt = pnt->next;
-	  if ( pnt ){
-	    os << ",";
-	  }
+      else {
+	append_value( out, pnt->FValue );
+	out += ( path.size() == 1 ) ? " (" : "  (";
+	append_value( out, pnt->TValue );
+	out += ' ';
+      }
+      const IBtree *down = 0;
+      bool with_dist = false;
+      if ( pnt->link ){
+	if ( PersistentDistributions && pnt->TDistribution ){
+	  append_dist( out, pnt->TDistribution, hashed );
+	  with_dist = true;
+	}
+	if ( pnt->link->FValue ){
+	  down = pnt->link;
+	}
+	else if ( !PersistentDistributions && pnt->link->TDistribution ){
+	  append_dist( out, pnt->link->TDistribution, hashed );
+	  with_dist = true;
 	}
-	os << "]\n";
       }
-      else if ( !PersistentDistributions && pnt->TDistribution ){
-	os << pnt->TDistribution->Save();
+      else if ( pnt->TDistribution ){
+	append_dist( out, pnt->TDistribution, hashed );
+	with_dist = true;
       }
-    }
-    else if ( pnt->TDistribution ){
-      os << pnt->TDistribution->Save();
-    }
-    os << ")\n";
-  }
-
-  void InstanceBase_base::write_tree_hashed( ostream &os, const IBtree *pnt ) const {
-    // part of saving a tree in a recoverable manner
-    os << "(" << pnt->TValue->Index();
-    if ( pnt->link ){
-      if ( PersistentDistributions && pnt->TDistribution ){
-	os << pnt->TDistribution->SaveHashed();
+      // count the nodes as a reader will create them: a distribution
+      // at the end of a path gets a node of its own
+      ++saved_nodes;
+      if ( down ){
+	out += '[';
+	path.push_back( down );
       }
-      pnt = pnt->link;
-      if ( pnt->FValue ){
-	os << "[";
-	while ( pnt ){
-	  os << pnt->FValue->Index();
-	  write_tree_hashed( os, pnt );
-	  pnt = pnt->next;
-	  if ( pnt ){
-	    os << ",";
+      else {
+	if ( with_dist ){
+	  ++saved_nodes;
+	  ++saved_tails;
+	}
+	out += ")\n";
+	while ( !path.empty() ){
+	  if ( path.back()->next ){
+	    out += ',';
+	    path.back() = path.back()->next;
+	    break;
+	  }
+	  out += "]\n";
+	  path.pop_back();
+	  if ( !path.empty() ){
+	    out += ")\n";
 	  }
 	}
-	os << "]\n";
       }
-      else if ( pnt->TDistribution && !PersistentDistributions ){
-	os << pnt->TDistribution->SaveHashed();
-      }
-    }
-    else if ( pnt->TDistribution ){
-      os << pnt->TDistribution->SaveHashed();
+      writer.check();
     }
-    os << ")\n";
   }
 
   const TargetValue *InstanceBase_base::TopTarget( bool &tie ) {
@@ -256,47 +289,36 @@ namespace Timbl {
     return TopT;
   }
 
-  void InstanceBase_base::Save( ostream &os, bool persist ) {
+  void InstanceBase_base::noteSubtree( streamoff pos ){
+    // remember where the next top level subtree starts, so an index
+    // can be written next to the file. Not possible on a pipe
+    if ( pos >= 0 ){
+      subtree_offsets.push_back( pos );
+    }
+  }
+
+  bool InstanceBase_base::Save( ostream &os, bool persist, bool background ) {
     // save an IBtree for later use.
+    LoadAll();
     bool temp_persist = PersistentDistributions;
     PersistentDistributions = persist;
     AssignDefaults();
     bool dummy;
-    os << "# Version " << Version << "\n#\n("
-       << TopTarget( dummy ) << " " << TopDistribution->Save();
-    IBtree *pnt = InstBase;
-    if ( pnt ){
-      os << "[";
-      while ( pnt ){
-	os << pnt->FValue;
-	write_tree( os, pnt );
-	pnt = pnt->next;
-	if ( pnt ){
-	  os << ",";
-	}
-      }
-      os << "]\n";
+    os << "# Version " << Version << "\n#\n(";
+    BlockWriter writer( os, background );
+    string& out = writer.buffer();
+    append_value( out, TopTarget( dummy ) );
+    out += ' ';
+    TopDistribution->SaveTo( out );
+    subtree_offsets.clear();
+    saved_nodes = 0;
+    saved_tails = 0;
+    if ( InstBase ){
+      write_list( writer, InstBase, false );
     }
-    os << ")\n";
+    out += ")\n";
     PersistentDistributions = temp_persist;
-  }
-
-  xmlNode *to_node( const FeatureValue *fv ){
-    xmlNode *result = TiCC::XmlNewNode( "feature" );
-    TiCC::XmlAddContent( result, fv->name_string() );
-    return result;
-  }
-
-  xmlNode *to_node( const TargetValue *tv ){
-    xmlNode *result = TiCC::XmlNewNode( "target" );
-    TiCC::XmlAddContent( result, tv->name_string() );
-    return result;
-  }
-
-  xmlNode *to_node( const ClassDistribution *d ){
-    xmlNode *result = TiCC::XmlNewNode( "distribution" );
-    TiCC::XmlAddContent( result, d->DistToString() );
-    return result;
+    return writer.flush();
   }
 
   int count_next( const IBtree *pnt ){
@@ -309,49 +331,138 @@ namespace Timbl {
     return cnt;
   }
 
-  xmlNode *to_xml( IBtree *pnt ) {
-    xmlNode *nodes = TiCC::XmlNewNode( "nodes" );
-    int cnt = count_next( pnt );
-    TiCC::XmlSetAttribute( nodes, "nodecount", TiCC::toString( cnt ) );
-    while ( pnt ){
-      xmlNode *node = TiCC::XmlNewChild( nodes, "node" );
-      if ( pnt->FValue ){
-	xmlAddChild( node, to_node( pnt->FValue ) );
-      }
-      if ( pnt->TValue ){
-	xmlAddChild( node, to_node( pnt->TValue ) );
-      }
-      if ( pnt->link ){
-	if ( pnt->link->FValue ){
-	  xmlAddChild( node, to_xml(pnt->link) );
-	}
-	else if ( pnt->link->TDistribution ){
-	  xmlAddChild( node, to_node( pnt->link->TDistribution ) );
-	}
-      }
-      else if ( pnt->TDistribution ){
-	xmlAddChild( node, to_node( pnt->TDistribution ) );
+  static void append_xml_text( string& out, const string& text ){
+    // escape text content the way libxml does
+    for ( const auto c : text ){
+      switch ( c ){
+      case '<':
+	out += "&lt;";
+	break;
+      case '>':
+	out += "&gt;";
+	break;
+      case '&':
+	out += "&amp;";
+	break;
+      case '\r':
+	out += "&#13;";
+	break;
+      default:
+	out += c;
       }
-      pnt = pnt->next;
     }
-    return nodes;
   }
 
-  void InstanceBase_base::toXML( ostream &os )  {
-    // save an IBtree for later use.
-    xmlDoc *doc = TiCC::create_xmlDocument( "root" );
-    xmlNode *root = TiCC::getRoot( doc );
-    xmlAddChild( root,
-		 TiCC::XmlNewComment( "Version " + TiCC::toString(Version) ) );
+  static void append_xml_element( string& out,
+				  size_t indent,
+				  const string& tag,
+				  const string& text ){
+    out.append( 2*indent, ' ' );
+    out += '<';
+    out += tag;
+    if ( text.empty() ){
+      out += "/>\n";
+    }
+    else {
+      out += '>';
+      append_xml_text( out, text );
+      out += "</";
+      out += tag;
+      out += ">\n";
+    }
+  }
+
+  static void open_xml_nodes( string& out,
+			      size_t indent,
+			      const IBtree *pnt ){
+    out.append( 2*indent, ' ' );
+    out += "<nodes nodecount=\"";
+    out += to_string( count_next( pnt ) );
+    out += pnt ? "\">\n" : "\"/>\n";
+  }
+
+  bool InstanceBase_base::toXML( ostream &os ) {
+    // writes the document libxml would produce for the tree (formatted,
+    // UTF-8), but streams it instead of building it in memory first
+    LoadAll();
+    BlockWriter writer( os );
+    string& out = writer.buffer();
+    out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<root>\n";
+    out += "  <!--Version " + to_string( Version ) + "-->\n";
     bool dummy;
-    xmlAddChild( root, to_node( TopTarget( dummy ) ) );
+    append_xml_element( out, 1, "target", TopTarget( dummy )->name_string() );
     if ( PersistentDistributions ){
-      xmlAddChild( root, to_node( TopDistribution ) );
+      append_xml_element( out, 1, "distribution",
+			  TopDistribution->DistToString() );
     }
-    IBtree *pnt = InstBase;
-    xmlNode *tree = to_xml( pnt );
-    xmlAddChild( root, tree );
-    os << doc << endl;
+    open_xml_nodes( out, 1, InstBase );
+    vector<const IBtree*> path;
+    if ( InstBase ){
+      path.push_back( InstBase );
+    }
+    while ( !path.empty() ){
+      // a <node> is indented 2 levels deeper than its parent <node>
+      const IBtree *pnt = path.back();
+      size_t indent = 2*path.size();
+      const IBtree *down = 0;
+      bool below = pnt->link ?
+	( pnt->link->FValue || pnt->link->TDistribution ) :
+	pnt->TDistribution != 0;
+      if ( !pnt->FValue && !pnt->TValue && !below ){
+	out.append( 2*indent, ' ' );
+	out += "<node/>\n";
+      }
+      else {
+	out.append( 2*indent, ' ' );
+	out += "<node>\n";
+	if ( pnt->FValue ){
+	  append_xml_element( out, indent+1, "feature",
+			      pnt->FValue->name_string() );
+	}
+	if ( pnt->TValue ){
+	  append_xml_element( out, indent+1, "target",
+			      pnt->TValue->name_string() );
+	}
+	if ( pnt->link ){
+	  if ( pnt->link->FValue ){
+	    down = pnt->link;
+	  }
+	  else if ( pnt->link->TDistribution ){
+	    append_xml_element( out, indent+1, "distribution",
+				pnt->link->TDistribution->DistToString() );
+	  }
+	}
+	else if ( pnt->TDistribution ){
+	  append_xml_element( out, indent+1, "distribution",
+			      pnt->TDistribution->DistToString() );
+	}
+	if ( down ){
+	  open_xml_nodes( out, indent+1, down );
+	  path.push_back( down );
+	}
+	else {
+	  out.append( 2*indent, ' ' );
+	  out += "</node>\n";
+	}
+      }
+      while ( !down && !path.empty() ){
+	if ( path.back()->next ){
+	  path.back() = path.back()->next;
+	  break;
+	}
+	path.pop_back();
+	indent = 2*path.size();
+	out.append( 2*(indent+1), ' ' );
+	out += "</nodes>\n";
+	if ( !path.empty() ){
+	  out.append( 2*indent, ' ' );
+	  out += "</node>\n";
+	}
+      }
+      writer.check();
+    }
+    out += "</root>\n\n";
+    return writer.flush();
   }
 
   UnicodeString VectoString( const vector<FeatureValue*>& vec ){
@@ -364,6 +475,7 @@ namespace Timbl {
 
   void InstanceBase_base::printStatsTree( ostream &os,
 					  unsigned int startLevel )  {
+    LoadAll();
     if ( !PersistentDistributions ){
       os << "no statsTree written, use IG tree and +D while training" << endl;
     }
@@ -416,46 +528,162 @@ namespace Timbl {
     os << endl;
   }
 
-  void InstanceBase_base::Save( ostream& os,
+  bool InstanceBase_base::Save( ostream& os,
 				const Hash::UnicodeHash& cats,
 				const Hash::UnicodeHash& feats,
-				bool persist ) {
+				bool persist,
+				bool background ) {
     // save an IBtree for later use.
+    LoadAll();
     bool temp_persist =  PersistentDistributions;
     PersistentDistributions = persist;
     AssignDefaults();
     os << "# Version " << Version << " (Hashed)\n#" << endl;
     save_hash( os , cats, feats );
     bool dummy;
-    os << "(" << TopTarget( dummy )->Index() << TopDistribution->SaveHashed();
-    IBtree *pnt = InstBase;
-    if ( pnt ){
-      os << "[";
-      while ( pnt ){
-	os << pnt->FValue->Index();
-	write_tree_hashed( os, pnt );
-	pnt = pnt->next;
-	if ( pnt ){
-	  os << ",";
-	}
-      }
-      os << "]\n";
+    os << "(" << TopTarget( dummy )->Index();
+    BlockWriter writer( os, background );
+    string& out = writer.buffer();
+    TopDistribution->SaveHashedTo( out );
+    subtree_offsets.clear();
+    saved_nodes = 0;
+    saved_tails = 0;
+    if ( InstBase ){
+      write_list( writer, InstBase, true );
     }
-    os << ")\n";
+    out += ")\n";
     PersistentDistributions = temp_persist;
+    return writer.flush();
+  }
+
+  class treeFragment {
+    // one top level subtree, parsed on its own by read_list_indexed().
+    // The feature values are looked up later, when the fragments are
+    // linked in file order, so the value tables end up exactly like
+    // after a sequential read
+  public:
+    struct pending {
+      IBtree *node;
+      int level;
+      UnicodeString name;   // the value, for a text tree
+      size_t index;         // the value, for a hashed tree
+      const ClassDistribution *dist; // to reconstruct the value from
+    };
+    treeFragment():
+      root(0), nodes(0), tails(0), end(0)
+    {};
+    IBtree *root;
+    unsigned long int nodes;
+    unsigned long int tails;
+    streamoff end;
+    vector<pending> values;
+    vector<string> warnings;
+    vector<string> errors;
+  };
+
+  class lazyTree {
+    // the state of a lazily read tree: the tree file mapped in memory,
+    // and for every top level subtree where it is and whether it is read.
+    // Not thread safe, LoadAll() before sharing the tree between threads
+  public:
+    struct subtree {
+      IBtree *top;
+      size_t begin;
+      size_t end;
+      unsigned long nodes;   // when read
+      size_t bytes;          // in memory, when read
+      unsigned long used;    // last use, for the eviction of cold ones
+      bool loaded;
+      bool seen;             // read before, its values are known
+    };
+    lazyTree( const string& name,
+	      unsigned long int n,
+	      unsigned long int t,
+	      size_t c ):
+      file( name ), nodes( n ), tails( t ), cap( c ),
+      data( 0 ), size( 0 ), hashed( false ), feats( 0 ), targets( 0 ),
+      resident( 0 ), clock( 0 ), unread( 0 )
+    {};
+    ~lazyTree(){ unmap(); };
+    bool map();
+    void unmap();
+    bool active() const { return unread > 0 || cap > 0; };
+    string file;
+    unsigned long int nodes;
+    unsigned long int tails;
+    size_t cap;
+    const char *data;
+    size_t size;
+    bool hashed;
+    Feature_List *feats;
+    Targets *targets;
+    vector<subtree> subtrees;
+    unordered_map<size_t, size_t> slots; // FeatureValue Index to subtree
+    size_t resident;
+    unsigned long clock;
+    size_t unread;
+  };
+
+  bool lazyTree::map(){
+    int fd = ::open( file.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size == 0 ){
+      ::close( fd );
+      return false;
+    }
+    void *pnt = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( pnt == MAP_FAILED ){
+      return false;
+    }
+    data = static_cast<const char *>( pnt );
+    size = st.st_size;
+    return true;
+  }
+
+  void lazyTree::unmap(){
+    if ( data ){
+      munmap( const_cast<char *>( data ), size );
+      data = 0;
+      size = 0;
+    }
+  }
+
+  void InstanceBase_base::loadWarning( treeFragment *frag,
+				       const string& msg ) const {
+    if ( frag ){
+      frag->warnings.push_back( msg );
+    }
+    else {
+      Warning( msg );
+    }
+  }
+
+  void InstanceBase_base::loadError( treeFragment *frag,
+				     const string& msg ) const {
+    if ( frag ){
+      frag->errors.push_back( msg );
+    }
+    else {
+      Error( msg );
+    }
   }
 
   IBtree* InstanceBase_base::read_list( istream &is,
 					Feature_List& feats,
 					Targets& Targ,
-					int level ){
+					int level,
+					treeFragment *frag ){
     IBtree *result = NULL;
     IBtree **pnt = &result;
     bool goon = true;
     char delim;
     while ( is && goon ) {
       is >> delim;    // skip the opening `[` or separating ','
-      *pnt = read_local( is, feats, Targ, level );
+      *pnt = read_local( is, feats, Targ, level, frag );
       if ( !(*pnt) ){
 	delete result;
 	return NULL;
@@ -470,14 +698,15 @@ namespace Timbl {
   IBtree* InstanceBase_base::read_list_hashed( istream &is,
 					       Feature_List& feats,
 					       Targets& Targ,
-					       int level ){
+					       int level,
+					       treeFragment *frag ){
     IBtree *result = NULL;
     IBtree **pnt = &result;
     bool goon = true;
     char delim;
     while ( is && goon ) {
       is >> delim;    // skip the opening `[` or separating ','
-      *pnt = read_local_hashed( is, feats, Targ, level );
+      *pnt = read_local_hashed( is, feats, Targ, level, frag );
       if ( !(*pnt) ){
 	delete result;
 	return NULL;
@@ -492,19 +721,29 @@ namespace Timbl {
   IBtree *InstanceBase_base::read_local( istream &is,
 					 Feature_List& feats,
 					 Targets& Targ,
-					 int level ){
+					 int level,
+					 treeFragment *frag,
+					 bool shallow ){
+    // with shallow, a node with a subtree is returned without it,
+    // at the opening `[`
     if ( !is ){
       return NULL;
     }
     IBtree *result = new IBtree();
-    ++ibCount;
     UnicodeString buf;
     char delim;
     is >> ws >> buf;
-    result->FValue = feats.perm_feats[level]->add_value( buf, NULL, 1 );
+    if ( frag ){
+      ++frag->nodes;
+      frag->values.push_back( { result, level, buf, 0, 0 } );
+    }
+    else {
+      ++ibCount;
+      result->FValue = feats.perm_feats[level]->add_value( buf, NULL, 1 );
+    }
     is >> delim;
     if ( !is || delim != '(' ){
-      Error( "missing `(` in Instance Base file" );
+      loadError( frag, "missing `(` in Instance Base file" );
       delete result;
       return NULL;
     }
@@ -517,19 +756,26 @@ namespace Timbl {
 	  = ClassDistribution::read_distribution( is, Targ, false );
       }
       catch ( const exception& e ){
-	Warning( e.what() );
-	Error( "problems reading a distribution from InstanceBase file" );
+	loadWarning( frag, e.what() );
+	loadError( frag,
+		   "problems reading a distribution from InstanceBase file" );
 	delete result;
 	return 0;
       }
       // also we have to update the targetinformation of the featurevalue
       // so we can recalculate the statistics later on.
-      if ( result->FValue->ValFreq() > 0 ){
+      if ( frag ){
+	frag->values.back().dist = result->TDistribution;
+      }
+      else if ( result->FValue->ValFreq() > 0 ){
 	result->FValue->ReconstructDistribution( *(result->TDistribution) );
       }
     }
     if ( look_ahead(is) == '[' ){
-      result->link = read_list( is, feats, Targ, level+1 );
+      if ( shallow ){
+	return result;
+      }
+      result->link = read_list( is, feats, Targ, level+1, frag );
       if ( !(result->link) ){
 	delete result;
 	return 0;
@@ -537,7 +783,6 @@ namespace Timbl {
     }
     else if ( look_ahead(is) == ')' && result->TDistribution ){
       result->link = new IBtree();
-      ++ibCount;
       result->link->TValue = result->TValue;
       if ( PersistentDistributions ){
 	result->link->TDistribution = result->TDistribution->to_VD_Copy();
@@ -546,11 +791,18 @@ namespace Timbl {
 	result->link->TDistribution = result->TDistribution;
 	result->TDistribution = NULL;
       }
-      NumOfTails++;
+      if ( frag ){
+	++frag->nodes;
+	++frag->tails;
+      }
+      else {
+	++ibCount;
+	NumOfTails++;
+      }
     }
     is >> delim;
     if ( delim != ')' ){
-      Error( "missing `)` in Instance Base file" );
+      loadError( frag, "missing `)` in Instance Base file" );
       delete result;
       return NULL;
     }
@@ -560,19 +812,28 @@ namespace Timbl {
   IBtree *InstanceBase_base::read_local_hashed( istream &is,
 						Feature_List& feats,
 						Targets& Targ,
-						int level ){
+						int level,
+						treeFragment *frag,
+						bool shallow ){
     if ( !is ){
       return NULL;
     }
     IBtree *result = new IBtree();
-    ++ibCount;
     char delim;
     int index;
     is >> index;
-    result->FValue = feats.perm_feats[level]->add_value( index, NULL, 1 );
+    if ( frag ){
+      ++frag->nodes;
+      frag->values.push_back( { result, level, UnicodeString(),
+				size_t(index), 0 } );
+    }
+    else {
+      ++ibCount;
+      result->FValue = feats.perm_feats[level]->add_value( index, NULL, 1 );
+    }
     is >> delim;
     if ( !is || delim != '(' ){
-      Error( "missing `(` in Instance Base file" );
+      loadError( frag, "missing `(` in Instance Base file" );
       delete result;
       return NULL;
     }
@@ -589,14 +850,17 @@ namespace Timbl {
 	  = ClassDistribution::read_distribution_hashed( is, Targ, false );
       }
       catch ( const exception& e ){
-	Warning( e.what() );
-	Error( "problems reading a hashed distribution from InstanceBase file" );
+	loadWarning( frag, e.what() );
+	loadError( frag, "problems reading a hashed distribution from InstanceBase file" );
 	delete result;
 	return 0;
       }
     }
     if ( look_ahead(is) == '[' ){
-      result->link = read_list_hashed( is, feats, Targ, level+1 );
+      if ( shallow ){
+	return result;
+      }
+      result->link = read_list_hashed( is, feats, Targ, level+1, frag );
       if ( !(result->link) ){
 	delete result;
 	return NULL;
@@ -607,7 +871,6 @@ namespace Timbl {
       // make a dummy node for the targetdistributions just read
       //
       result->link = new IBtree();
-      ++ibCount;
       result->link->TValue = result->TValue;
       if ( PersistentDistributions ){
 	result->link->TDistribution = result->TDistribution->to_VD_Copy();
@@ -616,23 +879,491 @@ namespace Timbl {
 	result->link->TDistribution = result->TDistribution;
 	result->TDistribution = NULL;
       }
-      NumOfTails++;
+      if ( frag ){
+	++frag->nodes;
+	++frag->tails;
+      }
+      else {
+	++ibCount;
+	NumOfTails++;
+      }
     }
     is >> delim;
     if ( delim != ')' ){
-      Error( "missing `)` in Instance Base file" );
+      loadError( frag, "missing `)` in Instance Base file" );
       delete result;
       return NULL;
     }
     return result;
   }
 
+  class rangebuf: public streambuf {
+    // a read-only streambuf on a range of characters in memory
+  public:
+    rangebuf( const char *b, const char *e ){
+      char *p = const_cast<char*>( b );
+      setg( p, p, const_cast<char*>( e ) );
+    }
+  protected:
+    pos_type seekoff( off_type off,
+		      ios::seekdir dir,
+		      ios::openmode ) override {
+      if ( dir == ios::cur && off == 0 ){
+	return pos_type( gptr() - eback() );
+      }
+      return pos_type( off_type(-1) );
+    }
+  };
+
+  static bool find_subtrees( const char *buf,
+			     size_t len,
+			     size_t from,
+			     streamoff base,
+			     const vector<streamoff>& offsets,
+			     vector<size_t>& begins ){
+    // translate the subtree offsets of an index into positions in buf,
+    // which holds the file from offset 'base' on. The list must start at
+    // position 'from', and each subtree must follow the `[` or the ','
+    // which separates it from its predecessor
+    begins.clear();
+    size_t prev = from;
+    for ( size_t k=0; k < offsets.size(); ++k ){
+      if ( offsets[k] <= base ){
+	return false;
+      }
+      size_t pos = offsets[k] - base;
+      if ( pos <= prev || pos >= len ){
+	return false;
+      }
+      size_t p = pos;
+      while ( p > from && isspace( static_cast<unsigned char>(buf[p-1]) ) ){
+	--p;
+      }
+      char sep = ( k == 0 ? '[' : ',' );
+      if ( p == from || buf[p-1] != sep ){
+	return false;
+      }
+      if ( k == 0 ){
+	size_t first = from;
+	while ( first < len
+		&& isspace( static_cast<unsigned char>(buf[first]) ) ){
+	  ++first;
+	}
+	if ( first != p-1 ){
+	  return false;
+	}
+      }
+      begins.push_back( pos );
+      prev = pos;
+    }
+    return true;
+  }
+
+  bool InstanceBase_base::read_list_indexed( istream& is,
+					     Feature_List& feats,
+					     Targets& Targ,
+					     bool hashed,
+					     IBtree*& result ){
+    // read the top level list using the subtree offsets of an index,
+    // parsing the subtrees in parallel.
+    // returns false when the index doesn't fit the file, 'is' is then
+    // untouched and the caller should read sequentially
+    result = 0;
+    streamoff start = is.tellg();
+    if ( start < 0 || subtree_offsets.empty() || load_threads < 2 ){
+      return false;
+    }
+    is.seekg( 0, ios::end );
+    streamoff size = is.tellg();
+    is.seekg( start );
+    string buffer;
+    vector<size_t> begins;
+    bool fits = ( size > start );
+    if ( fits ){
+      buffer.resize( size - start );
+      is.read( &buffer[0], buffer.size() );
+      fits = ( is.gcount() == static_cast<streamsize>(buffer.size()) )
+	&& find_subtrees( buffer.data(), buffer.size(), 0, start,
+			  subtree_offsets, begins );
+    }
+    if ( !fits ){
+      is.clear();
+      is.seekg( start );
+      return false;
+    }
+    size_t num = subtree_offsets.size();
+    begins.push_back( buffer.size() );
+    vector<treeFragment> frags( num );
+#pragma omp parallel for schedule(dynamic) num_threads(load_threads)
+    for ( size_t k=0; k < num; ++k ){
+      rangebuf rb( buffer.data() + begins[k], buffer.data() + begins[k+1] );
+      istream ss( &rb );
+      if ( hashed ){
+	frags[k].root = read_local_hashed( ss, feats, Targ, 0, &frags[k] );
+      }
+      else {
+	frags[k].root = read_local( ss, feats, Targ, 0, &frags[k] );
+      }
+      frags[k].end = ss.tellg();
+    }
+    // link the fragments, and look up their values in file order
+    bool ok = true;
+    for ( auto& frag : frags ){
+      for ( const auto& w : frag.warnings ){
+	Warning( w );
+      }
+      for ( const auto& e : frag.errors ){
+	Error( e );
+      }
+      if ( !frag.root ){
+	ok = false;
+      }
+    }
+    if ( ok ){
+      IBtree **pnt = &result;
+      for ( auto& frag : frags ){
+	for ( const auto& pv : frag.values ){
+	  FeatureValue *fv;
+	  if ( hashed ){
+	    fv = feats.perm_feats[pv.level]->add_value( pv.index, NULL, 1 );
+	  }
+	  else {
+	    fv = feats.perm_feats[pv.level]->add_value( pv.name, NULL, 1 );
+	    if ( pv.dist && fv->ValFreq() > 0 ){
+	      fv->ReconstructDistribution( *pv.dist );
+	    }
+	  }
+	  pv.node->FValue = fv;
+	}
+	ibCount += frag.nodes;
+	NumOfTails += frag.tails;
+	*pnt = frag.root;
+	pnt = &frag.root->next;
+      }
+      // continue after the last subtree, and skip the closing `]`
+      is.clear();
+      is.seekg( start + begins[num-1] + frags[num-1].end );
+      char delim;
+      is >> delim;
+    }
+    else {
+      for ( auto& frag : frags ){
+	delete frag.root;
+      }
+    }
+    return true;
+  }
+
+  void InstanceBase_base::setLazyLoad( const string& file,
+				       unsigned long int nodes,
+				       unsigned long int tails,
+				       size_t cap ){
+    // read the next tree lazily from 'file', which holds 'nodes' nodes
+    // and 'tails' tails. With a 'cap' > 0, subtrees are thrown away
+    // again when they take more than 'cap' bytes together
+    lazy = make_shared<lazyTree>( file, nodes, tails, cap );
+  }
+
+  bool InstanceBase_base::read_list_lazy( istream& is,
+					  Feature_List& feats,
+					  Targets& Targ,
+					  bool hashed,
+					  IBtree*& result ){
+    // read only the top level nodes of the list, using the subtree
+    // offsets of an index. Their subtrees are read by load_subtree()
+    // when a test needs them.
+    // returns false when the index doesn't fit the file, 'is' is then
+    // untouched and the caller should read the whole list
+    result = 0;
+    streamoff start = is.tellg();
+    if ( !lazy ){
+      return false;
+    }
+    vector<size_t> begins;
+    bool fits = ( start > 0 && !subtree_offsets.empty() && lazy->map()
+		  && find_subtrees( lazy->data, lazy->size, start, 0,
+				    subtree_offsets, begins ) );
+    size_t list_end = 0;
+    if ( fits ){
+      // the list ends with the `]` before the closing `)` of the file
+      size_t p = lazy->size;
+      while ( p > 0 && isspace( static_cast<unsigned char>(lazy->data[p-1]) ) ){
+	--p;
+      }
+      fits = ( p > 0 && lazy->data[p-1] == ')' );
+      if ( fits ){
+	--p;
+	while ( p > 0
+		&& isspace( static_cast<unsigned char>(lazy->data[p-1]) ) ){
+	  --p;
+	}
+	fits = ( p > begins.back() && lazy->data[p-1] == ']' );
+	list_end = p-1;
+      }
+    }
+    if ( !fits ){
+      Warning( "the index of " + lazy->file + " doesn't fit, "
+	       "reading the whole InstanceBase" );
+      lazy.reset();
+      return false;
+    }
+    lazy->hashed = hashed;
+    lazy->feats = &feats;
+    lazy->targets = &Targ;
+    unsigned long int count = ibCount;
+    IBtree **pnt = &result;
+    for ( size_t k=0; k < begins.size(); ++k ){
+      size_t end = ( k+1 < begins.size() ) ? begins[k+1] : list_end;
+      rangebuf rb( lazy->data + begins[k], lazy->data + end );
+      istream ss( &rb );
+      IBtree *top;
+      if ( hashed ){
+	top = read_local_hashed( ss, feats, Targ, 0, 0, true );
+      }
+      else {
+	top = read_local( ss, feats, Targ, 0, 0, true );
+      }
+      if ( !top ){
+	delete result;
+	result = 0;
+	lazy.reset();
+	return true;
+      }
+      // a top node without a subtree is complete already
+      bool complete = ( top->link != 0 || look_ahead( ss ) != '[' );
+      lazy->subtrees.push_back( { top, begins[k], end, 0, 0, 0,
+				  complete, complete } );
+      lazy->slots[top->FValue->Index()] = k;
+      if ( complete ){
+	lazy_finish( top, false );
+      }
+      else {
+	++lazy->unread;
+      }
+      *pnt = top;
+      pnt = &top->next;
+    }
+    // the counts of the whole tree come from the index
+    ibCount = count + lazy->nodes;
+    NumOfTails = lazy->tails;
+    if ( !lazy->subtrees[0].loaded ){
+      // HasDistributions() looks at the first subtree
+      lazy->subtrees[0].used = ++lazy->clock;
+      if ( !load_subtree( 0 ) ){
+	delete result;
+	result = 0;
+	lazy.reset();
+	return true;
+      }
+    }
+    is.clear();
+    is.seekg( list_end + 1 );
+    return true;
+  }
+
+  bool InstanceBase_base::load_subtree( size_t k ){
+    // read the subtree of top level node k, as read_list_indexed() does
+    lazyTree::subtree& sub = lazy->subtrees[k];
+    rangebuf rb( lazy->data + sub.begin, lazy->data + sub.end );
+    istream ss( &rb );
+    treeFragment frag;
+    if ( lazy->hashed ){
+      frag.root = read_local_hashed( ss, *lazy->feats, *lazy->targets,
+				     0, &frag );
+    }
+    else {
+      frag.root = read_local( ss, *lazy->feats, *lazy->targets, 0, &frag );
+    }
+    for ( const auto& w : frag.warnings ){
+      Warning( w );
+    }
+    for ( const auto& e : frag.errors ){
+      Error( e );
+    }
+    if ( !frag.root ){
+      return false;
+    }
+    // the first value is the one of the top node, which we have already.
+    // A subtree that was read before is already counted in the values
+    int freq = sub.seen ? 0 : 1;
+    for ( size_t i=1; i < frag.values.size(); ++i ){
+      const auto& pv = frag.values[i];
+      FeatureValue *fv;
+      if ( lazy->hashed ){
+	fv = lazy->feats->perm_feats[pv.level]->add_value( pv.index, NULL, freq );
+      }
+      else {
+	fv = lazy->feats->perm_feats[pv.level]->add_value( pv.name, NULL, freq );
+	if ( !sub.seen && pv.dist && fv->ValFreq() > 0 ){
+	  fv->ReconstructDistribution( *pv.dist );
+	}
+      }
+      pv.node->FValue = fv;
+    }
+    sub.top->link = frag.root->link;
+    frag.root->link = 0;
+    delete frag.root;
+    lazy_finish( sub.top, sub.seen );
+    sub.nodes = frag.nodes;
+    sub.loaded = true;
+    sub.seen = true;
+    lazy_measure( k );
+    --lazy->unread;
+    return true;
+  }
+
+  void InstanceBase_base::lazy_finish( IBtree *top, bool seen ){
+    // give the subtree below top, read just now, the distributions
+    // ReadIB() gives a tree read as a whole. Only the first time its
+    // values get their class distributions
+    IBtree *next = top->next;
+    top->next = 0;
+    top->redo_distributions( !seen );
+    top->share_distributions();
+    if ( top->link ){
+      top->link = top->link->order_by_rank();
+    }
+    top->next = next;
+    if ( !PersistentDistributions ){
+      delete top->TDistribution;
+      top->TDistribution = 0;
+    }
+  }
+
+  void TRIBL_InstanceBase::lazy_finish( IBtree *top, bool seen ){
+    InstanceBase_base::lazy_finish( top, seen );
+    if ( DefaultsValid && Threshold > 0 ){
+      // the defaults were assigned without this subtree
+      IBtree *next = top->next;
+      top->next = 0;
+      top->assign_defaults( Random, PersistentDistributions, Threshold );
+      top->next = next;
+    }
+  }
+
+  void InstanceBase_base::lazy_measure( size_t k ){
+    // the memory subtree k takes: its nodes and their distributions,
+    // which take the most with persistent distributions
+    lazyTree::subtree& sub = lazy->subtrees[k];
+    unsigned long int count = 0;
+    unsigned long int entries = 0;
+    if ( sub.top->link ){
+      unordered_set<const ClassDistribution *> shared;
+      sub.top->link->countDistributions( count, entries, shared );
+    }
+    lazy->resident -= sub.bytes;
+    sub.bytes = sub.nodes * sizeof(IBtree)
+      + count * sizeof(ClassDistribution) + entries * sizeof(Vfield);
+    lazy->resident += sub.bytes;
+  }
+
+  bool InstanceBase_base::lazy_load( const FeatureValue *fv ){
+    // make sure the subtree below the top level node with value fv is
+    // read. Returns true when it was read just now
+    auto it = lazy->slots.find( fv->Index() );
+    if ( it == lazy->slots.end() ){
+      return false;
+    }
+    size_t k = it->second;
+    lazyTree::subtree& sub = lazy->subtrees[k];
+    sub.used = ++lazy->clock;
+    if ( sub.loaded ){
+      return false;
+    }
+    if ( !load_subtree( k ) ){
+      Error( "problems reading a subtree of " + lazy->file );
+      return false;
+    }
+    while ( lazy->cap > 0 && lazy->resident > lazy->cap ){
+      // throw away the least recently used subtree, but not this one
+      lazyTree::subtree *cold = 0;
+      for ( auto& cand : lazy->subtrees ){
+	if ( cand.loaded && cand.bytes > 0 && &cand != &sub
+	     && ( !cold || cand.used < cold->used ) ){
+	  cold = &cand;
+	}
+      }
+      if ( !cold ){
+	break;
+      }
+      delete cold->top->link;
+      cold->top->link = 0;
+      cold->loaded = false;
+      lazy->resident -= cold->bytes;
+      cold->bytes = 0;
+      ++lazy->unread;
+    }
+    return true;
+  }
+
+  const FeatureValue *InstanceBase_base::lazy_value( const FeatureValue *fv,
+						     size_t level ) const {
+    // a test value that was unknown when the instance was made, might be
+    // known since a subtree was read
+    if ( fv && fv->isUnknown() ){
+      const FeatureValue *known
+	= lazy->feats->perm_feats[level]->Lookup( fv->name() );
+      if ( known ){
+	return known;
+      }
+    }
+    return fv;
+  }
+
+  bool InstanceBase_base::isLazy() const {
+    return lazy && lazy->active();
+  }
+
+  bool InstanceBase_base::Prefetch( const FeatureValue *fv ){
+    // read the subtree that a test starting with value fv needs, before
+    // that test. Returns true when it was read just now: values of the
+    // test instance which were unknown might be known now
+    return fv && isLazy() && lazy_load( fv );
+  }
+
+  bool InstanceBase_base::LoadAll(){
+    // read every subtree of a lazily read tree, and stop being lazy
+    if ( !lazy ){
+      return true;
+    }
+    bool result = true;
+    for ( size_t k=0; k < lazy->subtrees.size(); ++k ){
+      if ( !lazy->subtrees[k].loaded && !load_subtree( k ) ){
+	Error( "problems reading a subtree of " + lazy->file );
+	result = false;
+      }
+    }
+    lazy->subtrees.clear();
+    lazy->slots.clear();
+    lazy->unread = 0;
+    lazy->cap = 0;
+    lazy->unmap();
+    lazy.reset();
+    return result;
+  }
+
+  void InstanceBase_base::OrderByRank(){
+    // put the lists of a tree which was read in the order AddInstance()
+    // needs. The subtrees of a lazy tree get it when they are read
+    if ( InstBase ){
+      InstBase = InstBase->order_by_rank();
+      LastInstBasePos = InstBase;
+      while ( LastInstBasePos->next ){
+	LastInstBasePos = LastInstBasePos->next;
+      }
+    }
+  }
+
   bool InstanceBase_base::ReadIB( istream &is,
 				  Feature_List& feats,
 				  Targets& Targ,
 				  int expected_version ){
     if ( read_IB( is, feats, Targ, expected_version ) ){
-      InstBase->redo_distributions();
+      if ( !lazy ){
+	// a lazily read tree does this per subtree, in lazy_finish()
+	InstBase->redo_distributions();
+	InstBase->share_distributions();
+      }
       ClassDistribution *Top
 	= InstBase->sum_distributions( PersistentDistributions );
       delete Top; // still a bit silly but the Top Distribution is known
@@ -706,7 +1437,10 @@ namespace Timbl {
       }
       else {
 	if ( look_ahead( is ) == '[' ){
-	  InstBase = read_list( is, feats, Targs, 0 );
+	  if ( !read_list_lazy( is, feats, Targs, false, InstBase )
+	       && !read_list_indexed( is, feats, Targs, false, InstBase ) ){
+	    InstBase = read_list( is, feats, Targs, 0 );
+	  }
 	}
 	if ( InstBase ){
 	  is >> ws >> buf;
@@ -763,7 +1497,11 @@ namespace Timbl {
 					 Targets& Targs,
 					 int expected_version ){
     if ( read_IB_hashed( is, feats, Targs, expected_version ) ){
-      InstBase->redo_distributions();
+      if ( !lazy ){
+	// a lazily read tree does this per subtree, in lazy_finish()
+	InstBase->redo_distributions();
+	InstBase->share_distributions();
+      }
       ClassDistribution *Top
 	= InstBase->sum_distributions( PersistentDistributions );
       delete Top; // still a bit silly but the Top Distribution is known
@@ -832,7 +1570,10 @@ namespace Timbl {
 	Error( "problems reading Top Distribution from Instance Base file" );
       }
       if ( look_ahead( is ) == '[' ){
-	InstBase = read_list_hashed( is, feats, Targs, 0 );
+	if ( !read_list_lazy( is, feats, Targs, true, InstBase )
+	     && !read_list_indexed( is, feats, Targs, true, InstBase ) ){
+	  InstBase = read_list_hashed( is, feats, Targs, 0 );
+	}
       }
       if ( InstBase ){
 	is >> delim;
@@ -915,7 +1656,10 @@ namespace Timbl {
 							     && persist );
 	}
       }
-      pnt->TValue = pnt->TDistribution->BestTarget( dummy, Random );
+      if ( pnt->TDistribution ){
+	// not so for a top node of a lazily read tree without its subtree
+	pnt->TValue = pnt->TDistribution->BestTarget( dummy, Random );
+      }
       pnt = pnt->next;
     }
   }
@@ -937,18 +1681,19 @@ namespace Timbl {
     }
   }
 
-  void IBtree::redo_distributions(){
+  void IBtree::redo_distributions( bool reconstruct ){
     // recursively gather Distribution information up to the top.
     // removing old info...
-    // at each node we also Reconstruct Feature distributions
+    // at each node we also Reconstruct Feature distributions, unless
+    // they are known already
     // we keep the Target value that was given!
     IBtree *pnt = this;
     while ( pnt ){
       if ( pnt->link ){
-	pnt->link->redo_distributions();
+	pnt->link->redo_distributions( reconstruct );
 	delete pnt->TDistribution;
 	pnt->TDistribution = pnt->link->sum_distributions( false );
-	if ( pnt->FValue->ValFreq() > 0 ){
+	if ( reconstruct && pnt->FValue->ValFreq() > 0 ){
 	  pnt->FValue->ReconstructDistribution( *(pnt->TDistribution) );
 	}
       }
@@ -1004,7 +1749,12 @@ namespace Timbl {
     const IBtree *pnt = this;
     int pos = 0;
     while ( pnt ){
-      if ( pnt->link == NULL ){
+      if ( pnt->link == NULL && pnt->FValue ){
+	// a top node of a lazily read tree, without its subtree. It
+	// isn't ours, ours is read before the test
+	pnt = pnt->next;
+      }
+      else if ( pnt->link == NULL ){
 	if ( pnt->TDistribution->ZeroDist() ){
 	  return NULL;
 	}
@@ -1048,7 +1798,10 @@ namespace Timbl {
     LastInstBasePos( 0 ),
     ibCount( cnt ),
     Depth( depth ),
-    NumOfTails( 0 )
+    NumOfTails( 0 ),
+    load_threads( 1 ),
+    saved_nodes( 0 ),
+    saved_tails( 0 )
     {
       InstPath.resize(depth,0);
       RestartSearch.resize(depth,0);
@@ -1059,6 +1812,9 @@ namespace Timbl {
     // the Instance can become very large, with even millions of 'next' pointers
     // so recursive deletion will use a lot of stack
     // therefore we choose to iterate the first level(s).
+    if ( pool && InstBase ){
+      InstBase->release_distributions();
+    }
     IBtree *pnt1 = InstBase;
     while ( pnt1 ){
       IBtree *toDel1 = pnt1;
@@ -1117,6 +1873,65 @@ namespace Timbl {
     result->LastInstBasePos = LastInstBasePos;
     delete result->TopDistribution;
     result->TopDistribution = TopDistribution;
+    result->lazy = lazy;
+    result->pool = pool;
+    return result;
+  }
+
+  IBtree *IBtree::replicate( unordered_map<const ClassDistribution *,
+				  ClassDistribution *>& copies ) const {
+    // make a deep copy of this (sub)tree. The Feature and Target values
+    // are shared with the original, the nodes and distributions are new.
+    // Nodes sharing a distribution share its copy, using 'copies'.
+    // we iterate over the 'next' chain, only recursing on 'link'
+    IBtree *result = 0;
+    IBtree **pnt = &result;
+    const IBtree *src = this;
+    while ( src ){
+      *pnt = new IBtree( src->FValue );
+      (*pnt)->TValue = src->TValue;
+      if ( src->TDistribution ){
+	auto [it,fresh] = copies.emplace( src->TDistribution, nullptr );
+	if ( fresh ){
+	  it->second = src->TDistribution->Replicate();
+	  (*pnt)->TDistribution = it->second;
+	}
+	else {
+	  (*pnt)->TDistribution = it->second->share();
+	}
+      }
+      if ( src->link ){
+	(*pnt)->link = src->link->replicate( copies );
+      }
+      pnt = &((*pnt)->next);
+      src = src->next;
+    }
+    return result;
+  }
+
+  InstanceBase_base *InstanceBase_base::Replicate() const {
+    // unlike Copy(), this creates a private duplicate of the whole tree,
+    // which may be used (and deleted) independently of the original.
+    // Used to place a local copy of a read-only tree on every NUMA node.
+    InstanceBase_base *result = Copy();
+    result->InstBase = 0;
+    result->LastInstBasePos = 0;
+    // the copies of pooled distributions are shared by counting their
+    // users, like those of a tree which was read
+    result->pool.reset();
+    if ( InstBase ){
+      unordered_map<const ClassDistribution *, ClassDistribution *> copies;
+      result->InstBase = InstBase->replicate( copies );
+      IBtree *pnt = result->InstBase;
+      while ( pnt->next ){
+	pnt = pnt->next;
+      }
+      result->LastInstBasePos = pnt;
+    }
+    result->TopDistribution = 0;
+    if ( TopDistribution ){
+      result->TopDistribution = TopDistribution->Replicate();
+    }
     return result;
   }
 
@@ -1137,6 +1952,7 @@ namespace Timbl {
 
   void InstanceBase_base::summarizeNodes( std::vector<unsigned int>& terminals,
 					  std::vector<unsigned int>& nonTerminals ){
+    LoadAll();
     terminals.clear();
     nonTerminals.clear();
     terminals.resize( Depth+1, 0 );
@@ -1146,6 +1962,48 @@ namespace Timbl {
     }
   }
 
+  void IBtree::countDistributions( unsigned long int& count,
+				  unsigned long int& entries,
+				  unordered_set<const ClassDistribution*>& shared
+				  ) const {
+    // a shared distribution is counted once
+    const IBtree *pnt = this;
+    while ( pnt ){
+      if ( pnt->TDistribution
+	   && ( !pnt->TDistribution->isShared()
+		|| shared.insert( pnt->TDistribution ).second ) ){
+	++count;
+	entries += pnt->TDistribution->size();
+      }
+      if ( pnt->link ){
+	pnt->link->countDistributions( count, entries, shared );
+      }
+      pnt = pnt->next;
+    }
+  }
+
+  void InstanceBase_base::distributionInfo( unsigned long int& count,
+					    unsigned long int& bytes ){
+    // the number of distributions in the tree, and an estimate of the
+    // memory they take
+    LoadAll();
+    count = 0;
+    unsigned long int entries = 0;
+    if ( TopDistribution ){
+      ++count;
+      entries += TopDistribution->size();
+    }
+    if ( pool ){
+      count += pool->size();
+      entries += pool->entries();
+    }
+    else if ( InstBase ){
+      unordered_set<const ClassDistribution *> shared;
+      InstBase->countDistributions( count, entries, shared );
+    }
+    bytes = count * sizeof(ClassDistribution) + entries * sizeof(Vfield);
+  }
+
   TRIBL_InstanceBase *TRIBL_InstanceBase::clone() const {
     return new TRIBL_InstanceBase( Depth, ibCount,
 				   Random, PersistentDistributions );
@@ -1256,6 +2114,14 @@ namespace Timbl {
     }
     if ( !DefaultsValid ){
       InstBase->assign_defaults( Random, PersistentDistributions, Threshold );
+      if ( lazy ){
+	// this added distributions to the subtrees read already
+	for ( size_t k=0; k < lazy->subtrees.size(); ++k ){
+	  if ( lazy->subtrees[k].loaded && lazy->subtrees[k].nodes > 0 ){
+	    lazy_measure( k );
+	  }
+	}
+      }
     }
     DefAss = true;
     DefaultsValid = true;
@@ -1266,6 +2132,7 @@ namespace Timbl {
   }
 
   void IG_InstanceBase::Prune( const TargetValue *top, long depth ){
+    LoadAll();
     AssignDefaults( );
     if ( !Pruned ) {
       InstBase = InstBase->Reduce( top, ibCount, depth );
@@ -1290,7 +2157,184 @@ namespace Timbl {
     Pruned = true;
   }
 
+  unsigned long int IBtree::compact( bool persist,
+				     DistributionPool *pool,
+				     unsigned long int& dropped ){
+    // part of IG_InstanceBase::Compact(). Returns the number of nodes
+    // removed from this list and below it. With a pool, the distributions
+    // which are kept are replaced by the shared ones in it
+    unsigned long int removed = 0;
+    IBtree *pnt = this;
+    while ( pnt ){
+      if ( pnt->link ){
+	if ( pnt->link->FValue ){
+	  removed += pnt->link->compact( persist, pool, dropped );
+	}
+	else {
+	  // a tail, made when reading a leaf with a distribution. The
+	  // search stops before it, so only the distribution counts
+	  if ( pnt->link->TDistribution ){
+	    ++dropped;
+	  }
+	  delete pnt->link;
+	  pnt->link = 0;
+	  ++removed;
+	}
+      }
+      if ( pnt->TDistribution ){
+	if ( !persist ){
+	  // IG_test() only looks at persistent distributions
+	  delete pnt->TDistribution;
+	  pnt->TDistribution = 0;
+	  ++dropped;
+	}
+	else if ( pool ){
+	  pnt->TDistribution = pool->intern( pnt->TDistribution );
+	}
+      }
+      pnt = pnt->next;
+    }
+    return removed;
+  }
+
+  IBtree *IBtree::order_by_frequency(){
+    // relink every list below and including this one so the most frequent
+    // values come first, where search_node() finds them soonest.
+    // Only for trees which get no new nodes: add_feat_val() assumes that
+    // the lists are ordered on FeatureValue::before(). Returns the new
+    // head of this list
+    vector<IBtree *> nodes;
+    for ( IBtree *pnt = this; pnt; pnt = pnt->next ){
+      if ( !pnt->FValue ){
+	// not a list of values
+	return this;
+      }
+      if ( pnt->link ){
+	pnt->link = pnt->link->order_by_frequency();
+      }
+      nodes.push_back( pnt );
+    }
+    stable_sort( nodes.begin(), nodes.end(),
+		 []( const IBtree *a, const IBtree *b ){
+		   return a->FValue->ValFreq() > b->FValue->ValFreq(); } );
+    for ( size_t i=0; i+1 < nodes.size(); ++i ){
+      nodes[i]->next = nodes[i+1];
+    }
+    nodes.back()->next = 0;
+    return nodes.front();
+  }
+
+  IBtree *IBtree::order_by_rank(){
+    // relink every list below and including this one in the order
+    // add_feat_val() keeps, see FeatureValue::before(). A tree which was
+    // read may be in another order, e.g. ranked by another experiment.
+    // Returns the new head of this list
+    vector<IBtree *> nodes;
+    bool sorted = true;
+    for ( IBtree *pnt = this; pnt; pnt = pnt->next ){
+      if ( !pnt->FValue ){
+	// not a list of values
+	return this;
+      }
+      if ( pnt->link ){
+	pnt->link = pnt->link->order_by_rank();
+      }
+      if ( !nodes.empty() && !nodes.back()->FValue->before( pnt->FValue ) ){
+	sorted = false;
+      }
+      nodes.push_back( pnt );
+    }
+    if ( sorted ){
+      return this;
+    }
+    sort( nodes.begin(), nodes.end(),
+	  []( const IBtree *a, const IBtree *b ){
+	    return a->FValue->before( b->FValue ); } );
+    for ( size_t i=0; i+1 < nodes.size(); ++i ){
+      nodes[i]->next = nodes[i+1];
+    }
+    nodes.back()->next = 0;
+    return nodes.front();
+  }
+
+  void IBtree::release_distributions(){
+    // forget the distributions, which are owned by a DistributionPool
+    IBtree *pnt = this;
+    while ( pnt ){
+      pnt->TDistribution = 0;
+      if ( pnt->link ){
+	pnt->link->release_distributions();
+      }
+      pnt = pnt->next;
+    }
+  }
+
+  void IBtree::share_distributions(){
+    unordered_map<string, ClassDistribution *> seen;
+    share_distributions( seen );
+  }
+
+  void IBtree::share_distributions( unordered_map<string,
+					  ClassDistribution *>& seen ){
+    // let the leaves with equal distributions share one of them
+    IBtree *pnt = this;
+    while ( pnt ){
+      if ( pnt->link ){
+	pnt->link->share_distributions( seen );
+      }
+      else if ( !pnt->FValue && pnt->TDistribution ){
+	auto [it,fresh]
+	  = seen.emplace( DistributionPool::key( pnt->TDistribution ),
+			  pnt->TDistribution );
+	if ( !fresh && it->second != pnt->TDistribution ){
+	  ClassDistribution::release( pnt->TDistribution );
+	  pnt->TDistribution = it->second->share();
+	}
+      }
+      pnt = pnt->next;
+    }
+  }
+
+  void IBtree::unshare_distribution(){
+    // we are about to change our distribution, so make it our own
+    if ( TDistribution && TDistribution->isShared() ){
+      ClassDistribution *own = TDistribution->Replicate();
+      ClassDistribution::release( TDistribution );
+      TDistribution = own;
+    }
+  }
+
+  unsigned long int IG_InstanceBase::Compact(){
+    // free what a pruned tree keeps but IG_test() never uses: the tail
+    // nodes under leaves read from a file, and without persistent
+    // distributions, all distributions below the top. The persistent
+    // ones are shared: equal distributions become one, in a pool.
+    // Then the most frequent values are put first in every list.
+    // Classification stays the same.
+    // returns the number of distributions dropped
+    LoadAll();
+    unsigned long int dropped = 0;
+    if ( InstBase ){
+      DistributionPool *fresh = 0;
+      if ( PersistentDistributions && !pool ){
+	pool = make_shared<DistributionPool>();
+	fresh = pool.get();
+      }
+      ibCount -= InstBase->compact( PersistentDistributions, fresh, dropped );
+      if ( fresh ){
+	fresh->freeze();
+      }
+      InstBase = InstBase->order_by_frequency();
+      LastInstBasePos = InstBase;
+      while ( LastInstBasePos->next ){
+	LastInstBasePos = LastInstBasePos->next;
+      }
+    }
+    return dropped;
+  }
+
   bool InstanceBase_base::AddInstance( const Instance& Inst ){
+    LoadAll();
     bool sw_conflict = false;
     // add one instance to the IB
     IBtree *hlp;
@@ -1332,6 +2376,7 @@ namespace Timbl {
       }
       NumOfTails++;
     }
+    (*pnt)->unshare_distribution();
     int occ = Inst.Occurrences();
     if ( abs( Inst.ExemplarWeight() ) > Epsilon ){
       sw_conflict = (*pnt)->TDistribution->IncFreq( Inst.TV, occ,
@@ -1346,16 +2391,17 @@ namespace Timbl {
   }
 
   bool InstanceBase_base::MergeSub( InstanceBase_base *ib ){
+    LoadAll();
     if ( ib->InstBase ){
       // we place the InstanceBase of ib in front of the current InstanceBase
-      // the assumption is that both are sorted on ascending index, and that
-      // the indices in ib are all smaller then those in the current IB
+      // the assumption is that both are sorted like add_feat_val() does,
+      // and that the values in ib all come before those in the current IB
       if ( !InstBase ){
 	InstBase = ib->InstBase;
       }
       else {
 	IBtree *ibPnt = ib->InstBase;
-	if ( ib->LastInstBasePos->FValue->Index() >= InstBase->FValue->Index() ){
+	if ( !ib->LastInstBasePos->FValue->before( InstBase->FValue ) ){
 	  Error( "MergeSub assumes sorted ans unique additions!" );
 	  return false;
 	}
@@ -1389,7 +2435,7 @@ namespace Timbl {
   void IBtree::cleanDistributions() {
     IBtree *pnt = this;
     while ( pnt ){
-      delete pnt->TDistribution;
+      ClassDistribution::release( pnt->TDistribution );
       pnt->TDistribution = 0;
       if ( pnt->link ){
 	pnt->link->cleanDistributions();
@@ -1399,6 +2445,7 @@ namespace Timbl {
   }
 
   bool IG_InstanceBase::MergeSub( InstanceBase_base *ib ){
+    LoadAll();
     if ( ib->InstBase ){
       if ( !PersistentDistributions ){
 	ib->InstBase->cleanDistributions();
@@ -1477,12 +2524,14 @@ namespace Timbl {
   }
 
   void InstanceBase_base::RemoveInstance( const Instance& Inst ){
+    LoadAll();
     for ( int occ=0; occ < Inst.Occurrences(); ++occ ){
       // remove an instance from the IB
       int pos = 0;
       IBtree *pnt = InstBase;
       while ( pnt ){
 	if ( pnt->link == NULL ){
+	  pnt->unshare_distribution();
 	  pnt->TDistribution->DecFreq(Inst.TV);
 	  TopDistribution->DecFreq(Inst.TV);
 	  break;
@@ -1712,6 +2761,9 @@ namespace Timbl {
     int pos = 0;
     leaf = false;
     const IBtree *pnt = fast_search_node( Inst.FV[pos] );
+    // a subtree read just now may know values which were unknown when
+    // Inst was made
+    bool fresh = ( pnt && lazy && lazy->active() && lazy_load( pnt->FValue ) );
     while ( pnt ){
       result = pnt->TValue;
       if ( PersistentDistributions ){
@@ -1724,7 +2776,12 @@ namespace Timbl {
       leaf = (pnt == NULL);
       ++pos;
       if ( pnt ){
-	pnt = pnt->search_node( Inst.FV[pos] );
+	if ( fresh ){
+	  pnt = pnt->search_node( lazy_value( Inst.FV[pos], pos ) );
+	}
+	else {
+	  pnt = pnt->search_node( Inst.FV[pos] );
+	}
       }
     }
     end_level = pos;
@@ -1837,6 +2894,10 @@ namespace Timbl {
 	pnt = pnt->next;
       }
     }
+    if ( last_match == InstBase && isLazy() ){
+      // no match at the top, so IB1 runs over the whole tree
+      LoadAll();
+    }
     if ( last_match ){
       subtree = IBPartition( last_match );
       level = pos;
@@ -35,6 +35,7 @@
 #include "timbl/IBtree.h"
 #include "timbl/Instance.h"
 #include "timbl/TimblExperiment.h"
+#include "timbl/ModelBundle.h"
 #include "ticcutils/Timer.h"
 #include "ticcutils/PrettyPrint.h"
 
@@ -140,20 +141,16 @@ namespace Timbl {
 	  //	cerr << "MAJORITY CLASS = " << TopTarget << endl;
 	  // Open the file.
 	  //
-	  ifstream datafile( CurrentDataFile, ios::in);
+	  InputStream datafile( CurrentDataFile );
 	  //
 	  for ( const auto& fit : fmIndex ){
 	    for ( const auto& sit : fit.second ){
-	      datafile.clear();
-	      datafile.seekg( sit );
-	      nextLine( datafile, Buffer );
-	      chopLine( Buffer );
+	      indexedInstance( sit, datafile, Buffer );
 	      // Progress update.
 	      //
 	      if ( ( stats.dataLines() % Progress() ) == 0 ){
 		time_stamp( "Learning:  ", stats.dataLines() );
 	      }
-	      chopped_to_instance( TrainWords );
 	      if ( !outInstanceBase ){
 		outInstanceBase = new IG_InstanceBase( EffectiveFeatures(),
 						       ibCount,
@@ -198,7 +195,7 @@ namespace Timbl {
 	  //	cerr << "MAJORITY CLASS = " << TopTarget << endl;
 	  // Open the file.
 	  //
-	  ifstream datafile( CurrentDataFile, ios::in);
+	  InputStream datafile( CurrentDataFile );
 	  //
 	  for ( const auto& dit : fmIndex ){
 	    //	    FeatureValue *the_fv = dit.first;
@@ -217,16 +214,12 @@ namespace Timbl {
 						     true );
 	      for ( const auto& fit : dit.second ) {
 		for ( const auto& sit : fit.second ){
-		  datafile.clear();
-		  datafile.seekg( sit );
-		  nextLine( datafile, Buffer );
-		  chopLine( Buffer );
+		  indexedInstance( sit, datafile, Buffer );
 		  // Progress update.
 		  //
 		  if ( ( stats.dataLines() % Progress() ) == 0 ){
 		    time_stamp( "Learning:  ", stats.dataLines() );
 		  }
-		  chopped_to_instance( TrainWords );
 		  if ( !PartInstanceBase ){
 		    PartInstanceBase = new IG_InstanceBase( EffectiveFeatures(),
 							    ibCount,
@@ -273,16 +266,12 @@ namespace Timbl {
 	      //	    cerr << "other case!" << endl;
 	      for ( const auto& fit : dit.second ){
 		for ( const auto& sit : fit.second ){
-		  datafile.clear();
-		  datafile.seekg( sit );
-		  nextLine( datafile, Buffer );
-		  chopLine( Buffer );
+		  indexedInstance( sit, datafile, Buffer );
 		  // Progress update.
 		  //
 		  if ( ( stats.dataLines() % Progress() ) == 0 ){
 		    time_stamp( "Learning:  ", stats.dataLines() );
 		  }
-		  chopped_to_instance( TrainWords );
 		  if ( !outInstanceBase ){
 		    outInstanceBase = new IG_InstanceBase( EffectiveFeatures(),
 							   ibCount,
@@ -314,6 +303,7 @@ namespace Timbl {
 	  }
 	}
       }
+      releaseStore();
       if ( !Verbosity(SILENT) ){
 	time_stamp( "Finished:  ", stats.dataLines() );
       }
@@ -432,7 +422,8 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  Info( "Writing Instance-Base in: " + FileName );
 	}
-	if ( PutInstanceBase( outfile ) ){
+	if ( PutInstanceBase( outfile, Clones() > 1 ) ){
+	  writeTreeIndex( FileName, outfile.tellp() );
 	  string tmp = FileName;
 	  tmp += ".wgt";
 	  ofstream wf( tmp );
@@ -478,6 +469,8 @@ namespace Timbl {
 					    (RandomSeed()>=0),
 					    Pruned,
 					    KeepDistributions() );
+	InstanceBase->setLoadIndex( treeIndex, Clones() );
+	setLazyLoad();
 	int pos=0;
 	for ( size_t i=0; i < NumOfFeatures(); ++i ){
 	  features[i]->SetWeight( 1.0 );
@@ -519,6 +512,9 @@ namespace Timbl {
   }
 
   bool IG_Experiment::ReadInstanceBase( const string& FileName ){
+    if ( BundleReader::detect( FileName ) ){
+      return ReadBundle( FileName );
+    }
     bool result = false;
     if ( ConfirmOptions() ){
       ifstream infile( FileName, ios::in );
@@ -529,9 +525,12 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  Info( "Reading Instance-Base from: " + FileName );
 	}
-	if ( GetInstanceBase( infile ) ){
+	readTreeIndex( FileName, infile );
+	bool got = GetInstanceBase( infile );
+	treeIndex.clear();
+	if ( got ){
 	  if ( !Verbosity(SILENT) ){
-	    writePermutation( cout );
+	    writePermutation( *mylog );
 	  }
 	  string tmp = FileName;
 	  tmp += ".wgt";
@@ -0,0 +1,562 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "config.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "timbl/InputStream.h"
+
+using namespace std;
+
+namespace Timbl {
+
+  const size_t in_size = 256*1024;     // compressed bytes per read
+  const size_t block_size = 1024*1024; // decoded bytes per block
+  const size_t max_blocks = 4;         // blocks waiting for the reader
+
+  class zipBuffer: public streambuf {
+    // a streambuf which is filled with decoded blocks by a decoder thread
+  public:
+    zipBuffer( FILE *, Compression );
+    zipBuffer( const zipBuffer& ) = delete;
+    zipBuffer& operator=( const zipBuffer& ) = delete;
+    ~zipBuffer() override;
+    string error() const;
+  protected:
+    int_type underflow() override;
+    pos_type seekoff( off_type, ios_base::seekdir,
+		      ios_base::openmode ) override;
+    pos_type seekpos( pos_type, ios_base::openmode ) override;
+  private:
+    void decode();
+    bool flush( vector<char>&, size_t );
+    void gzip_decode();
+    void xz_decode();
+    void zstd_decode();
+    FILE *file;
+    Compression type;
+    mutable mutex lock;
+    condition_variable cv;
+    deque<vector<char>> ready;
+    vector<char> current;
+    streamsize consumed;  // the size of the blocks before current
+    bool finished;        // set by the decoder when it is done
+    bool stopping;        // set when the reader has gone
+    string message;
+    thread decoder;
+  };
+
+  zipBuffer::zipBuffer( FILE *f, Compression c ):
+    file( f ),
+    type( c ),
+    consumed( 0 ),
+    finished( false ),
+    stopping( false )
+  {
+    setg( 0, 0, 0 );
+    decoder = thread( &zipBuffer::decode, this );
+  }
+
+  zipBuffer::~zipBuffer(){
+    {
+      lock_guard<mutex> lk( lock );
+      stopping = true;
+    }
+    cv.notify_all();
+    decoder.join();
+    fclose( file );
+  }
+
+  string zipBuffer::error() const {
+    lock_guard<mutex> lk( lock );
+    return message;
+  }
+
+  bool zipBuffer::flush( vector<char>& out, size_t used ){
+    // hand the 'used' part of out to the reader and give out a fresh block
+    // returns false when the reader has gone
+    out.resize( used );
+    unique_lock<mutex> lk( lock );
+    cv.wait( lk, [this]{ return stopping || ready.size() < max_blocks; } );
+    if ( stopping ){
+      return false;
+    }
+    if ( used > 0 ){
+      ready.push_back( std::move( out ) );
+      cv.notify_all();
+    }
+    out.assign( block_size, 0 );
+    return true;
+  }
+
+  void zipBuffer::decode(){
+    // the decoder thread
+    switch ( type ){
+    case GzipCompression:
+      gzip_decode();
+      break;
+    case XzCompression:
+      xz_decode();
+      break;
+    case ZstdCompression:
+      zstd_decode();
+      break;
+    default:
+      break;
+    }
+    lock_guard<mutex> lk( lock );
+    finished = true;
+    cv.notify_all();
+  }
+
+  void zipBuffer::gzip_decode(){
+#ifdef HAVE_ZLIB
+    z_stream zs;
+    memset( &zs, 0, sizeof(zs) );
+    if ( inflateInit2( &zs, 15+32 ) != Z_OK ){
+      lock_guard<mutex> lk( lock );
+      message = "unable to initialize the gzip decoder";
+      return;
+    }
+    vector<char> in( in_size );
+    vector<char> out( block_size );
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    int ret = Z_OK;
+    bool full = false; // the last call filled the output, there may be more
+    string error;
+    while ( true ){
+      if ( zs.avail_in == 0 && !full ){
+	size_t len = fread( in.data(), 1, in.size(), file );
+	if ( len == 0 ){
+	  if ( ret != Z_STREAM_END ){
+	    error = "unexpected end of the gzip data";
+	  }
+	  break;
+	}
+	zs.next_in = reinterpret_cast<Bytef*>(in.data());
+	zs.avail_in = len;
+      }
+      ret = inflate( &zs, Z_NO_FLUSH );
+      if ( ret == Z_STREAM_END ){
+	// there may be more gzip members in the file
+	inflateReset( &zs );
+      }
+      else if ( ret != Z_OK && ret != Z_BUF_ERROR ){
+	error = ( zs.msg ? zs.msg : "corrupt gzip data" );
+	break;
+      }
+      full = ( zs.avail_out == 0 );
+      if ( full ){
+	if ( !flush( out, out.size() ) ){
+	  break;
+	}
+	zs.next_out = reinterpret_cast<Bytef*>(out.data());
+	zs.avail_out = out.size();
+      }
+    }
+    flush( out, out.size() - zs.avail_out );
+    inflateEnd( &zs );
+    if ( !error.empty() ){
+      lock_guard<mutex> lk( lock );
+      message = error;
+    }
+#endif
+  }
+
+  void zipBuffer::xz_decode(){
+#ifdef HAVE_LZMA
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if ( lzma_stream_decoder( &strm, UINT64_MAX,
+			      LZMA_CONCATENATED ) != LZMA_OK ){
+      lock_guard<mutex> lk( lock );
+      message = "unable to initialize the xz decoder";
+      return;
+    }
+    vector<char> in( in_size );
+    vector<char> out( block_size );
+    strm.next_out = reinterpret_cast<uint8_t*>(out.data());
+    strm.avail_out = out.size();
+    lzma_action action = LZMA_RUN;
+    bool full = false;
+    string error;
+    while ( true ){
+      if ( strm.avail_in == 0 && !full && action == LZMA_RUN ){
+	size_t len = fread( in.data(), 1, in.size(), file );
+	if ( len == 0 ){
+	  action = LZMA_FINISH;
+	}
+	strm.next_in = reinterpret_cast<uint8_t*>(in.data());
+	strm.avail_in = len;
+      }
+      lzma_ret ret = lzma_code( &strm, action );
+      if ( ret == LZMA_STREAM_END ){
+	break;
+      }
+      else if ( ret != LZMA_OK ){
+	error = ( ret == LZMA_BUF_ERROR ? "unexpected end of the xz data"
+		  : "corrupt xz data" );
+	break;
+      }
+      full = ( strm.avail_out == 0 );
+      if ( full ){
+	if ( !flush( out, out.size() ) ){
+	  break;
+	}
+	strm.next_out = reinterpret_cast<uint8_t*>(out.data());
+	strm.avail_out = out.size();
+      }
+    }
+    flush( out, out.size() - strm.avail_out );
+    lzma_end( &strm );
+    if ( !error.empty() ){
+      lock_guard<mutex> lk( lock );
+      message = error;
+    }
+#endif
+  }
+
+  void zipBuffer::zstd_decode(){
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *ds = ZSTD_createDStream();
+    if ( !ds || ZSTD_isError( ZSTD_initDStream( ds ) ) ){
+      ZSTD_freeDStream( ds );
+      lock_guard<mutex> lk( lock );
+      message = "unable to initialize the zstd decoder";
+      return;
+    }
+    vector<char> in( in_size );
+    vector<char> out( block_size );
+    ZSTD_inBuffer ib = { in.data(), 0, 0 };
+    ZSTD_outBuffer ob = { out.data(), out.size(), 0 };
+    size_t ret = 0;
+    bool full = false;
+    string error;
+    while ( true ){
+      if ( ib.pos == ib.size && !full ){
+	size_t len = fread( in.data(), 1, in.size(), file );
+	if ( len == 0 ){
+	  if ( ret != 0 ){
+	    error = "unexpected end of the zstd data";
+	  }
+	  break;
+	}
+	ib.size = len;
+	ib.pos = 0;
+      }
+      ret = ZSTD_decompressStream( ds, &ob, &ib );
+      if ( ZSTD_isError( ret ) ){
+	error = ZSTD_getErrorName( ret );
+	break;
+      }
+      full = ( ob.pos == ob.size );
+      if ( full ){
+	if ( !flush( out, out.size() ) ){
+	  break;
+	}
+	ob.dst = out.data();
+	ob.pos = 0;
+      }
+    }
+    flush( out, ob.pos );
+    ZSTD_freeDStream( ds );
+    if ( !error.empty() ){
+      lock_guard<mutex> lk( lock );
+      message = error;
+    }
+#endif
+  }
+
+  zipBuffer::int_type zipBuffer::underflow(){
+    if ( gptr() < egptr() ){
+      return traits_type::to_int_type( *gptr() );
+    }
+    consumed += current.size();
+    current.clear();
+    unique_lock<mutex> lk( lock );
+    cv.wait( lk, [this]{ return !ready.empty() || finished; } );
+    if ( ready.empty() ){
+      setg( 0, 0, 0 );
+      if ( !message.empty() ){
+	// the istream turns this into badbit
+	throw runtime_error( message );
+      }
+      return traits_type::eof();
+    }
+    current = std::move( ready.front() );
+    ready.pop_front();
+    cv.notify_all();
+    setg( current.data(), current.data(), current.data() + current.size() );
+    return traits_type::to_int_type( *gptr() );
+  }
+
+  zipBuffer::pos_type zipBuffer::seekoff( off_type off,
+					  ios_base::seekdir dir,
+					  ios_base::openmode ){
+    // we can only tell where we are
+    if ( off == 0 && dir == ios_base::cur ){
+      return pos_type( consumed + ( gptr() - eback() ) );
+    }
+    return pos_type( off_type(-1) );
+  }
+
+  zipBuffer::pos_type zipBuffer::seekpos( pos_type pos,
+					  ios_base::openmode which ){
+    pos_type here = seekoff( 0, ios_base::cur, which );
+    if ( pos == here ){
+      return here;
+    }
+    return pos_type( off_type(-1) );
+  }
+
+  class prefixBuffer: public streambuf {
+    // a streambuf which first delivers some text that was already read
+    // from another streambuf, and then continues with that one
+  public:
+    prefixBuffer( const string& s, streambuf *sb ):
+      text( s ),
+      next( sb ),
+      block( in_size )
+    {
+      setg( text.data(), text.data(), text.data() + text.size() );
+    }
+  protected:
+    int_type underflow() override {
+      // copy what next has available, without waiting for more
+      if ( traits_type::eq_int_type( next->sgetc(), traits_type::eof() ) ){
+	return traits_type::eof();
+      }
+      streamsize len = min<streamsize>( next->in_avail(), block.size() );
+      len = next->sgetn( block.data(), max<streamsize>( len, 1 ) );
+      setg( block.data(), block.data(), block.data() + len );
+      return traits_type::to_int_type( *gptr() );
+    }
+    streamsize showmanyc() override {
+      return next->in_avail();
+    }
+  private:
+    string text;
+    streambuf *next;
+    vector<char> block;
+  };
+
+  InputStream::InputStream():
+    istream( 0 ),
+    zipped( 0 ),
+    prefix( 0 ),
+    type( NoCompression ),
+    pipe( false )
+  {
+    setstate( ios::badbit );
+  }
+
+  InputStream::InputStream( const string& name ):
+    InputStream()
+  {
+    open( name );
+  }
+
+  InputStream::~InputStream(){
+    close();
+  }
+
+  static string system_name( const string& name ){
+    return ( name == "-" ) ? "/dev/stdin" : name;
+  }
+
+  static bool is_regular( const string& name ){
+    struct stat st;
+    return stat( system_name( name ).c_str(), &st ) == 0
+      && S_ISREG( st.st_mode );
+  }
+
+  Compression InputStream::detect( const string& name ){
+    // look at the magic bytes. But not of a pipe: we can't put them back
+    Compression result = NoCompression;
+    if ( !is_regular( name ) ){
+      return result;
+    }
+    FILE *f = fopen( system_name( name ).c_str(), "rb" );
+    if ( f ){
+      unsigned char magic[6];
+      size_t len = fread( magic, 1, 6, f );
+      fclose( f );
+      if ( len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b ){
+	result = GzipCompression;
+      }
+      else if ( len == 6 && memcmp( magic, "\xFD" "7zXZ\0", 6 ) == 0 ){
+	result = XzCompression;
+      }
+      else if ( len >= 4 && memcmp( magic, "\x28\xB5\x2F\xFD", 4 ) == 0 ){
+	result = ZstdCompression;
+      }
+    }
+    return result;
+  }
+
+  bool InputStream::supported( Compression c ){
+    switch ( c ){
+    case NoCompression:
+      return true;
+    case GzipCompression:
+#ifdef HAVE_ZLIB
+      return true;
+#else
+      return false;
+#endif
+    case XzCompression:
+#ifdef HAVE_LZMA
+      return true;
+#else
+      return false;
+#endif
+    case ZstdCompression:
+#ifdef HAVE_ZSTD
+      return true;
+#else
+      return false;
+#endif
+    }
+    return false;
+  }
+
+  bool InputStream::open( const string& file_name ){
+    close();
+    message.clear();
+    type = detect( file_name );
+    pipe = !is_regular( file_name );
+    if ( type == NoCompression ){
+      plain.open( system_name( file_name ), ios::in );
+      rdbuf( &plain );
+      if ( !plain.is_open() ){
+	setstate( ios::failbit );
+      }
+    }
+    else if ( !supported( type ) ){
+      message = "this version of timbl can't read " + name( type )
+	+ " compressed files like: " + file_name;
+      setstate( ios::failbit );
+    }
+    else {
+      FILE *f = fopen( system_name( file_name ).c_str(), "rb" );
+      if ( f ){
+	zipped = new zipBuffer( f, type );
+	rdbuf( zipped );
+      }
+      else {
+	setstate( ios::failbit );
+      }
+    }
+    return good();
+  }
+
+  void InputStream::unread( const string& text ){
+    // the next read starts with text, and then goes on where we are now
+    if ( text.empty() ){
+      return;
+    }
+    if ( prefix ){
+      // can't stack them, so we take the remainder of the old one too
+      string rest;
+      while ( prefix->in_avail() > 0 ){
+	char buf[4096];
+	streamsize len = prefix->sgetn( buf,
+					min<streamsize>( prefix->in_avail(),
+							 sizeof(buf) ) );
+	rest.append( buf, len );
+      }
+      prefixBuffer *old = prefix;
+      streambuf *below = ( zipped
+			   ? static_cast<streambuf*>(zipped)
+			   : static_cast<streambuf*>(&plain) );
+      prefix = new prefixBuffer( text + rest, below );
+      rdbuf( prefix );
+      delete old;
+    }
+    else {
+      prefix = new prefixBuffer( text, rdbuf() );
+      rdbuf( prefix );
+    }
+  }
+
+  void InputStream::close(){
+    rdbuf( 0 );
+    delete prefix;
+    prefix = 0;
+    delete zipped;
+    zipped = 0;
+    if ( plain.is_open() ){
+      plain.close();
+    }
+    type = NoCompression;
+    pipe = false;
+  }
+
+  bool InputStream::is_open() const {
+    return zipped || plain.is_open();
+  }
+
+  string InputStream::error() const {
+    if ( zipped ){
+      return zipped->error();
+    }
+    return message;
+  }
+
+  string InputStream::name( Compression c ){
+    switch ( c ){
+    case GzipCompression:
+      return "gzip";
+    case XzCompression:
+      return "xz";
+    case ZstdCompression:
+      return "zstd";
+    default:
+      return "uncompressed";
+    }
+  }
+
+}
@@ -46,14 +46,11 @@ namespace Timbl {
   }
 
   void Instance::clear(){
+    // unknown FeatureValues belong to the UnknownValues that made them
     for ( auto& it : FV ){
-      if ( it ){
-	if ( it->isUnknown() ){
-	  delete it;
-	}
-      }
       it = 0;
     }
+    Active.clear();
     TV = 0;
     sample_weight = 0.0;
     occ = 1;
@@ -77,6 +74,9 @@ namespace Timbl {
     for ( const auto* it : I.FV ){
       os << it << ", ";
     }
+    for ( const auto& [pos,fv] : I.Active ){
+      os << "(" << pos+1 << "," << fv << ") ";
+    }
     os << I.TV << " " << I.sample_weight;
     return os;
   }
@@ -0,0 +1,205 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include "timbl/Types.h"
+#include "timbl/Instance.h"
+#include "timbl/InstanceStore.h"
+
+using namespace std;
+
+namespace Timbl {
+
+  InstanceStore::InstanceStore( size_t nf, bool w, size_t limit ):
+    num_feats( nf ),
+    weighted( w ),
+    max_mem_rows( 0 ),
+    rows( 0 ),
+    mem_rows( 0 ),
+    with_occurrences( false ),
+    spill( 0 ),
+    dirty( false ),
+    cached_row( 0 )
+  {
+    size_t row_size = ( num_feats + 1 ) * sizeof(void*);
+    if ( weighted ){
+      row_size += sizeof(double);
+    }
+    max_mem_rows = limit / row_size;
+    columns.resize( num_feats );
+    record_size = ( num_feats + 1 ) * sizeof(void*)
+      + sizeof(int) + sizeof(double);
+    record.resize( record_size );
+  }
+
+  InstanceStore::~InstanceStore(){
+    if ( spill ){
+      fclose( spill );
+    }
+  }
+
+  bool InstanceStore::add( const Instance& inst ){
+    // inst must be chopped in the LearnWords phase, so with the
+    // FeatureValues in file order
+    if ( mem_rows < max_mem_rows ){
+      for ( size_t i=0; i < num_feats; ++i ){
+	columns[i].push_back( inst.FV[i] );
+      }
+      targets.push_back( inst.TV );
+      if ( inst.Occurrences() != 1 && !with_occurrences ){
+	// from now on, we need to remember them
+	occurrences.resize( mem_rows, 1 );
+	with_occurrences = true;
+      }
+      if ( with_occurrences ){
+	occurrences.push_back( inst.Occurrences() );
+      }
+      if ( weighted ){
+	weights.push_back( inst.ExemplarWeight() );
+      }
+      ++mem_rows;
+    }
+    else {
+      if ( !spill ){
+	spill = tmpfile();
+	if ( !spill ){
+	  return false;
+	}
+      }
+      unsigned char *pnt = record.data();
+      memcpy( pnt, inst.FV.data(), num_feats * sizeof(void*) );
+      pnt += num_feats * sizeof(void*);
+      memcpy( pnt, &inst.TV, sizeof(void*) );
+      pnt += sizeof(void*);
+      int occ = inst.Occurrences();
+      memcpy( pnt, &occ, sizeof(int) );
+      pnt += sizeof(int);
+      double exw = inst.ExemplarWeight();
+      memcpy( pnt, &exw, sizeof(double) );
+      if ( fwrite( record.data(), record_size, 1, spill ) != 1 ){
+	return false;
+      }
+      dirty = true;
+      cached_row = 0; // the record buffer is overwritten
+    }
+    ++rows;
+    return true;
+  }
+
+  bool InstanceStore::flush(){
+    // write out the buffered rows of the spill file
+    if ( dirty ){
+      if ( fflush( spill ) != 0 ){
+	return false;
+      }
+      dirty = false;
+    }
+    return true;
+  }
+
+  bool InstanceStore::read_record( size_t row ){
+    // read a spilled row into the record buffer
+    // consecutive requests for the same row are served from the buffer.
+    // we use pread() because forked shards share the file offset
+    if ( cached_row == row + 1 ){
+      return true;
+    }
+    if ( !flush() ){
+      return false;
+    }
+    off_t pos = ( row - mem_rows ) * record_size;
+    if ( pread( fileno( spill ), record.data(), record_size, pos )
+	 != static_cast<ssize_t>(record_size) ){
+      cached_row = 0;
+      return false;
+    }
+    cached_row = row + 1;
+    return true;
+  }
+
+  FeatureValue *InstanceStore::value( size_t row, size_t feat ){
+    if ( row < mem_rows ){
+      return columns[feat][row];
+    }
+    else if ( row < rows && read_record( row ) ){
+      FeatureValue *result;
+      memcpy( &result, record.data() + feat * sizeof(void*), sizeof(void*) );
+      return result;
+    }
+    return 0;
+  }
+
+  bool InstanceStore::fetch( size_t row,
+			     Instance& inst,
+			     const vector<size_t>& permutation,
+			     size_t effective ){
+    // fill inst like MBLClass::chopped_to_instance( TrainWords ) does
+    inst.clear();
+    if ( row < mem_rows ){
+      for ( size_t k=0; k < effective; ++k ){
+	inst.FV[k] = columns[permutation[k]][row];
+      }
+      inst.TV = targets[row];
+      if ( with_occurrences && occurrences[row] > 1 ){
+	inst.Occurrences( occurrences[row] );
+      }
+      if ( weighted ){
+	inst.ExemplarWeight( weights[row] );
+      }
+    }
+    else if ( row < rows && read_record( row ) ){
+      const unsigned char *pnt = record.data();
+      for ( size_t k=0; k < effective; ++k ){
+	memcpy( &inst.FV[k], pnt + permutation[k] * sizeof(void*),
+		sizeof(void*) );
+      }
+      pnt += num_feats * sizeof(void*);
+      memcpy( &inst.TV, pnt, sizeof(void*) );
+      pnt += sizeof(void*);
+      int occ;
+      memcpy( &occ, pnt, sizeof(int) );
+      pnt += sizeof(int);
+      if ( occ > 1 ){
+	inst.Occurrences( occ );
+      }
+      if ( weighted ){
+	double exw;
+	memcpy( &exw, pnt, sizeof(double) );
+	inst.ExemplarWeight( exw );
+      }
+    }
+    else {
+      return false;
+    }
+    return true;
+  }
+
+}
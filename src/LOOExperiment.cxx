@@ -123,12 +123,12 @@ namespace Timbl {
       time(&lStartTime);
       timeval startTime;
       gettimeofday( &startTime, 0 );
-      if ( InputFormat() == ARFF ){
+      if ( InputFormat() == ARFF && !binaryTest ){
 	skipARFFHeader( testStream );
       }
       UnicodeString Buffer;
-      while ( nextLine( testStream, Buffer ) ){
-	if ( !chopLine( Buffer ) ){
+      while ( nextTestLine( Buffer ) ){
+	if ( !chopTestLine( Buffer ) ){
 	  Warning( "testfile, skipped line #" +
 		   TiCC::toString<int>( stats.totalLines() ) +
 		   "\n" + TiCC::UnicodeToUTF8(Buffer) );
@@ -142,7 +142,10 @@ namespace Timbl {
 							   final_distance,
 							   exact );
 	  normalizeResult();
-	  string dString = bestResult.getResult();
+	  string dString;
+	  if ( Verbosity(DISTRIB) ){
+	    dString = bestResult.getResult();
+	  }
 	  double confi = 0;
 	  if ( Verbosity(CONFIDENCE) ){
 	    confi = confidence();
@@ -150,6 +153,7 @@ namespace Timbl {
 	  // Write it to the output file for later analysis.
 	  show_results( outStream, confi, dString,
 			ResultTarget, final_distance );
+	  resultsWritten();
 	  if ( exact ){ // remember that a perfect match may be incorrect!
 	    if ( Verbosity(EXACT) ){
 	      *mylog << "Exacte match:\n" << get_org_input() << endl;
@@ -162,6 +166,7 @@ namespace Timbl {
 	  Increment( CurrInst );
 	}
       }// end while.
+      outStream.flush();
       if ( !Verbosity(SILENT) ){
 	time_stamp( "Ready:  ", stats.dataLines() );
 	show_speed_summary( *mylog, startTime );
@@ -26,6 +26,7 @@
 */
 
 #include <vector>
+#include <map>
 #include <set>
 #include <fstream>
 #include <sstream>
@@ -35,6 +36,8 @@
 #include <typeinfo>
 
 #include <cassert>
+#include <ctime>
+#include <mutex>
 
 #include "ticcutils/StringOps.h"
 #include "ticcutils/PrettyPrint.h"
@@ -47,12 +50,16 @@
 #include "timbl/Options.h"
 #include "timbl/Instance.h"
 #include "timbl/IBtree.h"
+#include "timbl/SparseBase.h"
 #include "timbl/BestArray.h"
 #include "timbl/Testers.h"
 #include "timbl/Metrics.h"
 #include "timbl/Choppers.h"
 
 #include "timbl/MBLClass.h"
+#include "timbl/InputStream.h"
+#include "timbl/BinaryInstances.h"
+#include "timbl/BinaryTables.h"
 
 using namespace std;
 using namespace icu;
@@ -217,6 +224,7 @@ namespace Timbl {
     tableFilled(false),
     globalMetricOption(Overlap),
     do_diversify(false),
+    sparse_search(false),
     ChopInput(0),
     F_length(0),
     MaxFeatures(0),
@@ -240,7 +248,9 @@ namespace Timbl {
     keep_distributions(false),
     DBEntropy(-1.0),
     tester(0),
-    doOcc(0)
+    sparse_tester(0),
+    doOcc(0),
+    chop_count(0)
   {
   }
 
@@ -287,7 +297,11 @@ namespace Timbl {
       do_sloppy_loo      = m.do_sloppy_loo;
       do_silly_testing   = m.do_silly_testing;
       do_diversify       = m.do_diversify;
+      sparse_search      = m.sparse_search;
+      sparse_positions   = m.sparse_positions;
+      no_defaults        = m.no_defaults;
       tester = 0;
+      sparse_tester = 0;
       decay = 0;
       targets  = m.targets;
       features = m.features;
@@ -297,7 +311,7 @@ namespace Timbl {
       DBEntropy = -1.0;
       ChopInput = 0;
       setInputFormat( m.input_format );
-      CurrInst.Init( NumOfFeatures() );
+      CurrInst.Init( sparse_search ? 0 : NumOfFeatures() );
       myerr = m.myerr;
       mylog = m.mylog;
     }
@@ -323,27 +337,48 @@ namespace Timbl {
     }
     delete GlobalMetric;
     delete tester;
+    delete sparse_tester;
     delete decay;
     delete ChopInput;
   }
 
 
+  // serializes the log output of all experiments and their threads,
+  // including the progressReporter threads
+  static mutex log_lock;
+
+  void MBLClass::write_log( ostream& os, const string& text ) const {
+    // write an already formatted text in one go
+    lock_guard<mutex> guard( log_lock );
+    os << text << flush;
+  }
+
+  string MBLClass::time_string( time_t t ){
+    // like TiCC::Timer::now(), but without ctime's static buffer
+    char buf[32];
+    if ( !ctime_r( &t, buf ) ){
+      return "";
+    }
+    string result = buf;
+    if ( !result.empty() && result.back() == '\n' ){
+      result.pop_back();
+    }
+    return result;
+  }
+
   void MBLClass::Info( const string& out_line ) const {
-#pragma omp critical
-    {
-      // Info NEVER to socket !
-      if ( exp_name != "" ){
-	*mylog << "-" << exp_name << "-" << out_line << endl;
-      }
-      else {
-	*mylog << out_line << endl;
-      }
+    // Info NEVER to socket !
+    if ( exp_name != "" ){
+      write_log( *mylog, "-" + exp_name + "-" + out_line + "\n" );
+    }
+    else {
+      write_log( *mylog, out_line + "\n" );
     }
   }
 
   void MBLClass::Warning( const string& out_line ) const {
-#pragma omp critical
     {
+      lock_guard<mutex> guard( log_lock );
       if ( sock_os ){
 	if ( sock_is_json ){
 	  json out_json;
@@ -481,6 +516,66 @@ namespace Timbl {
     return result;
   }
 
+  json MBLClass::metrics_to_JSON() const {
+    // the per feature metrics which differ from the global one.
+    // settings_to_JSON() can't represent them
+    json result = json::object();
+    for ( size_t i=0; i < UserOptions.size(); ++i ){
+      if ( UserOptions[i] != globalMetricOption ){
+	result[TiCC::toString(i)] = TiCC::toString( UserOptions[i] );
+      }
+    }
+    return result;
+  }
+
+  bool MBLClass::restore_settings( const json& settings,
+				   const json& metrics ){
+    // take over the settings and metrics stored by settings_to_JSON()
+    // and metrics_to_JSON(), where they differ from ours. Settings which
+    // only concern the output or the input files are left alone
+    static const set<string> keep = { "VERBOSITY", "PROGRESS",
+				      "INPUTFORMAT" };
+    json ours = settings_to_JSON();
+    map<string,string> current;
+    for ( const auto& element : ours["settings"] ){
+      for ( const auto& it : element.items() ){
+	current[it.key()] = it.value().get<string>();
+      }
+    }
+    for ( const auto& element : settings ){
+      for ( const auto& it : element.items() ){
+	const string& tag = it.key();
+	string val = it.value().get<string>();
+	if ( keep.find( tag ) == keep.end()
+	     && current[tag] != val
+	     && !SetOption( tag + ": " + val ) ){
+	  return false;
+	}
+      }
+    }
+    for ( const auto& it : metrics.items() ){
+      size_t index;
+      if ( !TiCC::stringTo( it.key(), index )
+	   || index >= UserOptions.size() ){
+	Error( "cannot set a metric for feature " + it.key()
+	       + ", the maximum is " + TiCC::toString( MaxFeatures ) );
+	return false;
+      }
+    }
+    for ( size_t i=0; i < UserOptions.size(); ++i ){
+      string wanted = TiCC::toString( globalMetricOption );
+      string key = TiCC::toString( i );
+      if ( metrics.contains( key ) ){
+	wanted = metrics[key].get<string>();
+      }
+      if ( TiCC::toString( UserOptions[i] ) != wanted
+	   && !SetOption( "METRICS: " + key + "=" + wanted ) ){
+	return false;
+      }
+    }
+    return true;
+  }
+
   bool MBLClass::ShowWeights( ostream &os ) const {
     if ( ExpInvalid() ){
       return false;
@@ -602,7 +697,7 @@ namespace Timbl {
       else {
 	ostr << "        ";
       }
-      ostr << TiCC::Timer::now();
+      ostr << time_string( time(0) );
       Info( ostr.str() );
     }
   }
@@ -973,6 +1068,183 @@ namespace Timbl {
     }
   }
 
+  // status of a feature in a binary arrays table
+  enum ArrayStatus { Matrix_array=0, Ignored_array=1, Numeric_array=2 };
+
+  bool MBLClass::writeMatrices( BinaryTableWriter& os ) const {
+    os.put_u32( features.feats.size() );
+    for ( const auto& feat : features.feats ){
+      bool dummy;
+      if ( !feat->matrixPresent( dummy ) ){
+	os.put_u32( 0 );
+      }
+      else {
+	os.put_u32( 1 );
+	size_t section = os.start_section();
+	feat->write_matrix( os );
+	os.end_section( section );
+      }
+    }
+    return true;
+  }
+
+  bool MBLClass::readMatrices( BinaryTableReader& is ){
+    uint32_t num;
+    if ( !is.get_u32( num ) ){
+      Error( is.error() );
+      return false;
+    }
+    if ( num != NumOfFeatures() ){
+      Error( "the matrices file has " + TiCC::toString( num )
+	     + " features, " + TiCC::toString( NumOfFeatures() )
+	     + " expected" );
+      return false;
+    }
+    bool anything = false;
+    for ( size_t i=0; i < num; ++i ){
+      uint32_t present;
+      uint64_t len;
+      if ( !is.get_u32( present ) ){
+	Error( is.error() );
+	return false;
+      }
+      if ( !present ){
+	continue;
+      }
+      string nums = TiCC::toString( i+1 );
+      if ( !is.get_section( len ) ){
+	Error( is.error() );
+	return false;
+      }
+      if ( !features[i]->isStorableMetric() ){
+	Warning( "Ignoring entry for feature " + nums
+		 + " which is NOT set to a storable metric type."
+		 + " use -m commandline option to set metrics" );
+	if ( !is.skip( len ) ){
+	  Error( is.error() );
+	  return false;
+	}
+      }
+      else if ( !features[i]->fill_matrix( is ) ){
+	if ( !is.error().empty() ){
+	  Error( is.error() );
+	}
+	return false;
+      }
+      else {
+	Info( "read ValueMatrix for feature " + nums );
+	anything = true;
+      }
+    }
+    if ( !anything ){
+      Error( "NO metric values found" );
+      return false;
+    }
+    return true;
+  }
+
+  bool MBLClass::writeArrays( BinaryTableWriter& os ) {
+    if ( ExpInvalid() ){
+      return false;
+    }
+    else if ( !initProbabilityArrays( false ) ){
+      Warning( "couldn't Calculate probability Arrays's" );
+      return false;
+    }
+    os.put_u32( targets.values_array.size() );
+    for ( const auto& it : targets.values_array ){
+      os.put_string( it->name() );
+    }
+    os.put_u32( features.feats.size() );
+    for ( const auto& feat : features.feats ){
+      if ( feat->Ignore() ){
+	os.put_u32( Ignored_array );
+      }
+      else if ( feat->isNumerical() ){
+	os.put_u32( Numeric_array );
+      }
+      else {
+	os.put_u32( Matrix_array );
+	size_t section = os.start_section();
+	feat->write_vc_pb_array( os );
+	os.end_section( section );
+      }
+    }
+    return true;
+  }
+
+  bool MBLClass::readArrays( BinaryTableReader& is ){
+    uint32_t classes;
+    if ( !is.get_u32( classes ) ){
+      Error( is.error() );
+      return false;
+    }
+    for ( size_t i=0; i < classes; ++i ){
+      UnicodeString name;
+      if ( !is.get_string( name ) ){
+	Error( is.error() );
+	return false;
+      }
+    }
+    if ( classes != targets.values_array.size() ){
+      Error( "the Probability file has " + TiCC::toString( classes )
+	     + " classes, " + TiCC::toString( targets.values_array.size() )
+	     + " expected" );
+      return false;
+    }
+    uint32_t num;
+    if ( !is.get_u32( num ) ){
+      Error( is.error() );
+      return false;
+    }
+    if ( num != NumOfFeatures() ){
+      Error( "the Probability file has " + TiCC::toString( num )
+	     + " features, " + TiCC::toString( NumOfFeatures() )
+	     + " expected" );
+      return false;
+    }
+    bool result = true;
+    for ( size_t i=0; i < num && result; ++i ){
+      string index = TiCC::toString( i+1 );
+      uint32_t kind;
+      if ( !is.get_u32( kind ) ){
+	Error( is.error() );
+	return false;
+      }
+      if ( kind == Ignored_array ){
+	if ( !features[i]->Ignore() ){
+	  Error( "Feature #" + index + " may not be ignored..." );
+	  result = false;
+	}
+      }
+      else if ( kind == Numeric_array ){
+	if ( !features[i]->isNumerical() ){
+	  Error( "Feature #" + index + " is not Numeric..." );
+	  result = false;
+	}
+      }
+      else {
+	uint64_t len;
+	if ( !is.get_section( len ) ){
+	  Error( is.error() );
+	  return false;
+	}
+	if ( features[i]->Ignore() ||
+	     features[i]->isNumerical() ){
+	  Warning( "Matrix info found for feature #" + index + " (skipped)" );
+	  result = is.skip( len );
+	}
+	else {
+	  result = features[i]->read_vc_pb_array( is, classes );
+	}
+	if ( !result && !is.error().empty() ){
+	  Error( is.error() );
+	}
+      }
+    }
+    return result;
+  }
+
   bool MBLClass::allocate_arrays(){
     size_t Dim = targets.values_array.size();
     for ( auto *feat : features.feats ){
@@ -1040,15 +1312,184 @@ namespace Timbl {
     }
   }
 
+  bool MBLClass::mark_active(){
+    // for the sparse formats, only the active fields of the chopped line
+    // differ from the default value. Mark them, so we can skip the
+    // hashing of all the others.
+    const vector<size_t> *active = ChopInput->activeFields();
+    if ( !active ){
+      return false;
+    }
+    if ( active_stamp.size() != NumOfFeatures()+1 ){
+      active_stamp.assign( NumOfFeatures()+1, 0 );
+      sparse_defaults.assign( NumOfFeatures()+1, 0 );
+      chop_count = 0;
+    }
+    ++chop_count;
+    for ( const auto j : *active ){
+      active_stamp[j] = chop_count;
+    }
+    return true;
+  }
+
+  FeatureValue *MBLClass::sparse_default( size_t j ){
+    // the FeatureValue for the default value of feature j,
+    // or NULL when it isn't known (yet)
+    if ( !sparse_defaults[j] ){
+      sparse_defaults[j] = features[j]->Lookup( ChopInput->getField(j) );
+    }
+    return sparse_defaults[j];
+  }
+
+  const UnicodeString& MBLClass::sparse_string() const {
+    // the value of the fields which are not mentioned in a line
+    static const UnicodeString zero = "0";
+    if ( input_format == SparseBin ){
+      return zero;
+    }
+    return DefaultSparseString;
+  }
+
+  void MBLClass::init_sparse( Sparse_InstanceBase *IB ){
+    // the positions of the features in a sparse Instance, and the
+    // values of the positions that are not active.
+    // To be called when the permutation is known
+    sparse_positions.assign( NumOfFeatures(),
+			     std::numeric_limits<size_t>::max() );
+    no_defaults.clear();
+    vector<FeatureValue *> defaults( EffectiveFeatures(), 0 );
+    for ( size_t k = 0; k < EffectiveFeatures(); ++k ){
+      size_t j = features.permutation[k];
+      sparse_positions[j] = k;
+      defaults[k] = features[j]->Lookup( sparse_string() );
+      if ( !defaults[k] ){
+	// every training instance has a value here
+	no_defaults.push_back( k );
+      }
+    }
+    IB->setDefaults( defaults );
+  }
+
+  void MBLClass::count_sparse_defaults(){
+    // for a sparse search, LearnWords only counts the default value of a
+    // feature the first time it is seen. All the instances which don't
+    // mention the feature have it too
+    for ( const auto& feat : features.feats ){
+      FeatureValue *def = feat->Lookup( sparse_string() );
+      if ( !feat->Ignore() && def ){
+	feat->add_uncounted( def, targets.values_array );
+      }
+    }
+  }
+
+  const Instance *MBLClass::sparse_to_instance( PhaseValue phase,
+						int occ ){
+    // chopped_to_instance() for a sparse search: only the active fields
+    // are visited, and the Instance only holds the values which differ
+    // from the default of their position
+    const vector<size_t>& active = *ChopInput->activeFields();
+    vector<size_t> fields( active );
+    sort( fields.begin(), fields.end() );
+    fields.erase( unique( fields.begin(), fields.end() ), fields.end() );
+    while ( !fields.empty() && fields.back() >= NumOfFeatures() ){
+      fields.pop_back();
+    }
+    switch ( phase ){
+    case LearnWords: {
+      CurrInst.TV = targets.add_value( ChopInput->getField( NumOfFeatures() ),
+				       occ );
+      // the active fields, and the default values we haven't seen yet.
+      // In the order of the features, so the values are created in the
+      // same order as in a dense experiment.
+      vector<size_t> still_pending;
+      auto f = fields.begin();
+      auto p = pending_defaults.begin();
+      while ( f != fields.end() || p != pending_defaults.end() ){
+	size_t j;
+	if ( p == pending_defaults.end()
+	     || ( f != fields.end() && *f <= *p ) ){
+	  j = *f;
+	  if ( p != pending_defaults.end() && *p == j ){
+	    still_pending.push_back( j );
+	    ++p;
+	  }
+	  ++f;
+	}
+	else {
+	  j = *p;
+	  ++p;
+	}
+	if ( features[j]->Ignore() ){
+	  continue;
+	}
+	// a default value only counts when it is seen first,
+	// count_sparse_defaults() does the rest
+	features[j]->add_value( ChopInput->getField(j), CurrInst.TV, occ );
+      }
+      pending_defaults.swap( still_pending );
+      break;
+    }
+    case TrainWords:
+    case TestWords: {
+      const vector<FeatureValue *>& defaults =
+	dynamic_cast<const Sparse_InstanceBase*>(InstanceBase)->defaults();
+      for ( const auto j : fields ){
+	size_t k = sparse_positions[j];
+	if ( k == std::numeric_limits<size_t>::max() ){
+	  // ignored
+	  continue;
+	}
+	const UnicodeString& fld = ChopInput->getField(j);
+	FeatureValue *fv = features[j]->Lookup( fld );
+	if ( !fv && phase == TestWords ){
+	  // for "unknown" values have to add a dummy value
+	  fv = unknowns.get( fld );
+	}
+	if ( fv != defaults[k] ){
+	  CurrInst.Active.push_back( make_pair( k, fv ) );
+	}
+      }
+      if ( phase == TestWords ){
+	// every training instance has an active value on these positions.
+	// The default value is unknown there
+	for ( const auto k : no_defaults ){
+	  size_t j = features.permutation[k];
+	  if ( active_stamp[j] != chop_count ){
+	    CurrInst.Active.push_back( make_pair( k,
+						  unknowns.get( sparse_string() ) ) );
+	  }
+	}
+      }
+      sort( CurrInst.Active.begin(), CurrInst.Active.end(),
+	    []( const activeValue& a, const activeValue& b ){
+	      return a.first < b.first; } );
+      CurrInst.TV = targets.Lookup( ChopInput->getField( NumOfFeatures() ) );
+      break;
+    }
+    default:
+      FatalError( "Wrong value in Switch: "
+		  + TiCC::toString<PhaseValue>(phase) );
+    }
+    return &CurrInst;
+  }
+
   const Instance *MBLClass::chopped_to_instance( PhaseValue phase ){
     CurrInst.clear();
+    unknowns.release();
+    bool sparse = false;
     if ( NumOfFeatures() != target_pos ) {
       ChopInput->swapTarget( target_pos );
     }
+    else {
+      sparse = mark_active();
+    }
     int occ = ChopInput->getOcc();
     if ( occ > 1 ){
       CurrInst.Occurrences( occ );
     }
+    if ( sparse_search ){
+      return sparse_to_instance( phase, occ );
+    }
     switch ( phase  ){
     case LearnWords:
       // Add the target.
@@ -1061,12 +1502,21 @@ namespace Timbl {
 	  // but this might happen, take care!
 	  CurrInst.FV[i] = NULL;
 	}
+	else if ( sparse
+		  && active_stamp[i] != chop_count
+		  && sparse_defaults[i] ){
+	  // a default value we have seen before, use its index
+	  CurrInst.FV[i] = features[i]->add_value( sparse_defaults[i]->Index(),
+						      CurrInst.TV, occ );
+	}
 	else {
 	  // Add it to the Instance.
 	  //	  cerr << "Feature add: " << ChopInput->getField(i) << endl;
 	  CurrInst.FV[i] = features[i]->add_value( ChopInput->getField(i),
 						      CurrInst.TV, occ );
-
+	  if ( sparse && active_stamp[i] != chop_count ){
+	    sparse_defaults[i] = CurrInst.FV[i];
+	  }
 	}
       } // i
       //      cerr << "new instance: " << CurrInst << endl;
@@ -1076,7 +1526,12 @@ namespace Timbl {
       // First the Features
       for ( size_t k = 0; k < EffectiveFeatures(); ++k ){
 	size_t j = features.permutation[k];
-	CurrInst.FV[k] = features[j]->Lookup( ChopInput->getField(j) );
+	if ( sparse && active_stamp[j] != chop_count ){
+	  CurrInst.FV[k] = sparse_default( j );
+	}
+	else {
+	  CurrInst.FV[k] = features[j]->Lookup( ChopInput->getField(j) );
+	}
       } // k
       // and the Target
       CurrInst.TV = targets.Lookup( ChopInput->getField( NumOfFeatures() ) );
@@ -1100,13 +1555,32 @@ namespace Timbl {
       for ( size_t m = 0; m < EffectiveFeatures(); ++m ){
 	size_t j = features.permutation[m];
 	const UnicodeString& fld =  ChopInput->getField(j);
-	CurrInst.FV[m] = features[j]->Lookup( fld );
+	if ( sparse && active_stamp[j] != chop_count ){
+	  CurrInst.FV[m] = sparse_default( j );
+	}
+	else {
+	  CurrInst.FV[m] = features[j]->Lookup( fld );
+	}
 	if ( !CurrInst.FV[m] ){
 	  // for "unknown" values have to add a dummy value
-	  CurrInst.FV[m] = new FeatureValue( fld );
+	  CurrInst.FV[m] = unknowns.get( fld );
 	}
 
       } // i
+      if ( InstanceBase && EffectiveFeatures() > 0
+	   && InstanceBase->Prefetch( CurrInst.FV[0] ) ){
+	// a lazily read tree just read the subtree for this instance,
+	// which may know values that were unknown above
+	for ( size_t m = 1; m < EffectiveFeatures(); ++m ){
+	  if ( CurrInst.FV[m]->isUnknown() ){
+	    size_t j = features.permutation[m];
+	    FeatureValue *known = features[j]->Lookup( ChopInput->getField(j) );
+	    if ( known ){
+	      CurrInst.FV[m] = known;
+	    }
+	  }
+	}
+      }
       // the last string is the target
       CurrInst.TV = targets.Lookup( ChopInput->getField(NumOfFeatures()) );
       break;
@@ -1336,6 +1810,60 @@ namespace Timbl {
     return result;
   }
 
+  static double stored_weight( const Feature *feat, WeightType w ){
+    switch ( w ){
+    case GR_w:
+      return feat->GainRatio();
+    case IG_w:
+      return feat->InfoGain();
+    case X2_w:
+      return feat->ChiSquare();
+    case SV_w:
+      return feat->SharedVariance();
+    case SD_w:
+      return feat->StandardDeviation();
+    default:
+      return 1.0;
+    }
+  }
+
+  bool MBLClass::writeWeights( BinaryTableWriter& os ) const {
+    // the same weightings as the text version, at full precision
+    if ( ExpInvalid() ){
+      return false;
+    }
+    if ( features[0] == NULL ){
+      Warning( "unable to save Weights, nothing learned yet" );
+      return false;
+    }
+    os.put_u32( features.feats.size() );
+    os.put_double( DBEntropy );
+    os.put_u64( targets.values_array.size() );
+    os.put_u64( targets.TotalValues() );
+    for ( const auto& feat : features.feats ){
+      os.put_u32( feat->Ignore() );
+    }
+    vector<WeightType> stored;
+    if ( CurrentWeighting() == SD_w ){
+      stored = { SD_w };
+    }
+    else {
+      stored = { No_w, GR_w, IG_w };
+      if ( need_all_weights ){
+	stored.push_back( SV_w );
+	stored.push_back( X2_w );
+      }
+    }
+    os.put_u32( stored.size() );
+    for ( const auto w : stored ){
+      os.put_u32( w );
+      for ( const auto& feat : features.feats ){
+	os.put_double( feat->Ignore() ? 0.0 : stored_weight( feat, w ) );
+      }
+    }
+    return true;
+  }
+
   bool MBLClass::read_the_vals( istream& is ){
     vector<bool> done( NumOfFeatures(), false );;
     string Buffer;
@@ -1464,17 +1992,98 @@ namespace Timbl {
 	Warning( "unable to continue" );
 	return false;
       }
-      // make shure all weights are correct
-      // Paranoid?
-      for ( const auto& feat : features.feats ){
-	feat->InfoGain( feat->Weight() );
-	feat->GainRatio( feat->Weight() );
-	feat->ChiSquare( feat->Weight() );
-	feat->SharedVariance( feat->Weight() );
-	feat->StandardDeviation( 0.0 );
+      use_read_weights();
+    }
+    return true;
+  }
+
+  void MBLClass::use_read_weights(){
+    // make shure all weights are correct
+    // Paranoid?
+    for ( const auto& feat : features.feats ){
+      feat->InfoGain( feat->Weight() );
+      feat->GainRatio( feat->Weight() );
+      feat->ChiSquare( feat->Weight() );
+      feat->SharedVariance( feat->Weight() );
+      feat->StandardDeviation( 0.0 );
+    }
+    Weighting = UserDefined_w;
+  }
+
+  bool MBLClass::readWeights( BinaryTableReader& is, WeightType wanted ){
+    if ( ExpInvalid() ){
+      return true;
+    }
+    uint32_t num;
+    double entropy;
+    uint64_t classes;
+    uint64_t lines;
+    if ( !is.get_u32( num )
+	 || !is.get_double( entropy )
+	 || !is.get_u64( classes )
+	 || !is.get_u64( lines ) ){
+      Error( is.error() );
+      return false;
+    }
+    if ( num != NumOfFeatures() ){
+      Error( "the weightsfile has " + TiCC::toString( num )
+	     + " features, " + TiCC::toString( NumOfFeatures() )
+	     + " expected" );
+      return false;
+    }
+    vector<uint32_t> ignored( num );
+    for ( auto& ign : ignored ){
+      if ( !is.get_u32( ign ) ){
+	Error( is.error() );
+	return false;
+      }
+    }
+    uint32_t sections;
+    if ( !is.get_u32( sections ) ){
+      Error( is.error() );
+      return false;
+    }
+    vector<double> weights( num );
+    bool found = false;
+    for ( size_t s=0; s < sections && !found; ++s ){
+      uint32_t w;
+      if ( !is.get_u32( w ) ){
+	Error( is.error() );
+	return false;
+      }
+      for ( auto& wght : weights ){
+	if ( !is.get_double( wght ) ){
+	  Error( is.error() );
+	  return false;
+	}
       }
-      Weighting = UserDefined_w;
+      found = ( WeightType(w) == wanted );
     }
+    if ( !found ){
+      Warning( "Unable to retrieve "
+	       + TiCC::toString( wanted ) + " Weights" );
+      Warning( "unable to continue" );
+      return false;
+    }
+    for ( size_t i=0; i < num; ++i ){
+      string index = TiCC::toString( i+1 );
+      if ( ignored[i] ){
+	features[i]->SetWeight( 0.0 );
+	if ( !features[i]->Ignore() ){
+	  Warning( "in weightsfile, Feature " + index +
+		   " has value: 'Ignore', we will use: 0.0 " );
+	}
+      }
+      else {
+	features[i]->SetWeight( weights[i] );
+	if ( features[i]->Ignore() ){
+	  Warning( "in weightsfile, Feature " + index + " has value: " +
+		   TiCC::toString<double>( weights[i] ) +
+		   " assigned, but will be ignored" );
+	}
+      }
+    }
+    use_read_weights();
     return true;
   }
 
@@ -1531,6 +2140,24 @@ namespace Timbl {
     return changed;
   }
 
+  bool MBLClass::needsAllValues() const {
+    // weights and metrics which need the statistics of every feature
+    // value can't do with the subtrees of a lazily read tree
+    if ( CurrentWeighting() != UserDefined_w && CurrentWeighting() != No_w ){
+      return true;
+    }
+    for ( size_t g = 0; g < NumOfFeatures(); ++g ){
+      if ( !features.feats[g]->Ignore() ){
+	metricClass *tmpMetric = getMetricClass( UserOptions[g+1] );
+	bool all = tmpMetric->isNumerical() || tmpMetric->isStorable();
+	delete tmpMetric;
+	if ( all ){
+	  return true;
+	}
+      }
+    }
+    return false;
+  }
 
   void MBLClass::calculate_fv_entropy( bool always ){
     bool realy_first =  DBEntropy < 0.0;
@@ -1724,12 +2351,20 @@ namespace Timbl {
     }
   }
 
+  void MBLClass::ChopRow( const BinaryInstanceReader& reader,
+			 const binaryRow& row ){
+    // the binary counterpart of Chop(): no parsing needed
+    reader.fill( row, *ChopInput );
+  }
+
   bool MBLClass::setInputFormat( const InputFormatType IF ){
     if ( ChopInput ){
       delete ChopInput;
       ChopInput = 0;
     }
     ChopInput = Chopper::create( IF, chopExamples(), F_length, chopOcc() );
+    sparse_defaults.clear();
+    active_stamp.clear();
     if ( ChopInput ){
       input_format = IF;
       return true;
@@ -1737,6 +2372,11 @@ namespace Timbl {
     return false;
   }
 
+  Chopper *MBLClass::newChopper() const {
+    // a fresh Chopper for the current input format and phase
+    return Chopper::create( input_format, chopExamples(), F_length, chopOcc() );
+  }
+
   const ClassDistribution *MBLClass::ExactMatch( const Instance& inst ) const {
     const ClassDistribution *result = NULL;
     if ( !GlobalMetric->isSimilarityMetric() &&
@@ -1833,7 +2473,8 @@ namespace Timbl {
   void MBLClass::test_instance_ex( const Instance& Inst,
 				   InstanceBase_base *IB,
 				   size_t ib_offset ){
-    vector<FeatureValue *> CurrentFV(NumOfFeatures());
+    vector<FeatureValue *>& CurrentFV = testState.CurrentFV;
+    CurrentFV.assign( NumOfFeatures(), 0 );
     const ClassDistribution *best_distrib = IB->InitGraphTest( CurrentFV,
 							       &Inst.FV,
 							       ib_offset,
@@ -1912,32 +2553,59 @@ namespace Timbl {
     delete tester;
     tester = getTester( globalMetricOption,
 			features, mvd_threshold );
+    delete sparse_tester;
+    sparse_tester = 0;
+    if ( sparse_search ){
+      sparse_tester = new SparseTester( globalMetricOption,
+					features, mvd_threshold );
+    }
   }
 
-  void MBLClass::test_instance( const Instance& Inst,
+  void MBLClass::startSearch( searchState& st,
+				const Instance& Inst,
 				InstanceBase_base *IB,
 				size_t ib_offset ){
-    vector<FeatureValue *> CurrentFV(NumOfFeatures());
-    double Threshold = DBL_MAX;
-    size_t EffFeat = EffectiveFeatures() - ib_offset;
-    const ClassDistribution *best_distrib = IB->InitGraphTest( CurrentFV,
-							       &Inst.FV,
-							       ib_offset,
-							       EffectiveFeatures() );
+    st.CurrentFV.assign( NumOfFeatures(), 0 );
+    st.inst = &Inst;
+    st.IB = IB;
+    st.offset = ib_offset;
+    st.CurPos = 0;
+    st.Threshold = DBL_MAX;
+    st.leaves = 0;
+    st.best_distrib = IB->InitGraphTest( st.CurrentFV,
+					 &Inst.FV,
+					 ib_offset,
+					 EffectiveFeatures() );
     tester->init( Inst, EffectiveFeatures(), ib_offset );
-    size_t CurPos = 0;
+  }
+
+  bool MBLClass::stepSearch( searchState& st, size_t max_leaves ){
+    // continue the search, visiting at most max_leaves leaves
+    // (0 means: no limit). Only the paths which reach a leaf distribution
+    // count, the ones cut off on the way by the Threshold don't.
+    // Returns true when the search is finished.
+    // The results so far are in bestArray.
+    size_t EffFeat = EffectiveFeatures() - st.offset;
+    const ClassDistribution *best_distrib = st.best_distrib;
+    double Threshold = st.Threshold;
+    size_t CurPos = st.CurPos;
+    size_t visited = 0;
     while ( best_distrib ){
-      size_t EndPos = tester->test( CurrentFV,
+      if ( visited == max_leaves && max_leaves > 0 ){
+	break;
+      }
+      size_t EndPos = tester->test( st.CurrentFV,
 				    CurPos,
 				    Threshold + Epsilon );
       if ( EndPos == EffFeat ){
 	// we finished with a certain amount of succes
+	++visited;
 	double Distance = tester->getDistance(EndPos);
 	if ( Distance >= 0.0 ){
 	  UnicodeString origI;
 	  if ( Verbosity(NEAR_N) ){
-	    origI = formatInstance( Inst.FV, CurrentFV,
-				    ib_offset,
+	    origI = formatInstance( st.inst->FV, st.CurrentFV,
+				    st.offset,
 				    NumOfFeatures() );
 	  }
 	  Threshold = bestArray.addResult( Distance, best_distrib, origI );
@@ -1958,8 +2626,8 @@ namespace Timbl {
 	// rollback
 	if ( tester->getDistance(pos) <= Threshold ){
 	  CurPos = pos;
-	  best_distrib = IB->NextGraphTest( CurrentFV,
-					    CurPos );
+	  best_distrib = st.IB->NextGraphTest( st.CurrentFV,
+					       CurPos );
 	  break;
 	}
 	if ( pos == 0 ){
@@ -1968,12 +2636,33 @@ namespace Timbl {
 	--pos;
       }
     }
+    st.best_distrib = best_distrib;
+    st.Threshold = Threshold;
+    st.CurPos = CurPos;
+    st.leaves += visited;
+    return best_distrib == 0;
+  }
+
+  bool MBLClass::incrementalSearch() const {
+    // startSearch/stepSearch only implement the plain distance search
+    return !doSamples() && !GlobalMetric->isSimilarityMetric()
+      && !sparse_search;
+  }
+
+  void MBLClass::test_instance( const Instance& Inst,
+				InstanceBase_base *IB,
+				size_t ib_offset ){
+    // the search state is kept in the experiment, so its buffer is
+    // re-used for every instance
+    startSearch( testState, Inst, IB, ib_offset );
+    stepSearch( testState );
   }
 
   void MBLClass::test_instance_sim( const Instance& Inst,
 				    InstanceBase_base *IB,
 				    size_t ib_offset ){
-    vector<FeatureValue *> CurrentFV(NumOfFeatures());
+    vector<FeatureValue *>& CurrentFV = testState.CurrentFV;
+    CurrentFV.assign( NumOfFeatures(), 0 );
     size_t EffFeat = EffectiveFeatures() - ib_offset;
     const ClassDistribution *best_distrib = IB->InitGraphTest( CurrentFV,
 							       &Inst.FV,
@@ -2018,11 +2707,67 @@ namespace Timbl {
     }
   }
 
+  UnicodeString MBLClass::formatSparse( const Sparse_InstanceBase& IB,
+				       size_t e ) const {
+    // the active values of entry e, like the Sparse and SparseBin
+    // formats write them
+    vector<pair<size_t,const FeatureValue *>> fields;
+    for ( auto it = IB.begin(e); it != IB.end(e); ++it ){
+      fields.push_back( make_pair( features.permutation[it->first],
+				   it->second ) );
+    }
+    sort( fields.begin(), fields.end() );
+    UnicodeString result;
+    for ( const auto& [j,fv] : fields ){
+      if ( input_format == SparseBin ){
+	if ( fv->name()[0] == '1' ){
+	  result += TiCC::toUnicodeString<size_t>( j+1 ) + ",";
+	}
+      }
+      else if ( fv->name() != DefaultSparseString ){
+	result += "(" + TiCC::toUnicodeString<size_t>(j+1) + ","
+	  + CodeToStr( fv->name() ) + ")";
+      }
+    }
+    return result;
+  }
+
+  void MBLClass::test_instance_sparse( const Instance& Inst,
+				       const Sparse_InstanceBase *IB ){
+    // only the entries within the distance of the nearest neighbors
+    // are visited, in the order of a tree search
+    vector<pair<double,size_t>> found;
+    sparse_tester->init( *IB, Inst.Active );
+    sparse_tester->search( num_of_neighbors, found );
+    for ( const auto& [Distance,e] : found ){
+      if ( Distance >= 0.0 ){
+	UnicodeString origI;
+	if ( Verbosity(NEAR_N) ){
+	  origI = formatSparse( *IB, e );
+	}
+	bestArray.addResult( Distance, IB->distribution(e), origI );
+      }
+      else if ( GlobalMetric->type() == DotProduct ){
+	Error( "The Dot Product metric fails on your data: intermediate result too big to handle," );
+	Info( "you might consider using the Cosine metric '-mC' " );
+	FatalError( "timbl terminated" );
+      }
+      else {
+	Error( "DISTANCE == " + TiCC::toString<double>(Distance) );
+	FatalError( "we are dead" );
+      }
+    }
+  }
+
   void MBLClass::TestInstance( const Instance& Inst,
 			       InstanceBase_base *SubTree,
 			       size_t level ){
     // must be cleared for EVERY test
-    if (  doSamples() ){
+    if ( sparse_search ){
+      test_instance_sparse( Inst,
+			    dynamic_cast<Sparse_InstanceBase*>(SubTree) );
+    }
+    else if (  doSamples() ){
       test_instance_ex( Inst, SubTree, level );
     }
     else {
@@ -2064,94 +2809,117 @@ namespace Timbl {
     // Looks at the data files, counts number of features.
     // and sets input_format variables.
     //
-    size_t NumF = 0;
-    InputFormatType IF = UnknownInputFormat;
     // Open the file.
     //
     if ( FileName == "" ) {
       Warning( "couldn't initialize: No FileName specified " );
       return 0;
     }
-    else {
-      UnicodeString Buffer;
-      ifstream datafile( FileName, ios::in);
-      if (!datafile) {
-	Warning( "can't open DataFile: " + FileName );
-	return 0;
+    InputStream datafile( FileName );
+    if (!datafile) {
+      if ( !datafile.error().empty() ){
+	Warning( datafile.error() );
+      }
+      Warning( "can't open DataFile: " + FileName );
+      return 0;
+    }
+    return examineData( datafile, FileName );
+  }
+
+  size_t MBLClass::examineData( istream& datafile,
+				const string& FileName,
+				string *seen ){
+    // Does the real work for examineData() on an opened stream.
+    // When seen is given, the raw text of every line read is appended to it,
+    // so the caller can put it back on a stream which can't be rewound.
+    //
+    auto next_line = [&]( UnicodeString& line ) -> bool {
+      string raw;
+      if ( !getline( datafile, raw ) ){
+	return false;
       }
-      else if ( input_format != UnknownInputFormat ){
-	// The format is somehow already known, so use that
-	if ( input_format == SparseBin || input_format == Sparse ){
-	  NumF = MaxFeatures;
+      if ( seen ){
+	*seen += raw;
+	*seen += '\n';
+      }
+      line = TiCC::UnicodeFromUTF8( raw );
+      return true;
+    };
+    size_t NumF = 0;
+    InputFormatType IF = UnknownInputFormat;
+    UnicodeString Buffer;
+    if ( input_format != UnknownInputFormat ){
+      // The format is somehow already known, so use that
+      if ( input_format == SparseBin || input_format == Sparse ){
+	NumF = MaxFeatures;
+      }
+      else {
+	if ( !next_line( Buffer ) ) {
+	  Warning( "empty data file" );
 	}
 	else {
-	  if ( !TiCC::getline( datafile, Buffer ) ) {
-	    Warning( "empty data file" );
-	  }
-	  else {
-	    bool more = true;
-	    if ( input_format == ARFF ){
-	      while ( Buffer.caseCompare( "@DATA", 5 ) ){
-		if ( !TiCC::getline( datafile, Buffer ) ){
-		  Warning( "empty data file" );
-		  more = false;
-		  break;
-		};
-	      }
-	      if ( more && !TiCC::getline( datafile, Buffer ) ){
+	  bool more = true;
+	  if ( input_format == ARFF ){
+	    while ( Buffer.caseCompare( "@DATA", 5 ) ){
+	      if ( !next_line( Buffer ) ){
 		Warning( "empty data file" );
 		more = false;
+		break;
 	      };
 	    }
-	    while ( more && empty_line( Buffer, input_format ) ){
-	      if ( !TiCC::getline( datafile, Buffer ) ){
-		Warning( "empty data file" );
-		more = false;
-	      };
-	    }
-	    // now we have a usable line,
-	    //analyze it using the User defined input_format
-	    NumF = countFeatures( Buffer, input_format );
+	    if ( more && !next_line( Buffer ) ){
+	      Warning( "empty data file" );
+	      more = false;
+	    };
+	  }
+	  while ( more && empty_line( Buffer, input_format ) ){
+	    if ( !next_line( Buffer ) ){
+	      Warning( "empty data file" );
+	      more = false;
+	    };
 	  }
+	  // now we have a usable line,
+	  //analyze it using the User defined input_format
+	  NumF = countFeatures( Buffer, input_format );
 	}
-	IF = input_format;
-      }
-      else if ( !TiCC::getline( datafile, Buffer ) ){
-	Warning( "empty data file: " + FileName );
       }
-      // We start by reading the first line so we can figure out the number
-      // of Features, and see if the file is comma seperated or not,  etc.
-      //
-      else{
-	if ( IF == ARFF ){
-	  // Remember, we DON't want to auto-detect ARFF
-	  while ( Buffer.caseCompare( "@DATA", 5 ) ){
-	    if ( !TiCC::getline( datafile, Buffer ) ) {
-	      Warning( "no ARRF data after comments: " + FileName );
-	      return 0;
-	    }
+      IF = input_format;
+    }
+    else if ( !next_line( Buffer ) ){
+      Warning( "empty data file: " + FileName );
+    }
+    // We start by reading the first line so we can figure out the number
+    // of Features, and see if the file is comma seperated or not,  etc.
+    //
+    else{
+      if ( IF == ARFF ){
+	// Remember, we DON't want to auto-detect ARFF
+	while ( Buffer.caseCompare( "@DATA", 5 ) ){
+	  if ( !next_line( Buffer ) ) {
+	    Warning( "no ARRF data after comments: " + FileName );
+	    return 0;
 	  }
-	  do {
-	    if ( !TiCC::getline( datafile, Buffer ) ) {
-	      Warning( "no ARRF data after comments: " + FileName );
-	      return 0;
-	    }
-	  } while ( empty_line( Buffer, input_format ) );
 	}
-	else {
-	  while ( empty_line( Buffer, input_format ) ) {
-	    if ( !TiCC::getline( datafile, Buffer ) ) {
-	      Warning( "no data after comments: " + FileName );
-	      return 0;
-	    }
+	do {
+	  if ( !next_line( Buffer ) ) {
+	    Warning( "no ARRF data after comments: " + FileName );
+	    return 0;
+	  }
+	} while ( empty_line( Buffer, input_format ) );
+      }
+      else {
+	while ( empty_line( Buffer, input_format ) ) {
+	  if ( !next_line( Buffer ) ) {
+	    Warning( "no data after comments: " + FileName );
+	    return 0;
 	  }
-	  // We found a useful line!
-	  // Now determine the input_format (if not already known,
-	// and Count Features as well.
 	}
-	IF = getInputFormat( Buffer );
-	NumF = countFeatures( Buffer, IF );
+	// We found a useful line!
+	// Now determine the input_format (if not already known,
+      // and Count Features as well.
       }
+      IF = getInputFormat( Buffer );
+      NumF = countFeatures( Buffer, IF );
     }
     if ( NumF > 0 ){
       if ( input_format != UnknownInputFormat &&
@@ -2184,7 +2952,19 @@ namespace Timbl {
     }
     targets.init();
     features.init( numF, UserOptions );
-    CurrInst.Init( numF );
+    sparse_defaults.clear();
+    active_stamp.clear();
+    pending_defaults.clear();
+    if ( sparse_search ){
+      // a sparse Instance only holds its active values
+      CurrInst.Init( 0 );
+      for ( size_t j = 0; j < numF; ++j ){
+	pending_defaults.push_back( j );
+      }
+    }
+    else {
+      CurrInst.Init( numF );
+    }
     delete GlobalMetric;
     GlobalMetric = getMetricClass( globalMetricOption );
     Options.FreezeTable();
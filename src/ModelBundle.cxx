@@ -0,0 +1,376 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ticcutils/StringOps.h"
+#include "timbl/BinaryTables.h"
+#include "timbl/ModelBundle.h"
+
+using namespace std;
+using namespace nlohmann;
+
+namespace Timbl {
+
+  static const char magic[] = "TiMBLbdl";
+  static const size_t magic_len = 8;
+  static const uint32_t bundle_version = 1;
+  static const size_t prefix_len = magic_len + 4 + 4 + 8 + 8;
+  static const size_t hash_block = 1024*1024;
+  static const size_t first_read = 64*1024;
+
+  static void append_le( string& buf, uint64_t val, size_t width ){
+    for ( size_t i=0; i < width; ++i ){
+      buf += static_cast<char>( val & 0xff );
+      val >>= 8;
+    }
+  }
+
+  static uint64_t extract_le( const char *pnt, size_t width ){
+    uint64_t result = 0;
+    for ( size_t i=width; i > 0; --i ){
+      result = ( result << 8 ) | static_cast<unsigned char>( pnt[i-1] );
+    }
+    return result;
+  }
+
+  static string to_hex( uint64_t val ){
+    char buf[17];
+    snprintf( buf, sizeof(buf), "%016llx",
+	      static_cast<unsigned long long>( val ) );
+    return buf;
+  }
+
+  static uint64_t combine( const vector<uint64_t>& sums ){
+    string bytes;
+    for ( const auto sum : sums ){
+      append_le( bytes, sum, 8 );
+    }
+    return fnv_checksum( reinterpret_cast<const unsigned char*>(bytes.data()),
+			 bytes.size() );
+  }
+
+  uint64_t bundle_hash( const char *pnt, size_t len, int threads ){
+    size_t blocks = ( len + hash_block - 1 ) / hash_block;
+    vector<uint64_t> sums( blocks );
+    if ( threads < 1 ){
+      threads = 1;
+    }
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>( pnt );
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for ( size_t b=0; b < blocks; ++b ){
+      size_t from = b * hash_block;
+      sums[b] = fnv_checksum( bytes + from, min( hash_block, len - from ) );
+    }
+    return combine( sums );
+  }
+
+  string file_hash( const string& file_name, int threads ){
+    ifstream is( file_name, ios::binary );
+    if ( !is ){
+      return "";
+    }
+    vector<char> bytes( (istreambuf_iterator<char>( is )),
+			istreambuf_iterator<char>() );
+    if ( is.bad() ){
+      return "";
+    }
+    return to_hex( bundle_hash( bytes.data(), bytes.size(), threads ) );
+  }
+
+  void BundleWriter::add( const string& name, string&& content ){
+    sections.push_back( make_pair( name, std::move(content) ) );
+  }
+
+  bool BundleWriter::write( ostream& os, int threads ){
+    json list = json::array();
+    vector<uint64_t> sums;
+    size_t offset = 0;
+    for ( const auto& sec : sections ){
+      uint64_t sum = bundle_hash( sec.second.data(), sec.second.size(),
+				  threads );
+      json entry;
+      entry["name"] = sec.first;
+      entry["offset"] = offset;
+      entry["size"] = sec.second.size();
+      entry["hash"] = to_hex( sum );
+      list.push_back( entry );
+      sums.push_back( sum );
+      offset += sec.second.size();
+    }
+    head["sections"] = list;
+    head["hash"] = to_hex( combine( sums ) );
+    string header = head.dump( 2 ) + "\n";
+    string prefix( magic, magic_len );
+    append_le( prefix, bundle_version, 4 );
+    append_le( prefix, 0, 4 );
+    append_le( prefix, header.size(), 8 );
+    append_le( prefix,
+	       fnv_checksum( reinterpret_cast<const unsigned char*>(header.data()),
+			     header.size() ),
+	       8 );
+    os.write( prefix.data(), prefix.size() );
+    os.write( header.data(), header.size() );
+    for ( const auto& sec : sections ){
+      os.write( sec.second.data(), sec.second.size() );
+    }
+    return os.good();
+  }
+
+  BundleReader::BundleReader():
+    data( 0 ),
+    size( 0 ),
+    start( 0 ),
+    mapped( 0 )
+  {}
+
+  BundleReader::~BundleReader(){
+    close();
+  }
+
+  void BundleReader::close(){
+    if ( mapped ){
+      munmap( mapped, size );
+      mapped = 0;
+    }
+    buffer.clear();
+    head = json();
+    data = 0;
+    size = 0;
+    start = 0;
+  }
+
+  bool BundleReader::fail( const string& what ){
+    if ( message.empty() ){
+      message = what;
+    }
+    return false;
+  }
+
+  static bool read_at( int fd, char *buf, size_t len, size_t offset ){
+    while ( len > 0 ){
+      ssize_t got = pread( fd, buf, len, offset );
+      if ( got <= 0 ){
+	return false;
+      }
+      buf += got;
+      len -= got;
+      offset += got;
+    }
+    return true;
+  }
+
+  bool BundleReader::open( const string& file ){
+    // read and check the prefix and the header. The sections are only
+    // mapped, nothing is read from them yet
+    close();
+    message.clear();
+    name = file;
+    int fd = ::open( name.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      return fail( "can't open " + name );
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) ){
+      ::close( fd );
+      return fail( name + " is not a regular file" );
+    }
+    size_t file_size = st.st_size;
+    if ( file_size < prefix_len ){
+      ::close( fd );
+      return fail( name + " is too short for a bundle" );
+    }
+    // in one go: the prefix and, mostly, the whole header
+    string head_buf( min( file_size, first_read ), '\0' );
+    if ( !read_at( fd, &head_buf[0], head_buf.size(), 0 ) ){
+      ::close( fd );
+      return fail( "can't read " + name );
+    }
+    if ( memcmp( head_buf.data(), magic, magic_len ) != 0 ){
+      ::close( fd );
+      return fail( name + " is not a TiMBL bundle" );
+    }
+    uint32_t version = extract_le( head_buf.data() + magic_len, 4 );
+    if ( version > bundle_version ){
+      ::close( fd );
+      return fail( name + " has bundle version "
+		   + TiCC::toString( version ) + ", we can only read up to "
+		   + TiCC::toString( bundle_version ) );
+    }
+    uint64_t head_len = extract_le( head_buf.data() + magic_len + 8, 8 );
+    uint64_t head_sum = extract_le( head_buf.data() + magic_len + 16, 8 );
+    if ( head_len > file_size - prefix_len ){
+      ::close( fd );
+      return fail( name + " is truncated" );
+    }
+    size_t have = head_buf.size();
+    head_buf.resize( prefix_len + head_len );
+    if ( have < head_buf.size()
+	 && !read_at( fd, &head_buf[have], head_buf.size() - have, have ) ){
+      ::close( fd );
+      return fail( "can't read " + name );
+    }
+    const char *hp = head_buf.data() + prefix_len;
+    if ( fnv_checksum( reinterpret_cast<const unsigned char*>(hp),
+		       head_len ) != head_sum ){
+      ::close( fd );
+      return fail( name + " is corrupted, the header checksum doesn't match" );
+    }
+    head = json::parse( hp, hp + head_len, nullptr, false );
+    if ( head.is_discarded() || !head.is_object()
+	 || !head.contains( "sections" ) || !head["sections"].is_array() ){
+      ::close( fd );
+      return fail( name + " has an invalid bundle header" );
+    }
+    start = prefix_len + head_len;
+    size_t end = start;
+    for ( const auto& sec : head["sections"] ){
+      if ( !sec.is_object()
+	   || !sec.contains( "name" ) || !sec["name"].is_string()
+	   || !sec.contains( "offset" ) || !sec["offset"].is_number_unsigned()
+	   || !sec.contains( "size" ) || !sec["size"].is_number_unsigned()
+	   || !sec.contains( "hash" ) || !sec["hash"].is_string() ){
+	::close( fd );
+	return fail( name + " has an invalid section entry" );
+      }
+      size_t off = sec["offset"].get<size_t>();
+      size_t len = sec["size"].get<size_t>();
+      if ( off > file_size - start || len > file_size - start - off ){
+	::close( fd );
+	return fail( name + " is truncated" );
+      }
+      end = max( end, start + off + len );
+    }
+    if ( end != file_size ){
+      ::close( fd );
+      return fail( name + " has " + TiCC::toString( file_size - end )
+		   + " unexpected bytes at the end" );
+    }
+    size = file_size;
+    void *pnt = mmap( 0, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( pnt != MAP_FAILED ){
+      mapped = pnt;
+      data = static_cast<const char*>( pnt );
+    }
+    else {
+      // no mmap here, read it the old way
+      ifstream is( name, ios::binary );
+      buffer.resize( size );
+      if ( !is.read( buffer.data(), size ) ){
+	return fail( "can't read " + name );
+      }
+      data = buffer.data();
+    }
+    return true;
+  }
+
+  bool BundleReader::verify( int threads ){
+    // check the hash of every section, and of the whole
+    vector<uint64_t> sums;
+    for ( const auto& sec : head["sections"] ){
+      string sec_name = sec["name"].get<string>();
+      uint64_t sum = bundle_hash( data + start + sec["offset"].get<size_t>(),
+				  sec["size"].get<size_t>(),
+				  threads );
+      if ( to_hex( sum ) != sec["hash"].get<string>() ){
+	return fail( name + " is corrupted, the hash of section '"
+		     + sec_name + "' doesn't match" );
+      }
+      sums.push_back( sum );
+    }
+    if ( !head.contains( "hash" ) || !head["hash"].is_string()
+	 || to_hex( combine( sums ) ) != head["hash"].get<string>() ){
+      return fail( name + " is corrupted, the content hash doesn't match" );
+    }
+    return true;
+  }
+
+  bool BundleReader::section( const string& sec_name,
+			      const char *& pnt,
+			      size_t& len ) const {
+    for ( const auto& sec : head["sections"] ){
+      if ( sec["name"].get<string>() == sec_name ){
+	pnt = data + start + sec["offset"].get<size_t>();
+	len = sec["size"].get<size_t>();
+	return true;
+      }
+    }
+    return false;
+  }
+
+  bool BundleReader::detect( const string& file ){
+    // does file start with our magic?
+    ifstream is( file, ios::binary );
+    char buf[magic_len];
+    return is.read( buf, magic_len )
+      && memcmp( buf, magic, magic_len ) == 0;
+  }
+
+  memorybuf::memorybuf( const char *pnt, size_t len ){
+    char *p = const_cast<char*>( pnt );
+    setg( p, p, p + len );
+  }
+
+  memorybuf::pos_type memorybuf::seekoff( off_type off,
+					  ios_base::seekdir dir,
+					  ios_base::openmode which ){
+    if ( !( which & ios_base::in ) ){
+      return pos_type( off_type(-1) );
+    }
+    off_type base = 0;
+    if ( dir == ios_base::cur ){
+      base = gptr() - eback();
+    }
+    else if ( dir == ios_base::end ){
+      base = egptr() - eback();
+    }
+    off_type pos = base + off;
+    if ( pos < 0 || pos > egptr() - eback() ){
+      return pos_type( off_type(-1) );
+    }
+    setg( eback(), eback() + pos, egptr() );
+    return pos_type( pos );
+  }
+
+  memorybuf::pos_type memorybuf::seekpos( pos_type pos,
+					  ios_base::openmode which ){
+    return seekoff( off_type(pos), ios_base::beg, which );
+  }
+
+}
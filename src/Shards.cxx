@@ -0,0 +1,457 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "ticcutils/StringOps.h"
+#include "ticcutils/Unicode.h"
+#include "timbl/TimblAPI.h"
+#include "timbl/Shards.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Timbl {
+
+  //
+  // the wire format between the coordinator and the shards.
+  // Both ends are the same binary on the same host, so we just use the
+  // native representation. Every message is a 64 bit length followed
+  // by the payload.
+  //
+  static bool write_all( int fd, const char *buf, size_t len ){
+    while ( len > 0 ){
+      ssize_t n = send( fd, buf, len, MSG_NOSIGNAL );
+      if ( n < 0 ){
+	if ( errno == EINTR ){
+	  continue;
+	}
+	return false;
+      }
+      buf += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  static bool read_all( int fd, char *buf, size_t len ){
+    while ( len > 0 ){
+      ssize_t n = recv( fd, buf, len, 0 );
+      if ( n < 0 ){
+	if ( errno == EINTR ){
+	  continue;
+	}
+	return false;
+      }
+      else if ( n == 0 ){
+	return false; // EOF
+      }
+      buf += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  static bool send_message( int fd, const string& payload ){
+    uint64_t len = payload.size();
+    return write_all( fd, reinterpret_cast<const char*>(&len), sizeof(len) )
+      && write_all( fd, payload.data(), payload.size() );
+  }
+
+  static bool read_message( int fd, string& payload ){
+    uint64_t len = 0;
+    if ( !read_all( fd, reinterpret_cast<char*>(&len), sizeof(len) ) ){
+      return false;
+    }
+    payload.resize( len );
+    return read_all( fd, &payload[0], len );
+  }
+
+  template <typename T>
+  static void put( string& buf, const T& val ){
+    buf.append( reinterpret_cast<const char*>(&val), sizeof(T) );
+  }
+
+  template <typename T>
+  static bool get( const string& buf, size_t& pos, T& val ){
+    if ( pos + sizeof(T) > buf.size() ){
+      return false;
+    }
+    memcpy( &val, buf.data() + pos, sizeof(T) );
+    pos += sizeof(T);
+    return true;
+  }
+
+  static void put_distribution( string& buf, const ClassDistribution& dist ){
+    put<uint64_t>( buf, dist.size() );
+    for ( const auto& it : dist ){
+      put<uint64_t>( buf, it.second->Value()->Index() );
+      put<uint64_t>( buf, it.second->Freq() );
+    }
+  }
+
+  static ClassDistribution *get_distribution( const string& buf,
+					      size_t& pos,
+					      const Targets& targets ){
+    uint64_t size = 0;
+    if ( !get( buf, pos, size ) ){
+      return 0;
+    }
+    ClassDistribution *result = new ClassDistribution();
+    for ( uint64_t i=0; i < size; ++i ){
+      uint64_t index = 0;
+      uint64_t freq = 0;
+      if ( !get( buf, pos, index )
+	   || !get( buf, pos, freq ) ){
+	delete result;
+	return 0;
+      }
+      result->SetFreq( targets.ReverseLookup( index ), freq );
+    }
+    return result;
+  }
+
+  ShardSet::~ShardSet(){
+    // closing the sockets tells the shards to stop
+    for ( const auto fd : fds ){
+      close( fd );
+    }
+    for ( const auto pid : pids ){
+      waitpid( pid, 0, 0 );
+    }
+    delete exact;
+  }
+
+  void ShardSet::add( pid_t pid, int fd ){
+    pids.push_back( pid );
+    fds.push_back( fd );
+  }
+
+  void ShardSet::release(){
+    // used in a freshly forked shard: forget about our siblings
+    for ( const auto fd : fds ){
+      close( fd );
+    }
+    fds.clear();
+    pids.clear();
+  }
+
+  bool ShardSet::ready( vector<size_t>& counts ){
+    // wait until all shards have learned their part
+    counts.clear();
+    bool result = true;
+    for ( const auto fd : fds ){
+      string buf;
+      size_t pos = 0;
+      uint8_t ok = 0;
+      uint64_t count = 0;
+      if ( !read_message( fd, buf )
+	   || !get( buf, pos, ok )
+	   || !get( buf, pos, count )
+	   || !ok ){
+	result = false;
+      }
+      counts.push_back( count );
+    }
+    return result;
+  }
+
+  bool ShardSet::query( const Instance& inst,
+			size_t num_feats,
+			const Targets& targets ){
+    // send the instance to all shards, then merge what they found
+    string buf;
+    put<uint64_t>( buf, num_feats );
+    for ( size_t i=0; i < num_feats; ++i ){
+      string val = TiCC::UnicodeToUTF8( inst.FV[i]->name() );
+      put<uint64_t>( buf, val.size() );
+      buf += val;
+    }
+    for ( const auto fd : fds ){
+      if ( !send_message( fd, buf ) ){
+	return false;
+      }
+    }
+    delete exact;
+    exact = 0;
+    nearest.clear();
+    for ( const auto fd : fds ){
+      size_t pos = 0;
+      uint8_t has_exact = 0;
+      uint64_t bands = 0;
+      if ( !read_message( fd, buf )
+	   || !get( buf, pos, has_exact ) ){
+	return false;
+      }
+      if ( has_exact ){
+	ClassDistribution *dist = get_distribution( buf, pos, targets );
+	if ( !dist ){
+	  return false;
+	}
+	if ( exact ){
+	  exact->Merge( *dist );
+	  delete dist;
+	}
+	else {
+	  exact = dist;
+	}
+      }
+      if ( !get( buf, pos, bands ) ){
+	return false;
+      }
+      neighborSet part;
+      part.reserve( bands );
+      for ( uint64_t i=0; i < bands; ++i ){
+	double distance = 0.0;
+	if ( !get( buf, pos, distance ) ){
+	  return false;
+	}
+	ClassDistribution *dist = get_distribution( buf, pos, targets );
+	if ( !dist ){
+	  return false;
+	}
+	part.push_back( distance, *dist );
+	delete dist;
+      }
+      nearest.merge( part );
+    }
+    return true;
+  }
+
+  bool ShardSet::send_ready( int fd, bool ok, size_t count ){
+    string buf;
+    put<uint8_t>( buf, ok );
+    put<uint64_t>( buf, count );
+    return send_message( fd, buf );
+  }
+
+  bool ShardSet::read_query( int fd, vector<UnicodeString>& fields ){
+    string buf;
+    if ( !read_message( fd, buf ) ){
+      return false;
+    }
+    size_t pos = 0;
+    uint64_t num = 0;
+    if ( !get( buf, pos, num ) ){
+      return false;
+    }
+    fields.resize( num );
+    for ( auto& field : fields ){
+      uint64_t len = 0;
+      if ( !get( buf, pos, len )
+	   || pos + len > buf.size() ){
+	return false;
+      }
+      field = TiCC::UnicodeFromUTF8( buf.substr( pos, len ) );
+      pos += len;
+    }
+    return true;
+  }
+
+  bool ShardSet::send_reply( int fd,
+			     const ClassDistribution *exact,
+			     const neighborSet& ns ){
+    string buf;
+    put<uint8_t>( buf, exact != 0 );
+    if ( exact ){
+      put_distribution( buf, *exact );
+    }
+    put<uint64_t>( buf, ns.size() );
+    for ( size_t i=0; i < ns.size(); ++i ){
+      put<double>( buf, ns.getDistance( i ) );
+      put_distribution( buf, *ns.getDistribution( i ) );
+    }
+    return send_message( fd, buf );
+  }
+
+  bool TimblExperiment::ownedByShard( const Instance& inst ){
+    size_t key;
+    if ( shardByFeature ){
+      // the first feature in tree order, which is the top level of the
+      // InstanceBase
+      key = inst.FV[0]->Index();
+    }
+    else {
+      key = shardSeen++;
+    }
+    if ( key % numOfShards == static_cast<size_t>(shardIndex) ){
+      ++shardLearned;
+      return true;
+    }
+    return false;
+  }
+
+  void TimblExperiment::runShard( int num,
+				  int fd,
+				  const string& FileName,
+				  bool warnOnSingleTarget ){
+    // runs in the forked shard process: learn our part of the data and
+    // answer queries until the coordinator closes the connection.
+    static ostream null_stream( nullptr );
+    shardIndex = num;
+    shardSeen = 0;
+    shardLearned = 0;
+    exp_name = "shard-" + TiCC::toString( num );
+    mylog = &null_stream;
+    bool ok = ClassicLearn( FileName, warnOnSingleTarget );
+    if ( ShardSet::send_ready( fd, ok, shardLearned ) && ok ){
+      vector<UnicodeString> fields;
+      while ( ShardSet::read_query( fd, fields )
+	      && fields.size() == EffectiveFeatures() ){
+	CurrInst.clear();
+	unknowns.release();
+	for ( size_t m = 0; m < EffectiveFeatures(); ++m ){
+	  size_t j = features.permutation[m];
+	  CurrInst.FV[m] = features[j]->Lookup( fields[m] );
+	  if ( !CurrInst.FV[m] ){
+	    CurrInst.FV[m] = unknowns.get( fields[m] );
+	  }
+	}
+	const ClassDistribution *ExResultDist = 0;
+	nSet.clear();
+	if ( shardLearned > 0 ){
+	  ExResultDist = ExactMatch( CurrInst );
+	  // the coordinator might need one extra band to resolve a tie
+	  ++num_of_neighbors;
+	  testInstance( CurrInst, InstanceBase );
+	  --num_of_neighbors;
+	  bestArray.initNeighborSet( nSet );
+	}
+	if ( !ShardSet::send_reply( fd, ExResultDist, nSet ) ){
+	  break;
+	}
+      }
+      CurrInst.clear();
+    }
+    close( fd );
+  }
+
+  bool TimblExperiment::ShardedLearn( const string& FileName,
+				      bool warnOnSingleTarget ){
+    // The coordinator does the Prepare phase on all data, so weights,
+    // value distributions and MVDM statistics are global. Then one process
+    // per shard is forked, which learns only its part of the instances.
+    // The coordinator itself keeps an empty InstanceBase.
+    if ( Algorithm() != IB1_a ){
+      Warning( "--shards is only supported for IB1. Ignored" );
+      return ClassicLearn( FileName, warnOnSingleTarget );
+    }
+    if ( doSamples() ){
+      Warning( "--shards is not supported with exemplar weights. Ignored" );
+      return ClassicLearn( FileName, warnOnSingleTarget );
+    }
+    if ( Verbosity( NEAR_N | ALL_K ) ){
+      Warning( "--shards can't be combined with +vn or +vk. Ignored" );
+      return ClassicLearn( FileName, warnOnSingleTarget );
+    }
+    if ( shards ){
+      Warning( "unable to Learn, the InstanceBase is already sharded" );
+      return false;
+    }
+    if ( CurrentDataFile.empty() ){
+      if ( FileName.empty() ){
+	Warning( "unable to build an InstanceBase: No datafile defined yet" );
+	return false;
+      }
+      else if ( !Prepare( FileName, warnOnSingleTarget ) || ExpInvalid() ){
+	return false;
+      }
+    }
+    if ( numOfThreads > 1 ){
+      Warning( "--clones is ignored for a sharded experiment" );
+      numOfThreads = 1;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "\nPhase 3: Learning from Datafile: " + CurrentDataFile
+	    + " in " + TiCC::toString( numOfShards ) + " shards"
+	    + ( shardByFeature ? " (on the first feature)" : "" ) );
+    }
+    // don't let the shards inherit pending output
+    cout.flush();
+    cerr.flush();
+    mylog->flush();
+    myerr->flush();
+    shards = new ShardSet();
+    for ( int i=0; i < numOfShards; ++i ){
+      int sv[2];
+      if ( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 ){
+	Error( "--shards: unable to create a socket: "
+	       + string( strerror(errno) ) );
+	delete shards;
+	shards = 0;
+	return false;
+      }
+      pid_t pid = fork();
+      if ( pid < 0 ){
+	Error( "--shards: unable to start a shard process: "
+	       + string( strerror(errno) ) );
+	close( sv[0] );
+	close( sv[1] );
+	delete shards;
+	shards = 0;
+	return false;
+      }
+      else if ( pid == 0 ){
+	close( sv[0] );
+	shards->release();
+	delete shards;
+	shards = 0;
+	runShard( i, sv[1], FileName, warnOnSingleTarget );
+	_exit( 0 );
+      }
+      close( sv[1] );
+      shards->add( pid, sv[0] );
+    }
+    // the shards have their own copy of the stored instances
+    releaseStore();
+    vector<size_t> counts;
+    if ( !shards->ready( counts ) ){
+      Error( "--shards: learning failed in one of the shard processes" );
+      delete shards;
+      shards = 0;
+      return false;
+    }
+    InitInstanceBase();
+    if ( !Verbosity(SILENT) ){
+      for ( size_t i=0; i < counts.size(); ++i ){
+	Info( "shard " + TiCC::toString( i ) + ": "
+	      + TiCC::toString( counts[i] ) + " instances" );
+      }
+    }
+    return true;
+  }
+
+}
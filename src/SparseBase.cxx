@@ -0,0 +1,159 @@
+/*
+  Copyright (c) 1998 - 2024
+  ILK   - Tilburg University
+  CLST  - Radboud University
+  CLiPS - University of Antwerp
+
+  This file is part of timbl
+
+  timbl is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  timbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/timbl/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#include <vector>
+#include <functional>
+#include <cmath>
+
+#include "timbl/Common.h"
+#include "timbl/Types.h"
+#include "timbl/Instance.h"
+#include "timbl/SparseBase.h"
+
+using namespace std;
+
+namespace Timbl {
+  using namespace Common;
+
+  static size_t hash_values( const vector<activeValue>& values ){
+    size_t result = values.size();
+    for ( const auto& [pos,fv] : values ){
+      result ^= hash<size_t>()( pos ) + 0x9e3779b9 + (result<<6) + (result>>2);
+      result ^= hash<const void*>()( fv ) + 0x9e3779b9
+	+ (result<<6) + (result>>2);
+    }
+    return result;
+  }
+
+  Sparse_InstanceBase::sparseStore::~sparseStore(){
+    for ( const auto *dist : distributions ){
+      delete dist;
+    }
+  }
+
+  Sparse_InstanceBase::Sparse_InstanceBase( size_t depth,
+					    unsigned long int& cnt,
+					    bool rand ):
+    InstanceBase_base( depth, cnt, rand, false ),
+    store( make_shared<sparseStore>() )
+  {
+    store->postings.resize( depth );
+  }
+
+  Sparse_InstanceBase *Sparse_InstanceBase::clone() const {
+    return new Sparse_InstanceBase( Depth, ibCount, Random );
+  }
+
+  Sparse_InstanceBase *Sparse_InstanceBase::Copy() const {
+    Sparse_InstanceBase *result = clone();
+    result->DefAss = DefAss;
+    result->DefaultsValid = DefaultsValid;
+    result->NumOfTails = NumOfTails;
+    result->store = store;
+    delete result->TopDistribution;
+    result->TopDistribution = TopDistribution;
+    return result;
+  }
+
+  void Sparse_InstanceBase::setDefaults( const vector<FeatureValue *>& defs ){
+    // the value of every position which is not active in an entry.
+    // A NULL default means that every entry has an active value there
+    store->defaults = defs;
+  }
+
+  size_t Sparse_InstanceBase::find( const Instance& Inst,
+				    size_t key ) const {
+    // the entry with the same active values as Inst, if any
+    auto range = store->lookup.equal_range( key );
+    for ( auto it = range.first; it != range.second; ++it ){
+      size_t e = it->second;
+      if ( size_t(end(e) - begin(e)) == Inst.Active.size()
+	   && equal( begin(e), end(e), Inst.Active.begin() ) ){
+	return e;
+      }
+    }
+    return size();
+  }
+
+  bool Sparse_InstanceBase::AddInstance( const Instance& Inst ){
+    bool sw_conflict = false;
+    size_t key = hash_values( Inst.Active );
+    size_t e = find( Inst, key );
+    if ( e == size() ){
+      store->values.insert( store->values.end(),
+			    Inst.Active.begin(), Inst.Active.end() );
+      store->starts.push_back( store->values.size() );
+      for ( const auto& [pos,fv] : Inst.Active ){
+	store->postings[pos].push_back( make_pair( e, fv ) );
+      }
+      if ( abs( Inst.ExemplarWeight() ) > Epsilon ){
+	store->distributions.push_back( new WClassDistribution() );
+      }
+      else {
+	store->distributions.push_back( new ClassDistribution );
+      }
+      store->lookup.emplace( key, e );
+      ibCount += Inst.Active.size() + 1;
+      NumOfTails++;
+    }
+    int occ = Inst.Occurrences();
+    if ( abs( Inst.ExemplarWeight() ) > Epsilon ){
+      sw_conflict = store->distributions[e]->IncFreq( Inst.TV, occ,
+						      Inst.ExemplarWeight() );
+    }
+    else {
+      store->distributions[e]->IncFreq( Inst.TV, occ );
+    }
+    TopDistribution->IncFreq( Inst.TV, occ );
+    DefaultsValid = false;
+    return !sw_conflict;
+  }
+
+  const ClassDistribution *Sparse_InstanceBase::ExactMatch( const Instance& Inst ) const {
+    size_t e = find( Inst, hash_values( Inst.Active ) );
+    if ( e == size() ){
+      return 0;
+    }
+    return store->distributions[e];
+  }
+
+  unsigned long int Sparse_InstanceBase::GetSizeInfo( unsigned long int& CurSize,
+						      double &Compression ) const {
+    // every entry and every active value counts as a node, compared with
+    // a tree which has a node for every feature of every entry
+    unsigned long int MaxSize = (Depth+1) * NumOfTails;
+    CurSize = ibCount;
+    Compression = 0.0;
+    if ( MaxSize > 0 ){
+      Compression = 100*(1-(double)CurSize/(double)MaxSize);
+    }
+    return store->values.size() * ( sizeof(activeValue)
+				    + sizeof(sparsePosting) )
+      + size() * ( sizeof(size_t) + sizeof(ClassDistribution *) );
+  }
+
+}
@@ -262,13 +262,32 @@ namespace Timbl {
     }
   }
 
+  StatisticsClass& StatisticsClass::operator=( const StatisticsClass& in ){
+    if ( this != &in ){
+      _data = in.dataLines();
+      _skipped = in.skippedLines();
+      _correct = in.testedCorrect();
+      _tieOk = in.tiedCorrect();
+      _tieFalse = in.tiedFailure();
+      _exact = in.exactMatches();
+    }
+    return *this;
+  }
+
   void StatisticsClass::merge( const StatisticsClass& in ){
-    _data += in._data;
-    _skipped += in._skipped;
-    _correct += in._correct;
-    _tieOk += in._tieOk;
-    _tieFalse += in._tieFalse;
-    _exact += in._exact;
+    _data = dataLines() + in.dataLines();
+    _skipped = skippedLines() + in.skippedLines();
+    _correct = testedCorrect() + in.testedCorrect();
+    _tieOk = tiedCorrect() + in.tiedCorrect();
+    _tieFalse = tiedFailure() + in.tiedFailure();
+    _exact = exactMatches() + in.exactMatches();
+  }
+
+  void statsSnapshot::add( const StatisticsClass& in ){
+    lines += in.dataLines();
+    skipped += in.skippedLines();
+    correct += in.testedCorrect();
+    exact += in.exactMatches();
   }
 
 }
@@ -28,9 +28,12 @@
 #include <algorithm>
 #include <string>
 #include <iostream>
+#include <sstream>
+#include <charconv>
 
 #include <cerrno>
 #include <cfloat>
+#include <cmath>
 #include "ticcutils/StringOps.h"
 #include "timbl/StringOps.h"
 #include "unicode/ustream.h"
@@ -102,6 +105,152 @@ namespace Timbl {
     return out;
   }
 
+  istream& read_line( istream& is,
+		      string& buffer,
+		      UnicodeString& line ){
+    // TiCC::getline(), but re-using the storage of both buffer and line,
+    // so reading a line doesn't allocate once they are large enough.
+    // Plain ASCII is widened in place, anything else is decoded as UTF-8
+    if ( !getline( is, buffer ) ){
+      line.remove();
+      return is;
+    }
+    int32_t len = buffer.size();
+    bool ascii = true;
+    for ( const auto c : buffer ){
+      if ( static_cast<unsigned char>(c) >= 0x80 ){
+	ascii = false;
+	break;
+      }
+    }
+    if ( ascii ){
+      char16_t *buf = line.getBuffer( len );
+      if ( buf ){
+	for ( int32_t i=0; i < len; ++i ){
+	  buf[i] = buffer[i];
+	}
+	line.releaseBuffer( len );
+	return is;
+      }
+    }
+    line = UnicodeString::fromUTF8( buffer );
+    return is;
+  }
+
+  static bool plain_ascii( const char16_t *buf, int32_t len ){
+    for ( int32_t i=0; i < len; ++i ){
+      if ( buf[i] >= 0x80 ){
+	return false;
+      }
+    }
+    return true;
+  }
+
+  void append_string( string& out, const UnicodeString& us ){
+    // append us to out, as 'os << us' would write it. Plain ASCII is
+    // copied directly, anything else goes through the ICU stream conversion
+    const char16_t *buf = us.getBuffer();
+    int32_t len = us.length();
+    if ( !plain_ascii( buf, len ) ){
+      ostringstream os;
+      os << us;
+      out += os.str();
+      return;
+    }
+    size_t pos = out.size();
+    out.resize( pos + len );
+    for ( int32_t i=0; i < len; ++i ){
+      out[pos+i] = static_cast<char>( buf[i] );
+    }
+  }
+
+  void append_code( string& out, const UnicodeString& us ){
+    // append_string( out, CodeToStr( us ) ), without the temporary
+    const char16_t *buf = us.getBuffer();
+    int32_t len = us.length();
+    if ( !plain_ascii( buf, len ) ){
+      append_string( out, CodeToStr( us ) );
+      return;
+    }
+    for ( int32_t i=0; i < len; ++i ){
+      char c = static_cast<char>( buf[i] );
+      if ( c == '\\' && i+1 < len ){
+	++i;
+	switch ( buf[i] ){
+	case '_':
+	  out += ' ';
+	  break;
+	case '\\':
+	  out += '\\';
+	  break;
+	case 't':
+	  out += '\t';
+	  break;
+	default:
+	  out += '\\';
+	  out += static_cast<char>( buf[i] );
+	}
+      }
+      else {
+	out += c;
+      }
+    }
+  }
+
+  void append_double( string& out, double d, int precision, bool showpoint ){
+    // append d the way an ostream with this precision and (no)showpoint
+    // writes it, which is printf's "%.*g" or "%#.*g"
+    char buf[128];
+    auto res = to_chars( buf, buf + sizeof(buf), d,
+			 chars_format::general, precision );
+    if ( res.ec != errc() ){
+      ostringstream os;
+      os.precision( precision );
+      if ( showpoint ){
+	os.setf( ios::showpoint );
+      }
+      os << d;
+      out += os.str();
+      return;
+    }
+    if ( !showpoint || !isfinite( d ) ){
+      out.append( buf, res.ptr - buf );
+      return;
+    }
+    // "%#g" keeps the decimal point and the trailing zeros, which
+    // to_chars() leaves out
+    const char *end = res.ptr;
+    const char *exp = find( static_cast<const char *>(buf), end, 'e' );
+    bool point = false;
+    bool nonzero = false;
+    int digits = 0;
+    for ( const char *p = buf; p != exp; ++p ){
+      if ( *p == '.' ){
+	point = true;
+      }
+      else if ( *p >= '0' && *p <= '9' ){
+	if ( *p != '0' ){
+	  nonzero = true;
+	}
+	if ( nonzero ){
+	  ++digits;
+	}
+      }
+    }
+    if ( !nonzero ){
+      digits = 1; // a zero has one significant digit
+    }
+    out.append( buf, exp - buf );
+    if ( !point ){
+      out += '.';
+    }
+    if ( digits < precision ){
+      out.append( precision - digits, '0' );
+    }
+    out.append( exp, end - exp );
+  }
+
+
   bool nocase_cmp( char c1, char c2 ){
     return toupper(c1) == toupper(c2);
   }
@@ -332,6 +332,8 @@ namespace Timbl {
 					       ibCount,
 					       (RandomSeed()>=0),
 					       KeepDistributions() );
+	InstanceBase->setLoadIndex( treeIndex, Clones() );
+	setLazyLoad();
 	int pos=0;
 	for ( size_t i=0; i < NumOfFeatures(); ++i ){
 	  features[i]->SetWeight( 1.0 );
@@ -385,6 +387,8 @@ namespace Timbl {
 						ibCount,
 						(RandomSeed()>=0),
 						KeepDistributions() );
+	InstanceBase->setLoadIndex( treeIndex, Clones() );
+	setLazyLoad();
 	int pos=0;
 	for ( size_t i=0; i < NumOfFeatures(); ++i ){
 	  features[i]->SetWeight( 1.0 );
@@ -41,6 +41,7 @@
 #include "timbl/Common.h"
 #include "timbl/Types.h"
 #include "timbl/Targets.h"
+#include "timbl/StringOps.h"
 
 using namespace std;
 using namespace icu;
@@ -94,30 +95,38 @@ namespace Timbl {
     return 0.0;
   }
 
+  void append_value( string& out, const ValueClass *vc ){
+    // append vc like operator<<( ostream&, ValueClass const * ) writes it
+    if ( vc ){
+      append_string( out, vc->name() );
+    }
+    else {
+      out += "*FV-NF*";
+    }
+  }
+
   void ClassDistribution::DistToString( string& DistStr, double minf ) const {
-    ostringstream oss;
-    oss.setf(ios::showpoint);
+    // formats the numbers like an ostream with showpoint set
+    DistStr = "{ ";
     bool first = true;
-    oss << "{ ";
     for ( const auto& it : distribution ){
       const Vfield *f = it.second;
       if ( f->frequency >= minf ){
 	if ( !first ){
-	  oss << ", ";
+	  DistStr += ", ";
 	}
-	oss << f->value << " " << double(f->frequency);
+	append_value( DistStr, f->value );
+	DistStr += ' ';
+	append_double( DistStr, double(f->frequency), 6, true );
 	first = false;
       }
     }
-    oss << " }";
-    DistStr = oss.str();
+    DistStr += " }";
   }
 
   void WClassDistribution::DistToString( string& DistStr, double minw ) const {
-    ostringstream oss;
-    oss.setf(ios::showpoint);
+    DistStr = "{ ";
     bool first = true;
-    oss << "{ ";
     for( const auto& it : distribution ){
       const Vfield *f = it.second;
       if ( abs(f->weight) < minw ){
@@ -127,13 +136,14 @@ namespace Timbl {
 	continue;
       }
       if ( !first ){
-	oss << ", ";
+	DistStr += ", ";
       }
-      oss << f->value << " " << f->weight;
+      append_value( DistStr, f->value );
+      DistStr += ' ';
+      append_double( DistStr, f->weight, 6, true );
       first = false;
     }
-    oss << " }";
-    DistStr = oss.str();
+    DistStr += " }";
   }
 
   class dblCmp {
@@ -267,6 +277,28 @@ namespace Timbl {
     return res;
   }
 
+  void ClassDistribution::release( ClassDistribution *dist ){
+    // drop one user of dist, deleting it when it was the last
+    if ( dist ){
+      if ( dist->users > 1 ){
+	--dist->users;
+      }
+      else {
+	delete dist;
+      }
+    }
+  }
+
+  ClassDistribution *ClassDistribution::Replicate() const {
+    // an exact copy, of the same (weighted or not) type
+    ClassDistribution *result = clone();
+    for ( const auto& [key,vdf] : distribution ){
+      result->distribution[key] = new Vfield( *vdf );
+    }
+    result->total_items = total_items;
+    return result;
+  }
+
   WClassDistribution *WClassDistribution::to_WVD_Copy( ) const {
     WClassDistribution *result = new WClassDistribution();
     for ( const auto& [key,vdf] : distribution ){
@@ -286,82 +318,97 @@ namespace Timbl {
   // First hashed variant:
   //
 
-  const string ClassDistribution::SaveHashed() const{
-    ostringstream oss;
-    oss << "{ ";
+  void ClassDistribution::SaveHashedTo( string& out ) const{
+    out += "{ ";
     bool first = true;
     for ( const auto& it : distribution ){
       const Vfield *f = it.second;
       if ( f->frequency > 0 ){
 	if ( !first ){
-	  oss << ", ";
+	  out += ", ";
 	}
-	oss << f->value->Index() << " " << f->frequency;
+	out += to_string( f->value->Index() );
+	out += ' ';
+	out += to_string( f->frequency );
 	first = false;
       }
     }
-    oss << " }";
-    return oss.str();
+    out += " }";
   }
 
-  const string WClassDistribution::SaveHashed() const{
-    ostringstream oss;
+  void WClassDistribution::SaveHashedTo( string& out ) const{
+    out += "{ ";
     bool first = true;
-    oss << "{ ";
     for ( const auto& it : distribution ){
       const Vfield *f = it.second;
       if ( f->frequency > 0 ){
 	if ( !first ){
-	  oss << ", ";
+	  out += ", ";
 	}
-	oss << f->Value()->Index() << " "
-	    << f->frequency << " " << f->weight;
+	out += to_string( f->Value()->Index() );
+	out += ' ';
+	out += to_string( f->frequency );
+	out += ' ';
+	append_double( out, f->weight, 6, false );
 	first = false;
       }
     }
-    oss << " }";
-    return oss.str();
+    out += " }";
+  }
+
+  const string ClassDistribution::SaveHashed() const{
+    string result;
+    SaveHashedTo( result );
+    return result;
   }
 
   //
   // non-hashed variant:
   //
 
-  const string ClassDistribution::Save() const{
-    ostringstream oss;
-    oss << "{ ";
+  void ClassDistribution::SaveTo( string& out ) const{
+    out += "{ ";
     bool first = true;
     for ( const auto& it : distribution ){
       const Vfield *f = it.second;
       if ( f->frequency > 0 ){
 	if ( !first ){
-	  oss << ", ";
+	  out += ", ";
 	}
-	oss << f->value << " " << f->frequency;
+	append_value( out, f->value );
+	out += ' ';
+	out += to_string( f->frequency );
 	first = false;
       }
     }
-    oss << " }";
-    return oss.str();
+    out += " }";
   }
 
-  const string WClassDistribution::Save() const{
-    ostringstream oss;
-    oss << "{ ";
+  void WClassDistribution::SaveTo( string& out ) const{
+    // the weights are written like an ostream with showpoint set
+    out += "{ ";
     bool first = true;
     for ( const auto& it : distribution ){
       const Vfield *f = it.second;
       if ( f->frequency > 0 ){
 	if ( !first ){
-	  oss << ", ";
+	  out += ", ";
 	}
-	oss.setf(ios::showpoint);
-	oss << f->value << " " << f->frequency << " " << f->weight;
+	append_value( out, f->value );
+	out += ' ';
+	out += to_string( f->frequency );
+	out += ' ';
+	append_double( out, f->weight, 6, true );
 	first = false;
       }
     }
-    oss << " }";
-    return oss.str();
+    out += " }";
+  }
+
+  const string ClassDistribution::Save() const{
+    string result;
+    SaveTo( result );
+    return result;
   }
 
   void ClassDistribution::SetFreq( const TargetValue *val, const int freq,
@@ -620,6 +667,11 @@ namespace Timbl {
     if ( nextCh != '{' ){
       throw runtime_error( "missing '{' in distribution string." );
     }
+    else if ( look_ahead(is) == '}' ){
+      // all instances of this branch were removed (Decrement/Remove)
+      is >> nextCh;
+      result = new ClassDistribution();
+    }
     else {
       int next;
       do {
@@ -694,6 +746,11 @@ namespace Timbl {
     if ( nextCh != '{' ){
       throw runtime_error( "missing '{' in distribution string." );
     }
+    else if ( look_ahead(is) == '}' ){
+      // all instances of this branch were removed (Decrement/Remove)
+      is >> nextCh;
+      result = new ClassDistribution();
+    }
     else {
       int next;
       do {
@@ -858,6 +915,47 @@ namespace Timbl {
     return result;
   }
 
+  DistributionPool::~DistributionPool(){
+    for ( const auto& d : dists ){
+      delete d;
+    }
+  }
+
+  string DistributionPool::key( const ClassDistribution *dist ){
+    // the exact content of dist, weights and type included
+    string key( 1,
+		dynamic_cast<const WClassDistribution*>( dist ) ? 'W' : 'C' );
+    size_t total = dist->totalSize();
+    key.append( reinterpret_cast<const char*>(&total), sizeof(total) );
+    for ( const auto& [index,vdf] : *dist ){
+      size_t freq = vdf->Freq();
+      double weight = vdf->Weight();
+      key.append( reinterpret_cast<const char*>(&index), sizeof(index) );
+      key.append( reinterpret_cast<const char*>(&freq), sizeof(freq) );
+      key.append( reinterpret_cast<const char*>(&weight), sizeof(weight) );
+    }
+    return key;
+  }
+
+  ClassDistribution *DistributionPool::intern( ClassDistribution *dist ){
+    // takes ownership of dist. Returns the pooled distribution with the
+    // same content, deleting dist when there already is one
+    auto [it,fresh] = index.emplace( key( dist ), dist );
+    if ( fresh ){
+      dists.push_back( dist );
+      num_entries += dist->size();
+    }
+    else {
+      delete dist;
+    }
+    return it->second;
+  }
+
+  void DistributionPool::freeze(){
+    // done interning: the index is not needed anymore
+    unordered_map<string, ClassDistribution *>().swap( index );
+  }
+
   bool Targets::increment_value( TargetValue *TV ){
     bool result = false;
     if ( TV ){
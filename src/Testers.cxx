@@ -27,12 +27,16 @@
 #include <vector>
 #include <string>
 #include <iosfwd>
+#include <algorithm>
+#include <numeric>
+#include <cfloat>
 
 #include "timbl/Common.h"
 #include "timbl/Types.h"
 #include "timbl/Instance.h"
 #include "timbl/Metrics.h"
 #include "timbl/Testers.h"
+#include "timbl/SparseBase.h"
 
 using namespace std;
 using Common::Epsilon;
@@ -164,6 +168,11 @@ namespace Timbl{
       cerr << "feature " << TrueF << " (perm=" << permutation[TrueF]
 	   << ")" << endl;
 #endif
+      if ( (*FV)[TrueF] == G[i] ){
+	// the same value, so a distance of 0. Very common for sparse data
+	distances[i+1] = distances[i];
+	continue;
+      }
       double result = metricTest[permutation[TrueF]]->test( (*FV)[TrueF],
 							    G[i],
 							    permFeatures[TrueF] );
@@ -196,14 +205,34 @@ namespace Timbl{
     return false;
   }
 
-  double innerProduct( const FeatureValue *FV,
-		       const FeatureValue *G ) {
+  bool realValues::get( const FeatureValue *FV,
+			double& result ){
+    // FV_to_real(), but remember the outcome for every known value
+    if ( !FV || FV->Index() == 0 ){
+      return FV_to_real( FV, result );
+    }
+    size_t index = FV->Index();
+    if ( index >= status.size() ){
+      status.resize( index+1, 0 );
+      values.resize( index+1, 0.0 );
+    }
+    if ( status[index] == 0 ){
+      double val = 0.0;
+      status[index] = FV_to_real( FV, val ) ? 1 : 2;
+      values[index] = val;
+    }
+    result = values[index];
+    return status[index] == 1;
+  }
+
+  double SimilarityTester::innerProduct( const FeatureValue *FV,
+					 const FeatureValue *G ) {
     double r1=0, r2=0, result;
 #ifdef DBGTEST_DOT
     cerr << "innerproduct " << FV << " x " << G << endl;
 #endif
-    if ( FV_to_real( FV, r1 ) &&
-	 FV_to_real( G, r2 ) ){
+    if ( reals.get( FV, r1 ) &&
+	 reals.get( G, r2 ) ){
 #ifdef DBGTEST_DOT
       cerr << "innerproduct " << r1 << " x " << r2 << endl;
 #endif
@@ -277,4 +306,339 @@ namespace Timbl{
     return (std::numeric_limits<int>::max() - distances[pos])/std::numeric_limits<int>::max();;
   }
 
+  SparseTester::SparseTester( MetricType m,
+			      const Feature_List& features,
+			      int mvdmThreshold ):
+    metric( m ),
+    permutation( features.permutation ),
+    base( 0 ),
+    prepared( 0 ),
+    generation( 0 ),
+    inst( 0 ),
+    inst_value( 0.0 )
+  {
+    size_t size = features.feats.size();
+    permFeatures.resize( size, 0 );
+    metricTest.resize( size, 0 );
+    for ( size_t j=0; j < size; ++j ){
+      permFeatures[j] = features.feats[features.permutation[j]];
+      if ( features[j]->Ignore() || isSimilarity() ){
+	continue;
+      }
+      if ( features[j]->isStorableMetric() ){
+	metricTest[j] = new valueDiffTestFunction( mvdmThreshold );
+      }
+      else {
+	metricTest[j] = new overlapTestFunction();
+      }
+    }
+  }
+
+  SparseTester::~SparseTester(){
+    for ( const auto& it : metricTest ){
+      delete it;
+    }
+  }
+
+  double SparseTester::term( size_t pos,
+			     const FeatureValue *F,
+			     const FeatureValue *G ) const {
+    // the weighted distance on one position, like DistanceTester::test()
+    if ( F == G ){
+      return 0.0;
+    }
+    return metricTest[permutation[pos]]->test( F, G, permFeatures[pos] );
+  }
+
+  double SparseTester::product( size_t pos,
+				const FeatureValue *F,
+				const FeatureValue *G ){
+    // the weighted inner product on one position, like the
+    // SimilarityTesters
+    double r1=0, r2=0;
+    if ( reals.get( F, r1 ) &&
+	 reals.get( G, r2 ) ){
+      return r1 * r2 * permFeatures[pos]->Weight();
+    }
+    return 0.0;
+  }
+
+  void SparseTester::prepare(){
+    // for every entry the distance to an instance with only default
+    // values, in the order of that distance. For the similarity metrics
+    // its norm.
+    // Done once for our weights, and again when the entries have grown
+    if ( prepared == base->size() ){
+      return;
+    }
+    const vector<FeatureValue *>& defaults = base->defaults();
+    entry_values.resize( base->size() );
+    for ( size_t e = 0; e < base->size(); ++e ){
+      double result = 0.0;
+      for ( auto it = base->begin(e); it != base->end(e); ++it ){
+	if ( isSimilarity() ){
+	  result += product( it->first, it->second, it->second );
+	}
+	else if ( defaults[it->first] ){
+	  result += term( it->first, defaults[it->first], it->second );
+	}
+      }
+      entry_values[e] = result;
+    }
+    order.clear();
+    if ( !isSimilarity() ){
+      order.resize( base->size() );
+      iota( order.begin(), order.end(), 0 );
+      stable_sort( order.begin(), order.end(),
+		   [this]( size_t a, size_t b ){
+		     return entry_values[a] < entry_values[b]; } );
+    }
+    seen.assign( base->size(), 0 );
+    sums.assign( base->size(), 0.0 );
+    generation = 0;
+    prepared = base->size();
+  }
+
+  void SparseTester::init( const Sparse_InstanceBase& ib,
+			   const vector<activeValue>& active ){
+    if ( base != &ib ){
+      base = &ib;
+      prepared = 0;
+    }
+    prepare();
+    inst = &active;
+    ++generation;
+    // the distance of the instance to one with only default values, or
+    // its norm
+    const vector<FeatureValue *>& defaults = base->defaults();
+    inst_value = 0.0;
+    for ( const auto& [pos,fv] : active ){
+      if ( isSimilarity() ){
+	inst_value += product( pos, fv, fv );
+      }
+      else if ( defaults[pos] ){
+	inst_value += term( pos, fv, defaults[pos] );
+      }
+    }
+  }
+
+  const FeatureValue *SparseTester::value( size_t pos ) const {
+    // the value of the instance on position pos
+    auto it = lower_bound( inst->begin(), inst->end(), pos,
+			   []( const activeValue& av, size_t p ){
+			     return av.first < p; } );
+    if ( it != inst->end() && it->first == pos ){
+      return it->second;
+    }
+    return base->defaults()[pos];
+  }
+
+  double SparseTester::distance( size_t e, double Threshold ) const {
+    // DistanceTester::test() over the union of the active positions.
+    // Stops as soon as the Threshold is exceeded
+    const vector<FeatureValue *>& defaults = base->defaults();
+    double result = 0.0;
+    auto x = inst->begin();
+    auto y = base->begin(e);
+    auto y_end = base->end(e);
+    while ( x != inst->end() || y != y_end ){
+      if ( y == y_end
+	   || ( x != inst->end() && x->first < y->first ) ){
+	result += term( x->first, x->second, defaults[x->first] );
+	++x;
+      }
+      else if ( x == inst->end() || y->first < x->first ){
+	result += term( y->first, defaults[y->first], y->second );
+	++y;
+      }
+      else {
+	result += term( x->first, x->second, y->second );
+	++x;
+	++y;
+      }
+      if ( result > Threshold ){
+	break;
+      }
+    }
+    return result;
+  }
+
+  double SparseTester::similarity( double result, size_t e ) const {
+    // the distance for an inner product, like CosineTester and
+    // DotProductTester calculate it
+    if ( metric == Cosine ){
+      double denom = sqrt( inst_value * entry_values[e] );
+      return 1.0 - result / (denom + Common::Epsilon);
+    }
+    return (std::numeric_limits<int>::max() - result)/std::numeric_limits<int>::max();
+  }
+
+  bool SparseTester::treeOrder( size_t a, size_t b ) const {
+    // the order in which a tree search would visit entries a and b:
+    // on the first position where they differ, the one with the value of
+    // our instance goes first, otherwise the lowest value
+    const vector<FeatureValue *>& defaults = base->defaults();
+    auto pa = base->begin(a);
+    auto pa_end = base->end(a);
+    auto pb = base->begin(b);
+    auto pb_end = base->end(b);
+    while ( pa != pa_end || pb != pb_end ){
+      size_t pos;
+      const FeatureValue *va;
+      const FeatureValue *vb;
+      if ( pb == pb_end
+	   || ( pa != pa_end && pa->first < pb->first ) ){
+	pos = pa->first;
+	va = pa->second;
+	vb = defaults[pos];
+	++pa;
+      }
+      else if ( pa == pa_end || pb->first < pa->first ){
+	pos = pb->first;
+	va = defaults[pos];
+	vb = pb->second;
+	++pb;
+      }
+      else {
+	pos = pa->first;
+	va = pa->second;
+	vb = pb->second;
+	++pa;
+	++pb;
+      }
+      if ( va != vb ){
+	const FeatureValue *own = value( pos );
+	if ( va == own ){
+	  return true;
+	}
+	if ( vb == own ){
+	  return false;
+	}
+	return va->before( vb );
+      }
+    }
+    return false;
+  }
+
+  static double add_distance( vector<double>& bests, double Distance ){
+    // keep the k best distances, like BestArray::addResult() does.
+    // returns the worst of them
+    for ( size_t k = 0; k < bests.size(); ++k ){
+      if ( fabs( Distance - bests[k] ) < Epsilon ){
+	break;
+      }
+      else if ( Distance < bests[k] ){
+	bests.pop_back();
+	bests.insert( bests.begin() + k, Distance );
+	break;
+      }
+    }
+    return bests.back();
+  }
+
+  void SparseTester::nearest( vector<double>& bests,
+			      vector<pair<double,size_t>>& found ){
+    // first the entries which share an active position with our
+    // instance, then the others, from near to far. Those are at the sum
+    // of their and our distance to the default values, at least. So we
+    // may stop when that exceeds the distance of the k-th neighbor.
+    const vector<FeatureValue *>& defaults = base->defaults();
+    double Threshold = DBL_MAX;
+    for ( const auto& [pos,fv] : *inst ){
+      if ( !defaults[pos] ){
+	continue;
+      }
+      for ( const auto& [e,val] : base->postings( pos ) ){
+	if ( seen[e] == generation ){
+	  continue;
+	}
+	seen[e] = generation;
+	if ( base->distribution(e)->ZeroDist() ){
+	  continue;
+	}
+	double result = distance( e, Threshold + Epsilon );
+	if ( result <= Threshold + Epsilon ){
+	  found.push_back( make_pair( result, e ) );
+	  Threshold = add_distance( bests, result );
+	}
+      }
+    }
+    for ( const auto e : order ){
+      if ( seen[e] == generation ){
+	continue;
+      }
+      double bound = inst_value + entry_values[e];
+      // allow for rounding, the bound is summed in another order
+      if ( bound - bound * 1.0e-9 > Threshold + Epsilon ){
+	break;
+      }
+      if ( base->distribution(e)->ZeroDist() ){
+	continue;
+      }
+      double result = distance( e, Threshold + Epsilon );
+      if ( result <= Threshold + Epsilon ){
+	found.push_back( make_pair( result, e ) );
+	Threshold = add_distance( bests, result );
+      }
+    }
+  }
+
+  void SparseTester::similar( vector<double>& bests,
+			      vector<pair<double,size_t>>& found ){
+    // sum the inner products of the entries which share an active
+    // position with our instance. All the others have a product of 0
+    vector<size_t> shared;
+    for ( const auto& [pos,fv] : *inst ){
+      for ( const auto& [e,val] : base->postings( pos ) ){
+	if ( seen[e] != generation ){
+	  seen[e] = generation;
+	  sums[e] = 0.0;
+	  shared.push_back( e );
+	}
+	sums[e] += product( pos, fv, val );
+      }
+    }
+    for ( const auto e : shared ){
+      if ( !base->distribution(e)->ZeroDist() ){
+	double result = similarity( sums[e], e );
+	found.push_back( make_pair( result, e ) );
+	add_distance( bests, result );
+      }
+    }
+    if ( shared.size() < base->size() ){
+      double Threshold = add_distance( bests, similarity( 0.0, 0 ) );
+      if ( similarity( 0.0, 0 ) <= Threshold + Epsilon ){
+	for ( size_t e = 0; e < base->size(); ++e ){
+	  if ( seen[e] != generation
+	       && !base->distribution(e)->ZeroDist() ){
+	    found.push_back( make_pair( similarity( 0.0, e ), e ) );
+	  }
+	}
+      }
+    }
+  }
+
+  void SparseTester::search( size_t k,
+			     vector<pair<double,size_t>>& found ){
+    // find the entries within the distance of the k nearest neighbors,
+    // in the order in which a tree search would find them
+    found.clear();
+    vector<double> bests( k, DBL_MAX );
+    if ( isSimilarity() ){
+      similar( bests, found );
+    }
+    else {
+      nearest( bests, found );
+    }
+    double Threshold = bests.back();
+    found.erase( remove_if( found.begin(), found.end(),
+			    [Threshold]( const pair<double,size_t>& f ){
+			      return f.first > Threshold + Epsilon; } ),
+		 found.end() );
+    stable_sort( found.begin(), found.end(),
+		 [this]( const pair<double,size_t>& a,
+			 const pair<double,size_t>& b ){
+		   return treeOrder( a.second, b.second ); } );
+  }
+
 }
@@ -31,6 +31,7 @@
 #include <iosfwd>
 #include <string>
 #include <fstream>
+#include <sys/stat.h>
 
 #include "config.h"
 #include "ticcutils/CommandLine.h"
@@ -50,6 +51,7 @@ bool Do_NS = false;
 bool Do_Indirect = false;
 bool Do_Save_Perc = false;
 bool Do_Limit = false;
+bool Do_Compact = false;
 size_t limit_val = 0;
 
 string I_Path = "";
@@ -63,6 +65,7 @@ string MatrixInFile = "";
 string MatrixOutFile = "";
 string TreeInFile = "";
 string TreeOutFile = "";
+string BundleOutFile = "";
 string levelTreeOutFile = "";
 int levelTreeLevel = 0;
 string XOutFile = "";
@@ -72,6 +75,7 @@ string WgtOutFile = "";
 string ProbInFile = "";
 string ProbOutFile = "";
 string NamesFile = "";
+string ConvertFile = "";
 
 inline void usage_full(void){
   cerr << "usage: timbl -f data-file {-t test-file} [options]" << endl;
@@ -113,7 +117,23 @@ inline void usage_full(void){
        << endl;
 #ifdef HAVE_OPENMP
   cerr << "--clones=<num> : use 'n' threads for parallel testing" << endl;
+  cerr << "                 and for reading large training files" << endl;
+  cerr << "--numa    : with --clones, use a copy of the InstanceBase per NUMA node"
+       << endl;
 #endif
+  cerr << "--shards=<n>[:rr|:ff] : (IB1 only) split the InstanceBase over 'n'"
+       << " processes," << endl
+       << "            round-robin (rr, default) or on the first feature (ff)"
+       << endl;
+  cerr << "--ingest-limit=<Mb> : keep at most 'Mb' megabytes of training instances"
+       << endl
+       << "            in memory while learning, the rest is spilled to a"
+       << " temporary file." << endl
+       << "            0 means: re-read the datafile instead." << endl;
+  cerr << "--sparse  : (IB1 only) for Sparse and SparseBin data: keep only the"
+       << " active values" << endl
+       << "            of every instance, and search only the instances"
+       << " that share them" << endl;
   cerr << "--Diversify: rescale weight (see docs)" << endl;
   cerr << "-d val    : weight neighbors as function of their distance:"
        << endl;
@@ -129,6 +149,9 @@ inline void usage_full(void){
   cerr << "-L n      : MVDM threshold at level n" << endl;
   cerr << "-R n      : solve ties at random with seed n" << endl;
   cerr << "-t  f     : test using file 'f'" << endl;
+  cerr << "-t  -     : test on standard input (or use a FIFO as 'f')."
+       << " The results" << endl
+       << "            go to standard output, unless -o is given" << endl;
   cerr << "-t leave_one_out:"
        << " test with Leave One Out,using IB1" << endl;
   cerr << " you may add -sloppy to speed up Leave One Out testing (see docs)"
@@ -143,13 +166,22 @@ inline void usage_full(void){
   cerr << "Input options:" << endl;
   cerr << "-f f      : read from Datafile 'f'" << endl;
   cerr << "-f f      : OR: use filenames from 'f' for CV test" << endl;
+  cerr << "            (data and test files may be gzip, xz or zstd compressed)"
+       << endl;
   cerr << "-F format : Assume the specified inputformat" << endl;
   cerr << "            (Compact, C4.5, ARFF, Columns, Tabbed, Binary, Sparse )"
        << endl;
   cerr << "-l n      : length of Features (Compact format only)" << endl;
   cerr << "-i f      : read the InstanceBase from file 'f' "
        << "(skips phase 1 & 2 )"
+       << endl
+       << "            with --clones=n and an index 'f.idx', using n threads"
        << endl;
+  cerr << "--lazy[=mb] : with -i and an index 'f.idx', read the subtrees of an"
+       << " IGTree, TRIBL or TRIBL2 tree" << endl
+       << "              when a test needs them. Keep at most 'mb' MB of them"
+       << endl
+       << "              in memory (default: keep them all)" << endl;
   cerr << "--matrixin=<f> read ValueDifference Matrices from file 'f'" << endl;
   cerr << "-u f      : read value_class probabilities from file 'f'"
        << endl;
@@ -163,8 +195,21 @@ inline void usage_full(void){
   cerr << "Output options:" << endl;
   cerr << "-e n      : estimate time until n patterns tested" << endl;
   cerr << "--Beam=<n> : limit +v db output to n highest-vote classes" << endl;
-  cerr << "-I f      : dump the InstanceBase in file 'f'" << endl;
+  cerr << "-I f      : dump the InstanceBase in file 'f'"
+       << " (and an index in 'f.idx')" << endl;
+  cerr << "--bundle=<f> : store the InstanceBase, weights, arrays, matrices"
+       << " and settings" << endl
+       << "              together in file 'f' (read it back with -i)" << endl;
+  cerr << "--compact : strip what a pruned IGTree keeps but never uses before"
+       << " testing" << endl
+       << "            or writing it with -I or --bundle" << endl;
+  cerr << "--frequency-order : keep the values in the lists of an IB1, IB2,"
+       << " TRIBL or TRIBL2" << endl
+       << "            InstanceBase in order of frequency" << endl;
   cerr << "--matrixout=<f> store ValueDifference Matrices in file 'f'" << endl;
+  cerr << "--binary-tables[=true|false] : write the -W, -U and --matrixout"
+       << " files in binary" << endl
+       << "              (reading detects the format automatically)" << endl;
   cerr << "-X f      : dump the InstanceBase as XML in file 'f'" << endl;
   cerr << "-n f      : create names file 'f'" << endl;
   cerr << "-p n      : show progress every n lines (default p = 100,000)"
@@ -205,8 +250,20 @@ inline void usage_full(void){
        << "             2     : does the same" << endl;
   cerr << "-W f      : calculate and save all Weights in file 'f'" << endl;
   cerr << "+% or -%  : do or don't save test result (%) to file" << endl;
-  cerr << "-o s      : use s as output filename" << endl;
+  cerr << "-o s      : use s as output filename ('-' for standard output)"
+       << endl;
+  cerr << "--flush=<n> : flush the output file after every 'n' results"
+       << endl
+       << "              (default: when waiting for input from a pipe)"
+       << endl;
+  cerr << "--echo-input[=true|false] : start each output line with the test"
+       << " line as read," << endl
+       << "              instead of rebuilding it from the features (default false)"
+       << endl;
   cerr << "-O d      : save output using path 'd'" << endl;
+  cerr << "--convert=<f> : convert the datafile (-f) to a binary instance "
+       << "file 'f'," << endl
+       << "              or a binary instance file back to text" << endl;
   cerr << "Internal representation options:" << endl;
   cerr << "-B n      : number of bins used for discretization of numeric "
        << "feature values (default B=20)" << endl;
@@ -296,6 +353,12 @@ void Preset_Values( TiCC::CL_Options& opts ){
   }
   else {
     algorithm = IB1; // general default
+    if ( opts.is_present( 'i', value ) ){
+      // but a bundle knows its own algorithm
+      string path;
+      opts.is_present( 'P', path );
+      bundle_algorithm( correct_path( value, path ), algorithm );
+    }
   }
   opts.insert( 'a', to_string( algorithm ), false );
   if ( opts.extract( 'Z', value ) ){
@@ -337,6 +400,9 @@ void Preset_Values( TiCC::CL_Options& opts ){
       throw( hardExit() ); // no chance to proceed
     }
   }
+  if ( opts.extract( "compact" ) ){
+    Do_Compact = true;
+  }
   if ( opts.extract( 'P', value ) ){
     I_Path = value;
   }
@@ -395,6 +461,7 @@ bool get_file_names( TiCC::CL_Options& opts ){
   MatrixOutFile = "";
   TreeInFile = "";
   TreeOutFile = "";
+  BundleOutFile = "";
   levelTreeOutFile = "";
   levelTreeLevel = 0;
   XOutFile = "";
@@ -404,6 +471,7 @@ bool get_file_names( TiCC::CL_Options& opts ){
   ProbInFile = "";
   ProbOutFile = "";
   NamesFile = "";
+  ConvertFile = "";
   string value;
   if ( opts.extract( 'P', value ) || opts.extract( 'f', value ) ){
     cerr << "illegal option, value = " << value << endl;
@@ -424,11 +492,19 @@ bool get_file_names( TiCC::CL_Options& opts ){
     TestFile = dataFile;
   }
   else if ( opts.extract( 't', value ) ){
-    TestFile = correct_path( value, I_Path );
+    if ( value == "-" ){
+      TestFile = value; // standard input
+    }
+    else {
+      TestFile = correct_path( value, I_Path );
+    }
   }
   if ( opts.extract( 'n', value ) ){
     NamesFile = correct_path( value, O_Path );
   }
+  if ( opts.extract( "convert", value ) ){
+    ConvertFile = correct_path( value, O_Path );
+  }
   if ( opts.extract( "matrixout", value ) ){
     MatrixOutFile = correct_path( value, O_Path );
   }
@@ -440,7 +516,12 @@ bool get_file_names( TiCC::CL_Options& opts ){
       cerr << "-o option not possible for Cross Validation testing" << endl;
       return false;
     }
-    OutputFile = correct_path( value, O_Path );
+    if ( value == "-" ){
+      OutputFile = value; // standard output
+    }
+    else {
+      OutputFile = correct_path( value, O_Path );
+    }
   }
   if ( opts.extract( "IL", value ) ){
     vector<string> vec = TiCC::split_at( value, ":" );
@@ -455,6 +536,9 @@ bool get_file_names( TiCC::CL_Options& opts ){
   if ( opts.extract( 'I', value ) ){
     TreeOutFile = correct_path( value, O_Path );
   }
+  if ( opts.extract( "bundle", value ) ){
+    BundleOutFile = correct_path( value, O_Path );
+  }
   if ( opts.extract( 'X', value ) ){
     XOutFile = correct_path( value, O_Path );
   }
@@ -504,7 +588,18 @@ bool get_file_names( TiCC::CL_Options& opts ){
 }
 
 bool Default_Output_Names( TiCC::CL_Options& opts ){
-  if ( OutputFile == "" && TestFile != "" ){
+  if ( OutputFile == "" && TestFile == "-" ){
+    // streaming: from standard input to standard output
+    OutputFile = "-";
+  }
+  if ( OutputFile == "-" ){
+    if ( Do_Save_Perc ){
+      cerr << "Warning: +% is ignored when writing to standard output"
+	   << endl;
+    }
+    PercFile = "";
+  }
+  else if ( OutputFile == "" && TestFile != "" ){
     string value;
     string temp = correct_path( TestFile, O_Path, false );
     temp += ".";
@@ -682,6 +777,12 @@ void Do_Test( TimblAPI *Run ){
 }
 
 bool checkInputFile( const string& name ){
+  struct stat st;
+  if ( name == "-"
+       || ( stat( name.c_str(), &st ) == 0 && S_ISFIFO( st.st_mode ) ) ){
+    // don't touch standard input or a FIFO: there is only one reader
+    return true;
+  }
   if ( !name.empty() ){
     ifstream is( name );
     if ( !is.good() ){
@@ -739,12 +840,23 @@ int main(int argc, char *argv[]){
       return 3;
     }
     Default_Output_Names( opts );
+    if ( OutputFile == "-" ){
+      // keep standard output clean for the results
+      Run->SetLogStream( cerr );
+    }
     vector<string> mas = opts.getMassOpts();
     if ( !mas.empty() ){
       cerr << "unknown value in option string: " << mas[0] << endl;
       usage();
       return 33;
     }
+    if ( !ConvertFile.empty() ){
+      bool ok = checkInputFile( dataFile )
+	&& checkOutputFile( ConvertFile )
+	&& Run->ConvertInstances( dataFile, ConvertFile );
+      delete Run;
+      return ok ? EXIT_SUCCESS : 3;
+    }
     if ( Do_CV ){
       if ( checkInputFile( TestFile ) ){
 	Run->CVprepare( WgtInFile, WgtType, ProbInFile );
@@ -761,6 +873,7 @@ int main(int argc, char *argv[]){
 	   !checkInputFile( MatrixInFile ) ||
 	   !checkInputFile( ProbInFile ) ||
 	   !checkOutputFile( TreeOutFile ) ||
+	   !checkOutputFile( BundleOutFile ) ||
 	   !checkOutputFile( levelTreeOutFile ) ||
 	   !checkOutputFile( XOutFile ) ||
 	   !checkOutputFile( NamesFile ) ||
@@ -793,6 +906,9 @@ int main(int argc, char *argv[]){
 		 << "the data with option: -m" << m_val << endl;
 	    delete Run;
 	    Run = new TimblAPI( opts );
+	    if ( OutputFile == "-" ){
+	      Run->SetLogStream( cerr );
+	    }
 	  }
 	  if ( WgtOutFile != "" ) {
 	    Run->SaveWeights( WgtOutFile );
@@ -809,6 +925,7 @@ int main(int argc, char *argv[]){
 	  if ( do_test ||     // something to test ?
 	       MatrixOutFile != "" || // or at least to produce
 	       TreeOutFile != "" || // or at least to produce
+	       BundleOutFile != "" || // or at least to produce
 	       levelTreeOutFile != "" || // or at least to produce
 	       XOutFile != "" ){ // or at least to produce
 	    bool ok = true;
@@ -823,9 +940,15 @@ int main(int argc, char *argv[]){
 	      }
 	    }
 	    if ( ok && Run->Learn( dataFile ) ){
+	      if ( Do_Compact ){
+		Run->CompactInstanceBase();
+	      }
 	      if ( TreeOutFile != "" ){
 		Run->WriteInstanceBase( TreeOutFile );
 	      }
+	      if ( BundleOutFile != "" ){
+		Run->WriteBundle( BundleOutFile );
+	      }
 	      if ( levelTreeOutFile != "" ){
 		Run->WriteInstanceBaseLevels( levelTreeOutFile,
 					      levelTreeLevel );
@@ -838,7 +961,8 @@ int main(int argc, char *argv[]){
 	}
       }
       else if ( !dataFile.empty() &&
-		!( TestFile.empty() && TreeOutFile.empty() && levelTreeOutFile.empty() ) ){
+		!( TestFile.empty() && TreeOutFile.empty()
+		   && BundleOutFile.empty() && levelTreeOutFile.empty() ) ){
 	// it seems we want to expand our tree
 	do_test = false;
 	if ( Run->GetInstanceBase( TreeInFile ) ) {
@@ -846,6 +970,9 @@ int main(int argc, char *argv[]){
 	    if ( !TreeOutFile.empty() ){
 	      Run->WriteInstanceBase( TreeOutFile );
 	    }
+	    if ( !BundleOutFile.empty() ){
+	      Run->WriteBundle( BundleOutFile );
+	    }
 	    if ( levelTreeOutFile != "" ){
 	      Run->WriteInstanceBaseLevels( levelTreeOutFile,
 					    levelTreeLevel );
@@ -857,17 +984,26 @@ int main(int argc, char *argv[]){
       else {
 	// normal case
 	//   running a testing phase from recovered tree
-	if ( TestFile.empty()
-	     && XOutFile == ""
-	     && !Do_Indirect ){
+	bool testing = !TestFile.empty() || XOutFile != "" || Do_Indirect;
+	bool compacting = Do_Compact
+	  && !( TreeOutFile.empty() && BundleOutFile.empty() );
+	if ( !testing && !compacting ){
 	  cerr << "reading an instancebase(-i option) without a testfile (-t option) is useless" << endl;
 	  do_test = false;
 	}
 	else {
-	  do_test = true;
-	}
-	if ( do_test ){
 	  do_test = Run->GetInstanceBase( TreeInFile );
+	  if ( do_test && Do_Compact ){
+	    // offline compaction: read, compact and write it again
+	    Run->CompactInstanceBase();
+	    if ( !TreeOutFile.empty() ){
+	      Run->WriteInstanceBase( TreeOutFile );
+	    }
+	    if ( !BundleOutFile.empty() ){
+	      Run->WriteBundle( BundleOutFile );
+	    }
+	  }
+	  do_test = do_test && testing;
 	}
       }
       if ( do_test ){
@@ -35,6 +35,7 @@
 #include "timbl/BestArray.h"
 #include "timbl/Statistics.h"
 #include "timbl/MBLClass.h"
+#include "timbl/IBtree.h"
 #include "ticcutils/CommandLine.h"
 #include "timbl/GetOptClass.h"
 
@@ -43,6 +44,7 @@ using namespace icu;
 
 #include "timbl/TimblAPI.h"
 #include "timbl/TimblExperiment.h"
+#include "timbl/ModelBundle.h"
 
 namespace Timbl {
 
@@ -80,16 +82,16 @@ namespace Timbl {
   }
 
   TimblAPI::TimblAPI( const TimblAPI& exp ):
-    pimpl( exp.pimpl->splitChild() ), i_am_fine(true) {
+    pimpl( exp.pimpl->splitChild() ), pool(0), i_am_fine(true) {
   }
 
   TimblAPI::TimblAPI( ):
-    pimpl( 0 ), i_am_fine(false) {
+    pimpl( 0 ), pool(0), i_am_fine(false) {
   }
 
   TimblAPI::TimblAPI( const TiCC::CL_Options& opts,
 		      const string& name ):
-    pimpl(), i_am_fine(false) {
+    pimpl(), pool(0), i_am_fine(false) {
     GetOptClass *OptPars = new GetOptClass( opts );
     if ( !OptPars->parse_options( opts ) ){
       delete OptPars;
@@ -105,7 +107,7 @@ namespace Timbl {
 
   TimblAPI::TimblAPI( const string& pars,
 		      const string& name ):
-    pimpl(), i_am_fine(false){
+    pimpl(), pool(0), i_am_fine(false){
     TiCC::CL_Options Opts;
     Opts.init( pars );
     GetOptClass *OptPars = new GetOptClass( Opts );
@@ -120,8 +122,83 @@ namespace Timbl {
     i_am_fine = (pimpl != NULL);
   }
 
+  struct originDeleter {
+    // deletes the origin of a set of forks, unless it is taken back
+    // by grabAndDisconnectExp()
+    bool owner = true;
+    void operator()( TimblExperiment *exp ) const {
+      if ( owner ){
+	delete exp;
+      }
+    }
+  };
+
+  unique_ptr<TimblAPI> TimblAPI::Fork(){
+    // a cheap copy of a trained experiment, which shares our InstanceBase
+    // and may be tested with other settings. Forks may run concurrently.
+    // They keep the shared experiment alive, and we may not change it
+    // while they exist. A fork logs nothing, until SetLogStream() is used
+    unique_ptr<TimblAPI> result;
+    if ( Valid() ){
+      TimblExperiment *exp = pimpl->Fork();
+      if ( exp ){
+	if ( !fork_origin ){
+	  fork_origin.reset( pimpl, originDeleter() );
+	}
+	result.reset( new TimblAPI() );
+	result->pimpl = exp;
+	result->i_am_fine = true;
+	result->fork_origin = fork_origin;
+      }
+    }
+    return result;
+  }
+
+  bool TimblAPI::hasForks() const {
+    return fork_origin
+      && fork_origin.get() == pimpl
+      && fork_origin.use_count() > 1;
+  }
+
+  bool TimblAPI::notForked( const string& what ) const {
+    if ( pimpl->IsFork() ){
+      pimpl->Warning( what + " is not possible on a fork, "
+		      "it shares the InstanceBase of its parent" );
+      return false;
+    }
+    else if ( hasForks() ){
+      pimpl->Warning( what + " is not possible while forks of this "
+		      "experiment exist, they share its InstanceBase" );
+      return false;
+    }
+    return true;
+  }
+
+  TimblExperiment *TimblAPI::grabAndDisconnectExp(){
+    TimblExperiment *res = 0;
+    if ( Valid() ){
+      if ( fork_origin ){
+	if ( pimpl->IsFork() || hasForks() ){
+	  pimpl->Warning( "unable to disconnect an experiment that shares "
+			  "its InstanceBase with forks" );
+	  return 0;
+	}
+	get_deleter<originDeleter>( fork_origin )->owner = false;
+	fork_origin.reset();
+      }
+      res = pimpl;
+      pimpl = 0;
+    }
+    return res;
+  }
+
   TimblAPI::~TimblAPI(){
-    delete pimpl;
+    delete pool;
+    if ( fork_origin.get() != pimpl ){
+      // a fork, or never forked.
+      // The origin is deleted with the last fork_origin reference
+      delete pimpl;
+    }
   }
 
   bool TimblAPI::Valid() const {
@@ -163,6 +240,16 @@ namespace Timbl {
     return result;
   }
 
+  bool bundle_algorithm( const string& name, Algorithm& A ){
+    // when name is a valid bundle, get the algorithm it was made with
+    if ( !BundleReader::detect( name ) ){
+      return false;
+    }
+    BundleReader bundle;
+    return bundle.open( name )
+      && string_to( bundle.header().value( "algorithm", "" ), A );
+  }
+
   bool string_to( const string& s, Algorithm& A ){
     A = UNKNOWN_ALG;
     AlgorithmType tmp;
@@ -291,7 +378,7 @@ namespace Timbl {
   }
 
   bool TimblAPI::Learn( const string& s ){
-    if ( Valid() ){
+    if ( Valid() && notForked( "Learn" ) ){
       return pimpl->Learn( s );
     }
     else {
@@ -300,7 +387,7 @@ namespace Timbl {
   }
 
   bool TimblAPI::Prepare( const string& s ){
-    if ( Valid() ){
+    if ( Valid() && notForked( "Prepare" ) ){
       return pimpl->Prepare( s );
     }
     else {
@@ -309,7 +396,7 @@ namespace Timbl {
   }
 
   bool TimblAPI::CVprepare( const string& wf, Weighting w, const string& pf ){
-    if ( Valid() ){
+    if ( Valid() && notForked( "CVprepare" ) ){
       WeightType tmp;
       switch ( w ){
       case UNKNOWN_W: tmp = Unknown_w;
@@ -338,26 +425,32 @@ namespace Timbl {
 
 
   bool TimblAPI::Increment_u( const UnicodeString& us ){
-    return Valid() && pimpl->Increment( us );
+    return Valid() && notForked( "Increment" )
+      && pimpl->Increment( us );
   }
 
   bool TimblAPI::Increment( const string& s ){
-    return Valid() && pimpl->Increment( TiCC::UnicodeFromUTF8(s) );
+    return Valid() && notForked( "Increment" )
+      && pimpl->Increment( TiCC::UnicodeFromUTF8(s) );
   }
 
   bool TimblAPI::Decrement_u( const UnicodeString& us ){
-    return Valid() && pimpl->Decrement( us );
+    return Valid() && notForked( "Decrement" )
+      && pimpl->Decrement( us );
   }
   bool TimblAPI::Decrement( const string& s ){
-    return Valid() && pimpl->Decrement( TiCC::UnicodeFromUTF8(s) );
+    return Valid() && notForked( "Decrement" )
+      && pimpl->Decrement( TiCC::UnicodeFromUTF8(s) );
   }
 
   bool TimblAPI::Expand( const string& s ){
-    return Valid() && pimpl->Expand( s );
+    return Valid() && notForked( "Expand" )
+      && pimpl->Expand( s );
   }
 
   bool TimblAPI::Remove( const string& s ){
-    return Valid() && pimpl->Remove( s );
+    return Valid() && notForked( "Remove" )
+      && pimpl->Remove( s );
   }
 
   bool TimblAPI::Test( const string& in,
@@ -611,6 +704,78 @@ namespace Timbl {
     }
   }
 
+  bool TimblAPI::StartClassifyPool( int workers, size_t max_queue ){
+    // start 'workers' threads for asynchronous classification, sharing
+    // the current InstanceBase. The experiment itself should not be
+    // modified while the pool is active.
+    if ( !Valid() ){
+      return false;
+    }
+    if ( pool ){
+      pimpl->Warning( "StartClassifyPool: a pool is already running" );
+      return false;
+    }
+    if ( pimpl->Algorithm() == LOO_a || pimpl->Algorithm() == CV_a ){
+      pimpl->Error( "StartClassifyPool: not possible for "
+		    + TiCC::toString( pimpl->Algorithm() ) );
+      return false;
+    }
+    if ( pimpl->Sharded() ){
+      pimpl->Error( "StartClassifyPool: not possible for a sharded "
+		    "InstanceBase" );
+      return false;
+    }
+    if ( workers <= 0 ){
+      pimpl->Error( "StartClassifyPool: number of workers must be > 0" );
+      return false;
+    }
+    if ( pimpl->InstanceBase ){
+      // the workers share the tree, a lazily read one can't be shared
+      pimpl->InstanceBase->LoadAll();
+    }
+    pool = new ClassifyPool( pimpl, workers, max_queue );
+    return true;
+  }
+
+  void TimblAPI::StopClassifyPool(){
+    // waits until all pending instances are handled
+    delete pool;
+    pool = 0;
+  }
+
+  vector<future<classifyResult>> TimblAPI::ClassifyAsync( const vector<string>& lines ){
+    // returns a future for every line. When the queue is full, this blocks
+    // until the workers have made room.
+    if ( Valid() ){
+      if ( pool ){
+	return pool->submit( lines );
+      }
+      pimpl->Warning( "ClassifyAsync: StartClassifyPool was not called" );
+    }
+    return vector<future<classifyResult>>();
+  }
+
+  bool TimblAPI::ClassifyAsync( const vector<string>& lines,
+				const classifyCallback& cb ){
+    // the callback is called with the index and result of every line, in
+    // the same order as 'lines'. It runs in one of the worker threads.
+    if ( Valid() ){
+      if ( pool ){
+	return pool->submit( lines, cb );
+      }
+      pimpl->Warning( "ClassifyAsync: StartClassifyPool was not called" );
+    }
+    return false;
+  }
+
+  ClassifySearch *TimblAPI::NewClassifySearch(){
+    // the caller owns the result, and must delete it before this TimblAPI
+    if ( Valid() ){
+      return new ClassifySearch( pimpl );
+    }
+    return 0;
+  }
+
   double TimblAPI::GetAccuracy() {
     if (Valid()) {
         return pimpl->stats.testedCorrect()/(double) pimpl->stats.dataLines();
@@ -639,10 +804,21 @@ namespace Timbl {
   }
 
   bool TimblAPI::SetOptions( const string& argv ){
+    // new settings would recompute the matrices our forks use
+    if ( hasForks() ){
+      pimpl->Warning( "SetOptions is not possible while forks of this "
+		      "experiment exist" );
+      return false;
+    }
     return Valid() && pimpl->SetOptions( argv );
   }
 
   bool TimblAPI::SetIndirectOptions( const TiCC::CL_Options& opts ){
+    if ( hasForks() ){
+      pimpl->Warning( "SetIndirectOptions is not possible while forks of "
+		      "this experiment exist" );
+      return false;
+    }
     return Valid() && pimpl->IndirectOptions( opts );
   }
 
@@ -674,6 +850,33 @@ namespace Timbl {
     }
   }
 
+  bool TimblAPI::WriteSnapshot( const string& f, size_t compact ){
+    if ( Valid() ){
+      return pimpl->WriteSnapshot( f, compact );
+    }
+    else {
+      return false;
+    }
+  }
+
+  bool TimblAPI::WriteBundle( const string& f ){
+    if ( Valid() ){
+      return pimpl->WriteBundle( f );
+    }
+    else {
+      return false;
+    }
+  }
+
+  bool TimblAPI::CompactInstanceBase(){
+    if ( Valid() && notForked( "CompactInstanceBase" ) ){
+      return pimpl->CompactInstanceBase();
+    }
+    else {
+      return false;
+    }
+  }
+
   bool TimblAPI::WriteInstanceBaseXml( const string& f ){
     if ( Valid() ){
       return pimpl->WriteInstanceBaseXml( f );
@@ -693,7 +896,7 @@ namespace Timbl {
   }
 
   bool TimblAPI::GetInstanceBase( const string& f ){
-    if ( Valid() ){
+    if ( Valid() && notForked( "GetInstanceBase" ) ){
       if ( !pimpl->ReadInstanceBase( f ) ){
 	i_am_fine = false;
       }
@@ -714,7 +917,7 @@ namespace Timbl {
   }
 
   bool TimblAPI::GetArrays( const string& f ){
-    if ( Valid() ){
+    if ( Valid() && notForked( "GetArrays" ) ){
       return pimpl->GetArrays( f );
     }
     else {
@@ -727,7 +930,8 @@ namespace Timbl {
   }
 
   bool TimblAPI::GetMatrices( const string& f ){
-    return Valid() && pimpl->GetMatrices( f );
+    return Valid() && notForked( "GetMatrices" )
+      && pimpl->GetMatrices( f );
   }
 
   bool TimblAPI::ShowBestNeighbors( ostream& os ) const{
@@ -760,6 +964,30 @@ namespace Timbl {
     return Valid() && pimpl->showStatistics( os );
   }
 
+  statsSnapshot TimblAPI::GetLiveStatistics() const {
+    // may be called from another thread while a Test is running
+    if ( Valid() ){
+      return pimpl->liveStatistics();
+    }
+    return statsSnapshot();
+  }
+
+  bool TimblAPI::ConvertInstances( const string& in, const string& out ){
+    // convert the instances in a text file to a binary instance file,
+    // or the other way round
+    return Valid() && pimpl->ConvertInstances( in, out );
+  }
+
+  bool TimblAPI::SetLogStream( ostream& os ){
+    // send the progress and information messages to os instead of cout
+    // (e.g. when the results are written to standard output)
+    if ( Valid() ){
+      pimpl->setLogStream( os );
+      return true;
+    }
+    return false;
+  }
+
   string TimblAPI::extract_limited_m( int lim ) const {
     if ( Valid() ){
       return pimpl->extract_limited_m( lim );
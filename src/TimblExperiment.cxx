@@ -28,10 +28,17 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <limits>
 #include <fstream>
 #include <iomanip>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include <charconv>
 
 #include <cassert>
+#include <cstdio>
 #include <sys/time.h>
 
 #include "config.h"
@@ -47,10 +54,16 @@
 #include "timbl/neighborSet.h"
 #include "timbl/BestArray.h"
 #include "timbl/IBtree.h"
+#include "timbl/SparseBase.h"
 #include "timbl/MBLClass.h"
 #include "timbl/GetOptClass.h"
 #include "timbl/TimblExperiment.h"
+#include "timbl/Shards.h"
+#include "timbl/InstanceStore.h"
+#include "timbl/BinaryTables.h"
+#include "timbl/ModelBundle.h"
 #include "ticcutils/XMLtools.h"
+#include "ticcutils/UniHash.h"
 #include "ticcutils/Timer.h"
 #include "ticcutils/PrettyPrint.h"
 #include "ticcutils/CommandLine.h"
@@ -59,6 +72,12 @@
 #include <omp.h>
 #endif
 
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 using namespace std;
 using namespace icu;
 using namespace nlohmann;
@@ -67,7 +86,7 @@ namespace Timbl {
   using TiCC::operator<<;
 
   const string timbl_short_opts = "a:b:B:c:C:d:De:f:F:G::hHi:I:k:l:L:m:M:n:N:o:O:p:P:q:QR:s::t:T:u:U:v:Vw:W:xX:Z%";
-  const string timbl_long_opts = ",Beam:,clones:,Diversify,occurrences:,sloppy::,silly::,Threshold:,Treeorder:,matrixin:,matrixout:,version,help,limit:";
+  const string timbl_long_opts = ",Beam:,clones:,Diversify,occurrences:,sloppy::,silly::,Threshold:,Treeorder:,matrixin:,matrixout:,numa::,shards:,ingest-limit:,flush:,echo-input::,binary-tables::,frequency-order,sparse,lazy::,convert:,bundle:,compact,version,help,limit:";
   const string timbl_serv_short_opts = "C:d:G::k:l:L:p:Qv:x";
   const string timbl_indirect_opts = "d:e:G:k:L:m:o:p:QR:t:v:w:x%";
 
@@ -111,11 +130,11 @@ namespace Timbl {
     return dist;
   }
 
-  string resultStore::getResult() {
+  const string& resultStore::getResult() {
     if ( isTop ){
       if ( topCache.empty() ){
 	if ( dist ) {
-	  topCache = dist->DistToStringW( beam );
+	  dist->DistToStringW( topCache, beam );
 	}
 	else {
 	  topCache = "{}";
@@ -125,7 +144,7 @@ namespace Timbl {
     }
     else if ( resultCache.empty() ){
       if ( dist ) {
-	resultCache = dist->DistToStringW( beam );
+	dist->DistToStringW( resultCache, beam );
       }
       else {
 	resultCache = "{}";
@@ -204,12 +223,36 @@ namespace Timbl {
     Initialized( false ),
     OptParams( NULL ),
     algorithm( Alg ),
+    treeNodes( 0 ),
+    treeTails( 0 ),
+    binaryTest( 0 ),
     ibCount( 0 ),
     confusionInfo( 0 ),
     match_depth(-1),
     last_leaf(true),
     estimate( 0 ),
-    numOfThreads( 1 )
+    numOfThreads( 1 ),
+    numaReplicas( false ),
+    shards( 0 ),
+    numOfShards( 1 ),
+    shardByFeature( false ),
+    shardIndex( -1 ),
+    shardSeen( 0 ),
+    shardLearned( 0 ),
+    known_bands( 0 ),
+    ingest( 0 ),
+    ingestLimit( -1 ),
+    flushEvery( 0 ),
+    unflushed( 0 ),
+    echoInput( false ),
+    binaryTables( false ),
+    frequencyOrder( false ),
+    sparseSearch( false ),
+    lazyLoad( -1 ),
+    deltaLimit( 0 ),
+    deltaCount( 0 ),
+    forked( false ),
+    forkLog( 0 )
   {
     Weighting = GR_w;
   }
@@ -217,6 +260,10 @@ namespace Timbl {
   TimblExperiment::~TimblExperiment() {
     delete OptParams;
     delete confusionInfo;
+    delete shards;
+    delete ingest;
+    delete binaryTest;
+    delete forkLog;
   }
 
   TimblExperiment& TimblExperiment::operator=( const TimblExperiment&in ){
@@ -233,6 +280,16 @@ namespace Timbl {
       match_depth = -1;
       estimate = in.estimate;
       numOfThreads = in.numOfThreads;
+      numaReplicas = in.numaReplicas;
+      numOfShards = in.numOfShards;
+      shardByFeature = in.shardByFeature;
+      ingestLimit = in.ingestLimit;
+      flushEvery = in.flushEvery;
+      echoInput = in.echoInput;
+      binaryTables = in.binaryTables;
+      frequencyOrder = in.frequencyOrder;
+      sparseSearch = in.sparseSearch;
+      lazyLoad = in.lazyLoad;
     }
     return *this;
   }
@@ -264,6 +321,55 @@ namespace Timbl {
     return result;
   }
 
+  TimblExperiment *TimblExperiment::Fork(){
+    // a copy to test with other settings. It shares the InstanceBase and
+    // the feature and target values with us, and has its own settings,
+    // weights, metrics and testers. We may not change while it exists
+    if ( shards ){
+      Warning( "unable to fork a sharded experiment" );
+      return 0;
+    }
+    else if ( InstanceBase == 0 ){
+      Warning( "unable to fork, nothing learned yet" );
+      return 0;
+    }
+    switch ( Algorithm() ){
+    case IB1_a:
+    case TRIBL_a:
+    case TRIBL2_a:
+    case IGTREE_a:
+      break;
+    default:
+      Warning( "unable to fork a " + TiCC::toString(algorithm)
+	       + " experiment" );
+      return 0;
+    }
+    if ( !ConfirmOptions() ){
+      return 0;
+    }
+    initExperiment();
+    // the fork shares the tree, a lazily read one can't be shared
+    InstanceBase->LoadAll();
+    if ( !is_copy ){
+      // a fork may use a value difference metric where we don't. It can't
+      // fill the shared probability arrays itself, so fill them all now
+      initProbabilityArrays( true );
+    }
+    TimblExperiment *result = clone();
+    *result = *this;
+    if ( OptParams ){
+      result->OptParams = OptParams->Clone( 0 );
+    }
+    // a fork may choose another weighting, so it needs all statistics
+    result->SetOption( "ALL_WEIGHTS: true" );
+    result->forked = true;
+    // forks run concurrently, so don't let them share our log stream.
+    // By default they are silent
+    result->forkLog = new ostream( nullptr );
+    result->setLogStream( *result->forkLog );
+    return result;
+  }
+
   void TimblExperiment::initExperiment( bool all_vd ){
     if ( !ExpInvalid() ){
       match_depth = NumOfFeatures();
@@ -275,6 +381,11 @@ namespace Timbl {
 	  confusionInfo = new ConfusionMatrix( targets.num_of_values() );
 	}
 	initDecay();
+	if ( InstanceBase && InstanceBase->isLazy() && needsAllValues() ){
+	  Warning( "the weights and metrics need every value of the "
+		   "Instance-Base, reading the rest of it" );
+	  InstanceBase->LoadAll();
+	}
 	calculate_fv_entropy( true );
 	if (!is_copy ){
 	  if ( ib2_offset != 0 ){
@@ -304,6 +415,13 @@ namespace Timbl {
 	    diverseWeights();
 	  }
 	}
+	else if ( forked ){
+	  // a fork keeps its own weights
+	  InitWeights();
+	  if ( do_diversify ){
+	    diverseWeights();
+	  }
+	}
 	srand( random_seed );
 	initTesters();
 	MBL_init = true;
@@ -332,7 +450,7 @@ namespace Timbl {
     //
     bool found = false;
     cnt = 0;
-    while ( !found && TiCC::getline( datafile, Line ) ){
+    while ( !found && read_line( datafile, lineBuffer, Line ) ){
       ++cnt;
       if ( empty_line( Line, InputFormat() ) ){
 	stats.addSkipped();
@@ -345,6 +463,24 @@ namespace Timbl {
     return found;
   }
 
+  void TimblExperiment::resultsWritten( int n ){
+    // called after n results are written to outStream.
+    // With --flush=<n> we flush every n results, otherwise a streaming
+    // test flushes whenever reading the next line might block, so
+    // the results are never held back waiting for more input.
+    if ( flushEvery > 0 ){
+      unflushed += n;
+      if ( unflushed >= flushEvery ){
+	outStream.flush();
+	unflushed = 0;
+      }
+    }
+    else if ( testStream.streaming()
+	      && testStream.rdbuf()->in_avail() <= 0 ){
+      outStream.flush();
+    }
+  }
+
   bool TimblExperiment::chopLine( const UnicodeString& line ){
     if ( !Chop( line ) ){
       stats.addSkipped();
@@ -356,6 +492,504 @@ namespace Timbl {
     }
   }
 
+  bool TimblExperiment::chopRow( const BinaryInstanceReader& reader,
+				 const binaryRow& row ){
+    // chopLine() for a row of a binary instance file. Nothing to parse,
+    // so nothing can go wrong
+    ChopRow( reader, row );
+    stats.addLine();
+    return true;
+  }
+
+  bool TimblExperiment::nextTestLine( UnicodeString& Buffer ){
+    // nextLine() on the testStream, or the next row of a binary one
+    if ( binaryTest ){
+      return binaryTest->next( testRow );
+    }
+    return nextLine( testStream, Buffer );
+  }
+
+  bool TimblExperiment::chopTestLine( const UnicodeString& Buffer ){
+    if ( binaryTest ){
+      return chopRow( *binaryTest, testRow );
+    }
+    return chopLine( Buffer );
+  }
+
+  bool TimblExperiment::readFailed( const InputStream& is,
+				    const string& FileName,
+				    const BinaryInstanceReader *binary ){
+    // reading stops at the end of the file, but also on a corrupt
+    // compressed file or binary instance file. Report those.
+    if ( is.bad() ){
+      Error( "error while reading '" + FileName + "': " + is.error() );
+      return true;
+    }
+    if ( binary && !binary->good() ){
+      Error( "error while reading '" + FileName + "': " + binary->error() );
+      return true;
+    }
+    return false;
+  }
+
+  BinaryInstanceReader *TimblExperiment::openBinary( istream& is,
+						     const string& FileName ){
+    // read the header of a binary instance file, and check that it suits
+    // our settings. Returns 0 when it doesn't
+    BinaryInstanceReader *result = new BinaryInstanceReader( is );
+    string problem;
+    if ( !result->good() ){
+      problem = result->error();
+    }
+    else if ( InputFormat() != UnknownInputFormat
+	      && InputFormat() != result->format() ){
+      problem = "it holds " + TiCC::toString( result->format() )
+	+ " instances, not " + TiCC::toString( InputFormat() );
+    }
+    else if ( result->numFeatures() > MaxFeats() ){
+      problem = "Number of Features exceeds the maximum number. (currently "
+	+ TiCC::toString( MaxFeats() ) + ")";
+    }
+    else if ( chopExamples() && !result->weighted() ){
+      problem = "it has no exemplar weights";
+    }
+    else if ( chopOcc() && !result->withOccurrences() ){
+      problem = "it has no occurrence counts";
+    }
+    if ( !problem.empty() ){
+      Error( "unable to use binary instance file '" + FileName + "': "
+	     + problem );
+      delete result;
+      return 0;
+    }
+    // a fresh Chopper, with the exemplar weights and occurrences of
+    // the current phase, like examineData() gives
+    setInputFormat( result->format() );
+    return result;
+  }
+
+  bool TimblExperiment::rejectBinary( const string& FileName,
+				      const string& what ){
+    // for the code paths that can only read text
+    if ( BinaryInstanceReader::detect( FileName ) ){
+      Error( "unable to " + what + " from binary instance file '"
+	     + FileName + "'" );
+      return true;
+    }
+    return false;
+  }
+
+  bool TimblExperiment::storeFailed( const string& FileName ){
+    // the InstanceStore is unable to keep the training data.
+    // Returns true when we can't do without.
+    releaseStore();
+    if ( InputStream::detect( FileName ) != NoCompression
+	 || BinaryInstanceReader::detect( FileName ) ){
+      Error( "unable to store the training data of: " + FileName );
+      return true;
+    }
+    Warning( "unable to store the training data, "
+	     "it will be read again from: " + FileName );
+    return false;
+  }
+
+  bool TimblExperiment::learnLines( InputStream& datafile,
+				    const string& FileName ){
+    // the serial first learning phase: chop the lines one by one and
+    // learn the values from them.
+    UnicodeString Buffer;
+    if ( !nextLine( datafile, Buffer )
+	 || !chopLine( Buffer ) ){
+      Error( "no useful data in: " + FileName );
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Phase 1: Reading Datafile: " + FileName );
+      time_stamp( "Start:     ", 0 );
+    }
+    bool go_on = true;
+    while( go_on ){
+      chopped_to_instance( LearnWords );
+      if ( ingest
+	   && !ingest->add( CurrInst )
+	   && storeFailed( FileName ) ){
+	return false;
+      }
+      // Progress update.
+      //
+      if ( !Verbosity(SILENT) ){
+	if ( ( stats.dataLines() % Progress() ) == 0 ){
+	  time_stamp( "Examining: ", stats.dataLines() );
+	}
+      }
+      bool found = false;
+      while ( !found &&
+	      nextLine( datafile, Buffer ) ){
+	found = chopLine( Buffer );
+	if ( !found ){
+	  Warning( "datafile, skipped line #" +
+		   TiCC::toString<int>( stats.totalLines() ) +
+		   "\n" + TiCC::UnicodeToUTF8(Buffer) );
+	}
+      }
+      go_on = found;
+    }
+    return !readFailed( datafile, FileName );
+  }
+
+  bool TimblExperiment::learnBinary( InputStream& datafile,
+				     BinaryInstanceReader& reader,
+				     const string& FileName ){
+    // learnLines() for a binary instance file: the instances are
+    // already chopped
+    binaryRow row;
+    if ( !reader.next( row ) ){
+      if ( !readFailed( datafile, FileName, &reader ) ){
+	Error( "no useful data in: " + FileName );
+      }
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Phase 1: Reading binary Datafile: " + FileName );
+      time_stamp( "Start:     ", 0 );
+    }
+    do {
+      chopRow( reader, row );
+      chopped_to_instance( LearnWords );
+      if ( ingest
+	   && !ingest->add( CurrInst )
+	   && storeFailed( FileName ) ){
+	return false;
+      }
+      // Progress update.
+      //
+      if ( !Verbosity(SILENT) ){
+	if ( ( stats.dataLines() % Progress() ) == 0 ){
+	  time_stamp( "Examining: ", stats.dataLines() );
+	}
+      }
+    } while ( reader.next( row ) );
+    return !readFailed( datafile, FileName, &reader );
+  }
+
+  class learnChunk {
+    // The result of chopping a range of lines of a training file.
+    // All strings are interned locally, numbered in order of their first
+    // appearance in the range, like the global hashes would do.
+  public:
+    static constexpr uint32_t no_slot = UINT32_MAX;
+    struct skipped_line {
+      size_t line;      // line number within the range
+      string what;      // the message of the Chopper, if any
+      string text;
+    };
+    struct value_table {
+      // the values of one feature
+      unordered_map<uint32_t,uint32_t> slot_of; // word -> slot
+      vector<uint32_t> words;                   // slot -> word
+      unordered_map<uint64_t,size_t> freqs;     // (slot,target) -> freq
+    };
+    learnChunk( streamsize b, streamsize e, size_t num_feats, bool rows ):
+      begin(b), end(e), lines(0), data(0), skipped(0), first(0),
+      keep_rows(rows), features( num_feats ) {};
+    uint32_t add_target( const UnicodeString& us, int occ ){
+      auto [it,fresh] = target_of.try_emplace( us, target_words.size() );
+      if ( fresh ){
+	target_words.push_back( &it->first );
+	target_freqs.push_back( 0 );
+      }
+      target_freqs[it->second] += occ;
+      return it->second;
+    }
+    uint32_t add_value( size_t feat, const UnicodeString& us ){
+      auto [wit,fresh] = word_of.try_emplace( us, words.size() );
+      if ( fresh ){
+	words.push_back( &wit->first );
+      }
+      value_table& vt = features[feat];
+      auto [sit,new_slot] = vt.slot_of.try_emplace( wit->second,
+						   vt.words.size() );
+      if ( new_slot ){
+	vt.words.push_back( wit->second );
+      }
+      return sit->second;
+    }
+    void count( size_t feat, uint32_t slot, uint32_t target, int occ ){
+      features[feat].freqs[ (uint64_t(slot) << 32) | target ] += occ;
+    }
+    streamsize begin;
+    streamsize end;
+    size_t lines;    // all lines read
+    size_t data;     // the useful ones
+    size_t skipped;
+    int first;       // 1 when the first non-empty line is OK, -1 if not
+    bool keep_rows;
+    vector<skipped_line> notes;
+    unordered_map<UnicodeString,uint32_t,unicode_hash> word_of;
+    vector<const UnicodeString*> words;
+    unordered_map<UnicodeString,uint32_t,unicode_hash> target_of;
+    vector<const UnicodeString*> target_words;
+    vector<size_t> target_freqs;
+    vector<value_table> features;
+    // the instances, only when keep_rows is set
+    vector<uint32_t> row_slots;
+    vector<uint32_t> row_targets;
+    vector<int> row_occ;
+    vector<double> row_exw;
+  };
+
+  vector<streamsize> chunk_bounds( istream& is, size_t parts ){
+    // split the remainder of 'is' in at most 'parts' byte ranges which
+    // start at a line boundary. Returns the boundaries, or nothing when
+    // splitting isn't possible or not worthwhile.
+    // 'is' is positioned at the same place afterwards.
+    const streamsize min_chunk = 1024*1024;
+    vector<streamsize> result;
+    streamsize start = is.tellg();
+    if ( parts < 2 || start < 0 ){
+      return result;
+    }
+    is.seekg( 0, ios::end );
+    streamsize size = is.tellg();
+    if ( size > start ){
+      parts = min<size_t>( parts, (size-start) / min_chunk );
+    }
+    if ( parts > 1 ){
+      result.push_back( start );
+      for ( size_t k=1; k < parts; ++k ){
+	streamsize pos = start + ( (size-start) * k ) / parts;
+	is.seekg( pos-1 );
+	is.ignore( numeric_limits<streamsize>::max(), '\n' );
+	if ( !is.good() ){
+	  is.clear();
+	  break;
+	}
+	streamsize bound = is.tellg();
+	if ( bound > result.back() && bound < size ){
+	  result.push_back( bound );
+	}
+      }
+      result.push_back( size );
+    }
+    is.clear();
+    is.seekg( start );
+    return result;
+  }
+
+  void TimblExperiment::chopChunk( const string& FileName,
+				   learnChunk& ck ) const {
+    // chop the lines of the range and intern the values
+    // runs in parallel with other chunks, so it only touches ck
+    ifstream is( FileName, ios::in );
+    is.seekg( ck.begin );
+    Chopper *chopper = newChopper();
+    size_t num_feats = NumOfFeatures();
+    bool swap = ( num_feats != targetPos() );
+    // for the sparse formats, the slots of the default values per feature
+    vector<uint32_t> defaults( num_feats, learnChunk::no_slot );
+    vector<size_t> active_stamp( num_feats, 0 );
+    size_t stamp = 0;
+    streamsize pos = ck.begin;
+    string line;
+    while ( pos < ck.end
+	    && getline( is, line ) ){
+      pos += line.size() + 1;
+      ++ck.lines;
+      UnicodeString Line = TiCC::UnicodeFromUTF8( line );
+      if ( empty_line( Line, InputFormat() ) ){
+	++ck.skipped;
+	continue;
+      }
+      bool ok = false;
+      string what;
+      try {
+	ok = chopper->chop( Line, num_feats );
+      }
+      catch ( const exception& e ){
+	what = e.what();
+      }
+      if ( ck.first == 0 ){
+	ck.first = ( ok ? 1 : -1 );
+      }
+      if ( !ok ){
+	++ck.skipped;
+	ck.notes.push_back( { ck.lines, what, line } );
+	continue;
+      }
+      ++ck.data;
+      const vector<size_t> *active = 0;
+      if ( swap ){
+	chopper->swapTarget( targetPos() );
+      }
+      else {
+	active = chopper->activeFields();
+      }
+      if ( active ){
+	++stamp;
+	for ( const auto j : *active ){
+	  active_stamp[j] = stamp;
+	}
+      }
+      int occ = chopper->getOcc();
+      uint32_t target = ck.add_target( chopper->getField( num_feats ), occ );
+      for ( size_t i=0; i < num_feats; ++i ){
+	uint32_t slot = learnChunk::no_slot;
+	if ( !features[i]->Ignore() ){
+	  if ( active
+	       && active_stamp[i] != stamp
+	       && defaults[i] != learnChunk::no_slot ){
+	    slot = defaults[i];
+	  }
+	  else {
+	    slot = ck.add_value( i, chopper->getField(i) );
+	    if ( active && active_stamp[i] != stamp ){
+	      defaults[i] = slot;
+	    }
+	  }
+	  ck.count( i, slot, target, occ );
+	}
+	if ( ck.keep_rows ){
+	  ck.row_slots.push_back( slot );
+	}
+      }
+      if ( ck.keep_rows ){
+	ck.row_targets.push_back( target );
+	ck.row_occ.push_back( occ );
+	if ( doSamples() ){
+	  ck.row_exw.push_back( chopper->getExW() );
+	}
+      }
+    }
+    delete chopper;
+  }
+
+  bool TimblExperiment::learnChunked( const string& FileName,
+				      const vector<streamsize>& bounds ){
+    // the parallel first learning phase: the ranges between the bounds
+    // are chopped and interned in parallel. Then the results are merged
+    // in file order, so the hashes, the values and their statistics
+    // are exactly the same as after learnLines()
+    int num = bounds.size() - 1;
+    if ( !Verbosity(SILENT) ){
+      Info( "Phase 1: Reading Datafile: " + FileName + " using "
+	    + TiCC::toString( num ) + " threads" );
+      time_stamp( "Start:     ", 0 );
+    }
+    vector<learnChunk*> chunks( num, 0 );
+    for ( int c=0; c < num; ++c ){
+      chunks[c] = new learnChunk( bounds[c], bounds[c+1],
+				  NumOfFeatures(), ingest != 0 );
+    }
+#pragma omp parallel for schedule(dynamic) num_threads(num)
+    for ( int c=0; c < num; ++c ){
+      chopChunk( FileName, *chunks[c] );
+    }
+    int first = 0;
+    for ( const auto *ck : chunks ){
+      first = ck->first;
+      if ( first != 0 ){
+	break;
+      }
+    }
+    if ( first != 1 ){
+      Error( "no useful data in: " + FileName );
+      for ( const auto *ck : chunks ){
+	delete ck;
+      }
+      return false;
+    }
+    // intern the strings in the global hashes, in order of appearance
+    Hash::UnicodeHash *feature_hash = features.hash();
+    vector<vector<size_t>> indices( num );
+    vector<vector<TargetValue*>> chunk_targets( num );
+    for ( int c=0; c < num; ++c ){
+      const learnChunk *ck = chunks[c];
+      size_t base = stats.totalLines();
+      for ( const auto& note : ck->notes ){
+	if ( !note.what.empty() ){
+	  Warning( note.what );
+	}
+	Warning( "datafile, skipped line #" +
+		 TiCC::toString( base + note.line ) + "\n" + note.text );
+      }
+      for ( size_t i=0; i < ck->data; ++i ){
+	stats.addLine();
+      }
+      for ( size_t i=0; i < ck->skipped; ++i ){
+	stats.addSkipped();
+      }
+      indices[c].reserve( ck->words.size() );
+      for ( const auto *word : ck->words ){
+	indices[c].push_back( feature_hash->hash( *word ) );
+      }
+      for ( size_t t=0; t < ck->target_words.size(); ++t ){
+	chunk_targets[c].push_back( targets.add_value( *ck->target_words[t],
+						       ck->target_freqs[t] ) );
+      }
+    }
+    // now the features are independent, so merge them in parallel
+    int num_feats = NumOfFeatures();
+    vector<vector<vector<FeatureValue*>>> slot_values( num );
+    for ( auto& sv : slot_values ){
+      sv.resize( num_feats );
+    }
+#pragma omp parallel for schedule(dynamic) num_threads(num)
+    for ( int i=0; i < num_feats; ++i ){
+      Feature *feat = features[i];
+      if ( feat->Ignore() ){
+	continue;
+      }
+      for ( int c=0; c < num; ++c ){
+	const learnChunk::value_table& vt = chunks[c]->features[i];
+	vector<FeatureValue*> values;
+	values.reserve( vt.words.size() );
+	for ( const auto word : vt.words ){
+	  // create them in order of appearance
+	  values.push_back( feat->add_value( indices[c][word], 0, 0 ) );
+	}
+	for ( const auto& [key,freq] : vt.freqs ){
+	  uint32_t slot = key >> 32;
+	  uint32_t target = key & UINT32_MAX;
+	  feat->add_value( values[slot]->Index(),
+			   chunk_targets[c][target],
+			   freq );
+	}
+	if ( chunks[c]->keep_rows ){
+	  slot_values[c][i] = std::move( values );
+	}
+      }
+    }
+    for ( int c=0; c < num; ++c ){
+      const learnChunk *ck = chunks[c];
+      for ( size_t r=0; ingest && r < ck->row_targets.size(); ++r ){
+	CurrInst.clear();
+	CurrInst.TV = chunk_targets[c][ck->row_targets[r]];
+	if ( ck->row_occ[r] > 1 ){
+	  CurrInst.Occurrences( ck->row_occ[r] );
+	}
+	for ( int i=0; i < num_feats; ++i ){
+	  uint32_t slot = ck->row_slots[r*num_feats+i];
+	  if ( slot != learnChunk::no_slot ){
+	    CurrInst.FV[i] = slot_values[c][i][slot];
+	  }
+	}
+	if ( doSamples() ){
+	  double exW = ck->row_exw[r];
+	  if ( exW < 0 ){
+	    exW = 1.0;
+	  }
+	  CurrInst.ExemplarWeight( exW );
+	}
+	if ( !ingest->add( CurrInst ) ){
+	  // only plain files are chunked, so this isn't fatal
+	  storeFailed( FileName );
+	}
+      }
+      delete ck;
+    }
+    return true;
+  }
+
   /*
     First learning Phase:
     Learning of the names of the FeatureValues and TargetValues
@@ -376,7 +1010,19 @@ namespace Timbl {
 		 "'\nInstanceBase already filled" );
 	}
 	else {
-	  size_t Num = examineData( FileName );
+	  InputStream datafile;
+	  unique_ptr<BinaryInstanceReader> binary;
+	  size_t Num = 0;
+	  if ( BinaryInstanceReader::detect( FileName ) ){
+	    datafile.open( FileName );
+	    binary.reset( openBinary( datafile, FileName ) );
+	    if ( binary ){
+	      Num = binary->numFeatures();
+	    }
+	  }
+	  else {
+	    Num = examineData( FileName );
+	  }
 	  if ( Num == 0 ){
 	    Error( "Unable to initialize from file :'" + FileName + "'\n" );
 	  }
@@ -389,6 +1035,7 @@ namespace Timbl {
 	      showInputFormat( *mylog );
 	    }
 	    if ( NumOfFeatures() == 0 ){
+	      sparse_search = !expand && useSparseSearch( Num );
 	      Initialize( Num );
 	    }
 	    CurrentDataFile = FileName;
@@ -397,49 +1044,52 @@ namespace Timbl {
 	    }
 	    // Open the file.
 	    //
-	    ifstream datafile( FileName, ios::in);
+	    if ( !binary ){
+	      datafile.open( FileName );
+	    }
 	    stats.clear();
-	    UnicodeString Buffer;
-	    if ( InputFormat() == ARFF ){
+	    releaseStore();
+	    if ( !expand && !sparse_search
+		 && ( ingestLimit != 0 || datafile.compressed() || binary ) ){
+	      // keep the chopped instances, so Learn() doesn't have to
+	      // read the datafile again.
+	      // That is a must for compressed and binary files, because we
+	      // can't seek to a line in those.
+	      // With --ingest-limit=0 they all go to the spill file
+	      size_t limit = SIZE_MAX;
+	      if ( ingestLimit >= 0 ){
+		limit = ingestLimit * 1024 * 1024;
+	      }
+	      ingest = new InstanceStore( NumOfFeatures(), doSamples(), limit );
+	    }
+	    if ( InputFormat() == ARFF && !binary ){
 	      skipARFFHeader( datafile );
 	    }
-	    if ( !nextLine( datafile, Buffer ) ){
-	      Error( "no useful data in: " + FileName );
-	      result = false;
+	    TiCC::Timer prepT;
+	    prepT.start();
+	    bool go_on;
+	    vector<streamsize> bounds;
+	    if ( !datafile.compressed() && !binary && !sparse_search ){
+	      bounds = chunk_bounds( datafile, Clones() );
 	    }
-	    else if ( !chopLine( Buffer ) ){
-	      Error( "no useful data in: " + FileName );
-	      result = false;
+	    if ( binary ){
+	      go_on = learnBinary( datafile, *binary, FileName );
+	    }
+	    else if ( bounds.size() > 2 ){
+	      go_on = learnChunked( FileName, bounds );
 	    }
 	    else {
-	      TiCC::Timer prepT;
-	      prepT.start();
-	      bool go_on = true;
-	      if ( !Verbosity(SILENT) ){
-		Info( "Phase 1: Reading Datafile: " + FileName );
-		time_stamp( "Start:     ", 0 );
-	      }
-	      while( go_on ){
-		chopped_to_instance( LearnWords );
-		// Progress update.
-		//
-		if ( !Verbosity(SILENT) ){
-		  if ( ( stats.dataLines() % Progress() ) == 0 ){
-		    time_stamp( "Examining: ", stats.dataLines() );
-		  }
-		}
-		bool found = false;
-		while ( !found &&
-			nextLine( datafile, Buffer ) ){
-		  found = chopLine( Buffer );
-		  if ( !found ){
-		    Warning( "datafile, skipped line #" +
-			     TiCC::toString<int>( stats.totalLines() ) +
-			     "\n" + TiCC::UnicodeToUTF8(Buffer) );
-		  }
-		}
-		go_on = found;
-	      }
+	      go_on = learnLines( datafile, FileName );
+	    }
+	    if ( go_on && sparse_search ){
+	      count_sparse_defaults();
+	    }
+	    if ( go_on
+		 && ingest
+		 && !ingest->flush() ){
+	      go_on = !storeFailed( FileName );
+	    }
+	    if ( go_on ){
 	      if ( stats.dataLines() < 1 ){
 		Error( "no useful data in: " + FileName );
 	      }
@@ -462,11 +1112,16 @@ namespace Timbl {
 		}
 		prepT.stop();
 		if ( !Verbosity(SILENT) ){
+		  if ( ingest && ingest->spilledRows() > 0 ){
+		    Info( "Spilled " + TiCC::toString( ingest->spilledRows() )
+			  + " instances to a temporary file" );
+		  }
 		  Info( "Preparation took " + prepT.toString() );
 		}
 		if ( warnOnSingleTarget && targets.EffectiveValues() <=1 ){
 		  Warning( "Training file contains only 1 class." );
 		}
+		rankValues();
 		result = true;
 	      }
 	    }
@@ -474,6 +1129,9 @@ namespace Timbl {
 	}
       }
     }
+    if ( !result ){
+      releaseStore();
+    }
     return result;
   }
 
@@ -493,29 +1151,68 @@ namespace Timbl {
     return os;
   }
 
+  void TimblExperiment::releaseStore(){
+    delete ingest;
+    ingest = 0;
+  }
+
+  bool TimblExperiment::indexedInstance( streamsize pos,
+					 istream& datafile,
+					 UnicodeString& Buffer ){
+    // fill CurrInst for TreeBuilding with the instance at pos in a
+    // fileIndex. That is a row in the InstanceStore when we have one,
+    // otherwise an offset in datafile
+    if ( ingest ){
+      if ( !ingest->fetch( pos, CurrInst,
+			   features.permutation, EffectiveFeatures() ) ){
+	FatalError( "unable to retrieve stored instance "
+		    + TiCC::toString( pos ) );
+	return false;
+      }
+      stats.addLine();
+      return true;
+    }
+    datafile.clear();
+    if ( !datafile.seekg( pos ) ){
+      FatalError( "unable to seek to position " + TiCC::toString( pos )
+		  + " in: " + CurrentDataFile );
+      return false;
+    }
+    nextLine( datafile, Buffer );
+    chopLine( Buffer );
+    chopped_to_instance( TrainWords );
+    return true;
+  }
+
   bool TimblExperiment::learnFromFileIndex( const fileIndex& fi,
 					    istream& datafile ){
     InstanceBase_base *outInstanceBase = 0;
+    UnicodeString Buffer;
     for ( const auto& fit : fi ){
       for ( const auto& sit : fit.second ){
-	datafile.clear();
-	datafile.seekg( sit );
-	UnicodeString Buffer;
-	nextLine( datafile, Buffer );
-	chopLine( Buffer );
+	indexedInstance( sit, datafile, Buffer );
 	// Progress update.
 	//
 	if ( ( stats.dataLines() % Progress() ) == 0 ){
 	  time_stamp( "Learning:  ", stats.dataLines() );
 	}
-	chopped_to_instance( TrainWords );
+	if ( shardIndex >= 0 && !ownedByShard( CurrInst ) ){
+	  continue;
+	}
 	if ( !outInstanceBase ){
 	  outInstanceBase = InstanceBase->clone();
 	}
 	//		  cerr << "add instance " << &CurrInst << endl;
 	if ( !outInstanceBase->AddInstance( CurrInst ) ){
+	  string line;
+	  if ( ingest ){
+	    line = TiCC::toString( CurrInst );
+	  }
+	  else {
+	    line = TiCC::UnicodeToUTF8(Buffer);
+	  }
 	  Warning( "deviating exemplar weight in:\n" +
-		   TiCC::UnicodeToUTF8(Buffer) + "\nIgnoring the new weight" );
+		   line + "\nIgnoring the new weight" );
 	}
       }
     }
@@ -529,6 +1226,80 @@ namespace Timbl {
     return true;
   }
 
+  bool TimblExperiment::useSparseSearch( size_t Num ){
+    // may we use a Sparse_InstanceBase for the data we are about to
+    // learn? Only when asked for, and for a plain IB1 experiment
+    if ( !sparseSearch ){
+      return false;
+    }
+    string problem;
+    if ( Algorithm() != IB1_a ){
+      problem = "it only works for IB1";
+    }
+    else if ( InputFormat() != Sparse && InputFormat() != SparseBin ){
+      problem = "it needs Sparse or SparseBin input";
+    }
+    else if ( doSamples() ){
+      problem = "it doesn't handle exemplar weights";
+    }
+    else if ( numOfShards > 1 || shardIndex >= 0 ){
+      problem = "it doesn't handle shards";
+    }
+    else if ( targetPos() != std::numeric_limits<size_t>::max()
+	      && targetPos() != Num ){
+      problem = "the target must be the last field";
+    }
+    if ( !problem.empty() ){
+      Warning( "--sparse is ignored: " + problem );
+      return false;
+    }
+    return true;
+  }
+
+  bool TimblExperiment::learnSparse(){
+    // Phase 3 for a sparse search: add the instances to the
+    // Sparse_InstanceBase in the order of the datafile. There is no tree
+    // to build, so no index is needed
+    stats.clear();
+    if ( !Verbosity(SILENT) ) {
+      Info( "\nPhase 3: Learning from Datafile: " + CurrentDataFile );
+      time_stamp( "Start:     ", 0 );
+    }
+    InputStream datafile( CurrentDataFile );
+    unique_ptr<BinaryInstanceReader> binary;
+    if ( BinaryInstanceReader::detect( CurrentDataFile ) ){
+      binary.reset( openBinary( datafile, CurrentDataFile ) );
+      if ( !binary ){
+	return false;
+      }
+    }
+    UnicodeString Buffer;
+    binaryRow row;
+    while ( true ){
+      if ( binary ){
+	if ( !binary->next( row ) ){
+	  break;
+	}
+	chopRow( *binary, row );
+      }
+      else if ( !nextLine( datafile, Buffer ) ){
+	break;
+      }
+      else if ( !chopLine( Buffer ) ){
+	// Phase 1 warned about it already
+	continue;
+      }
+      chopped_to_instance( TrainWords );
+      InstanceBase->AddInstance( CurrInst );
+      // Progress update.
+      //
+      if ( ( stats.dataLines() % Progress() ) == 0 ){
+	time_stamp( "Learning:  ", stats.dataLines() );
+      }
+    }
+    return !readFailed( datafile, CurrentDataFile, binary.get() );
+  }
+
   bool TimblExperiment::ClassicLearn( const string& FileName,
 				      bool warnOnSingleTarget ){
     bool result = true;
@@ -558,7 +1329,10 @@ namespace Timbl {
       if ( ExpInvalid() ){
 	return false;
       }
-      if ( EffectiveFeatures() < 2 ) {
+      if ( sparse_search ){
+	result = learnSparse();
+      }
+      else if ( EffectiveFeatures() < 2 ) {
 	fileIndex fmIndex;
 	//      TiCC::Timer t;
 	//      t.start();
@@ -575,7 +1349,7 @@ namespace Timbl {
 	  }
 	  // Open the file.
 	  //
-	  ifstream datafile( CurrentDataFile, ios::in);
+	  InputStream datafile( CurrentDataFile );
 	  //
 	  learnFromFileIndex( fmIndex, datafile );
 	}
@@ -597,13 +1371,14 @@ namespace Timbl {
 	  }
 	  // Open the file.
 	  //
-	  ifstream datafile( CurrentDataFile, ios::in);
+	  InputStream datafile( CurrentDataFile );
 	  //
 	  for ( const auto& mit : fIndex ){
 	    learnFromFileIndex( mit.second, datafile );
 	  }
 	}
       }
+      releaseStore();
       if ( !Verbosity(SILENT) ){
 	time_stamp( "Finished:  ", stats.dataLines() );
       }
@@ -626,6 +1401,9 @@ namespace Timbl {
 	 !ConfirmOptions() ){
       return false;
     }
+    if ( numOfShards > 1 && shardIndex < 0 ){
+      return ShardedLearn( s, warnOnSingleTarget );
+    }
     return ClassicLearn( s, warnOnSingleTarget );
   }
 
@@ -651,6 +1429,14 @@ namespace Timbl {
       Warning( "unable to Increment, No InstanceBase available" );
       result = false;
     }
+    else if ( Sharded() ){
+      Warning( "unable to Increment a sharded InstanceBase" );
+      result = false;
+    }
+    else if ( sparse_search ){
+      Warning( "unable to Increment the InstanceBase of a sparse search" );
+      result = false;
+    }
     else if ( !Chop( InstanceString ) ){
       Error( "Couldn't convert to Instance: "
 	     + TiCC::UnicodeToUTF8(InstanceString) );
@@ -665,6 +1451,8 @@ namespace Timbl {
 		 TiCC::UnicodeToUTF8(InstanceString)
 		 + "\nIgnoring the new weight" );
       }
+      logDelta( '+', InstanceString );
+      result = syncDelta();
     }
     return result;
   }
@@ -681,6 +1469,14 @@ namespace Timbl {
       Warning( "unable to Decrement, No InstanceBase available" );
       result = false;
     }
+    else if ( Sharded() ){
+      Warning( "unable to Decrement a sharded InstanceBase" );
+      result = false;
+    }
+    else if ( sparse_search ){
+      Warning( "unable to Decrement the InstanceBase of a sparse search" );
+      result = false;
+    }
     else {
       if ( !Chop( InstanceString ) ){
 	Error( "Couldn't convert to Instance: "
@@ -690,6 +1486,8 @@ namespace Timbl {
       else {
 	chopped_to_instance( TestWords );
 	HideInstance( CurrInst );
+	logDelta( '-', InstanceString );
+	result = syncDelta();
       }
     }
     return result;
@@ -707,10 +1505,17 @@ namespace Timbl {
       Warning( "unable to expand the InstanceBase: Not there" );
       result = false;
     }
+    else if ( sparse_search ){
+      Warning( "unable to expand the InstanceBase of a sparse search" );
+      result = false;
+    }
     else if ( FileName.empty() ){
       Warning( "unable to expand the InstanceBase: No inputfile specified" );
       result = false;
     }
+    else if ( rejectBinary( FileName, "expand" ) ){
+      result = false;
+    }
     else {
       if ( InputFormat() == UnknownInputFormat ){
 	// we may expand from 'nothing'
@@ -723,7 +1528,7 @@ namespace Timbl {
       stats.clear();
       // Open the file.
       //
-      ifstream datafile( FileName, ios::in);
+      InputStream datafile( FileName );
       if ( InputFormat() == ARFF ){
 	skipARFFHeader( datafile );
       }
@@ -752,6 +1557,7 @@ namespace Timbl {
 		     TiCC::UnicodeToUTF8(Buffer) +
 		     "\nIgnoring the new weight" );
 	  }
+	  logDelta( '+', Buffer );
 	  // Progress update.
 	  //
 	  if ( (stats.dataLines() % Progress() ) == 0 ){
@@ -771,6 +1577,7 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  IBInfo( *mylog );
 	}
+	result = syncDelta();
       }
     }
     return result;
@@ -788,16 +1595,23 @@ namespace Timbl {
       Warning( "unable to remove from InstanceBase: Not there" );
       result = false;
     }
+    else if ( sparse_search ){
+      Warning( "unable to remove from the InstanceBase of a sparse search" );
+      result = false;
+    }
     else if ( FileName.empty() ){
       Warning( "unable to remove from InstanceBase: No input specified" );
       result = false;
     }
-    else {
+    else if ( rejectBinary( FileName, "remove" ) ){
+      result = false;
+    }
+    else {
       UnicodeString Buffer;
       stats.clear();
       // Open the file.
       //
-      ifstream datafile( FileName, ios::in);
+      InputStream datafile( FileName );
       if ( InputFormat() == ARFF ){
 	skipARFFHeader( datafile );
       }
@@ -819,6 +1633,7 @@ namespace Timbl {
 	  // The next Instance to remove.
 	  chopped_to_instance( TestWords );
 	  HideInstance( CurrInst );
+	  logDelta( '-', Buffer );
 	  // Progress update.
 	  //
 	  if ( (stats.dataLines() % Progress() ) == 0 ){
@@ -839,6 +1654,7 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  IBInfo( *mylog );
 	}
+	result = syncDelta();
       }
     }
     return result;
@@ -896,13 +1712,16 @@ namespace Timbl {
 	  Progress( 10000 );
 	}
       }
+      // called from the progressReporter thread too, so build the line
+      // locally and write it at once
+      ostringstream out;
       if ( !exp_name.empty() ){
-	os  << "-" << exp_name << "-";
+	out  << "-" << exp_name << "-";
       }
-      os << "Tested: ";
-      os.width(6);
-      os.setf(ios::right, ios::adjustfield);
-      os << line << " @ " << TiCC::Timer::now();
+      out << "Tested: ";
+      out.width(6);
+      out.setf(ios::right, ios::adjustfield);
+      out << line << " @ " << time_string( Time );
       // Estimate time until Estimate.
       //
       if ( Estimate() > 0 &&  (unsigned int)Estimate() > line ) {
@@ -911,12 +1730,11 @@ namespace Timbl {
 	  double Estimated = ( SecsUsed / double(line) )
 	    * double(Estimate());
 	  time_t EstimatedTime = (long)Estimated + start;
-	  string time_string = ctime(&EstimatedTime);
-	  time_string.pop_back(); // the newline from ctime
-	  os << ", " << Estimate() << ": " << time_string;
+	  out << ", " << Estimate() << ": " << time_string( EstimatedTime );
 	}
       }
-      os << endl;
+      out << "\n";
+      write_log( os, out.str() );
     }
   }
 
@@ -950,14 +1768,15 @@ namespace Timbl {
 	  Progress( 10000 );
 	}
       }
+      ostringstream out;
       if ( !exp_name.empty() ){
-	os  << "-" << exp_name << "-";
+	out  << "-" << exp_name << "-";
       }
-      os << "Learning:  ";
-      os.width(6);
-      os.setf(ios::right, ios::adjustfield);
-      os << lines << " @ " << TiCC::Timer::now();
-      os << "\t added:" << added;
+      out << "Learning:  ";
+      out.width(6);
+      out.setf(ios::right, ios::adjustfield);
+      out << lines << " @ " << time_string( Time );
+      out << "\t added:" << added;
       // Estime time until Estimate.
       //
       if ( Estimate() > 0 && (unsigned int)Estimate() > lines ) {
@@ -966,12 +1785,11 @@ namespace Timbl {
 	  double Estimated = ( SecsUsed / double(line) )
 	    * ( double(Estimate() - IB2_offset()) );
 	  time_t EstimatedTime = (long)Estimated + start;
-	  string time_string = ctime(&EstimatedTime);
-	  time_string.pop_back(); // the newline from ctime
-	  os << "\t, " << Estimate() << ": " << time_string;
+	  out << "\t, " << Estimate() << ": " << time_string( EstimatedTime );
 	}
       }
-      os << endl;
+      out << "\n";
+      write_log( os, out.str() );
       return true;
     }
     else {
@@ -986,55 +1804,106 @@ namespace Timbl {
     long int uSecsUsed = (Time.tv_sec - Start.tv_sec) * 1000000 +
       (Time.tv_usec - Start.tv_usec);
     double secsUsed = (double)uSecsUsed / 1000000 + Epsilon;
-    int oldPrec = os.precision(4);
-    os << setprecision(4);
-    os.setf( ios::fixed, ios::floatfield );
-    os << "Seconds taken: " << secsUsed << " (";
-    os << setprecision(2);
-    os << stats.dataLines() / secsUsed << " p/s)" << endl;
-    os << setprecision(oldPrec);
+    ostringstream out;
+    out << setprecision(4);
+    out.setf( ios::fixed, ios::floatfield );
+    out << "Seconds taken: " << secsUsed << " (";
+    out << setprecision(2);
+    out << stats.dataLines() / secsUsed << " p/s)\n";
+    for ( size_t node = 0; node < nodeLines.size(); ++node ){
+      out << "  NUMA node " << node << ": " << nodeLines[node]
+	  << " instances (" << nodeLines[node] / secsUsed << " p/s)\n";
+    }
+    write_log( os, out.str() );
   }
 
   bool TimblExperiment::showStatistics( ostream& os ) const {
-    os << endl;
+    // Tests may run in parallel, so write the report at once.
+    // in fixed notation, as it used to inherit from show_speed_summary()
+    ostringstream out;
+    out.setf( ios::fixed, ios::floatfield );
+    out << endl;
     if ( confusionInfo ){
-      confusionInfo->FScore( os, targets, Verbosity(CLASS_STATS) );
+      confusionInfo->FScore( out, targets, Verbosity(CLASS_STATS) );
     }
-    os << "overall accuracy:        "
-       << stats.testedCorrect()/(double) stats.dataLines()
-       << "  (" << stats.testedCorrect() << "/" << stats.dataLines()  << ")" ;
+    out << "overall accuracy:        "
+	<< stats.testedCorrect()/(double) stats.dataLines()
+	<< "  (" << stats.testedCorrect() << "/" << stats.dataLines()  << ")" ;
     if ( stats.exactMatches() != 0 ){
-      os << ", of which " << stats.exactMatches() << " exact matches " ;
+      out << ", of which " << stats.exactMatches() << " exact matches " ;
     }
-    os << endl;
+    out << endl;
     int totalTies =  stats.tiedCorrect() + stats.tiedFailure();
     if ( totalTies > 0 ){
       if ( totalTies == 1 ) {
-	os << "There was 1 tie";
+	out << "There was 1 tie";
       }
       else {
-	os << "There were " << totalTies << " ties";
+	out << "There were " << totalTies << " ties";
       }
       double tie_perc = 100 * ( stats.tiedCorrect() / (double)totalTies);
-      int oldPrec = os.precision(2);
-      os << " of which " << stats.tiedCorrect()
-	 << " (" << setprecision(2)
-	 << tie_perc << setprecision(6) << "%)";
+      int oldPrec = out.precision(2);
+      out << " of which " << stats.tiedCorrect()
+	  << " (" << setprecision(2)
+	  << tie_perc << setprecision(6) << "%)";
       if ( totalTies == 1 ){
-	os << " was correctly resolved" << endl;
+	out << " was correctly resolved" << endl;
       }
       else {
-	os << " were correctly resolved" << endl;
+	out << " were correctly resolved" << endl;
       }
-      os.precision(oldPrec);
+      out.precision(oldPrec);
+    }
+    if ( Verbosity(ADVANCED_STATS)
+	 && unknowns.Hits() + unknowns.Misses() > 0 ){
+      out << "Unknown feature values:  " << unknowns.Hits() + unknowns.Misses()
+	  << ", of which " << unknowns.Hits() << " reused an interned value"
+	  << endl;
     }
     if ( confusionInfo && Verbosity(CONF_MATRIX) ){
-      os << endl;
-      confusionInfo->Print( os, targets );
+      out << endl;
+      confusionInfo->Print( out, targets );
     }
+    write_log( os, out.str() );
     return true;
   }
 
+  void TimblExperiment::startLiveStatistics( const vector<const StatisticsClass *>& counters ){
+    lock_guard<mutex> guard( live_lock );
+    live_stats = counters;
+    live_start = chrono::steady_clock::now();
+  }
+
+  void TimblExperiment::stopLiveStatistics(){
+    // must be called BEFORE the per thread counters are merged
+    lock_guard<mutex> guard( live_lock );
+    live_last = statsSnapshot();
+    for ( const auto *st : live_stats ){
+      live_last.add( *st );
+    }
+    live_last.seconds = chrono::duration<double>( chrono::steady_clock::now()
+						  - live_start ).count();
+    live_stats.clear();
+  }
+
+  statsSnapshot TimblExperiment::liveStatistics() const {
+    // the statistics of the running Test, or else of the last one.
+    // Safe to call from another thread.
+    lock_guard<mutex> guard( live_lock );
+    if ( live_stats.empty() ){
+      // not the stats member: outside a Test it may hold the counts
+      // of the training data
+      return live_last;
+    }
+    statsSnapshot result;
+    for ( const auto *st : live_stats ){
+      result.add( *st );
+    }
+    result.seconds = chrono::duration<double>( chrono::steady_clock::now()
+					       - live_start ).count();
+    return result;
+  }
+
   bool TimblExperiment::createPercFile( const string& fileName ) const {
     if ( !fileName.empty() ) {
       ofstream outfile( fileName, ios::out | ios::trunc);
@@ -1087,24 +1956,51 @@ namespace Timbl {
 				      const string& dString,
 				      const TargetValue *Best,
 				      const double Distance ) {
-    outfile << get_org_input() << CodeToStr(Best->name());
+    // the line is assembled in resultLine and written in one go. The
+    // numbers come out exactly as outfile itself would format them
+    resultLine.clear();
+    if ( echoInput ){
+      ChopInput->appendRaw( resultLine );
+    }
+    else {
+      ChopInput->appendString( resultLine );
+    }
+    append_code( resultLine, Best->name() );
     if ( Verbosity(CONFIDENCE) ){
-      outfile << " [" << confidence << "]";
+      resultLine += " [";
+      if ( ( outfile.flags() & ios::floatfield ) == 0 ){
+	append_double( resultLine,
+		       confidence,
+		       outfile.precision(),
+		       outfile.flags() & ios::showpoint );
+      }
+      else {
+	ostringstream tmp;
+	tmp.flags( outfile.flags() );
+	tmp.precision( outfile.precision() );
+	tmp << confidence;
+	resultLine += tmp.str();
+      }
+      resultLine += "]";
     }
     if ( Verbosity(DISTRIB) ){
-      outfile << " " << dString;
+      resultLine += " ";
+      resultLine += dString;
     }
     if ( Verbosity(DISTANCE) ) {
-      int OldPrec = outfile.precision(DBL_DIG-1);
+      // the stream used to print this as width(8) << " " << Distance,
+      // with showpoint left set for what follows
+      resultLine.append( 8, ' ' );
+      append_double( resultLine, Distance, DBL_DIG-1, true );
       outfile.setf(ios::showpoint);
-      outfile.width(8);
-      outfile << " " << Distance;
-      outfile.precision(OldPrec);
     }
     if ( Verbosity(MATCH_DEPTH) ){
-      outfile << " " << matchDepth() << ":" << (matchedAtLeaf()?"L":"N");
+      resultLine += " ";
+      resultLine += to_string( matchDepth() );
+      resultLine += ( matchedAtLeaf() ? ":L" : ":N" );
     }
-    outfile << endl;
+    resultLine += '\n';
+    outfile.write( resultLine.data(), resultLine.size() );
     showBestNeighbors( outfile );
   }
 
@@ -1154,12 +2050,17 @@ namespace Timbl {
 	  result = false;
 	}
       }
+      if ( result && rejectBinary( CurrentDataFile, "learn IB2" ) ){
+	result = false;
+      }
       if ( result ) {
+	// IB2 learns sequentially from the file, the InstanceStore isn't used
+	releaseStore();
 	UnicodeString Buffer;
 	stats.clear();
 	// Open the file.
 	//
-	ifstream datafile( CurrentDataFile, ios::in);
+	InputStream datafile( CurrentDataFile );
 	if ( InputFormat() == ARFF ){
 	  skipARFFHeader( datafile );
 	}
@@ -1281,11 +2182,14 @@ namespace Timbl {
       else {
 	file_name = FileName;
       }
+      if ( rejectBinary( file_name, "expand IB2" ) ){
+	return false;
+      }
       UnicodeString Buffer;
       stats.clear();
       // Open the file.
       //
-      ifstream datafile( file_name, ios::in);
+      InputStream datafile( file_name );
       if ( InputFormat() == ARFF ){
 	skipARFFHeader( datafile );
       }
@@ -1341,6 +2245,7 @@ namespace Timbl {
 			 TiCC::UnicodeToUTF8(Buffer) +
 			 "\nIgnoring the new weight" );
 	      }
+	      logDelta( '+', Buffer );
 	      ++Added;
 	      ++TotalAdded;
 	      MBL_init = true; // avoid recalculations in LocalClassify
@@ -1365,6 +2270,7 @@ namespace Timbl {
 
 	  time_stamp( "Finished:  ", stats.dataLines() );
 	  *mylog << "in total added " << TotalAdded << " new entries" << endl;
+	  result = syncDelta();
 	  if ( !Verbosity(SILENT) ){
 	    IBInfo( *mylog );
 	    LearningInfo( *mylog );
@@ -1376,14 +2282,32 @@ namespace Timbl {
     return result;
   }
 
+  static void open_output( ofstream& os,
+			   vector<char>& buffer,
+			   const string& name,
+			   ios::openmode mode ){
+    // results are written a line at a time, so give the file a buffer
+    // large enough to hand the OS big blocks. It must be set before open()
+    const size_t out_buffer_size = 1 << 16;
+    if ( buffer.empty() ){
+      buffer.resize( out_buffer_size );
+    }
+    os.rdbuf()->pubsetbuf( buffer.data(), buffer.size() );
+    os.open( name, mode );
+  }
+
   bool TimblExperiment::initTestFiles( const string& InFileName,
 				       const string& OutFileName ){
     if ( !ExpInvalid() &&
 	 ConfirmOptions() ){
-      testStream.close();
-      testStream.clear(); // just to be shure. old G++ libraries are in error here
-      testStream.open( InFileName, ios::in);
-      if ( !testStream ) {
+      delete binaryTest;
+      binaryTest = 0;
+      unknowns.clearCounts();
+      bool binary = BinaryInstanceReader::detect( InFileName );
+      if ( !testStream.open( InFileName ) ){
+	if ( !testStream.error().empty() ){
+	  Warning( testStream.error() );
+	}
 	Error( "can't open: " + InFileName );
       }
       else {
@@ -1392,17 +2316,31 @@ namespace Timbl {
 	// first we check if the outFile is writable.
 	// We don't write it though, because we don't want to have
 	// it mangled when checkTestFile fails
-	outStream.open( OutFileName, ios::app );
+	// "-" is standard output, which we can't truncate anyway
+	bool to_stdout = ( OutFileName == "-" );
+	open_output( outStream, outBuffer,
+		     to_stdout ? "/dev/stdout" : OutFileName, ios::app );
 	if ( !outStream ) {
 	  Error( "can't open: " + OutFileName );
 	}
 	else {
 	  testStreamName = InFileName;
-	  outStreamName = OutFileName;
+	  outStreamName = to_stdout ? "standard output" : OutFileName;
+	  unflushed = 0;
+	  if ( binary ){
+	    runningPhase = TestWords;
+	    binaryTest = openBinary( testStream, InFileName );
+	    if ( !binaryTest ){
+	      return false;
+	    }
+	  }
 	  if ( checkTestFile() ){
-	    outStream.close();
-	    outStream.clear(); // just to be shure. old G++ libraries are in error here
-	    outStream.open( OutFileName, ios::out | ios::trunc );
+	    if ( !to_stdout ){
+	      outStream.close();
+	      outStream.clear(); // just to be shure. old G++ libraries are in error here
+	      open_output( outStream, outBuffer,
+			   OutFileName, ios::out | ios::trunc );
+	    }
 	    return true;
 	  }
 	}
@@ -1419,7 +2357,21 @@ namespace Timbl {
     else {
       runningPhase = TestWords;
       size_t numF =0;
-      if ( (numF = examineData( testStreamName )) != NumOfFeatures() ){
+      if ( binaryTest ){
+	numF = binaryTest->numFeatures();
+      }
+      else if ( testStream.streaming() ){
+	// a pipe can't be opened twice. Look at it through testStream,
+	// and give back what we have seen
+	string seen;
+	numF = examineData( testStream, testStreamName, &seen );
+	testStream.clear();
+	testStream.unread( seen );
+      }
+      else {
+	numF = examineData( testStreamName );
+      }
+      if ( numF != NumOfFeatures() ){
 	if ( numF == 0 ){
 	  Error( "unable to use the data from '" + testStreamName +
 		 "', wrong Format?" );
@@ -1639,7 +2591,21 @@ namespace Timbl {
       Warning( "no normalisation possible because a BeamSize is specified\n"
 	       "output is NOT normalized!" );
     }
-    const ClassDistribution *ExResultDist = ExactMatch( Inst );
+    const ClassDistribution *ExResultDist = 0;
+    // when the k+1 nearest bands are already known (from the shards or from
+    // an incremental search) we use them, instead of searching ourselves
+    const neighborSet *bands = known_bands;
+    if ( shards ){
+      initExperiment();
+      if ( !shards->query( Inst, EffectiveFeatures(), targets ) ){
+	FatalError( "lost the connection with the shard processes" );
+      }
+      ExResultDist = shards->exactMatch();
+      bands = &shards->nearestBands();
+    }
+    else {
+      ExResultDist = ExactMatch( Inst );
+    }
     WClassDistribution *ResultDist = 0;
     nSet.clear();
     const TargetValue *Res;
@@ -1659,8 +2625,16 @@ namespace Timbl {
       bestArray.initNeighborSet( nSet );
     }
     else {
-      testInstance( Inst, InstanceBase );
-      bestArray.initNeighborSet( nSet );
+      if ( bands ){
+	nSet.clear();
+	for ( size_t i=0; i < num_of_neighbors; ++i ){
+	  nSet.append( *bands, i );
+	}
+      }
+      else {
+	testInstance( Inst, InstanceBase );
+	bestArray.initNeighborSet( nSet );
+      }
       ResultDist = getBestDistribution( );
       Res = ResultDist->BestTarget( Tie, (RandomSeed() >= 0) );
       Distance = getBestDistance();
@@ -1668,8 +2642,13 @@ namespace Timbl {
     if ( Tie && recurse ){
       bool Tie2 = true;
       ++num_of_neighbors;
-      testInstance( Inst, InstanceBase );
-      bestArray.addToNeighborSet( nSet, num_of_neighbors );
+      if ( bands ){
+	nSet.append( *bands, num_of_neighbors-1 );
+      }
+      else {
+	testInstance( Inst, InstanceBase );
+	bestArray.addToNeighborSet( nSet, num_of_neighbors );
+      }
       WClassDistribution *ResultDist2 = getBestDistribution();
       const TargetValue *Res2 = ResultDist2->BestTarget( Tie2, (RandomSeed() >= 0) );
       --num_of_neighbors;
@@ -1734,8 +2713,20 @@ namespace Timbl {
   }
 
   const neighborSet *TimblExperiment::LocalClassify( const Instance& Inst ){
-    testInstance( Inst, InstanceBase );
-    bestArray.initNeighborSet( nSet );
+    if ( shards ){
+      initExperiment();
+      if ( !shards->query( Inst, EffectiveFeatures(), targets ) ){
+	FatalError( "lost the connection with the shard processes" );
+      }
+      nSet.clear();
+      for ( size_t i=0; i < num_of_neighbors; ++i ){
+	nSet.append( shards->nearestBands(), i );
+      }
+    }
+    else {
+      testInstance( Inst, InstanceBase );
+      bestArray.initNeighborSet( nSet );
+    }
     nSet.setShowDistance( Verbosity(DISTANCE) );
     nSet.setShowDistribution( Verbosity(DISTRIB) );
     return &nSet;
@@ -1847,15 +2838,70 @@ namespace Timbl {
     }
   }
 
+  class progressReporter {
+    // shows the progress of a Test from a separate thread, looking at the
+    // counters of all test threads at most once per 'interval'.
+    // So the test threads don't need a lock to report their progress.
+  public:
+    progressReporter( TimblExperiment *e, time_t t ):
+      exp(e), start(t), shown(0), stopping(false),
+      interval( chrono::milliseconds(500) ),
+      worker( &progressReporter::run, this ) {};
+    ~progressReporter() { stop(); };
+    void stop();
+  private:
+    void run();
+    void report();
+    TimblExperiment *exp;
+    time_t start;
+    unsigned int shown;
+    bool stopping;
+    chrono::milliseconds interval;
+    mutex lock;
+    condition_variable wakeup;
+    thread worker;
+  };
+
+  void progressReporter::run(){
+    unique_lock<mutex> guard( lock );
+    while ( !stopping ){
+      wakeup.wait_for( guard, interval );
+      report();
+    }
+  }
+
+  void progressReporter::report(){
+    unsigned int lines = exp->liveStatistics().lines;
+    while ( shown < lines ){
+      // show_progress decides which lines are worth mentioning
+      exp->show_progress( *exp->mylog, start, ++shown );
+    }
+  }
+
+  void progressReporter::stop(){
+    if ( worker.joinable() ){
+      {
+	lock_guard<mutex> guard( lock );
+	stopping = true;
+      }
+      wakeup.notify_one();
+      worker.join();
+    }
+  }
+
   class threadData {
   public:
-    threadData():exp(0), lineNo(0), resultTarget(0),
-		 exact(false), distance(-1), confidence(0) {};
+    threadData():exp(0), binary(0), lineNo(0), classified(0),
+		 resultTarget(0), exact(false), distance(-1), confidence(0) {};
     bool exec();
-    void show( ostream& ) const;
+    bool show( ostream& ) const;
     TimblExperiment *exp;
+    const BinaryInstanceReader *binary;
     UnicodeString Buffer;
+    binaryRow Row;
     unsigned int lineNo;
+    unsigned int classified;
+    vector<unsigned int> nodeLines;
     const TargetValue *resultTarget;
     bool exact;
     string distrib;
@@ -1867,10 +2913,10 @@ namespace Timbl {
     resultTarget = 0;
 // #pragma omp critical
 //     cerr << "exec " << lineNo << " '" << Buffer << "'" << endl;
-    if ( Buffer.isEmpty() ){
+    if ( binary ? Row.values.empty() : Buffer.isEmpty() ){
       return false;
     }
-    if ( !exp->chopLine( Buffer ) ){
+    if ( binary ? !exp->chopRow( *binary, Row ) : !exp->chopLine( Buffer ) ){
       exp->Warning( "testfile, skipped line #" +
 		    TiCC::toString<int>( lineNo ) +
 		    "\n" + TiCC::UnicodeToUTF8(Buffer) );
@@ -1883,18 +2929,21 @@ namespace Timbl {
 					 distance,
 					 exact );
       exp->normalizeResult();
-      distrib = exp->bestResult.getResult();
+      if ( exp->Verbosity(DISTRIB) ){
+	distrib = exp->bestResult.getResult();
+      }
       if ( exp->Verbosity(CONFIDENCE) ){
 	confidence = exp->confidence();
       }
       else {
 	confidence = 0;
       }
+      ++classified;
       return true;
     }
   }
 
-  void threadData::show( ostream& os ) const {
+  bool threadData::show( ostream& os ) const {
     if ( resultTarget != 0 ){
       exp->show_results( os, confidence, distrib, resultTarget, distance );
       if ( exact ){ // remember that a perfect match may be incorrect!
@@ -1902,17 +2951,84 @@ namespace Timbl {
 	  *exp->mylog << "Exacte match:\n" << exp->get_org_input() << endl;
 	}
       }
+      return true;
     }
+    return false;
+  }
+
+#ifdef __linux__
+  static bool parse_cpulist( const string& line, cpu_set_t& mask ){
+    // parse a sysfs cpulist like: "0-7,16-23"
+    CPU_ZERO( &mask );
+    vector<string> ranges = TiCC::split_at( TiCC::trim( line ), "," );
+    for ( const auto& range : ranges ){
+      vector<string> parts = TiCC::split_at( range, "-" );
+      int low = -1;
+      int high = -1;
+      if ( parts.size() == 1 ){
+	if ( !TiCC::stringTo( parts[0], low ) ){
+	  return false;
+	}
+	high = low;
+      }
+      else if ( parts.size() != 2
+		|| !TiCC::stringTo( parts[0], low )
+		|| !TiCC::stringTo( parts[1], high ) ){
+	return false;
+      }
+      for ( int cpu = low; cpu <= high && cpu < CPU_SETSIZE; ++cpu ){
+	CPU_SET( cpu, &mask );
+      }
+    }
+    return CPU_COUNT( &mask ) > 0;
+  }
+
+  static vector<cpu_set_t> numa_nodes(){
+    // find the cpus of every NUMA node that has any
+    vector<cpu_set_t> result;
+    for ( int node = 0; ; ++node ){
+      ifstream is( "/sys/devices/system/node/node"
+		   + TiCC::toString( node ) + "/cpulist" );
+      if ( !is ){
+	break;
+      }
+      string line;
+      cpu_set_t mask;
+      if ( getline( is, line ) && parse_cpulist( line, mask ) ){
+	result.push_back( mask );
+      }
+    }
+    return result;
+  }
+#endif
+
+  static int thread_num(){
+#ifdef HAVE_OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
   }
 
   class threadBlock {
   public:
     explicit threadBlock( TimblExperiment *, int = 1 );
-    bool readLines( istream& );
+    ~threadBlock();
+    bool readLines( InputStream& );
+    size_t replicate_on_nodes();
+    bool exec( int );
     void finalize();
     vector<threadData> exps;
   private:
+    size_t current_node() const;
     size_t size;
+    vector<InstanceBase_base *> replicas;
+    vector<vector<InstanceBase_base *>> views;
+    vector<InstanceBase_base *> own_ibs;
+#ifdef __linux__
+    vector<cpu_set_t> nodes;
+    vector<cpu_set_t> saved_masks;
+#endif
   };
 
   threadBlock::threadBlock( TimblExperiment *parent, int num ){
@@ -1920,6 +3036,10 @@ namespace Timbl {
       throw range_error( "threadBlock size cannot be <=0" );
     }
     size = num;
+    if ( size > 1 && parent->InstanceBase ){
+      // the clones share the tree, a lazily read one can't be shared
+      parent->InstanceBase->LoadAll();
+    }
     exps.resize( size );
     exps[0].exp = parent;
     for ( size_t i = 1; i < size; ++i ){
@@ -1927,15 +3047,36 @@ namespace Timbl {
       *exps[i].exp = *parent;
       exps[i].exp->initExperiment();
     };
+    for ( auto& td : exps ){
+      td.binary = parent->binaryTest;
+    }
   }
 
-  bool threadBlock::readLines( istream& is  ){
+  bool threadBlock::readLines( InputStream& is  ){
+    // fill the block with the next lines. From a pipe we only wait for
+    // the first one, and take the others only when they are available
     bool result = true;
+    for ( auto& td : exps ){
+      td.Buffer.remove();
+      td.Row.values.clear();
+    }
+    BinaryInstanceReader *binary = exps[0].exp->binaryTest;
     for ( size_t i=0; i < size; ++i ){
-      exps[i].Buffer = "";
-      int cnt;
-      bool goon = exps[0].exp->nextLine( is, exps[i].Buffer, cnt );
-      exps[i].lineNo += cnt;
+      bool goon;
+      if ( binary ){
+	goon = binary->next( exps[i].Row );
+	if ( goon ){
+	  ++exps[i].lineNo;
+	}
+      }
+      else {
+	if ( i > 0 && is.streaming() && is.rdbuf()->in_avail() <= 0 ){
+	  break;
+	}
+	int cnt;
+	goon = exps[0].exp->nextLine( is, exps[i].Buffer, cnt );
+	exps[i].lineNo += cnt;
+      }
       if ( !goon && i == 0 ){
 	result = false;
       }
@@ -1943,14 +3084,147 @@ namespace Timbl {
     return result;
   }
 
+  threadBlock::~threadBlock(){
+    for ( size_t i=0; i < own_ibs.size(); ++i ){
+      exps[i].exp->InstanceBase = own_ibs[i];
+    }
+    for ( const auto& row : views ){
+      for ( const auto& view : row ){
+	view->CleanPartition( false );
+      }
+    }
+    for ( const auto& rep : replicas ){
+      delete rep;
+    }
+  }
+
+  size_t threadBlock::replicate_on_nodes(){
+    // Give every NUMA node its own replica of the (read-only) InstanceBase
+    // and pin the threads to the cpus of their node.
+    // The replica is built by a thread that is already pinned to that node,
+    // so the default 'first touch' policy places it in local memory.
+    // Every experiment gets a view on each replica, exec() picks the one
+    // of the node it runs on.
+    // returns the number of nodes used. (0 when replication isn't possible)
+#ifdef __linux__
+    nodes = numa_nodes();
+    size_t num_nodes = min( nodes.size(), size );
+    if ( num_nodes < 2 ){
+      nodes.clear();
+      return 0;
+    }
+    nodes.resize( num_nodes );
+    TimblExperiment *parent = exps[0].exp;
+    replicas.resize( num_nodes, 0 );
+    saved_masks.resize( size );
+    int num = size;
+#pragma omp parallel num_threads(num)
+    {
+      size_t thread = thread_num();
+      size_t node = thread % num_nodes;
+      sched_getaffinity( 0, sizeof(cpu_set_t), &saved_masks[thread] );
+      sched_setaffinity( 0, sizeof(cpu_set_t), &nodes[node] );
+      if ( thread == node ){
+	replicas[node] = parent->InstanceBase->Replicate();
+      }
+    }
+    for ( const auto& rep : replicas ){
+      if ( !rep ){
+	// the runtime gave us less threads than nodes
+	for ( const auto& r : replicas ){
+	  delete r;
+	}
+	replicas.clear();
+	nodes.clear();
+	return 0;
+      }
+    }
+    views.resize( size );
+    for ( size_t i=0; i < size; ++i ){
+      own_ibs.push_back( exps[i].exp->InstanceBase );
+      for ( const auto& rep : replicas ){
+	views[i].push_back( rep->Copy() );
+      }
+      exps[i].exp->InstanceBase = views[i][0];
+      exps[i].nodeLines.assign( num_nodes, 0 );
+    }
+    return num_nodes;
+#else
+    return 0;
+#endif
+  }
+
+  size_t threadBlock::current_node() const {
+    // OpenMP doesn't promise that a parallel region hands an iteration to
+    // the same thread as the region in replicate_on_nodes() did. So we
+    // ask where the calling thread actually runs.
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if ( cpu >= 0 && cpu < CPU_SETSIZE ){
+      for ( size_t node = 0; node < nodes.size(); ++node ){
+	if ( CPU_ISSET( cpu, &nodes[node] ) ){
+	  return node;
+	}
+      }
+    }
+#endif
+    return thread_num() % replicas.size();
+  }
+
+  bool threadBlock::exec( int i ){
+    // run experiment i on the replica of the node the thread is on
+    threadData& td = exps[i];
+    if ( replicas.empty() ){
+      return td.exec();
+    }
+    size_t node = current_node();
+    td.exp->InstanceBase = views[i][node];
+    bool result = td.exec();
+    if ( result ){
+      ++td.nodeLines[node];
+    }
+    return result;
+  }
+
   void threadBlock::finalize(){
+    TimblExperiment *parent = exps[0].exp;
+    parent->nodeLines.clear();
+    if ( !replicas.empty() ){
+      parent->nodeLines.resize( replicas.size(), 0 );
+      for ( const auto& td : exps ){
+	for ( size_t node = 0; node < td.nodeLines.size(); ++node ){
+	  parent->nodeLines[node] += td.nodeLines[node];
+	}
+      }
+      // restore the original InstanceBases and the thread affinities
+      for ( size_t i=0; i < size; ++i ){
+	exps[i].exp->InstanceBase = own_ibs[i];
+	for ( const auto& view : views[i] ){
+	  view->CleanPartition( false );
+	}
+      }
+      own_ibs.clear();
+      views.clear();
+#ifdef __linux__
+      int num = size;
+#pragma omp parallel num_threads(num)
+      {
+	sched_setaffinity( 0, sizeof(cpu_set_t), &saved_masks[thread_num()] );
+      }
+#endif
+    }
     for ( size_t i=1; i < size; ++i ){
-      exps[0].exp->stats.merge( exps[i].exp->stats );
-      if ( exps[0].exp->confusionInfo ){
-	exps[0].exp->confusionInfo->merge( exps[i].exp->confusionInfo );
+      parent->stats.merge( exps[i].exp->stats );
+      parent->unknowns.mergeCounts( exps[i].exp->unknowns );
+      if ( parent->confusionInfo ){
+	parent->confusionInfo->merge( exps[i].exp->confusionInfo );
       }
       delete exps[i].exp;
     }
+    for ( const auto& rep : replicas ){
+      delete rep;
+    }
+    replicas.clear();
   }
 
 #ifdef HAVE_OPENMP
@@ -1965,49 +3239,83 @@ namespace Timbl {
 	omp_set_num_threads( numOfThreads );
       }
       threadBlock experiments( this, numOfThreads );
+      if ( numaReplicas ){
+	if ( numOfThreads < 2 ){
+	  Warning( "--numa is only useful with --clones > 1. Ignored" );
+	}
+	else if ( Algorithm() != IB1_a
+		  && Algorithm() != IGTREE_a
+		  && Algorithm() != TRIBL_a
+		  && Algorithm() != TRIBL2_a ){
+	  Warning( "--numa is not supported for "
+		   + TiCC::toString( Algorithm() ) + ". Ignored" );
+	}
+	else {
+	  size_t nodes = experiments.replicate_on_nodes();
+	  if ( nodes == 0 ){
+	    Warning( "--numa: less then 2 NUMA nodes found, using one shared "
+		     "InstanceBase" );
+	  }
+	  else if ( !Verbosity(SILENT) ){
+	    Info( "Replicated the InstanceBase on " + TiCC::toString( nodes )
+		  + " NUMA nodes" );
+	  }
+	}
+      }
       // Start time.
       //
       time_t lStartTime;
       time(&lStartTime);
       timeval startTime;
       gettimeofday( &startTime, 0 );
-      if ( InputFormat() == ARFF ){
+      if ( InputFormat() == ARFF && !binaryTest ){
 	skipARFFHeader( testStream );
       }
-      unsigned int dataCount = stats.dataLines();
+      vector<const StatisticsClass *> counters;
+      for ( const auto& td : experiments.exps ){
+	counters.push_back( &td.exp->stats );
+      }
+      startLiveStatistics( counters );
+      unique_ptr<progressReporter> reporter;
+      if ( !Verbosity(SILENT) ){
+	// Display progress counter.
+	reporter.reset( new progressReporter( this, lStartTime ) );
+      }
       while ( experiments.readLines( testStream ) ){
 	if ( numOfThreads > 1 ){
-#pragma omp parallel for shared( experiments, dataCount )
+#pragma omp parallel for schedule(static) shared( experiments )
 	  for ( int i=0; i < numOfThreads; ++i ){
-	    if ( experiments.exps[i].exec() &&
-		 !Verbosity(SILENT) )
-	      // Display progress counter.
-#pragma omp critical
-	      show_progress( *mylog, lStartTime, ++dataCount );
+	    experiments.exec( i );
 	  }
 
+	  int shown = 0;
 	  for ( int i=0; i < numOfThreads; ++i ){
 	    // Write it to the output file for later analysis.
-	    experiments.exps[i].show( outStream );
+	    if ( experiments.exps[i].show( outStream ) ){
+	      ++shown;
+	    }
 	  }
+	  resultsWritten( shown );
 	}
 	else {
-	  if ( experiments.exps[0].exec() &&
-	       !Verbosity(SILENT) ){
-	    // Display progress counter.
-	    show_progress( *mylog, lStartTime, ++dataCount );
-	  }
+	  experiments.exps[0].exec();
 	  // Write it to the output file for later analysis.
-	  experiments.exps[0].show( outStream );
+	  if ( experiments.exps[0].show( outStream ) ){
+	    resultsWritten();
+	  }
 	}
       }
+      reporter.reset();
+      stopLiveStatistics();
       experiments.finalize();
+      outStream.flush();
       if ( !Verbosity(SILENT) ){
 	time_stamp( "Ready:  ", stats.dataLines() );
 	show_speed_summary( *mylog, startTime );
 	showStatistics( *mylog );
       }
-      result = true;
+      nodeLines.clear();
+      result = !readFailed( testStream, FileName, binaryTest );
     }
     return result;
   }
@@ -2025,12 +3333,13 @@ namespace Timbl {
       time(&lStartTime);
       timeval startTime;
       gettimeofday( &startTime, 0 );
-      if ( InputFormat() == ARFF ){
+      if ( InputFormat() == ARFF && !binaryTest ){
 	skipARFFHeader( testStream );
       }
+      startLiveStatistics( { &stats } );
       UnicodeString Buffer;
-      while ( nextLine( testStream, Buffer ) ){
-	if ( !chopLine( Buffer ) ) {
+      while ( nextTestLine( Buffer ) ){
+	if ( !chopTestLine( Buffer ) ) {
 	  Warning( "testfile, skipped line #" +
 		   TiCC::toString<int>( stats.totalLines() ) +
 		   "\n" + TiCC::UnicodeToUTF8(Buffer) );
@@ -2045,11 +3354,14 @@ namespace Timbl {
 							   distance,
 							   exact );
 	  normalizeResult();
-	  distrib = bestResult.getResult();
+	  if ( Verbosity(DISTRIB) ){
+	    distrib = bestResult.getResult();
+	  }
 	  if ( Verbosity(CONFIDENCE) ){
 	    confi = confidence();
 	  }
 	  show_results( outStream, confi, distrib, resultTarget, distance );
+	  resultsWritten();
 	  if ( exact ){ // remember that a perfect match may be incorrect!
 	    if ( Verbosity(EXACT) ) {
 	      *mylog << "Exacte match:\n" << get_org_input() << endl;
@@ -2061,12 +3373,14 @@ namespace Timbl {
 	  }
 	}
       }
+      stopLiveStatistics();
+      outStream.flush();
       if ( !Verbosity(SILENT) ){
 	time_stamp( "Ready:  ", stats.dataLines() );
 	show_speed_summary( *mylog, startTime );
 	showStatistics( *mylog );
       }
-      result = true;
+      result = !readFailed( testStream, FileName, binaryTest );
     }
     return result;
   }
@@ -2091,12 +3405,12 @@ namespace Timbl {
       time(&lStartTime);
       timeval startTime;
       gettimeofday( &startTime, 0 );
-      if ( InputFormat() == ARFF ){
+      if ( InputFormat() == ARFF && !binaryTest ){
 	skipARFFHeader( testStream );
       }
       UnicodeString Buffer;
-      while ( nextLine( testStream, Buffer ) ){
-	if ( !chopLine( Buffer ) ) {
+      while ( nextTestLine( Buffer ) ){
+	if ( !chopTestLine( Buffer ) ) {
 	  Warning( "testfile, skipped line #" +
 		   TiCC::toString<int>( stats.totalLines() ) +
 		   "\n" + TiCC::UnicodeToUTF8(Buffer) );
@@ -2105,6 +3419,7 @@ namespace Timbl {
 	  chopped_to_instance( TestWords );
 	  const neighborSet *res = LocalClassify( CurrInst );
 	  outStream << get_org_input() << endl << *res;
+	  resultsWritten();
 	  if ( !Verbosity(SILENT) ){
 	    // Display progress counter.
 	    show_progress( *mylog, lStartTime, stats.dataLines() );
@@ -2115,13 +3430,13 @@ namespace Timbl {
 	time_stamp( "Ready:  ", stats.dataLines() );
 	show_speed_summary( *mylog, startTime );
       }
-      result = true;
+      result = !readFailed( testStream, FileName, binaryTest );
     }
     return result;
   }
 
   bool TimblExperiment::SetOptions( int argc, const char *argv[] ){
-    if ( IsClone() ){
+    if ( IsClone() && !forked ){
       TiCC::CL_Options Opts( timbl_serv_short_opts, "" );
       try {
 	Opts.init( argc, argv );
@@ -2145,7 +3460,7 @@ namespace Timbl {
   }
 
   bool TimblExperiment::SetOptions( const string& arg ){
-    if ( IsClone() ){
+    if ( IsClone() && !forked ){
       TiCC::CL_Options Opts( timbl_serv_short_opts, "" );
       try {
 	Opts.init( arg );
@@ -2170,7 +3485,7 @@ namespace Timbl {
 
   bool TimblExperiment::SetOptions( const TiCC::CL_Options& Opts ){
     bool result;
-    if ( IsClone() ){
+    if ( IsClone() && !forked ){
       result = OptParams->parse_options( Opts, 2 );
     }
     else {
@@ -2244,7 +3559,7 @@ namespace Timbl {
   }
 
   bool TimblExperiment::WriteArrays( const std::string& FileName ){
-    ofstream out( FileName, ios::out | ios::trunc );
+    ofstream out( FileName, ios::out | ios::trunc | ios::binary );
     if ( !out ) {
       Warning( "Problem opening Probability file '" +
 	       FileName + "' (not written)" );
@@ -2254,11 +3569,30 @@ namespace Timbl {
       if ( !Verbosity(SILENT) ){
 	Info( "Saving Probability Arrays in " + FileName );
       }
+      if ( binaryTables ){
+	BinaryTableWriter tab( ArraysTable );
+	return MBLClass::writeArrays( tab ) && tab.write( out );
+      }
       return MBLClass::writeArrays( out );
     }
   }
 
   bool TimblExperiment::GetArrays( const std::string& FileName ){
+    if ( BinaryTableReader::detect( FileName ) ){
+      if ( !Verbosity(SILENT) ){
+	Info( "Reading binary Probability Arrays from " + FileName );
+      }
+      BinaryTableReader tab;
+      if ( !tab.open( FileName, ArraysTable ) ){
+	Error( tab.error() );
+	return false;
+      }
+      else if ( !readArrays( tab ) ){
+	Error( "Errors found in file " + FileName );
+	return false;
+      }
+      return true;
+    }
     ifstream inf( FileName, ios::in );
     if ( !inf ){
       Error( "Problem opening Probability file " + FileName );
@@ -2279,7 +3613,7 @@ namespace Timbl {
   }
 
   bool TimblExperiment::WriteMatrices( const std::string& FileName ){
-    ofstream out( FileName, ios::out | ios::trunc );
+    ofstream out( FileName, ios::out | ios::trunc | ios::binary );
     if ( !out ) {
       Warning( "Problem opening matrices file '" +
 	       FileName + "' (not written)" );
@@ -2290,11 +3624,30 @@ namespace Timbl {
 	Info( "Saving Matrices in " + FileName );
       }
       initExperiment( );
+      if ( binaryTables ){
+	BinaryTableWriter tab( MatricesTable );
+	return writeMatrices( tab ) && tab.write( out );
+      }
       return writeMatrices( out );
     }
     }
 
   bool TimblExperiment::GetMatrices( const std::string& FileName ){
+    if ( BinaryTableReader::detect( FileName ) ){
+      if ( !Verbosity(SILENT) ){
+	Info( "Reading binary matrices from " + FileName );
+      }
+      BinaryTableReader tab;
+      if ( !tab.open( FileName, MatricesTable ) ){
+	Error( tab.error() );
+	return false;
+      }
+      else if ( !readMatrices( tab ) ){
+	Error( "Errors found in file " + FileName );
+	return false;
+      }
+      return true;
+    }
     ifstream inf( FileName, ios::in );
     if ( !inf ){
       Error( "Problem opening matrices file " + FileName );
@@ -2318,7 +3671,7 @@ namespace Timbl {
     if ( ConfirmOptions() ){
       // Open the output file.
       //
-      ofstream outfile( FileName, ios::out | ios::trunc);
+      ofstream outfile( FileName, ios::out | ios::trunc | ios::binary );
       if (!outfile) {
 	Warning( "can't open Weightsfile: " + FileName );
 	return false;
@@ -2327,7 +3680,15 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  Info( "Saving Weights in " + FileName );
 	}
-	if ( writeWeights( outfile ) ){
+	bool ok;
+	if ( binaryTables ){
+	  BinaryTableWriter tab( WeightsTable );
+	  ok = writeWeights( tab ) && tab.write( outfile );
+	}
+	else {
+	  ok = writeWeights( outfile );
+	}
+	if ( ok ){
 	  return true;
 	}
 	else {
@@ -2357,7 +3718,21 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  Info( "Reading weights from " + FileName );
 	}
-	if ( readWeights( weightsfile, w ) ){
+	bool ok;
+	if ( BinaryTableReader::detect( FileName ) ){
+	  BinaryTableReader tab;
+	  ok = tab.open( FileName, WeightsTable );
+	  if ( !ok ){
+	    Error( tab.error() );
+	  }
+	  else {
+	    ok = readWeights( tab, w );
+	  }
+	}
+	else {
+	  ok = readWeights( weightsfile, w );
+	}
+	if ( ok ){
 	  WFileName = FileName;
 	  return true;
 	}
@@ -2374,7 +3749,13 @@ namespace Timbl {
 
   bool TimblExperiment::WriteInstanceBase( const std::string& FileName ){
     bool result = false;
-    if ( ConfirmOptions() ){
+    if ( shards ){
+      Warning( "unable to write a sharded InstanceBase" );
+    }
+    else if ( sparse_search ){
+      Warning( "unable to write the InstanceBase of a sparse search" );
+    }
+    else if ( ConfirmOptions() ){
       ofstream outfile( FileName, ios::out | ios::trunc );
       if (!outfile) {
 	Warning( "can't open outputfile: " + FileName );
@@ -2383,12 +3764,348 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  Info( "Writing Instance-Base in: " + FileName );
 	}
-	result = PutInstanceBase( outfile );
+	result = PutInstanceBase( outfile, Clones() > 1 );
+	if ( result ){
+	  writeTreeIndex( FileName, outfile.tellp() );
+	}
       }
     }
     return result;
   }
 
+  void TimblExperiment::writeTreeIndex( const string& FileName,
+					streamoff size ) const {
+    // write the offsets of the top level subtrees of the InstanceBase
+    // file just written, next to it as FileName.idx. With such an index
+    // ReadInstanceBase() parses the subtrees in parallel, or an IGTree
+    // reads them on demand
+    const vector<streamoff>& offsets = InstanceBase->subtreeOffsets();
+    string idxName = FileName + ".idx";
+    if ( offsets.size() < 2 || size < 0 ){
+      remove( idxName.c_str() ); // don't leave a stale one
+      return;
+    }
+    ofstream os( idxName, ios::out | ios::trunc );
+    if ( !os ){
+      Warning( "can't write InstanceBase index: " + idxName );
+      return;
+    }
+    os << "# InstanceBase index for: " << FileName << "\n"
+       << "# Size: " << size << "\n"
+       << "# Nodes: " << InstanceBase->savedNodes() << "\n"
+       << "# Tails: " << InstanceBase->savedTails() << "\n"
+       << "# Subtrees: " << offsets.size() << "\n";
+    for ( const auto off : offsets ){
+      os << off << "\n";
+    }
+  }
+
+  void TimblExperiment::readTreeIndex( const string& FileName,
+				       istream& is ){
+    // read the index of FileName, when it exists and still belongs to it.
+    // Only useful when we may use more than one thread, or load lazily
+    treeIndex.clear();
+    treeFile.clear();
+    treeNodes = 0;
+    treeTails = 0;
+    if ( Clones() < 2 && lazyLoad < 0 ){
+      return;
+    }
+    ifstream idx( FileName + ".idx" );
+    if ( !idx ){
+      return;
+    }
+    streamoff start = is.tellg();
+    is.seekg( 0, ios::end );
+    streamoff size = is.tellg();
+    is.seekg( start );
+    streamoff idx_size = -1;
+    size_t count = 0;
+    string line;
+    while ( look_ahead( idx ) == '#' && getline( idx, line ) ){
+      vector<string> parts = TiCC::split( line );
+      if ( parts.size() == 3 ){
+	if ( parts[1] == "Size:" ){
+	  TiCC::stringTo( parts[2], idx_size );
+	}
+	else if ( parts[1] == "Subtrees:" ){
+	  TiCC::stringTo( parts[2], count );
+	}
+	else if ( parts[1] == "Nodes:" ){
+	  TiCC::stringTo( parts[2], treeNodes );
+	}
+	else if ( parts[1] == "Tails:" ){
+	  TiCC::stringTo( parts[2], treeTails );
+	}
+      }
+    }
+    streamoff off;
+    while ( idx >> off ){
+      treeIndex.push_back( off );
+    }
+    if ( idx_size != size || treeIndex.size() != count ){
+      Warning( "ignoring InstanceBase index " + FileName + ".idx"
+	       + ", it doesn't match the file" );
+      treeIndex.clear();
+    }
+    else {
+      treeFile = FileName;
+      if ( !Verbosity(SILENT) && Clones() > 1 ){
+	Info( "Using InstanceBase index " + FileName + ".idx with "
+	      + TiCC::toString( Clones() ) + " threads" );
+      }
+    }
+  }
+
+  void TimblExperiment::setLazyLoad(){
+    // let the InstanceBase just made read its subtrees on demand,
+    // when asked for and possible
+    if ( LazyLoad() < 0 ){
+      return;
+    }
+    else if ( Clones() > 1 ){
+      Warning( "lazy loading isn't possible with more than 1 thread, "
+	       "reading the whole Instance-Base" );
+    }
+    else if ( treeIndex.empty() || treeNodes == 0 ){
+      Warning( "lazy loading needs a matching index with node counts, "
+	       "reading the whole Instance-Base" );
+    }
+    else {
+      InstanceBase->setLazyLoad( treeFile, treeNodes, treeTails,
+				 size_t(LazyLoad()) );
+    }
+  }
+
+  static streamoff file_size( const string& FileName ){
+    ifstream is( FileName, ios::binary | ios::ate );
+    if ( !is ){
+      return -1;
+    }
+    return is.tellg();
+  }
+
+  static bool sync_file( const string& FileName ){
+    // make sure FileName (or a directory) is on disk
+    int fd = open( FileName.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      return false;
+    }
+    bool result = ( fsync( fd ) == 0 );
+    close( fd );
+    return result;
+  }
+
+  static string dir_name( const string& FileName ){
+    string::size_type pos = FileName.rfind( '/' );
+    if ( pos == string::npos ){
+      return ".";
+    }
+    else if ( pos == 0 ){
+      return "/";
+    }
+    return FileName.substr( 0, pos );
+  }
+
+  bool TimblExperiment::WriteSnapshot( const string& FileName,
+				       size_t limit ){
+    // write the InstanceBase to FileName, and start a fresh delta log
+    // FileName.delta next to it. From now on every instance added or
+    // removed is appended to that log, and ReadInstanceBase( FileName )
+    // replays it on top of the snapshot. After 'limit' changes (0 means
+    // never) a new snapshot is written and the log starts over.
+    // The new snapshot and log are written next to the old ones, and only
+    // renamed over them when they are on disk. Until then a crash leaves
+    // the old snapshot and its log intact
+    deltaLog.close();
+    snapshotName.clear();
+    string tmpName = FileName + ".tmp";
+    string deltaName = FileName + ".delta";
+    string tmpDelta = deltaName + ".tmp";
+    string hash;
+    if ( WriteInstanceBase( tmpName ) && sync_file( tmpName ) ){
+      hash = file_hash( tmpName, Clones() );
+    }
+    bool ok = !hash.empty();
+    if ( ok ){
+      ofstream os( tmpDelta, ios::out | ios::trunc );
+      os << "# Delta log for: " << FileName << "\n"
+	 << "# Size: " << file_size( tmpName ) << "\n"
+	 << "# Hash: " << hash << "\n"
+	 << "# Format: " << TiCC::toString( InputFormat() ) << "\n"
+	 << "# Compact: " << limit << endl;
+      ok = os.good();
+    }
+    ok = ok && sync_file( tmpDelta );
+    // the old log doesn't match the new snapshot, so after this rename
+    // it is ignored until it is replaced too
+    ok = ok && rename( tmpName.c_str(), FileName.c_str() ) == 0;
+    if ( !ok ){
+      Warning( "can't write snapshot: " + FileName
+	       + ", the old one is kept" );
+      for ( const auto& ext : { "", ".idx", ".wgt" } ){
+	remove( ( tmpName + ext ).c_str() );
+      }
+      remove( tmpDelta.c_str() );
+      return false;
+    }
+    for ( const auto& ext : { ".idx", ".wgt" } ){
+      // the files written next to the InstanceBase follow it
+      string from = tmpName + ext;
+      if ( file_size( from ) >= 0 ){
+	rename( from.c_str(), ( FileName + ext ).c_str() );
+      }
+      else if ( string(ext) == ".idx" ){
+	remove( ( FileName + ext ).c_str() );
+      }
+    }
+    if ( rename( tmpDelta.c_str(), deltaName.c_str() ) != 0 ){
+      Warning( "can't write delta log: " + deltaName );
+      remove( tmpDelta.c_str() );
+      return false;
+    }
+    sync_file( dir_name( FileName ) );
+    deltaLog.open( deltaName, ios::out | ios::app );
+    if ( !deltaLog ){
+      Warning( "can't write delta log: " + deltaName );
+      return false;
+    }
+    snapshotName = FileName;
+    deltaLimit = limit;
+    deltaCount = 0;
+    return true;
+  }
+
+  void TimblExperiment::logDelta( char op, const UnicodeString& line ){
+    // remember an added ('+') or removed ('-') instance
+    if ( deltaLog.is_open() ){
+      deltaLog << op << ' ' << line << '\n';
+      ++deltaCount;
+    }
+  }
+
+  bool TimblExperiment::syncDelta(){
+    // called after each update: make the log durable, and compact it into
+    // a new snapshot when it grew too long
+    if ( !deltaLog.is_open() ){
+      return true;
+    }
+    if ( deltaLimit > 0 && deltaCount >= deltaLimit ){
+      return WriteSnapshot( string(snapshotName), deltaLimit );
+    }
+    // an ofstream only flushes to the OS, so fsync the file too. fsync()
+    // writes all data of the file, whichever descriptor wrote it
+    if ( !deltaLog.flush()
+	 || !sync_file( snapshotName + ".delta" ) ){
+      Warning( "writing the delta log for " + snapshotName + " failed" );
+      return false;
+    }
+    return true;
+  }
+
+  bool TimblExperiment::replayDelta( const string& FileName ){
+    // apply FileName.delta, when it belongs to the snapshot just read,
+    // and keep logging to it
+    string deltaName = FileName + ".delta";
+    ifstream is( deltaName );
+    if ( !is ){
+      return true;
+    }
+    streamoff size = -1;
+    string hash;
+    InputFormatType IF = UnknownInputFormat;
+    size_t limit = 0;
+    string line;
+    while ( look_ahead( is ) == '#' && getline( is, line ) ){
+      vector<string> parts = TiCC::split( line );
+      if ( parts.size() == 3 ){
+	if ( parts[1] == "Size:" ){
+	  TiCC::stringTo( parts[2], size );
+	}
+	else if ( parts[1] == "Hash:" ){
+	  hash = parts[2];
+	}
+	else if ( parts[1] == "Compact:" ){
+	  TiCC::stringTo( parts[2], limit );
+	}
+	else if ( parts[1] == "Format:" ){
+	  try {
+	    IF = TiCC::stringTo<InputFormatType>( parts[2] );
+	  }
+	  catch( ... ){
+	    IF = UnknownInputFormat;
+	  }
+	}
+      }
+    }
+    // only the size is cheap to check, the hash proves the log belongs
+    // to this very snapshot
+    if ( size != file_size( FileName )
+	 || hash.empty()
+	 || hash != file_hash( FileName, Clones() ) ){
+      Warning( "ignoring delta log " + deltaName
+	       + ", it doesn't match the InstanceBase" );
+      return true;
+    }
+    if ( IF == UnknownInputFormat ){
+      Error( "delta log " + deltaName + " has no valid Format" );
+      return false;
+    }
+    if ( InputFormat() == UnknownInputFormat ){
+      setInputFormat( IF );
+    }
+    else if ( InputFormat() != IF ){
+      Error( "delta log " + deltaName + " is in " + TiCC::toString( IF )
+	     + " format, not in " + TiCC::toString( InputFormat() ) );
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Replaying delta log: " + deltaName );
+    }
+    size_t count = 0;
+    UnicodeString Buffer;
+    while ( TiCC::getline( is, Buffer ) ){
+      if ( Buffer.length() < 3
+	   || ( Buffer[0] != '+' && Buffer[0] != '-' )
+	   || Buffer[1] != ' ' ){
+	if ( !Buffer.isEmpty() ){
+	  Warning( "delta log, skipped line #" + TiCC::toString( count+1 )
+		   + "\n" + TiCC::UnicodeToUTF8(Buffer) );
+	}
+	continue;
+      }
+      if ( !Chop( UnicodeString( Buffer, 2 ) ) ){
+	Error( "Couldn't convert to Instance: "
+	       + TiCC::UnicodeToUTF8(Buffer) );
+	return false;
+      }
+      if ( Buffer[0] == '+' ){
+	chopped_to_instance( TrainLearnWords );
+	InstanceBase->AddInstance( CurrInst );
+      }
+      else {
+	chopped_to_instance( TestWords );
+	HideInstance( CurrInst );
+      }
+      ++count;
+    }
+    MBL_init = false;
+    if ( !Verbosity(SILENT) ){
+      Info( "Replayed " + TiCC::toString( count ) + " changes" );
+    }
+    is.close();
+    deltaLog.open( deltaName, ios::out | ios::app );
+    if ( !deltaLog ){
+      Warning( "can't append to delta log: " + deltaName );
+    }
+    else {
+      snapshotName = FileName;
+      deltaLimit = limit;
+      deltaCount = count;
+    }
+    return true;
+  }
+
   bool TimblExperiment::WriteInstanceBaseXml( const std::string& FileName ) {
     bool result = false;
     if ( ConfirmOptions() ){
@@ -2406,8 +4123,11 @@ namespace Timbl {
 	else if ( InstanceBase == NULL ){
 	  Warning( "unable to write an Instance Base, nothing learned yet" );
 	}
+	else if ( sparse_search ){
+	  Warning( "unable to write the InstanceBase of a sparse search" );
+	}
 	else {
-	  InstanceBase->toXML( os );
+	  result = InstanceBase->toXML( os );
 	}
       }
     }
@@ -2432,6 +4152,9 @@ namespace Timbl {
 	else if ( InstanceBase == NULL ){
 	  Warning( "unable to write an Instance Base, nothing learned yet" );
 	}
+	else if ( sparse_search ){
+	  Warning( "unable to write the InstanceBase of a sparse search" );
+	}
 	else {
 	  InstanceBase->printStatsTree( os, levels );
 	}
@@ -2475,6 +4198,7 @@ namespace Timbl {
 	InstanceBase = new IB_InstanceBase( EffectiveFeatures(),
 					    ibCount,
 					    (RandomSeed()>=0) );
+	InstanceBase->setLoadIndex( treeIndex, Clones() );
 	if ( Hashed ){
 	  result = InstanceBase->ReadIB_hashed( is,
 						features,
@@ -2492,7 +4216,35 @@ namespace Timbl {
     return result;
   }
 
+  void TimblExperiment::rankValues(){
+    // with --frequency-order, rank the values of every feature on their
+    // frequency, which orders the value lists of the InstanceBase
+    if ( !frequencyOrder ){
+      return;
+    }
+    if ( Algorithm() == IGTREE_a ){
+      Warning( "--frequency-order is ignored for IGTree, "
+	       "use --compact to order a tree on frequency" );
+      return;
+    }
+    for ( const auto& feat : features.feats ){
+      feat->rank_by_frequency();
+    }
+  }
+
+  void TimblExperiment::orderInstanceBase(){
+    // a tree which was read may have its value lists in another order
+    // than AddInstance() needs, e.g. from a ranked experiment
+    if ( InstanceBase && Algorithm() != IGTREE_a ){
+      rankValues();
+      InstanceBase->OrderByRank();
+    }
+  }
+
   bool TimblExperiment::ReadInstanceBase( const string& FileName ){
+    if ( BundleReader::detect( FileName ) ){
+      return ReadBundle( FileName );
+    }
     bool result = false;
     if ( ConfirmOptions() ){
       ifstream infile( FileName, ios::in );
@@ -2503,10 +4255,24 @@ namespace Timbl {
 	if ( !Verbosity(SILENT) ){
 	  Info( "Reading Instance-Base from: " + FileName );
 	}
-	if ( GetInstanceBase( infile ) ){
+	if ( lazyLoad >= 0 && Algorithm() != IGTREE_a
+	     && Algorithm() != TRIBL_a && Algorithm() != TRIBL2_a ){
+	  Warning( "lazy loading is only possible for IGTree, TRIBL and "
+		   "TRIBL2, reading the whole Instance-Base" );
+	}
+	readTreeIndex( FileName, infile );
+	bool got = GetInstanceBase( infile );
+	treeIndex.clear();
+	deltaLog.close();
+	snapshotName.clear();
+	if ( got ){
+	  orderInstanceBase();
+	  got = replayDelta( FileName );
+	}
+	if ( got ){
 	  if ( !Verbosity(SILENT) ){
-	    IBInfo( cout );
-	    writePermutation( cout );
+	    IBInfo( *mylog );
+	    writePermutation( *mylog );
 	  }
 	  result = true;
 	}
@@ -2515,6 +4281,240 @@ namespace Timbl {
     return result;
   }
 
+  bool TimblExperiment::WriteBundle( const string& FileName ){
+    // write everything needed to run this experiment again in one file:
+    // the InstanceBase, the weights, the arrays and matrices when used,
+    // the names and the settings. ReadInstanceBase() recognizes it
+    if ( shards ){
+      Warning( "unable to write a bundle of a sharded InstanceBase" );
+      return false;
+    }
+    else if ( sparse_search ){
+      Warning( "unable to write a bundle of a sparse search" );
+      return false;
+    }
+    else if ( !ConfirmOptions() ){
+      return false;
+    }
+    else if ( InstanceBase == 0 ){
+      Warning( "unable to write a bundle, nothing learned yet" );
+      return false;
+    }
+    initExperiment();
+    BundleWriter bundle;
+    json& head = bundle.header();
+    head["format"] = "TiMBL bundle";
+    head["timbl"] = Common::Version();
+    head["algorithm"] = TiCC::toString( algorithm );
+    head["settings"] = MBLClass::settings_to_JSON()["settings"];
+    head["metrics"] = metrics_to_JSON();
+    ostringstream tree;
+    if ( !PutInstanceBase( tree, false ) ){
+      return false;
+    }
+    json tree_info;
+    tree_info["nodes"] = InstanceBase->savedNodes();
+    tree_info["tails"] = InstanceBase->savedTails();
+    tree_info["index"] = InstanceBase->subtreeOffsets();
+    head["tree"] = tree_info;
+    bundle.add( "tree", tree.str() );
+    BinaryTableWriter wgt( WeightsTable );
+    ostringstream wgt_out;
+    if ( !writeWeights( wgt ) || !wgt.write( wgt_out ) ){
+      Warning( "unable to store the weights in bundle " + FileName );
+      return false;
+    }
+    bundle.add( "weights", wgt_out.str() );
+    bool storable = false;
+    bool matrices = false;
+    for ( const auto& feat : features.feats ){
+      bool dummy;
+      storable |= ( !feat->Ignore() && feat->isStorableMetric() );
+      matrices |= feat->matrixPresent( dummy );
+    }
+    if ( storable ){
+      BinaryTableWriter arr( ArraysTable );
+      ostringstream arr_out;
+      if ( !writeArrays( arr ) || !arr.write( arr_out ) ){
+	Warning( "unable to store the probability arrays in bundle "
+		 + FileName );
+	return false;
+      }
+      bundle.add( "arrays", arr_out.str() );
+    }
+    if ( matrices ){
+      BinaryTableWriter mat( MatricesTable );
+      ostringstream mat_out;
+      if ( !writeMatrices( mat ) || !mat.write( mat_out ) ){
+	Warning( "unable to store the matrices in bundle " + FileName );
+	return false;
+      }
+      bundle.add( "matrices", mat_out.str() );
+    }
+    ostringstream names;
+    MBLClass::writeNamesFile( names );
+    bundle.add( "names", names.str() );
+    ofstream outfile( FileName, ios::out | ios::trunc | ios::binary );
+    if ( !outfile ){
+      Warning( "can't open outputfile: " + FileName );
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Writing bundle in: " + FileName );
+    }
+    if ( !bundle.write( outfile, Clones() ) ){
+      Warning( "failed to write bundle " + FileName );
+      return false;
+    }
+    return true;
+  }
+
+  bool TimblExperiment::CompactInstanceBase(){
+    // strip what a pruned IGTree keeps but never uses while testing,
+    // and report the sizes before and after
+    if ( shards ){
+      Warning( "unable to compact a sharded InstanceBase" );
+      return false;
+    }
+    else if ( InstanceBase == 0 ){
+      Warning( "unable to compact, nothing learned yet" );
+      return false;
+    }
+    IG_InstanceBase *ib = dynamic_cast<IG_InstanceBase*>( InstanceBase );
+    if ( !ib ){
+      Warning( "compacting is only supported for IGTree" );
+      return false;
+    }
+    unsigned long int old_dists;
+    unsigned long int old_dbytes;
+    ib->distributionInfo( old_dists, old_dbytes );
+    unsigned long int old_size;
+    double compression;
+    unsigned long int old_bytes = ib->GetSizeInfo( old_size, compression );
+    ib->Compact();
+    unsigned long int new_dists;
+    unsigned long int new_dbytes;
+    ib->distributionInfo( new_dists, new_dbytes );
+    unsigned long int new_size;
+    unsigned long int new_bytes = ib->GetSizeInfo( new_size, compression );
+    if ( !Verbosity(SILENT) ){
+      ostringstream msg;
+      msg << "Compacted Instance-Base: " << old_size << " -> " << new_size
+	  << " Nodes (" << old_bytes << " -> " << new_bytes << " bytes), "
+	  << old_dists << " -> " << new_dists << " distributions (about "
+	  << old_dbytes << " -> " << new_dbytes << " bytes)";
+      Info( msg.str() );
+    }
+    return true;
+  }
+
+  bool TimblExperiment::ReadBundle( const string& FileName ){
+    // read a bundle written by WriteBundle(). Its settings replace ours,
+    // except the ones about output and input files
+    BundleReader bundle;
+    if ( !bundle.open( FileName ) ){
+      Error( bundle.error() );
+      return false;
+    }
+    const json& head = bundle.header();
+    string algo = head.value( "algorithm", "" );
+    if ( algo != TiCC::toString( algorithm ) ){
+      Error( "bundle " + FileName + " was made with " + algo
+	     + ", not with " + TiCC::toString( algorithm ) );
+      return false;
+    }
+    if ( algorithm == TRIBL_a ){
+      // TRIBL insists on a -q, take the one of the bundle
+      for ( const auto& element : head.value( "settings", json::array() ) ){
+	if ( element.contains( "TRIBL_OFFSET" ) ){
+	  SetOptions( "-q " + element["TRIBL_OFFSET"].get<string>() );
+	}
+      }
+    }
+    if ( !ConfirmOptions() ){
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Reading bundle from: " + FileName );
+    }
+    if ( !bundle.verify( Clones() ) ){
+      Error( bundle.error() );
+      return false;
+    }
+    if ( !restore_settings( head.value( "settings", json::array() ),
+			    head.value( "metrics", json::object() ) ) ){
+      return false;
+    }
+    const char *pnt;
+    size_t len;
+    if ( !bundle.section( "tree", pnt, len ) ){
+      Error( "bundle " + FileName + " has no InstanceBase" );
+      return false;
+    }
+    treeIndex.clear();
+    treeFile.clear();
+    treeNodes = 0;
+    treeTails = 0;
+    if ( Clones() > 1 && head.contains( "tree" ) ){
+      treeIndex = head["tree"].value( "index", vector<streamoff>() );
+    }
+    long lazy = lazyLoad;
+    if ( lazy >= 0 ){
+      Warning( "lazy loading isn't possible from a bundle, "
+	       "reading the whole Instance-Base" );
+      lazyLoad = -1;
+    }
+    memorybuf tree_buf( pnt, len );
+    istream tree( &tree_buf );
+    bool got = GetInstanceBase( tree );
+    lazyLoad = lazy;
+    treeIndex.clear();
+    deltaLog.close();
+    snapshotName.clear();
+    if ( !got ){
+      return false;
+    }
+    orderInstanceBase();
+    bundle.section( "weights", pnt, len );
+    BinaryTableReader tab;
+    WeightType wanted = CurrentWeighting();
+    if ( wanted == UserDefined_w || wanted == Unknown_w ){
+      // weights read before are stored as GainRatio too
+      wanted = GR_w;
+    }
+    if ( !tab.open( pnt, len, WeightsTable, FileName + " (weights)" ) ){
+      Error( tab.error() );
+      return false;
+    }
+    else if ( !readWeights( tab, wanted ) ){
+      return false;
+    }
+    if ( bundle.section( "arrays", pnt, len ) ){
+      if ( !tab.open( pnt, len, ArraysTable, FileName + " (arrays)" ) ){
+	Error( tab.error() );
+	return false;
+      }
+      else if ( !readArrays( tab ) ){
+	return false;
+      }
+    }
+    if ( bundle.section( "matrices", pnt, len ) ){
+      if ( !tab.open( pnt, len, MatricesTable, FileName + " (matrices)" ) ){
+	Error( tab.error() );
+	return false;
+      }
+      else if ( !readMatrices( tab ) ){
+	return false;
+      }
+    }
+    WFileName = FileName;
+    if ( !Verbosity(SILENT) ){
+      IBInfo( *mylog );
+      writePermutation( *mylog );
+    }
+    return true;
+  }
+
   bool TimblExperiment::WriteNamesFile( const string& FileName ) const {
     // Open the file.
     //
@@ -2533,13 +4533,155 @@ namespace Timbl {
     }
   }
 
+  static UnicodeString strip_separator( const UnicodeString& line,
+				       InputFormatType IF ){
+    // getString() ends with the separator which show_results() expects
+    // before the answer. Remove it
+    UChar sep = 0;
+    switch ( IF ){
+    case C4_5:
+    case ARFF:
+    case SparseBin:
+    case Sparse:
+      sep = ',';
+      break;
+    case Tabbed:
+      sep = '\t';
+      break;
+    case Columns:
+      sep = ' ';
+      break;
+    default:
+      break;
+    }
+    UnicodeString result = line;
+    if ( sep != 0
+	 && !result.isEmpty()
+	 && result[result.length()-1] == sep ){
+      result.truncate( result.length()-1 );
+    }
+    return result;
+  }
+
+  bool TimblExperiment::ConvertInstances( const string& InFile,
+					  const string& OutFile ){
+    // Write the instances from InFile to OutFile, as a binary instance
+    // file when InFile is text, and as text when InFile is binary.
+    // (ARFF data comes back as C4.5 lines, without the ARFF header)
+    if ( ExpInvalid()
+	 || !ConfirmOptions() ){
+      return false;
+    }
+    bool to_text = BinaryInstanceReader::detect( InFile );
+    InputStream datafile;
+    unique_ptr<BinaryInstanceReader> binary;
+    size_t Num = 0;
+    if ( to_text ){
+      datafile.open( InFile );
+      binary.reset( openBinary( datafile, InFile ) );
+      if ( binary ){
+	Num = binary->numFeatures();
+      }
+    }
+    else {
+      Num = examineData( InFile );
+      datafile.open( InFile );
+    }
+    if ( Num == 0 ){
+      Error( "unable to convert the instances from: " + InFile );
+      return false;
+    }
+    ofstream os( OutFile, ios::out | ios::trunc | ios::binary );
+    if ( !os ){
+      Error( "can't open: " + OutFile );
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Converting " + InFile + " to a "
+	    + ( to_text ? "text" : "binary instance" ) + " file: "
+	    + OutFile );
+    }
+    unique_ptr<Chopper> chopper( newChopper() );
+    size_t count = 0;
+    if ( to_text ){
+      binaryRow row;
+      while ( binary->next( row ) ){
+	binary->fill( row, *chopper );
+	os << strip_separator( chopper->getString(), InputFormat() );
+	if ( binary->weighted() ){
+	  char buf[32];
+	  auto res = to_chars( buf, buf + sizeof(buf), row.weight );
+	  os << " " << string( buf, res.ptr );
+	}
+	if ( binary->withOccurrences() ){
+	  os << " " << row.occurrences;
+	}
+	os << "\n";
+	++count;
+      }
+      if ( readFailed( datafile, InFile, binary.get() ) ){
+	return false;
+      }
+    }
+    else {
+      if ( InputFormat() == ARFF ){
+	skipARFFHeader( datafile );
+      }
+      BinaryInstanceWriter writer( os, Num, InputFormat(),
+				   chopExamples(), chopOcc() );
+      UnicodeString Buffer;
+      stats.clear();
+      while ( nextLine( datafile, Buffer ) ){
+	bool chopped = false;
+	try {
+	  chopped = chopper->chop( Buffer, Num );
+	}
+	catch ( const exception& e ){
+	  Warning( e.what() );
+	}
+	if ( !chopped ){
+	  stats.addSkipped();
+	  Warning( "datafile, skipped line #" +
+		   TiCC::toString<int>( stats.totalLines() ) +
+		   "\n" + TiCC::UnicodeToUTF8(Buffer) );
+	}
+	else {
+	  stats.addLine();
+	  writer.add( *chopper );
+	}
+      }
+      if ( readFailed( datafile, InFile ) ){
+	return false;
+      }
+      writer.finish();
+      count = writer.size();
+    }
+    if ( !os.good() ){
+      Error( "problems writing: " + OutFile );
+      return false;
+    }
+    if ( !Verbosity(SILENT) ){
+      Info( "Converted " + TiCC::toString( count ) + " instances" );
+    }
+    return true;
+  }
+
   void IB1_Experiment::InitInstanceBase(){
     srand( RandomSeed() );
     set_order();
     runningPhase = TrainWords;
-    InstanceBase = new IB_InstanceBase( EffectiveFeatures(),
-					ibCount,
-					(RandomSeed()>=0) );
+    if ( sparse_search ){
+      Sparse_InstanceBase *sparse = new Sparse_InstanceBase( EffectiveFeatures(),
+							     ibCount,
+							     (RandomSeed()>=0) );
+      init_sparse( sparse );
+      InstanceBase = sparse;
+    }
+    else {
+      InstanceBase = new IB_InstanceBase( EffectiveFeatures(),
+					  ibCount,
+					  (RandomSeed()>=0) );
+    }
   }
 
   bool TimblExperiment::GetCurrentWeights( vector<double>& res ) {
@@ -2558,13 +4700,32 @@ namespace Timbl {
 
   bool TimblExperiment::build_file_index( const string& file_name,
 					  fileIndex& fmIndex ){
+    if ( ingest ){
+      // no need to read the file again
+      if ( !Verbosity(SILENT) ) {
+	Info( "Phase 2: Building index on the stored instances" );
+	time_stamp( "Start:     ", 0 );
+      }
+      size_t f0 = features.permutation[0];
+      for ( size_t row=0; row < ingest->size(); ++row ){
+	FeatureValue *fv0 = ingest->value( row, f0 );
+	if ( !fv0 ){
+	  Error( "unable to retrieve stored instance "
+		 + TiCC::toString( row ) );
+	  return false;
+	}
+	fmIndex[fv0].push_back( row );
+      }
+      time_stamp( "Finished:  ", ingest->size() );
+      return true;
+    }
     bool result = true;
     UnicodeString Buffer;
     stats.clear();
     size_t cur_pos = 0;
     // Open the file.
     //
-    ifstream datafile( file_name, ios::in);
+    InputStream datafile( file_name );
     if ( InputFormat() == ARFF ){
       skipARFFHeader( datafile );
     }
@@ -2591,12 +4752,10 @@ namespace Timbl {
 	FeatureValue *fv0 = CurrInst.FV[0];
 	auto const it = fmIndex.find( fv0 );
 	if ( it == fmIndex.end() ){
-	  set<streamsize> st;
-	  st.insert(cur_pos);
-	  fmIndex[fv0] = st;
+	  fmIndex[fv0].push_back( cur_pos );
 	}
 	else {
-	  it->second.insert( cur_pos );
+	  it->second.push_back( cur_pos );
 	}
 	if ( (stats.dataLines() % Progress() ) == 0 ){
 	  time_stamp( "Indexing:  ", stats.dataLines() );
@@ -2621,13 +4780,34 @@ namespace Timbl {
 
   bool TimblExperiment::build_file_multi_index( const string& file_name,
 						fileDoubleIndex& fmIndex ){
+    if ( ingest ){
+      // no need to read the file again
+      if ( !Verbosity(SILENT) ){
+	Info( "Phase 2: Building multi index on the stored instances" );
+	time_stamp( "Start:     ", 0 );
+      }
+      size_t f0 = features.permutation[0];
+      size_t f1 = features.permutation[1];
+      for ( size_t row=0; row < ingest->size(); ++row ){
+	FeatureValue *fv0 = ingest->value( row, f0 );
+	FeatureValue *fv1 = ingest->value( row, f1 );
+	if ( !fv0 || !fv1 ){
+	  Error( "unable to retrieve stored instance "
+		 + TiCC::toString( row ) );
+	  return false;
+	}
+	fmIndex[fv0][fv1].push_back( row );
+      }
+      time_stamp( "Finished:  ", ingest->size() );
+      return true;
+    }
     bool result = true;
     UnicodeString Buffer;
     stats.clear();
     size_t cur_pos = 0;
     // Open the file.
     //
-    ifstream datafile( file_name, ios::in);
+    InputStream datafile( file_name );
     if ( InputFormat() == ARFF ){
       skipARFFHeader( datafile );
     }
@@ -2655,11 +4835,11 @@ namespace Timbl {
 	FeatureValue *fv1 = CurrInst.FV[1];
 	auto const it = fmIndex.find( fv0 );
 	if ( it != fmIndex.end() ){
-	  it->second[fv1].insert( cur_pos );
+	  it->second[fv1].push_back( cur_pos );
 	}
 	else {
 	  fileIndex mi;
-	  mi[fv1].insert( cur_pos );
+	  mi[fv1].push_back( cur_pos );
 	  fmIndex[fv0] = mi;
 	}
 	if ( (stats.dataLines() % Progress() ) == 0 ){
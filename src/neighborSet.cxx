@@ -91,6 +91,13 @@ namespace Timbl {
     distributions.push_back( dist.to_VD_Copy() );
   }
 
+  void neighborSet::append( const neighborSet& s, size_t n ){
+    // add a copy of the n-th band of s (if it has one)
+    if ( n < s.size() ){
+      push_back( s.distances[n], *s.distributions[n] );
+    }
+  }
+
   void neighborSet::merge( const neighborSet& s ){
     // reserve enough space to avoid reallocations
     // reallocation invalidates pointers!